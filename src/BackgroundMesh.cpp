@@ -0,0 +1,260 @@
+/*
+ * @file BackgroundMesh.cpp 网格背景与噪声估计定义文件
+ * @date 2026-10-18
+ * @version 0.1
+ */
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include "BackgroundMesh.h"
+
+/*!
+ * @brief 由两级直方图查找第k个像素值(由小到大, 起始为0)
+ */
+static int hist_rank(const uint32_t *fine, const uint32_t *coarse, int k) {
+	int acc(0), b(0), v;
+	for (; b < 255 && acc + int(coarse[b]) <= k; ++b) acc += coarse[b];
+	for (v = b << 8; v < 65535 && acc + int(fine[v]) <= k; ++v) acc += fine[v];
+	return v;
+}
+
+void clipped_mode(const uint16_t *pix, int n, uint32_t *hist, float &mode, float &sigma) {
+	if (n <= 0) {
+		mode = sigma = 0.0f;
+		return;
+	}
+
+	uint32_t *fine = hist, *coarse = hist + 65536;
+	int i, v, lo, hi, nlo, nhi, med;
+	double cnt, sum, sq, mean, sig;
+
+	for (i = 0; i < n; ++i) {
+		++fine[pix[i]];
+		++coarse[pix[i] >> 8];
+	}
+	// 由四分位距估计初值, 仅统计中值±5σ内的像素
+	med = hist_rank(fine, coarse, n / 2);
+	sig = std::max((hist_rank(fine, coarse, n * 3 / 4) - hist_rank(fine, coarse, n / 4)) / 1.349, 1.0);
+	lo  = std::max(med - int(5.0 * sig) - 1, 0);
+	hi  = std::min(med + int(5.0 * sig) + 1, 65535);
+	mean = med;
+	for (int iter = 0; iter < 10; ++iter) {// 迭代3σ裁剪
+		cnt = sum = sq = 0.0;
+		for (v = lo; v <= hi; ++v) {
+			if (!fine[v]) continue;
+			cnt += fine[v];
+			sum += double(fine[v]) * v;
+			sq  += double(fine[v]) * v * v;
+		}
+		if (cnt < 1.0) break;
+		mean = sum / cnt;
+		sig  = sqrt(std::max(sq / cnt - mean * mean, 0.0));
+		nlo = std::max(int(ceil(mean - 3.0 * sig)), 0);
+		nhi = std::min(int(floor(mean + 3.0 * sig)), 65535);
+		if (nlo == lo && nhi == hi) break;
+		lo = nlo;
+		hi = nhi;
+	}
+	// 裁剪后中值: 累计直方图线性插值, 像素值v对应区间[v - 0.5, v + 0.5)
+	double half(0.0), acc(0.0), median(med);
+	for (v = lo; v <= hi; ++v) half += fine[v];
+	half *= 0.5;
+	for (v = lo; v <= hi; ++v) {
+		if (fine[v] && acc + fine[v] >= half) {
+			median = v - 0.5 + (half - acc) / fine[v];
+			break;
+		}
+		acc += fine[v];
+	}
+	mode  = float(sig > 0.0 && fabs(mean - median) < 0.3 * sig ? 2.5 * median - 1.5 * mean : median);
+	sigma = float(sig);
+
+	for (i = 0; i < n; ++i) fine[pix[i]] = 0;
+	memset(coarse, 0, 256 * sizeof(uint32_t));
+}
+
+/*!
+ * @brief 计算Catmull-Rom插值权重
+ * @param t 位于第2与第3个节点之间的位置, [0, 1)
+ * @param w 4个节点的权重
+ */
+static inline void cubic_weight(float t, float *w) {
+	float t2 = t * t, t3 = t2 * t;
+	w[0] = 0.5f * (-t + 2.0f * t2 - t3);
+	w[1] = 0.5f * (2.0f - 5.0f * t2 + 3.0f * t3);
+	w[2] = 0.5f * (t + 4.0f * t2 - 3.0f * t3);
+	w[3] = 0.5f * (t3 - t2);
+}
+
+BackgroundMesh::BackgroundMesh(int mesh, int filter, int nthread) {
+	mesh_    = mesh < 8 ? 8 : mesh;
+	filter_  = filter;
+	nthread_ = nthread > 0 ? nthread : int(boost::thread::hardware_concurrency());
+	if (nthread_ <= 0) nthread_ = 1;
+	width_ = height_ = 0;
+	nx_ = ny_ = 0;
+	gback_ = grms_ = 0.0f;
+	data_ = NULL;
+	nextband_ = 0;
+}
+
+BackgroundMesh::~BackgroundMesh() {
+}
+
+bool BackgroundMesh::Estimate(const uint16_t *data, int width, int height) {
+	if (width < mesh_ || height < mesh_) return false;
+
+	width_  = width;
+	height_ = height;
+	nx_ = width / mesh_;
+	ny_ = height / mesh_;
+	back_.assign(nx_ * ny_, 0.0f);
+	rms_.assign(nx_ * ny_, 0.0f);
+	data_ = data;
+	nextband_ = 0;
+
+	int n = std::min(nthread_, ny_);
+	if (n <= 1) thread_band();
+	else {
+		boost::thread_group thrds;
+		for (int i = 0; i < n; ++i) thrds.create_thread(boost::bind(&BackgroundMesh::thread_band, this));
+		thrds.join_all();
+	}
+	data_ = NULL;
+
+	xnode_.resize(width);
+	xweight_.resize(width * 4);
+	for (int x = 0; x < width; ++x) {// 首尾半个网格取网格值
+		float gx = (x + 0.5f) / mesh_ - 0.5f, *w = &xweight_[x * 4];
+		int ix = int(floorf(gx));
+		if (ix < 0 || ix >= nx_ - 1) {
+			xnode_[x] = ix < 0 ? 0 : nx_ - 1;
+			w[0] = w[2] = w[3] = 0.0f;
+			w[1] = 1.0f;
+		}
+		else {
+			xnode_[x] = ix;
+			cubic_weight(gx - ix, w);
+		}
+	}
+
+	filter_grid(back_);
+	filter_grid(rms_);
+	std::vector<float> tmp(back_);
+	std::nth_element(tmp.begin(), tmp.begin() + tmp.size() / 2, tmp.end());
+	gback_ = tmp[tmp.size() / 2];
+	tmp = rms_;
+	std::nth_element(tmp.begin(), tmp.begin() + tmp.size() / 2, tmp.end());
+	grms_ = tmp[tmp.size() / 2];
+	return true;
+}
+
+void BackgroundMesh::thread_band() {
+	std::vector<std::vector<uint16_t> > bufs(nx_);
+	std::vector<uint32_t> hist(65536 + 256, 0);
+	int iy;
+
+	while ((iy = __sync_fetch_and_add(&nextband_, 1)) < ny_)
+		estimate_band(iy, bufs, &hist[0]);
+}
+
+void BackgroundMesh::estimate_band(int iy, std::vector<std::vector<uint16_t> > &bufs, uint32_t *hist) {
+	int y0 = iy * mesh_;
+	int y1 = iy == ny_ - 1 ? height_ : y0 + mesh_;
+	int ix, x0, w;
+
+	for (ix = 0, x0 = 0; ix < nx_; ++ix, x0 += mesh_) {
+		w = ix == nx_ - 1 ? width_ - x0 : mesh_;
+		bufs[ix].resize(size_t(w) * (y1 - y0));
+	}
+	for (int y = y0; y < y1; ++y) {// 逐行顺序读取, 分发至各网格
+		const uint16_t *row = data_ + size_t(y) * width_;
+		for (ix = 0, x0 = 0; ix < nx_; ++ix, x0 += mesh_) {
+			w = ix == nx_ - 1 ? width_ - x0 : mesh_;
+			memcpy(&bufs[ix][size_t(w) * (y - y0)], row + x0, w * sizeof(uint16_t));
+		}
+	}
+	for (ix = 0; ix < nx_; ++ix) {
+		clipped_mode(&bufs[ix][0], int(bufs[ix].size()), hist, back_[iy * nx_ + ix], rms_[iy * nx_ + ix]);
+	}
+}
+
+void BackgroundMesh::filter_grid(std::vector<float> &grid) {
+	if (filter_ <= 1 || (nx_ == 1 && ny_ == 1)) return;
+
+	std::vector<float> src(grid), win;
+	int half = filter_ / 2;
+	int ix, iy, i, j, hx, hy;
+
+	for (iy = 0; iy < ny_; ++iy) {
+		for (ix = 0; ix < nx_; ++ix) {// 边缘处缩小窗口并保持对称, 不改变线性梯度
+			hx = std::min(half, std::min(ix, nx_ - 1 - ix));
+			hy = std::min(half, std::min(iy, ny_ - 1 - iy));
+			win.clear();
+			for (j = iy - hy; j <= iy + hy; ++j) {
+				for (i = ix - hx; i <= ix + hx; ++i) win.push_back(src[j * nx_ + i]);
+			}
+			std::nth_element(win.begin(), win.begin() + win.size() / 2, win.end());
+			grid[iy * nx_ + ix] = win[win.size() / 2];
+		}
+	}
+}
+
+void BackgroundMesh::InterpolateRow(int y, float *back, float *rms) {
+	std::vector<float> col(nx_ + 3);
+	float gy = (y + 0.5f) / mesh_ - 0.5f, wy[4];
+	int iy = int(floorf(gy)), ix, x, i, k;
+	const std::vector<float> *grids[] = {&back_, &rms_};
+	float *outs[] = {back, rms};
+
+	if (iy < 0 || iy >= ny_ - 1) {// 首尾半个网格取网格值
+		iy = iy < 0 ? 0 : ny_ - 1;
+		wy[0] = wy[2] = wy[3] = 0.0f;
+		wy[1] = 1.0f;
+	}
+	else cubic_weight(gy - iy, wy);
+
+	for (k = 0; k < 2; ++k) {
+		if (!outs[k]) continue;
+		const std::vector<float> &grid = *grids[k];
+		// 纵向插值各网格列, 两端各扩展一个节点. col[ix + 1]对应网格列ix
+		for (ix = 0; ix < nx_; ++ix) {
+			float v(0.0f);
+			for (i = 0; i < 4; ++i) v += wy[i] * grid[std::min(std::max(iy - 1 + i, 0), ny_ - 1) * nx_ + ix];
+			col[ix + 1] = v;
+		}
+		col[0] = col[1];
+		col[nx_ + 1] = col[nx_ + 2] = col[nx_];
+		// 横向插值
+		float *out = outs[k];
+		const float *w = &xweight_[0];
+		for (x = 0; x < width_; ++x, w += 4) {
+			const float *cp = &col[xnode_[x]];
+			out[x] = w[0] * cp[0] + w[1] * cp[1] + w[2] * cp[2] + w[3] * cp[3];
+		}
+	}
+}
+
+void BackgroundMesh::MeshSize(int &nx, int &ny) {
+	nx = nx_;
+	ny = ny_;
+}
+
+float BackgroundMesh::MeshBack(int ix, int iy) {
+	return back_[iy * nx_ + ix];
+}
+
+float BackgroundMesh::MeshRms(int ix, int iy) {
+	return rms_[iy * nx_ + ix];
+}
+
+float BackgroundMesh::GlobalBack() {
+	return gback_;
+}
+
+float BackgroundMesh::GlobalRms() {
+	return grms_;
+}
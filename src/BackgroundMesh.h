@@ -0,0 +1,117 @@
+/*
+ * @file BackgroundMesh.h 网格背景与噪声估计声明文件
+ * @date 2026-10-18
+ * @version 0.1
+ * @note
+ * - 参照SExtractor: 图像划分为mesh×mesh像素网格, 各网格经3σ迭代裁剪后估计众数与σ,
+ *   网格值经中值滤波后以双三次(Catmull-Rom)插值得到逐像素背景与噪声
+ * - 裁剪在两级直方图(65536+256)上进行: 以四分位距估计初值, 仅统计中值±5σ内的像素,
+ *   每个网格只遍历像素两次(计数与清零)
+ * - 网格按行带分配给工作线程. 每个线程逐行扫描其行带, 将像素分发至各网格缓冲区,
+ *   图像按地址顺序读取
+ * - 不足mesh的右侧列与底部行并入相邻网格
+ * - 插值按行进行, 不生成全幅背景图, 供检测等逐行处理的算法使用. 横向插值的节点与权重在估计时预先计算
+ */
+
+#ifndef BACKGROUNDMESH_H_
+#define BACKGROUNDMESH_H_
+
+#include <vector>
+#include <stdint.h>
+
+class BackgroundMesh {
+public:
+	/*!
+	 * @brief 构造函数
+	 * @param mesh    网格边长, 量纲: 像素
+	 * @param filter  网格中值滤波窗口边长, 量纲: 网格. <=1: 不滤波
+	 * @param nthread 工作线程数. <=0: 按CPU核数
+	 */
+	BackgroundMesh(int mesh = 64, int filter = 3, int nthread = 0);
+	virtual ~BackgroundMesh();
+
+protected:
+	/* 成员变量 */
+	int mesh_;		//< 网格边长
+	int filter_;	//< 中值滤波窗口边长
+	int nthread_;	//< 工作线程数
+	int width_, height_;	//< 图像尺寸
+	int nx_, ny_;			//< 网格数量
+	std::vector<float> back_;	//< 网格背景
+	std::vector<float> rms_;	//< 网格噪声
+	float gback_, grms_;		//< 全幅背景与噪声: 网格值的中值
+	std::vector<int> xnode_;	//< 各列横向插值的首个节点
+	std::vector<float> xweight_;//< 各列横向插值的4个权重
+	/* 多线程估计 */
+	const uint16_t *data_;	//< 图像数据
+	int nextband_;			//< 下一个待处理网格行
+
+public:
+	/*!
+	 * @brief 估计网格背景与噪声
+	 * @param data   图像数据
+	 * @param width  图像宽度
+	 * @param height 图像高度
+	 * @return
+	 * 估计结果. 图像小于一个网格时返回false
+	 */
+	bool Estimate(const uint16_t *data, int width, int height);
+	/*!
+	 * @brief 插值一行背景与噪声
+	 * @param y    行序号, 起始为0
+	 * @param back 背景, 长度为图像宽度
+	 * @param rms  噪声, 长度为图像宽度. 可为NULL
+	 */
+	void InterpolateRow(int y, float *back, float *rms);
+	/*!
+	 * @brief 查看网格数量
+	 */
+	void MeshSize(int &nx, int &ny);
+	/*!
+	 * @brief 查看网格背景与噪声
+	 * @param ix 网格X序号
+	 * @param iy 网格Y序号
+	 */
+	float MeshBack(int ix, int iy);
+	float MeshRms(int ix, int iy);
+	/*!
+	 * @brief 查看全幅背景: 网格背景的中值
+	 */
+	float GlobalBack();
+	/*!
+	 * @brief 查看全幅噪声: 网格噪声的中值
+	 */
+	float GlobalRms();
+
+protected:
+	/*!
+	 * @brief 线程: 估计网格行
+	 */
+	void thread_band();
+	/*!
+	 * @brief 估计一行网格
+	 * @param iy   网格行
+	 * @param bufs 各网格像素缓冲区
+	 * @param hist 直方图工作区
+	 */
+	void estimate_band(int iy, std::vector<std::vector<uint16_t> > &bufs, uint32_t *hist);
+	/*!
+	 * @brief 中值滤波网格
+	 * @param grid 网格值
+	 */
+	void filter_grid(std::vector<float> &grid);
+};
+
+/*!
+ * @brief 以迭代3σ裁剪估计像素集合的众数与σ
+ * @param pix   像素
+ * @param n     像素数
+ * @param hist  直方图工作区, 65536+256个计数, 调用前须为0, 函数返回时恢复为0
+ * @param mode  众数
+ * @param sigma σ
+ * @note
+ * 裁剪后平均值与中值相差小于0.3σ时众数取2.5×中值-1.5×平均值, 否则取中值
+ */
+extern void clipped_mode(const uint16_t *pix, int n, uint32_t *hist, float &mode, float &sigma);
+
+#endif /* BACKGROUNDMESH_H_ */
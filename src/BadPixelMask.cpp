@@ -0,0 +1,181 @@
+/*
+ * @file BadPixelMask.cpp 坏像素表定义文件
+ * @date 2026-10-18
+ * @version 0.1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stddef.h>
+#include <vector>
+#include <algorithm>
+#include "BadPixelMask.h"
+
+struct bpm_header {// 文件头
+	char magic[8];	//< 标志
+	int32_t width;	//< 图像宽度
+	int32_t height;	//< 图像高度
+	int32_t columns;	//< 坏列数量. FOCBPM2起
+	int32_t reserved;	//< 保留
+};
+
+static const char bpm_magic[8] = {'F', 'O', 'C', 'B', 'P', 'M', '2', 0};
+static const char bpm_magic1[8] = {'F', 'O', 'C', 'B', 'P', 'M', '1', 0};	// 旧格式: 16字节头, 无坏列数量
+
+/*!
+ * @brief 由直方图计算中值
+ */
+static int hist_median(const std::vector<uint32_t> &hist, size_t total) {
+	size_t sum(0), half((total + 1) / 2);
+	int i(0);
+	for (; i < int(hist.size()) && (sum += hist[i]) < half; ++i);
+	return i;
+}
+
+BadPixelMask::BadPixelMask() {
+	width_ = height_ = 0;
+	count_ = columns_ = 0;
+}
+
+BadPixelMask::~BadPixelMask() {
+}
+
+void BadPixelMask::alloc(int width, int height) {
+	size_t bytes = (size_t(width) * height + 7) / 8 + 8;
+	width_  = width;
+	height_ = height;
+	count_ = columns_ = 0;
+	bits_.reset(new uint8_t[bytes]);
+	memset(bits_.get(), 0, bytes);
+}
+
+bool BadPixelMask::Build(const uint16_t *dark, int width, int height, double nsigma) {
+	if (width <= 0 || height <= 0) return false;
+
+	size_t pixels = size_t(width) * height, k;
+	std::vector<uint32_t> hist(65536, 0);
+	int med, mad, thresh, x, y;
+	uint8_t *bits;
+
+	alloc(width, height);
+	bits = bits_.get();
+	// 热像素
+	for (k = 0; k < pixels; ++k) ++hist[dark[k]];
+	med = hist_median(hist, pixels);
+	std::fill(hist.begin(), hist.end(), 0);
+	for (k = 0; k < pixels; ++k) ++hist[abs(int(dark[k]) - med)];
+	mad = hist_median(hist, pixels);
+	thresh = med + int(nsigma * std::max(1.4826 * mad, 1.0) + 0.5);
+	for (k = 0; k < pixels; ++k) {
+		if (dark[k] > thresh) {
+			bits[k >> 3] |= uint8_t(1 << (k & 7));
+			++count_;
+		}
+	}
+	// 坏列
+	std::vector<double> colsum(width, 0.0), devs;
+	std::vector<int> coln(width, 0);
+	for (y = 0, k = 0; y < height; ++y) {
+		for (x = 0; x < width; ++x, ++k) {
+			if (dark[k] <= thresh) {
+				colsum[x] += dark[k];
+				++coln[x];
+			}
+		}
+	}
+	for (x = 0; x < width; ++x) colsum[x] = coln[x] ? colsum[x] / coln[x] : 65535.0;
+	devs = colsum;
+	std::nth_element(devs.begin(), devs.begin() + width / 2, devs.end());
+	double cmed = devs[width / 2];
+	for (x = 0; x < width; ++x) devs[x] = fabs(colsum[x] - cmed);
+	std::nth_element(devs.begin(), devs.begin() + width / 2, devs.end());
+	double climit = nsigma * std::max(1.4826 * devs[width / 2], 0.5);
+	for (x = 0; x < width; ++x) {
+		if (fabs(colsum[x] - cmed) <= climit) continue;
+		++columns_;
+		for (y = 0, k = x; y < height; ++y, k += width) {
+			if (!(bits[k >> 3] & (1 << (k & 7)))) {
+				bits[k >> 3] |= uint8_t(1 << (k & 7));
+				++count_;
+			}
+		}
+	}
+	return true;
+}
+
+bool BadPixelMask::Load(const std::string &filepath) {
+	FILE *fp = fopen(filepath.c_str(), "rb");
+	bpm_header hdr;
+	bool rslt(false);
+
+	if (!fp) return false;
+	const size_t base = offsetof(bpm_header, columns);
+	bool v1(false);
+	if (fread(&hdr, base, 1, fp) == 1
+			&& ((v1 = !memcmp(hdr.magic, bpm_magic1, sizeof(bpm_magic1)))
+				|| (!memcmp(hdr.magic, bpm_magic, sizeof(bpm_magic)) && fread(&hdr.columns, sizeof(hdr) - base, 1, fp) == 1))
+			&& hdr.width > 0 && hdr.height > 0) {
+		alloc(hdr.width, hdr.height);
+		size_t bytes = (size_t(width_) * height_ + 7) / 8;
+		rslt = fread(bits_.get(), 1, bytes, fp) == bytes;
+		for (size_t i = 0; rslt && i < bytes; ++i) count_ += __builtin_popcount(bits_[i]);
+		if (rslt) columns_ = v1 ? masked_columns() : hdr.columns;
+	}
+	fclose(fp);
+	if (!rslt) width_ = height_ = count_ = columns_ = 0;
+	return rslt;
+}
+
+bool BadPixelMask::Save(const std::string &filepath) {
+	if (!width_) return false;
+
+	std::string tmppath = filepath + ".tmp";
+	FILE *fp = fopen(tmppath.c_str(), "wb");
+	size_t bytes = (size_t(width_) * height_ + 7) / 8;
+	bpm_header hdr;
+	bool rslt;
+
+	if (!fp) return false;
+	memcpy(hdr.magic, bpm_magic, sizeof(bpm_magic));
+	hdr.width   = width_;
+	hdr.height  = height_;
+	hdr.columns = columns_;
+	hdr.reserved = 0;
+	rslt = fwrite(&hdr, sizeof(hdr), 1, fp) == 1 && fwrite(bits_.get(), 1, bytes, fp) == bytes;
+	rslt = !fclose(fp) && rslt && !rename(tmppath.c_str(), filepath.c_str()); // 替换完整文件
+	if (!rslt) remove(tmppath.c_str());
+	return rslt;
+}
+
+int BadPixelMask::Width() {
+	return width_;
+}
+
+int BadPixelMask::Height() {
+	return height_;
+}
+
+int BadPixelMask::Count() {
+	return count_;
+}
+
+int BadPixelMask::Columns() {
+	return columns_;
+}
+
+int BadPixelMask::masked_columns() {
+	const uint8_t *bits = bits_.get();
+	int n(0), x, y;
+	size_t k;
+	for (x = 0; x < width_; ++x) {
+		for (y = 0, k = x; y < height_ && (bits[k >> 3] & (1 << (k & 7))); ++y, k += width_);
+		if (y == height_) ++n;
+	}
+	return n;
+}
+
+const uint8_t *BadPixelMask::Bits() {
+	return bits_.get();
+}
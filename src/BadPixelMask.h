@@ -0,0 +1,92 @@
+/*
+ * @file BadPixelMask.h 坏像素表声明文件
+ * @date 2026-10-18
+ * @version 0.1
+ * @note
+ * - 坏像素表为全幅位图, 每像素1位, 低位在前. 4k×4k图像占用2MB
+ * - 由合并暗场生成: 热像素与坏列
+ * @li 热像素: 高于全幅中值+nsigma×σ, σ由MAD估计
+ * @li 坏列: 剔除热像素后的列平均值偏离各列平均值的中值超过nsigma×σ
+ * - 文件格式: 24字节头(标志FOCBPM2与宽度、高度、坏列数量, 主机字节序)后接位图.
+ *   兼容读取16字节头的FOCBPM1文件, 坏列数量由整列屏蔽的列统计
+ */
+
+#ifndef BADPIXELMASK_H_
+#define BADPIXELMASK_H_
+
+#include <string>
+#include <stdint.h>
+#include <boost/smart_ptr.hpp>
+
+class BadPixelMask {
+public:
+	BadPixelMask();
+	virtual ~BadPixelMask();
+
+protected:
+	/* 成员变量 */
+	int width_, height_;	//< 图像尺寸
+	int count_;		//< 坏像素数量
+	int columns_;	//< 坏列数量
+	boost::shared_array<uint8_t> bits_;	//< 位图
+
+public:
+	/*!
+	 * @brief 由合并暗场生成坏像素表
+	 * @param dark   合并暗场
+	 * @param width  图像宽度
+	 * @param height 图像高度
+	 * @param nsigma 判定阈值, 量纲: σ
+	 * @return
+	 * 生成结果
+	 */
+	bool Build(const uint16_t *dark, int width, int height, double nsigma = 5.0);
+	/*!
+	 * @brief 由文件加载坏像素表
+	 * @param filepath 文件路径
+	 * @return
+	 * 加载结果
+	 */
+	bool Load(const std::string &filepath);
+	/*!
+	 * @brief 将坏像素表存储为文件
+	 * @param filepath 文件路径
+	 * @return
+	 * 存储结果
+	 */
+	bool Save(const std::string &filepath);
+	/*!
+	 * @brief 查看图像宽度
+	 */
+	int Width();
+	/*!
+	 * @brief 查看图像高度
+	 */
+	int Height();
+	/*!
+	 * @brief 查看坏像素数量
+	 */
+	int Count();
+	/*!
+	 * @brief 查看坏列数量
+	 */
+	int Columns();
+	/*!
+	 * @brief 查看位图
+	 * @return
+	 * 位图. 末尾多分配8字节, 供mask_fill_u16()读取
+	 */
+	const uint8_t *Bits();
+
+protected:
+	/*!
+	 * @brief 按图像尺寸分配并清空位图
+	 */
+	void alloc(int width, int height);
+	/*!
+	 * @brief 统计整列屏蔽的列数, 用于旧格式文件
+	 */
+	int masked_columns();
+};
+
+#endif /* BADPIXELMASK_H_ */
@@ -0,0 +1,297 @@
+/*
+ * @file Calibrator.cpp 实时定标定义文件
+ * @date 2026-10-18
+ * @version 0.1
+ */
+
+#include <glob.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "Calibrator.h"
+#include "GLog.h"
+#include "pixkernel.h"
+#include "numamem.h"
+
+struct fits_plane {// 由FITS文件读取的图像
+	int width, height;	//< 图像尺寸
+	double exptime;		//< 曝光时间, 量纲: 秒
+	boost::shared_array<float> data;	//< 图像数据
+};
+
+/*!
+ * @brief 查找目录中文件名排序最后的匹配文件
+ * @param pattern 文件名通配符
+ * @return
+ * 文件路径. 空: 无匹配文件
+ */
+static std::string find_latest(const std::string &pattern) {
+	glob_t gl;
+	std::string filepath;
+
+	if (!glob(pattern.c_str(), 0, NULL, &gl) && gl.gl_pathc) filepath = gl.gl_pathv[gl.gl_pathc - 1];
+	globfree(&gl);
+	return filepath;
+}
+
+/*!
+ * @brief 查找FITS头关键字的值
+ * @param card 关键字卡片, 80字节
+ * @param key  关键字
+ * @param val  关键字的值
+ * @return
+ * 匹配关键字时返回true
+ */
+static bool fits_card(const char *card, const char *key, double &val) {
+	int n = strlen(key);
+	if (strncmp(card, key, n) || (card[n] != ' ' && card[n] != '=') || card[8] != '=') return false;
+	char buff[72];
+	memcpy(buff, card + 10, 70);
+	buff[70] = 0;
+	val = atof(buff);
+	return true;
+}
+
+/*!
+ * @brief 以mmap映射FITS文件, 并将主HDU图像转换为主机字节序浮点数
+ * @param filepath 文件路径
+ * @param plane    图像
+ * @return
+ * 读取结果. 仅支持BITPIX=16与-32的二维图像
+ */
+static bool load_fits(const std::string &filepath, fits_plane &plane) {
+	int fd = open(filepath.c_str(), O_RDONLY);
+	struct stat st;
+	if (fd < 0) return false;
+	if (fstat(fd, &st) || st.st_size < 2880) {
+		close(fd);
+		return false;
+	}
+
+	size_t size = size_t(st.st_size);
+	void *ptr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (ptr == MAP_FAILED) return false;
+	madvise(ptr, size, MADV_SEQUENTIAL);
+
+	const char *card = (const char*) ptr;
+	double bitpix(0), naxis(0), w(0), h(0), bzero(0), bscale(1), val;
+	size_t ncard(0), offset, pixels;
+	bool end(false);
+
+	plane.exptime = 0.0;
+	for (; !end && (ncard + 1) * 80 <= size; ++ncard, card += 80) {
+		if (!strncmp(card, "END     ", 8)) end = true;
+		else if (fits_card(card, "BITPIX", val)) bitpix = val;
+		else if (fits_card(card, "NAXIS", val))  naxis = val;
+		else if (fits_card(card, "NAXIS1", val)) w = val;
+		else if (fits_card(card, "NAXIS2", val)) h = val;
+		else if (fits_card(card, "BZERO", val))  bzero = val;
+		else if (fits_card(card, "BSCALE", val)) bscale = val;
+		else if (fits_card(card, "EXPTIME", val)) plane.exptime = val;
+	}
+	offset = (ncard * 80 + 2879) / 2880 * 2880;
+	plane.width  = int(w);
+	plane.height = int(h);
+	pixels = size_t(plane.width) * plane.height;
+	if (!end || int(naxis) != 2 || !pixels || (int(bitpix) != 16 && int(bitpix) != -32)
+			|| offset + pixels * (int(bitpix) == 16 ? 2 : 4) > size) {
+		munmap(ptr, size);
+		return false;
+	}
+
+	const uint8_t *src = (const uint8_t*) ptr + offset;
+	float *dst;
+	plane.data.reset(dst = new float[pixels]);
+	if (int(bitpix) == 16) {
+		for (size_t i = 0; i < pixels; ++i, src += 2)
+			dst[i] = float(int16_t((src[0] << 8) | src[1]) * bscale + bzero);
+	}
+	else {
+		union { uint32_t u; float f; } cvt;
+		for (size_t i = 0; i < pixels; ++i, src += 4) {
+			cvt.u = (uint32_t(src[0]) << 24) | (uint32_t(src[1]) << 16) | (uint32_t(src[2]) << 8) | src[3];
+			dst[i] = float(cvt.f * bscale + bzero);
+		}
+	}
+	munmap(ptr, size);
+	return true;
+}
+
+/*!
+ * @brief 将浮点图像转换为16位无符号整数
+ */
+static boost::shared_array<uint8_t> to_u16(const fits_plane &plane) {
+	size_t pixels = size_t(plane.width) * plane.height;
+	boost::shared_array<uint8_t> buff = numamem_alloc(pixels * sizeof(uint16_t));
+	uint16_t *dst = (uint16_t*) buff.get();
+	const float *src = plane.data.get();
+	float v;
+
+	for (size_t i = 0; i < pixels; ++i) {
+		v = src[i] < 0.0f ? 0.0f : (src[i] > 65535.0f ? 65535.0f : src[i]);
+		dst[i] = uint16_t(v + 0.5f);
+	}
+	return buff;
+}
+
+Calibrator::Calibrator() {
+	width_ = height_ = 0;
+	tdark_    = 0.0;
+	toffset_  = -1.0;
+	pedestal_ = 1000.0f;
+}
+
+Calibrator::~Calibrator() {
+}
+
+bool Calibrator::Load(const std::string &dirname, const std::string &cid) {
+	mutex_lock lck(mtxcal_);
+	const char *type[] = {"bias", "dark", "flat"};
+	std::string filepath;
+	fits_plane plane;
+
+	width_ = height_ = 0;
+	bias_.reset();
+	dark_.reset();
+	gain_.reset();
+	offset_.reset();
+	mask_.reset();
+	toffset_ = -1.0;
+
+	for (int i = 0; i < 3; ++i) {
+		filepath = find_latest(dirname + "/G" + cid + "_m" + type[i] + "_*.fit");
+		if (filepath.empty()) continue;
+		if (!load_fits(filepath, plane)) {
+			gLog.Write(LOG_WARN, "Calibrator::Load()", "Fail to load master %s <%s>", type[i], filepath.c_str());
+			continue;
+		}
+		if (width_ && (plane.width != width_ || plane.height != height_)) {
+			gLog.Write(LOG_WARN, "Calibrator::Load()", "master %s <%s> is %d×%d, expect %d×%d",
+					type[i], filepath.c_str(), plane.width, plane.height, width_, height_);
+			continue;
+		}
+		width_  = plane.width;
+		height_ = plane.height;
+
+		if (i == 0) bias_ = to_u16(plane);
+		else if (i == 1) {
+			dark_  = to_u16(plane);
+			tdark_ = plane.exptime;
+		}
+		else {// 以正值像素的平均值归一化. 非正值像素的系数为0
+			size_t pixels = size_t(width_) * height_, n(0);
+			const float *flat = plane.data.get();
+			double sum(0.0);
+			for (size_t j = 0; j < pixels; ++j) {
+				if (flat[j] > 0.0f) {
+					sum += flat[j];
+					++n;
+				}
+			}
+			if (!n) continue;
+			float mean = float(sum / n);
+			gain_ = numamem_alloc(pixels * sizeof(float));
+			float *gain = (float*) gain_.get();
+			for (size_t j = 0; j < pixels; ++j) gain[j] = flat[j] > 0.0f ? mean / flat[j] : 0.0f;
+		}
+		gLog.Write("master %s for camera<%s>: %s", type[i], cid.c_str(), filepath.c_str());
+	}
+	if (width_ && !gain_) {
+		size_t pixels = size_t(width_) * height_;
+		gain_ = numamem_alloc(pixels * sizeof(float));
+		float *gain = (float*) gain_.get();
+		for (size_t j = 0; j < pixels; ++j) gain[j] = 1.0f;
+	}
+
+	maskptr mask = boost::make_shared<BadPixelMask>();
+	filepath = dirname + "/G" + cid + "_badpix.msk";
+	if (!access(filepath.c_str(), F_OK)) {
+		if (!mask->Load(filepath))
+			gLog.Write(LOG_WARN, "Calibrator::Load()", "Fail to load bad pixel mask <%s>", filepath.c_str());
+		else if (width_ && (mask->Width() != width_ || mask->Height() != height_))
+			gLog.Write(LOG_WARN, "Calibrator::Load()", "bad pixel mask <%s> is %d×%d, expect %d×%d",
+					filepath.c_str(), mask->Width(), mask->Height(), width_, height_);
+		else {
+			mask_   = mask;
+			width_  = mask->Width();
+			height_ = mask->Height();
+			gLog.Write("bad pixel mask for camera<%s>: %s, %d pixels", cid.c_str(), filepath.c_str(), mask->Count());
+		}
+	}
+
+	return width_ > 0;
+}
+
+bool Calibrator::SetMask(maskptr mask) {
+	mutex_lock lck(mtxcal_);
+	if (gain_ && (mask->Width() != width_ || mask->Height() != height_)) return false;
+	mask_   = mask;
+	width_  = mask->Width();
+	height_ = mask->Height();
+	return true;
+}
+
+bool Calibrator::IsValid() {
+	mutex_lock lck(mtxcal_);
+	return width_ > 0;
+}
+
+void Calibrator::make_offset(double expdur) {
+	size_t pixels = size_t(width_) * height_;
+	if (!offset_) offset_ = numamem_alloc(pixels * sizeof(uint16_t));
+	uint16_t *dst = (uint16_t*) offset_.get();
+	const uint16_t *bias = (const uint16_t*) bias_.get();
+	const uint16_t *dark = (const uint16_t*) dark_.get();
+
+	if (dark && tdark_ > 1E-6) {// 暗场包含偏置: offset = bias + (dark - bias) * k
+		float k = float(expdur / tdark_), v;
+		for (size_t i = 0; i < pixels; ++i) {
+			v = bias ? bias[i] + (float(dark[i]) - bias[i]) * k : dark[i] * k;
+			dst[i] = uint16_t(v < 0.0f ? 0.0f : (v > 65535.0f ? 65535.0f : v + 0.5f));
+		}
+	}
+	else if (bias) memcpy(dst, bias, pixels * sizeof(uint16_t));
+	else memset(dst, 0, pixels * sizeof(uint16_t));
+	toffset_ = expdur;
+}
+
+bool Calibrator::Apply(const uint16_t *raw, const ROI &roi, double expdur, uint16_t *dst) {
+	mutex_lock lck(mtxcal_);
+	if (!width_ || roi.xbin != 1 || roi.ybin != 1 || roi.xstart < 1 || roi.ystart < 1
+			|| roi.xstart - 1 + roi.width > width_ || roi.ystart - 1 + roi.height > height_)
+		return false;
+	if (gain_ && fabs(expdur - toffset_) > 1E-6) make_offset(expdur);
+
+	const uint16_t *offset = (const uint16_t*) offset_.get();
+	const float *gain = (const float*) gain_.get();
+	const uint8_t *bits = mask_ ? mask_->Bits() : NULL;
+	size_t start, w(roi.width);
+
+	if (!bits && roi.width == width_) {// 全幅或整行子窗口连续存储
+		start = size_t(roi.ystart - 1) * width_;
+		calib_u16(raw, offset + start, gain + start, pedestal_, dst, w * roi.height);
+	}
+	else if (!bits) {
+		for (int y = 0; y < roi.height; ++y) {
+			start = size_t(roi.ystart - 1 + y) * width_ + roi.xstart - 1;
+			calib_u16(raw + y * w, offset + start, gain + start, pedestal_, dst + y * w, w);
+		}
+	}
+	else {// 逐行定标至行缓存, 再替换坏像素. 行缓存驻留在L1缓存中
+		if (row_.size() < w) row_.resize(w);
+		for (int y = 0; y < roi.height; ++y) {
+			start = size_t(roi.ystart - 1 + y) * width_ + roi.xstart - 1;
+			if (!gain) mask_fill_u16(raw + y * w, bits, start, dst + y * w, w);
+			else {
+				calib_u16(raw + y * w, offset + start, gain + start, pedestal_, &row_[0], w);
+				mask_fill_u16(&row_[0], bits, start, dst + y * w, w);
+			}
+		}
+	}
+	return true;
+}
@@ -0,0 +1,93 @@
+/*
+ * @file Calibrator.h 实时定标声明文件
+ * @date 2026-10-18
+ * @version 0.1
+ * @note
+ * - 合并本底/暗场/平场由目录中的FITS文件加载, 文件名格式为G<相机>_mbias/mdark/mflat_*.fit,
+ *   同类文件有多个时采用文件名排序最后者(时间最新). 各类文件均可缺省
+ * - FITS文件以mmap映射后一次性转换为主机字节序, 随即解除映射
+ * - 暗场包含偏置, 按曝光时间与暗场曝光时间之比缩放暗流. 偏置与暗流之和按曝光时间生成并缓存,
+ *   曝光时间不变时每帧仅需读取原始图像、偏置暗流与平场系数
+ * - 定标结果仅用于分析, 原始图像不变, 仍用于存储
+ * - 坏像素表G<相机>_badpix.msk与合并图像位于同一目录. 定标后以相邻像素替换坏像素;
+ *   仅有坏像素表时只替换坏像素, 不改变其它像素
+ * - 不支持合并模式, 子窗口按ROI区在全幅中的位置定标
+ */
+
+#ifndef CALIBRATOR_H_
+#define CALIBRATOR_H_
+
+#include <string>
+#include <stdint.h>
+#include <boost/smart_ptr.hpp>
+#include <boost/thread.hpp>
+#include <vector>
+#include "CameraBase.h"
+#include "BadPixelMask.h"
+
+class Calibrator {
+public:
+	Calibrator();
+	virtual ~Calibrator();
+
+protected:
+	/* 声明数据类型 */
+	typedef boost::shared_array<uint8_t> bufptr;
+	typedef boost::unique_lock<boost::mutex> mutex_lock;
+	typedef boost::shared_ptr<BadPixelMask> maskptr;
+
+	/* 成员变量 */
+	int width_, height_;	//< 合并图像或坏像素表尺寸
+	bufptr bias_;		//< 合并本底. 空: 缺省
+	bufptr dark_;		//< 合并暗场. 空: 缺省
+	double tdark_;		//< 暗场曝光时间, 量纲: 秒
+	bufptr gain_;		//< 平场归一化系数的倒数, float型. 无平场时为1. 空: 未加载合并图像
+	bufptr offset_;		//< 偏置与暗流之和
+	double toffset_;	//< offset_对应的曝光时间. <0: 未生成
+	float pedestal_;	//< 定标后图像基底
+	maskptr mask_;		//< 坏像素表. 空: 缺省
+	std::vector<uint16_t> row_;	//< 替换坏像素前的定标行
+	boost::mutex mtxcal_;	//< 定标互斥锁
+
+public:
+	/*!
+	 * @brief 加载合并图像
+	 * @param dirname 合并图像所在目录
+	 * @param cid     相机标志
+	 * @return
+	 * 至少加载一类合并图像或坏像素表时返回true
+	 */
+	bool Load(const std::string &dirname, const std::string &cid);
+	/*!
+	 * @brief 替换坏像素表
+	 * @param mask 坏像素表
+	 * @return
+	 * 坏像素表尺寸与已加载合并图像不一致时返回false
+	 */
+	bool SetMask(maskptr mask);
+	/*!
+	 * @brief 检查是否已加载合并图像或坏像素表
+	 * @return
+	 * 加载标志
+	 */
+	bool IsValid();
+	/*!
+	 * @brief 定标一帧图像
+	 * @param raw    原始图像
+	 * @param roi    图像对应的ROI区
+	 * @param expdur 曝光时间, 量纲: 秒
+	 * @param dst    定标后图像, 尺寸与原始图像相同
+	 * @return
+	 * 定标结果. 未加载合并图像与坏像素表、采用合并模式或ROI区超出全幅时返回false
+	 */
+	bool Apply(const uint16_t *raw, const ROI &roi, double expdur, uint16_t *dst);
+
+protected:
+	/*!
+	 * @brief 按曝光时间生成偏置与暗流之和
+	 * @param expdur 曝光时间, 量纲: 秒
+	 */
+	void make_offset(double expdur);
+};
+
+#endif /* CALIBRATOR_H_ */
@@ -54,7 +54,6 @@ bool CameraApogee::OpenCamera() {
 				nfcam_->roi.height = altacam_->GetRoiNumRows();
 				nfcam_->roi.xbin   = altacam_->GetRoiBinCol();
 				nfcam_->roi.ybin   = altacam_->GetRoiBinRow();
-				data.resize(nfcam_->roi.get_width() * nfcam_->roi.get_height());
 			}
 		}
 		return altacam_->IsConnected();
@@ -70,7 +69,6 @@ bool CameraApogee::OpenCamera() {
 }
 
 void CameraApogee::CloseCamera() {
-	data.clear();
 	altacam_->CloseConnection();
 	altacam_.reset();
 }
@@ -102,7 +100,6 @@ void CameraApogee::UpdateGain(uint32_t& index) {
 void CameraApogee::UpdateROI(int& xbin, int& ybin, int& xstart, int& ystart, int& width, int& height) {
 	try {
 		ROI& roi = nfcam_->roi;
-		int n;
 
 		if (xbin != roi.xbin) altacam_->SetRoiBinCol(xbin);
 		if (ybin != roi.ybin) altacam_->SetRoiBinRow(ybin);
@@ -117,7 +114,6 @@ void CameraApogee::UpdateROI(int& xbin, int& ybin, int& xstart, int& ystart, int
 		ystart = altacam_->GetRoiStartRow() + 1;
 		width  = altacam_->GetRoiNumCols();
 		height = altacam_->GetRoiNumRows();
-		if ((n = width * height) > data.capacity()) data.resize(n);
 	}
 	catch(std::runtime_error &ex) {
 		nfcam_->errmsg = ex.what();
@@ -167,9 +163,16 @@ CAMERA_STATUS CameraApogee::CameraState() {
 
 CAMERA_STATUS CameraApogee::DownloadImage() {
 	try {
-		int n = nfcam_->roi.get_width() * nfcam_->roi.get_height();
-		altacam_->GetImage(data);
-		memcpy(nfcam_->data.get(), (char*)&data[0], n * sizeof(unsigned short));
+		size_t n = size_t(nfcam_->roi.get_width()) * nfcam_->roi.get_height();
+		VectorFramePool::vecptr vec = vecpool_.Get();
+		if (vec->size() < n) vec->resize(n); // 回收的vector已具备容量, 不再分配
+		altacam_->GetImage(*vec);
+		if (vec->size() < n) {
+			nfcam_->errmsg = "incomplete image on readout";
+			return CAMERA_ERROR;
+		}
+		// 替换图像数据存储区. 原存储区(缓冲池中的缓冲区)随之释放
+		nfcam_->data = vecpool_.Adopt(vec);
 		return CAMERA_IMGRDY;
 	}
 	catch(...) {
@@ -11,6 +11,7 @@
 #include <apogee/Alta.h>
 #include <vector>
 #include "CameraBase.h"
+#include "FramePool.h"
 
 class CameraApogee: public CameraBase {
 public:
@@ -19,7 +20,7 @@ public:
 
 protected:
 	boost::shared_ptr<Alta> altacam_;	//< 相机SDK接口
-	std::vector<uint16_t> data; 				//< 存储从相机读出的数据
+	VectorFramePool vecpool_;			//< 读出数据存储区. 直接作为图像缓冲区, 不再复制
 
 protected:
 	/*!
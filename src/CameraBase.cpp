@@ -7,11 +7,13 @@
 
 #include <boost/make_shared.hpp>
 #include "CameraBase.h"
+#include "numamem.h"
 
 using namespace std;
 
 CameraBase::CameraBase() {
 	nfcam_ = boost::make_shared<devcam_info>();
+	evtstate_ = false;
 }
 
 CameraBase::~CameraBase() {
@@ -23,6 +25,10 @@ boost::shared_ptr<devcam_info> CameraBase::GetCameraInfo() {
 	return nfcam_;
 }
 
+const camera_stat &CameraBase::GetStatistics() {
+	return stat_;
+}
+
 void CameraBase::register_expose(const ExposeProcess::slot_type& slot) {
 	exposeproc_.connect(slot);
 }
@@ -42,7 +48,7 @@ bool CameraBase::Connect() {
 	nfcam_->roi.reset(nfcam_->wsensor, nfcam_->hsensor);
 	n = nfcam_->roi.get_width() * nfcam_->roi.get_height();
 	n = (n * 2 + 15) & ~15;	// 长度对准16字节
-	nfcam_->data.reset(new uint8_t[n]);
+	nfcam_->data = numamem_alloc(n);
 	// 线程
 	thrdIdle_.reset(new boost::thread(boost::bind(&CameraBase::ThreadIdle, this)));
 	thrdExpose_.reset(new boost::thread(boost::bind(&CameraBase::ThreadExpose, this)));
@@ -122,7 +128,7 @@ void CameraBase::SetROI(int xbin, int ybin, int xstart, int ystart, int width, i
 
 	/* 更新ROI区 */
 	ROI& roi = nfcam_->roi;
-	int oldn = roi.get_width() * roi.get_height();
+	int oldn = (roi.get_width() * roi.get_height() * 2 + 15) & ~15;
 	int newn;
 
 	UpdateROI(xbin, ybin, xstart, ystart, width, height);
@@ -133,7 +139,7 @@ void CameraBase::SetROI(int xbin, int ybin, int xstart, int ystart, int width, i
 	if (roi.width != width)   roi.width = width;
 	if (roi.height != height) roi.height = height;
 	newn = (roi.get_width() * roi.get_height() * 2 + 15) & ~15;
-	if (oldn != newn) nfcam_->data.reset(new uint8_t[newn]);
+	if (oldn != newn) nfcam_->data = numamem_alloc(newn);
 }
 
 void CameraBase::SetADCOffset(uint16_t offset) {
@@ -146,10 +152,16 @@ void CameraBase::SetADCOffset(uint16_t offset) {
 
 bool CameraBase::Expose(double duration, bool light) {
 	if (!nfcam_->connected || nfcam_->state >= CAMERA_EXPOSE) return false;
+	nfcam_->trace.reset();
+	nfcam_->trace.mark(TP_EXPOSE_BEGIN);
 	if (!StartExpose(duration, light)) return false;
+	nfcam_->trace.mark(TP_EXPOSE_START);
 
-	nfcam_->begin_expose(duration);
-	condexp_.notify_one();
+	{
+		mutex_lock lck(mtxexp_);
+		nfcam_->begin_expose(duration);
+		condexp_.notify_one();
+	}
 	nfcam_->format_utc();
 	nfcam_->check_ampm();
 
@@ -160,6 +172,12 @@ void CameraBase::AbortExpose() {
 	if (nfcam_->state >= CAMERA_EXPOSE) StopExpose();
 }
 
+boost::shared_array<uint8_t> CameraBase::SwapImage(boost::shared_array<uint8_t> buff) {
+	if (nfcam_->state == CAMERA_EXPOSE || !buff) return boost::shared_array<uint8_t>();
+	nfcam_->data.swap(buff);
+	return buff;
+}
+
 void CameraBase::ThreadIdle() {
 	boost::chrono::seconds duration(6);
 
@@ -170,29 +188,47 @@ void CameraBase::ThreadIdle() {
 }
 
 void CameraBase::ThreadExpose() {
-	boost::mutex mtx;    // 哑元
-	mutex_lock lck(mtx);
 	boost::chrono::milliseconds duration;	// 等待周期
 	double left;
 	CAMERA_STATUS& status = nfcam_->state;
 	int ms;
 
 	while (true) {
-		condexp_.wait(lck);
-		while ((status = CameraState()) == CAMERA_EXPOSE) {// 监测曝光过程
+		{// 等待曝光开始
+			mutex_lock lck(mtxexp_);
+			while (status != CAMERA_EXPOSE) condexp_.wait(lck);
+		}
+		/*
+		 * 监测曝光过程
+		 * - 事件驱动: 以100毫秒周期回调进度, 状态变化时由NotifyState()立即唤醒
+		 * - 轮询: 按剩余曝光时间休眠, 积分结束后以10毫秒周期查询状态
+		 */
+		while ((status = CameraState()) == CAMERA_EXPOSE) {
 			nfcam_->check_expose(left);
-			if (left > 0.1) ms = 100;
-			else ms = int(left * 1000);
-			duration = boost::chrono::milliseconds(ms);
-
 			exposeproc_(left, nfcam_->percent, (int) status);
-			if (ms > 0) boost::this_thread::sleep_for(duration);
+
+			if (evtstate_) {
+				mutex_lock lck(mtxstate_);
+				if (CameraState() == CAMERA_EXPOSE)
+					condstate_.wait_for(lck, boost::chrono::milliseconds(100));
+			}
+			else {
+				if (left > 0.1) ms = 100;
+				else if ((ms = int(left * 1000)) < 10) ms = 10;
+				duration = boost::chrono::milliseconds(ms);
+				boost::this_thread::sleep_for(duration);
+			}
 		}
 		if (status == CAMERA_IMGRDY) {
+			nfcam_->trace.mark(TP_IMGRDY);
 			nfcam_->end_expose();
-			exposeproc_(0.0, 100.0, (int) CAMERA_EXPOSE);
+			exposeproc_(0.0, 100.0, (int) CAMERA_READOUT);
 			status = DownloadImage();
+			nfcam_->trace.mark(TP_DOWNLOAD);
+			if (status == CAMERA_IMGRDY) nfcam_->trace.settle(nfcam_->eduration);
+			__sync_fetch_and_add(status == CAMERA_IMGRDY ? &stat_.frames : &stat_.failed, 1);
 		}
+		else __sync_fetch_and_add(&stat_.failed, 1);
 		/*
 		 * 此时状态三种可能:
 		 * 1) CAMERA_IMGRDY: 正常结束, 可以存储图像等
@@ -204,6 +240,11 @@ void CameraBase::ThreadExpose() {
 	}
 }
 
+void CameraBase::NotifyState() {
+	mutex_lock lck(mtxstate_);
+	condstate_.notify_all();
+}
+
 void CameraBase::ExitThread(threadptr &thrd) {
 	if (thrd.unique()) {
 		thrd->interrupt();
@@ -13,12 +13,14 @@
 #define CAMERABASE_H_
 
 #include <string>
+#include <string.h>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/interprocess/ipc/message_queue.hpp>
 #include <boost/smart_ptr.hpp>
 #include <boost/thread.hpp>
 #include <boost/format.hpp>
 #include <boost/signals2.hpp>
+#include "pipetrace.h"
 
 using namespace boost::posix_time;
 
@@ -27,6 +29,7 @@ enum CAMERA_STATUS {// 相机工作状态
 	CAMERA_IDLE,	// 空闲
 	CAMERA_EXPOSE,	// 曝光过程中
 	CAMERA_IMGRDY,	// 已完成曝光, 可以读出数据进入内存
+	CAMERA_READOUT,	// 积分结束, 开始读出. 仅用于曝光进度回调, 不作为工作状态
 	CAMERA_LAST		// 占位
 };
 
@@ -91,6 +94,7 @@ struct devcam_info {// 相机设备基本信息
 	std::string utctime;	//< 曝光起始时间, 用于生成文件名, 格式: YYMMDDThhmmssss
 	bool   ampm;			//< true: A.M.; false: P.M.
 	boost::shared_array<uint8_t> data;	//< 图像数据存储区
+	frame_trace trace;		//< 单帧流程时间点与阶段耗时
 
 public:
 	virtual ~devcam_info() {
@@ -157,6 +161,20 @@ public:
 		return percent < 100.0;
 	}
 };
+struct camera_stat {// 相机运行计数. 由曝光线程与数据接收线程原子累加
+	uint64_t frames;	//< 完成读出的帧数
+	uint64_t failed;	//< 未完成读出的曝光次数
+	uint64_t packrcv;	//< 收到的图像数据包. 仅网络相机
+	uint64_t packreq;	//< 申请重传的图像数据包. 仅网络相机
+	uint64_t packlost;	//< 读出结束时仍未收到的图像数据包. 仅网络相机
+	uint64_t skipped;	//< 连续采集时未及读出即被覆盖的帧数
+
+public:
+	camera_stat() {
+		memset(this, 0, sizeof(camera_stat));
+	}
+};
+
 /*!
  * @brief 声明曝光进度回调函数
  * @param <1> 曝光剩余时间, 量纲: 秒
@@ -177,7 +195,12 @@ protected:
 
 	/* 声明成员变量 */
 	boost::shared_ptr<devcam_info> nfcam_;	//< 相机基本信息
+	camera_stat stat_;						//< 运行计数
+	boost::mutex mtxexp_;					//< 曝光开始互斥锁
 	boost::condition_variable condexp_;		//< 通知曝光开始
+	bool evtstate_;		//< 继承类在工作状态离开CAMERA_EXPOSE时调用NotifyState(), 曝光线程不再轮询
+	boost::mutex mtxstate_;					//< 工作状态互斥锁
+	boost::condition_variable condstate_;	//< 通知工作状态变化
 	ExposeProcess exposeproc_;				//< 曝光进度回调函数
 	threadptr thrdIdle_;	//< 线程: 空闲时监测温度
 	threadptr thrdExpose_;	//< 线程: 监测曝光进度和结果
@@ -191,6 +214,12 @@ public:
 
 public:
 	boost::shared_ptr<devcam_info> GetCameraInfo();
+	/*!
+	 * @brief 查看运行计数
+	 * @return
+	 * 运行计数. 各计数单调递增
+	 */
+	const camera_stat &GetStatistics();
 	/*!
 	 * @brief 相机连接标志
 	 * @return
@@ -261,6 +290,15 @@ public:
 	 * @brief 中止当前曝光过程
 	 */
 	void AbortExpose();
+	/*!
+	 * @brief 以新的存储区替换图像数据存储区
+	 * @param buff 新的存储区, 容量不小于当前ROI区图像
+	 * @return
+	 * 原存储区, 即最近一次采集的图像. 若相机正在曝光则返回空指针, 存储区不变
+	 * @note
+	 * 用于图像缓冲池: 曝光完成后取走图像数据, 无需复制
+	 */
+	boost::shared_array<uint8_t> SwapImage(boost::shared_array<uint8_t> buff);
 
 protected:
 	/*!
@@ -271,6 +309,12 @@ protected:
 	 * @brief 曝光线程, 监测曝光进度和结果
 	 */
 	void ThreadExpose();
+	/*!
+	 * @brief 继承类通知工作状态变化
+	 * @note
+	 * 须在CameraState()返回新状态之后调用. 曝光线程随即处理完成或中止, 无需等待轮询周期
+	 */
+	void NotifyState();
 	/*!
 	 * @brief 统一线程结束操作
 	 * @param thrd 线程接口
@@ -13,22 +13,25 @@
 #include "CameraGY.h"
 
 //=============================================================================
-CameraGY::CameraGY(const std::string& camIP) {
+CameraGY::CameraGY(const std::string& camIP, int portLocal) {
 	// 相机控制与工作参数
 	camIP_ 		= camIP;
+	portLocal_	= portLocal;
 	expdur_		= UINT_MAX;
 	shtrmode_	= UINT_MAX;
 	msgcnt_		= 0;
 	tmdata_		= 0;
 	state_		= CAMERA_ERROR;
 	aborted_	= false;
+	hwroi_		= false;
+	evtstate_	= true;
 	// 数据缓冲区
 	byteimg_	= 0;
 	bytercd_	= 0;
 	packtot_	= -1;
 	// 初始化数据传输接口
 	const udp_session::slottype &slot1 = boost::bind(&CameraGY::ReceiveDataCB, this, _1, _2);
-	udpdata_ = boost::make_shared<udp_session>(PORT_LOCAL, true);
+	udpdata_ = boost::make_shared<udp_session>(portLocal, true);
 	udpdata_->register_receive(slot1);
 	// 初始化指令传输接口
 	udpcmd_ = boost::make_shared<udp_session>();
@@ -64,23 +67,20 @@ bool CameraGY::OpenCamera() {
 
 		/* 初始化参数 */
 		Write(0x0A00,     0x03);		// Set GevCCP
-		Write(0x0D00,     PORT_LOCAL);	// Set GevSCPHostPort
+		Write(0x0D00,     portLocal_);	// Set GevSCPHostPort
 		Write(0x0D04,     1500);		// Set PacketSize
 		Write(0x0D08,     0);			// Set PacketDelay
 		Write(0x0D18,     addrHost);	// Set GevSCDA
 		Write(0x0938,     0x2EE0);		// UDP keep time: 12000ms
 		Write(0xA000,     0x01);		// Start AcquisitionSequence
 		// 初始化监测量
-		Read(0xA004, val); nfcam_->wsensor = int(val);
-		Read(0xA008, val); nfcam_->hsensor = int(val);
-		byteimg_ = nfcam_->wsensor * nfcam_->hsensor * 2;
+		Read(REG_WIDTH,  val); nfcam_->wsensor = int(val);
+		Read(REG_HEIGHT, val); nfcam_->hsensor = int(val);
 		Read(0x0D04, packlen_);
 		headlen_ = 8;
 		packlen_ -= (20 + 8 + headlen_); // 20: IP Header; 8: UDP Header; headlen_: Customized Header
-		packtot_ = int(ceil(double(byteimg_ + 64) / packlen_)); // 最后一包多出64字节
 		packlen_ += 4; // 4: buffer header
-		packflag_.reset(new uint8_t[packtot_ + 1]);
-		bufpack_.reset(new uint8_t[(packtot_ + 1) * packlen_]);
+		AllocPackBuffer(nfcam_->wsensor, nfcam_->hsensor);
 		Read(0x00020008, nfcam_->gain);
 		Read(0x0002000C, shtrmode_);
 		Read(0x00020010, expdur_);
@@ -153,7 +153,32 @@ void CameraGY::UpdateGain(uint32_t& index) {
 // 更新ROI区域
 void CameraGY::UpdateROI(int& xbin, int& ybin,
 		int& xstart, int& ystart, int& width, int& height) {
-//...不支持该功能
+	if (state_ != CAMERA_IDLE) return;
+	if (!hwroi_) {// 未启用硬件ROI: 保持全幅, 不访问寄存器
+		xbin = ybin = 1;
+		xstart = ystart = 1;
+		width  = nfcam_->wsensor;
+		height = nfcam_->hsensor;
+		return;
+	}
+
+	try {
+		WriteGeometry(xbin, ybin, xstart, ystart, width, height);
+	}
+	catch(std::runtime_error& ex) {// 恢复全幅
+		nfcam_->errmsg = ex.what();
+		xbin = ybin = 1;
+		xstart = ystart = 1;
+		width  = nfcam_->wsensor;
+		height = nfcam_->hsensor;
+		try {
+			WriteGeometry(xbin, ybin, xstart, ystart, width, height);
+		}
+		catch(std::runtime_error& ex) {
+			nfcam_->errmsg = ex.what();
+		}
+	}
+	AllocPackBuffer(width / xbin, height / ybin);
 }
 
 void CameraGY::UpdateADCOffset(uint16_t offset) {
@@ -213,6 +238,7 @@ void CameraGY::StopExpose() {
 		state_ = CAMERA_ERROR;
 		if (state == CAMERA_IMGRDY) imgrdy_.notify_one();	// 中断读出过程
 	}
+	if (state == CAMERA_EXPOSE) NotifyState();
 }
 
 // 相机工作状态
@@ -233,9 +259,16 @@ CAMERA_STATUS CameraGY::DownloadImage() {
 	CAMERA_STATUS state;
 	boost::mutex tmp;
 	mutex_lock lck(tmp);
-	imgrdy_.wait(lck); // 等待图像就绪标志
+	boost::posix_time::milliseconds period(10);
+	// 等待图像就绪标志. 数据可能在进入等待前已接收完毕, 故以状态为准并限时等待
+	while (!aborted_ && bytercd_ != byteimg_ && state_ == CAMERA_IMGRDY) imgrdy_.timed_wait(lck, period);
 
 	state = state_;
+	if (bytercd_ != byteimg_) {// 统计丢失数据包
+		uint64_t lost(0);
+		for (int i = 1; i <= packtot_; ++i) lost += !packflag_[i];
+		__sync_fetch_and_add(&stat_.packlost, lost);
+	}
 	if (!aborted_ && bytercd_ == byteimg_) {// 合并数据
 		uint8_t *data = nfcam_->data.get();
 		uint8_t *buff = bufpack_.get() + packlen_;
@@ -252,6 +285,65 @@ CAMERA_STATUS CameraGY::DownloadImage() {
 	return state;
 }
 
+void CameraGY::WriteGeometry(int& xbin, int& ybin, int& xstart, int& ystart, int& width, int& height) {
+	uint32_t val[6] = {1, 1, 0, 0};
+	// 电控不支持合并或偏移时, 恢复1×1或零偏移无需访问对应寄存器
+	bool binning = xbin != 1 || ybin != 1 || nfcam_->roi.xbin != 1 || nfcam_->roi.ybin != 1;
+	bool offset  = xstart != 1 || ystart != 1 || nfcam_->roi.xstart != 1 || nfcam_->roi.ystart != 1;
+
+	Write(0xA000, 0x00);	// Stop AcquisitionSequence
+	if (binning) {
+		Write(REG_BINNINGH, xbin);
+		Write(REG_BINNINGV, ybin);
+	}
+	// 先清零偏移再更改尺寸, 避免中间状态越界
+	if (offset) {
+		Write(REG_OFFSETX, 0);
+		Write(REG_OFFSETY, 0);
+	}
+	Write(REG_WIDTH,   width / xbin);
+	Write(REG_HEIGHT,  height / ybin);
+	if (offset) {
+		Write(REG_OFFSETX, (xstart - 1) / xbin);
+		Write(REG_OFFSETY, (ystart - 1) / ybin);
+	}
+	Write(0xA000, 0x01);	// Start AcquisitionSequence
+	// 以回读值为准
+	if (binning) {
+		Read(REG_BINNINGH, val[0]);
+		Read(REG_BINNINGV, val[1]);
+	}
+	if (offset) {
+		Read(REG_OFFSETX,  val[2]);
+		Read(REG_OFFSETY,  val[3]);
+	}
+	Read(REG_WIDTH,    val[4]);
+	Read(REG_HEIGHT,   val[5]);
+	xbin   = val[0] ? int(val[0]) : 1;
+	ybin   = val[1] ? int(val[1]) : 1;
+	xstart = int(val[2]) * xbin + 1;
+	ystart = int(val[3]) * ybin + 1;
+	width  = int(val[4]) * xbin;
+	height = int(val[5]) * ybin;
+}
+
+void CameraGY::AllocPackBuffer(int width, int height) {
+	uint32_t payload = packlen_ - 4;
+
+	byteimg_ = uint32_t(width) * height * 2;
+	packtot_ = int(ceil(double(byteimg_ + 64) / payload)); // 最后一包多出64字节
+	packflag_.reset(new uint8_t[packtot_ + 1]);
+	bufpack_ = numamem_alloc(size_t(packtot_ + 1) * packlen_);
+}
+
+bool CameraGY::PinReceiveThread(const std::string &cpus) {
+	return pin_thread(udpdata_->native_handle(), cpus);
+}
+
+void CameraGY::EnableHardwareROI(bool enable) {
+	hwroi_ = enable;
+}
+
 uint16_t CameraGY::MsgCount() {
 	if (++msgcnt_ == 0) msgcnt_ = 1;
 	return msgcnt_;
@@ -315,6 +407,7 @@ void CameraGY::Retransmit(uint32_t iPack0, uint32_t iPack1) {
 	((uint32_t*)&buff)[3] = htonl(iPack0);
 	((uint32_t*)&buff)[4] = htonl(iPack1);
 	udpcmd_->write(buff.c_array(), buff.size());
+	if (iPack1 >= iPack0) __sync_fetch_and_add(&stat_.packreq, uint64_t(iPack1 - iPack0 + 1));
 }
 
 uint32_t CameraGY::GetHostAddr() {
@@ -431,7 +524,11 @@ void CameraGY::ReceiveDataCB(const long udp, const long len) {
 	if (bytercd_ == byteimg_ || !(state_ == CAMERA_EXPOSE || state_ == CAMERA_IMGRDY))
 		return;
 
-	if (state_ == CAMERA_EXPOSE && !aborted_) state_ = CAMERA_IMGRDY;
+	if (state_ == CAMERA_EXPOSE && !aborted_) {// 首个数据包: 积分结束, 立即通知曝光线程
+		state_ = CAMERA_IMGRDY;
+		nfcam_->trace.mark(TP_FIRST_PACKET);
+		NotifyState();
+	}
 	UpdateTimeFlag(tmdata_);
 
 	int n;
@@ -452,12 +549,14 @@ void CameraGY::ReceiveDataCB(const long udp, const long len) {
 			uint8_t *ptr = bufpack_.get() + idPack * packlen_;
 
 			packflag_[idPack] = 1;
+			__sync_fetch_and_add(&stat_.packrcv, 1);
 			if (idPack == packtot_) packlen -= 64;
 			((uint32_t*) ptr)[0] = packlen;
 			memcpy(ptr + 4, pack + headlen_, packlen);
 			bytercd_ += packlen;
 
 			if (bytercd_ == byteimg_) {// 若已接收所有数据
+				nfcam_->trace.mark(TP_LAST_PACKET);
 				imgrdy_.notify_one();
 			}
 			else {
@@ -23,6 +23,7 @@
 
 #include "CameraBase.h"
 #include "udp_asio.h"
+#include "numamem.h"
 
 //=============================================================================
 /* 定义 */
@@ -42,6 +43,19 @@
 #define ID_LEADER	0x01	// 引导数据包
 #define ID_TRAILER	0x02	// 结尾数据包
 #define ID_PAYLOAD	0x03	// 图像数据包
+/*!
+ * @note 图像几何寄存器, 以合并后像素为单位
+ * - 相机打开时读取的宽度/高度即全幅尺寸
+ * - 偏移与合并寄存器地址尚未经电控GenICam描述确认, 默认不访问,
+ *   由EnableHardwareROI()显式启用
+ * - 电控不支持偏移或合并时写入失败, ROI区恢复为全幅
+ */
+#define REG_WIDTH		0xA004	// 宽度
+#define REG_HEIGHT		0xA008	// 高度
+#define REG_OFFSETX		0xA00C	// X轴偏移, 起始为0
+#define REG_OFFSETY		0xA010	// Y轴偏移, 起始为0
+#define REG_BINNINGH	0xA014	// X轴合并因子
+#define REG_BINNINGV	0xA018	// Y轴合并因子
 
 //=============================================================================
 using boost::asio::ip::udp;
@@ -49,7 +63,12 @@ using boost::asio::ip::udp;
 /* 港宇相机控制接口 */
 class CameraGY: public CameraBase {
 public:
-	CameraGY(const std::string& camIP);
+	/*!
+	 * @brief 构造函数
+	 * @param camIP     相机IP地址
+	 * @param portLocal 本地UDP数据端口. 同一进程控制多台相机时, 各相机须采用不同端口
+	 */
+	CameraGY(const std::string& camIP, int portLocal = PORT_LOCAL);
 	virtual ~CameraGY();
 
 public:
@@ -81,6 +100,22 @@ public:
 	 * 更改后网关
 	 */
 	const char *SetGateway(const char *gateway);
+	/*!
+	 * @brief 将图像数据接收线程绑定至CPU列表
+	 * @param cpus CPU列表, 如"0-3,8"
+	 * @return
+	 * 绑定结果
+	 * @note
+	 * 宜与网卡中断及包缓存区位于同一NUMA节点
+	 */
+	bool PinReceiveThread(const std::string &cpus);
+	/*!
+	 * @brief 启用硬件ROI与合并
+	 * @param enable 启用标志. 禁用时ROI区保持全幅, 不写入偏移与合并寄存器
+	 * @note
+	 * 应在连接相机前调用
+	 */
+	void EnableHardwareROI(bool enable);
 
 protected:
 	/* 纯虚函数, 继承类实现 */
@@ -212,6 +247,24 @@ private:
 	 * 更新后网络参数. 若更新失败则返回空字符串
 	 */
 	const char *UpdateNetwork(const uint32_t addr, const char *vstr);
+	/*!
+	 * @brief 写入图像几何寄存器并回读
+	 * @param xbin   X轴合并因子
+	 * @param ybin   Y轴合并因子
+	 * @param xstart X轴起始位置
+	 * @param ystart Y轴起始位置
+	 * @param width  宽度
+	 * @param height 高度
+	 * @note
+	 * 操作失败抛出异常
+	 */
+	void WriteGeometry(int& xbin, int& ybin, int& xstart, int& ystart, int& width, int& height);
+	/*!
+	 * @brief 按图像尺寸分配包缓存区
+	 * @param width  合并后图像宽度
+	 * @param height 合并后图像高度
+	 */
+	void AllocPackBuffer(int width, int height);
 	/*!
 	 * @brief 心跳机制: 定时向相机发送心跳信号
 	 */
@@ -236,11 +289,13 @@ private:
 	/* 成员变量 */
 	/* 相机工作参数 */
 	std::string camIP_;		//< 相机IP地址
+	int portLocal_;			//< 本地UDP数据端口
 	uint32_t expdur_;		//< 曝光时间, 量纲: 微秒
 	uint32_t shtrmode_;		//< 快门模式. 0: Normal; 1: AlwaysOpen; 2: AlwaysClose
 //	uint32_t gain_;			//< 增益. 0: 1x; 1: 2x; 2: 3x. x: e-/ADU
 	CAMERA_STATUS state_;	//< 工作状态
 	bool aborted_;			//< 中止曝光标识
+	bool hwroi_;			//< 启用硬件ROI与合并
 	/* 相关定义: 控制指令 */
 	/*!
 	 * - 通过UDP<IP_CAMERA, PORT_CAMERA>发送控制指令, 接收指令反馈
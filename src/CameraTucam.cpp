@@ -12,9 +12,19 @@
 
 using namespace boost::placeholders;
 
-CameraTucam::CameraTucam() {
+boost::mutex CameraTucam::mtxapi_;
+int CameraTucam::apiref_ = 0;
+int CameraTucam::camcnt_ = 0;
+uint32_t CameraTucam::opened_ = 0;
+
+CameraTucam::CameraTucam(int idxOpen, int ring) {
 	state_ = CAMERA_IDLE;
 	expdur_= 0.0;
+	idxOpen_ = idxOpen;
+	ring_  = ring > 1 ? ring : 1;
+	evtstate_ = true;
+	frmidx_ = 0;
+	camOpen_.hIdxTUCam = NULL;
 }
 
 CameraTucam::~CameraTucam() {
@@ -22,18 +32,36 @@ CameraTucam::~CameraTucam() {
 }
 
 bool CameraTucam::OpenCamera() {
-	TUCAM_INIT itprm;
-	itprm.pstrConfigPath = "/usr/local/etc"; // 相机参数路径
+	{
+		mutex_lock lck(mtxapi_);
+		if (!apiref_) {
+			TUCAM_INIT itprm;
+			itprm.pstrConfigPath = "/usr/local/etc"; // 相机参数路径
 
-	if (TUCAM_Api_Init(&itprm) != TUCAMRET_SUCCESS
-			|| itprm.uiCamCount == 0) {
-		nfcam_->errmsg = "TUCAM_Api_Init() error or not found camera";
-		return false;
+			if (TUCAM_Api_Init(&itprm) != TUCAMRET_SUCCESS
+					|| itprm.uiCamCount == 0) {
+				nfcam_->errmsg = "TUCAM_Api_Init() error or not found camera";
+				return false;
+			}
+			camcnt_ = int(itprm.uiCamCount);
+		}
+		++apiref_;
+		if (idxOpen_ < 0) {// 第一台未打开的相机
+			for (idxOpen_ = 0; idxOpen_ < camcnt_ && (opened_ & (1 << idxOpen_)); ++idxOpen_);
+		}
+		if (idxOpen_ >= camcnt_ || (opened_ & (1 << idxOpen_))) {
+			nfcam_->errmsg = "camera not found or had been opened";
+			if (--apiref_ == 0) TUCAM_Api_Uninit();
+			return false;
+		}
+		opened_ |= 1 << idxOpen_;
 	}
 
-	camOpen_.uiIdxOpen = 0;
+	camOpen_.uiIdxOpen = idxOpen_;
 	if (TUCAM_Dev_Open(&camOpen_) != TUCAMRET_SUCCESS) {
 		nfcam_->errmsg = "TUCAM_Dev_Open() error";
+		camOpen_.hIdxTUCam = NULL;
+		ReleaseApi();
 		return false;
 	}
 
@@ -45,15 +73,19 @@ bool CameraTucam::OpenCamera() {
 	// 分配图像存储空间并获取靶面分辨率
 	camFrm_.pBuffer = NULL;
 	camFrm_.ucFormatGet = TUFRM_FMT_RAW;
-	camFrm_.uiRsdSize = 1;
+	camFrm_.uiRsdSize = ring_;
 	if (TUCAM_Buf_Alloc(camOpen_.hIdxTUCam, &camFrm_) != TUCAMRET_SUCCESS) {
 		nfcam_->errmsg = "TUCAM_Buf_Alloc() error";
+		TUCAM_Dev_Close(camOpen_.hIdxTUCam);
+		camOpen_.hIdxTUCam = NULL;
+		ReleaseApi();
 		return false;
 	}
 	nfcam_->wsensor = camFrm_.usWidth;
 	nfcam_->hsensor = camFrm_.usHeight;
 	expdur_= -1E30;
-	TUCAM_Cap_Start(camOpen_.hIdxTUCam, TUCCM_TRIGGER_SOFTWARE);
+	// 连续采集模式在首次曝光时设置曝光时间并重启采集
+	TUCAM_Cap_Start(camOpen_.hIdxTUCam, ring_ > 1 ? TUCCM_SEQUENCE : TUCCM_TRIGGER_SOFTWARE);
 	thrd_waitfrm_.reset(new boost::thread(boost::bind(&CameraTucam::thread_wait_frame, this)));
 
 	state_ = CAMERA_IDLE;
@@ -72,8 +104,9 @@ void CameraTucam::CloseCamera() {
 		TUCAM_Cap_Stop(camOpen_.hIdxTUCam);
 		TUCAM_Buf_Release(camOpen_.hIdxTUCam);
 		TUCAM_Dev_Close(camOpen_.hIdxTUCam);
+		camOpen_.hIdxTUCam = NULL;
+		ReleaseApi();
 	}
-	TUCAM_Api_Uninit();
 	// 销毁线程
 	if (thrd_waitfrm_.unique()) {
 		thrd_waitfrm_->interrupt();
@@ -81,6 +114,12 @@ void CameraTucam::CloseCamera() {
 	}
 }
 
+void CameraTucam::ReleaseApi() {
+	mutex_lock lck(mtxapi_);
+	if (idxOpen_ >= 0) opened_ &= ~(1 << idxOpen_);
+	if (apiref_ > 0 && --apiref_ == 0) TUCAM_Api_Uninit();
+}
+
 void CameraTucam::CoolerOnOff(double& coolerset, bool& onoff) {
 	// 来源: SDK使用说明, p.67
 	// 温度设置阈值: 0-100, 对应实际温度: -50~+50
@@ -105,9 +144,63 @@ void CameraTucam::UpdateGain(uint32_t& index) {
 }
 
 void CameraTucam::UpdateROI(int& xbin, int& ybin, int& xstart, int& ystart, int& width, int& height) {
-	if (state_ == CAMERA_IDLE) {
+	if (state_ != CAMERA_IDLE) return;
+	/*
+	 * ROI与合并须在停止采集时设置, 并重新分配SDK缓冲区
+	 * - 合并仅支持X、Y相同因子, 档位: 0=1×1, n=(n+1)×(n+1)
+	 * - SDK中ROI以合并后像素为单位, 左上角为(0,0)
+	 * - 以回读值更新ROI区, SDK可能按步长对齐起始位置与尺寸
+	 */
+	HDTUCAM handle = camOpen_.hIdxTUCam;
+	TUCAM_CAPA_ATTR capa;
+	TUCAM_ROI_ATTR roi;
+	int bin, n;
+
+	TUCAM_Cap_Stop(handle);
+	TUCAM_Buf_Release(handle);
+
+	capa.idCapa = TUIDC_BINNING_SUM;
+	if (TUCAM_Capa_GetAttr(handle, &capa) == TUCAMRET_SUCCESS) {
+		if ((n = xbin - 1) > capa.nValMax) n = capa.nValMax;
+		if (n < capa.nValMin) n = capa.nValMin;
+		TUCAM_Capa_SetValue(handle, TUIDC_BINNING_SUM, n);
+		bin = TUCAM_Capa_GetValue(handle, TUIDC_BINNING_SUM, &n) == TUCAMRET_SUCCESS ? n + 1 : 1;
+	}
+	else bin = 1;
 
+	roi.bEnable  = width < nfcam_->wsensor || height < nfcam_->hsensor;
+	roi.nHOffset = (xstart - 1) / bin;
+	roi.nVOffset = (ystart - 1) / bin;
+	roi.nWidth   = width / bin;
+	roi.nHeight  = height / bin;
+	TUCAM_Cap_SetROI(handle, roi);
+	if (TUCAM_Cap_GetROI(handle, &roi) == TUCAMRET_SUCCESS && roi.bEnable) {
+		xstart = roi.nHOffset * bin + 1;
+		ystart = roi.nVOffset * bin + 1;
+		width  = roi.nWidth * bin;
+		height = roi.nHeight * bin;
 	}
+	else {
+		xstart = ystart = 1;
+		width  = nfcam_->wsensor - nfcam_->wsensor % bin;
+		height = nfcam_->hsensor - nfcam_->hsensor % bin;
+	}
+	xbin = ybin = bin;
+
+	camFrm_.pBuffer = NULL;
+	camFrm_.ucFormatGet = TUFRM_FMT_RAW;
+	camFrm_.uiRsdSize = ring_;
+	if (TUCAM_Buf_Alloc(handle, &camFrm_) != TUCAMRET_SUCCESS) {
+		nfcam_->errmsg = "TUCAM_Buf_Alloc() error";
+		state_ = CAMERA_ERROR;
+		return;
+	}
+	if (camFrm_.usWidth * bin != width || camFrm_.usHeight * bin != height) {// 以图像帧尺寸为准
+		width  = camFrm_.usWidth * bin;
+		height = camFrm_.usHeight * bin;
+	}
+	expdur_ = -1E30; // 连续采集模式在下一次曝光时重启采集
+	TUCAM_Cap_Start(handle, ring_ > 1 ? TUCCM_SEQUENCE : TUCCM_TRIGGER_SOFTWARE);
 }
 
 void CameraTucam::UpdateADCOffset(uint16_t offset) {
@@ -121,11 +214,24 @@ double CameraTucam::SensorTemperature() {
 }
 
 bool CameraTucam::StartExpose(double duration, bool light) {
-	if (duration != expdur_
+	if (ring_ > 1) {
+		/*
+		 * 缓冲环中的帧可能早于本次曝光指令:
+		 * - 曝光时间变更
+		 * - 距上一帧超过一个帧周期, 即相机空闲期间持续采集
+		 * 此时重启采集, 否则直接取缓冲环中的下一帧
+		 */
+		ptime now = microsec_clock::universal_time();
+		if ((duration != expdur_ || (now - tmfrm_).total_microseconds() > (duration + 0.5) * 1E6)
+				&& !restart_sequence(duration))
+			return false;
+	}
+	else if (duration != expdur_
 			&& TUCAM_Prop_SetValue(camOpen_.hIdxTUCam, TUIDP_EXPOSURETM, duration * 1000) == TUCAMRET_SUCCESS) {
 		expdur_ = duration;
 	}
-	if (TUCAM_Cap_DoSoftwareTrigger(camOpen_.hIdxTUCam) == TUCAMRET_SUCCESS) {
+	if (ring_ > 1 || TUCAM_Cap_DoSoftwareTrigger(camOpen_.hIdxTUCam) == TUCAMRET_SUCCESS) {
+		mutex_lock lck(mtx_waitfrm_);
 		state_ = CAMERA_EXPOSE;
 		cv_waitfrm_.notify_one();
 		return true;
@@ -133,6 +239,18 @@ bool CameraTucam::StartExpose(double duration, bool light) {
 	return false;
 }
 
+bool CameraTucam::restart_sequence(double duration) {
+	TUCAM_Cap_Stop(camOpen_.hIdxTUCam);
+	if (TUCAM_Prop_SetValue(camOpen_.hIdxTUCam, TUIDP_EXPOSURETM, duration * 1000) == TUCAMRET_SUCCESS)
+		expdur_ = duration;
+	if (TUCAM_Cap_Start(camOpen_.hIdxTUCam, TUCCM_SEQUENCE) != TUCAMRET_SUCCESS) {
+		nfcam_->errmsg = "TUCAM_Cap_Start() error";
+		return false;
+	}
+	frmidx_ = 0;
+	return true;
+}
+
 void CameraTucam::StopExpose() {
 	if (state_ > CAMERA_IDLE
 			&& TUCAM_Buf_AbortWait(camOpen_.hIdxTUCam) == TUCAMRET_SUCCESS) {
@@ -147,25 +265,42 @@ CAMERA_STATUS CameraTucam::CameraState() {
 }
 
 CAMERA_STATUS CameraTucam::DownloadImage() {
-	int n = nfcam_->roi.get_width() * nfcam_->roi.get_height();
-	memcpy(nfcam_->data.get(), camFrm_.pBuffer + camFrm_.usHeader, n * sizeof(unsigned short));
+	size_t n = size_t(nfcam_->roi.get_width()) * nfcam_->roi.get_height() * sizeof(unsigned short);
+	if (ring_ > 1) {// 连续采集模式: 以帧到达时间回推曝光起始时间
+		nfcam_->tmobs = tmfrm_ - microseconds(int64_t(expdur_ * 1E6));
+		nfcam_->format_utc();
+	}
+	/*
+	 * 由SDK帧缓冲区直接复制至存储区(缓冲池中的缓冲区), 每帧仅复制一次
+	 * SDK缓冲区在下一次触发或缓冲环回绕后被覆盖, 不能交由存储线程直接引用
+	 */
+	if (n > camFrm_.uiImgSize) n = camFrm_.uiImgSize;
+	memcpy(nfcam_->data.get(), camFrm_.pBuffer + camFrm_.usHeader, n);
 	state_ = CAMERA_IDLE;
 	return CAMERA_IMGRDY;
 }
 
 void CameraTucam::thread_wait_frame() {
-	boost::mutex mtx;    // 哑元
-	mutex_lock lck(mtx);
 	int code;
 
 	while (true) {
-		cv_waitfrm_.wait(lck); // 等待曝光起始信号
+		{// 等待曝光起始信号
+			mutex_lock lck(mtx_waitfrm_);
+			while (state_ != CAMERA_EXPOSE) cv_waitfrm_.wait(lck);
+		}
 		if ((code = TUCAM_Buf_WaitForFrame(camOpen_.hIdxTUCam, &camFrm_)) == TUCAMRET_SUCCESS) {
-			TUCAM_Buf_CopyFrame(camOpen_.hIdxTUCam, &camFrm_);
+			// camFrm_.pBuffer指向SDK帧缓冲区, 由DownloadImage()复制
+			if (ring_ > 1) {// 帧序号不连续: 缓冲环已满, 旧帧被覆盖
+				tmfrm_ = microsec_clock::universal_time();
+				if (frmidx_ && camFrm_.uiIndex > frmidx_ + 1)
+					__sync_fetch_and_add(&stat_.skipped, camFrm_.uiIndex - frmidx_ - 1);
+				frmidx_ = camFrm_.uiIndex;
+			}
 			state_ = CAMERA_IMGRDY;
 		}
 		else {
 			state_ = code == TUCAMRET_ABORT ? CAMERA_IDLE : CAMERA_ERROR;
 		}
+		NotifyState();
 	}
 }
@@ -3,6 +3,11 @@
  * @date 2021-02-22
  * @version 0.1
  * @author Xiaomeng Lu
+ * @note
+ * 工作模式:
+ * - 软件触发模式: 每次曝光执行一次软件触发, 等待并读出该帧
+ * - 连续采集模式: 相机以TUCCM_SEQUENCE自由运行, SDK以多帧缓冲环接收图像.
+ *   每次曝光取缓冲环中的下一帧, 曝光节拍由相机帧率决定, 适用于高节拍调焦与视宁度测量
  */
 
 #ifndef CAMERATUCAM_H_
@@ -14,15 +19,31 @@
 
 class CameraTucam: public CameraBase {
 public:
-	CameraTucam();
+	/*!
+	 * @brief 构造函数
+	 * @param idxOpen SDK中的相机索引. -1: 第一台未打开的相机
+	 * @param ring    SDK缓冲环帧数. 大于1时启用连续采集模式, 否则为软件触发模式
+	 */
+	CameraTucam(int idxOpen = -1, int ring = 0);
 	virtual ~CameraTucam();
 
 protected:
+	/* SDK各实例共用: 首台相机初始化, 末台相机释放 */
+	static boost::mutex mtxapi_;	/// SDK互斥锁
+	static int apiref_;		/// SDK引用计数
+	static int camcnt_;		/// SDK发现的相机数量
+	static uint32_t opened_;	/// 已打开相机索引掩码
+
+	int idxOpen_;			/// SDK中的相机索引
 	TUCAM_OPEN camOpen_;	/// 相机打开参数
 	TUCAM_FRAME camFrm_;	/// 图像帧数据
 	CAMERA_STATUS state_;	/// 相机工作状态, 指示曝光过程
 	double expdur_;			/// 曝光时间
+	int ring_;				/// SDK缓冲环帧数. 大于1: 连续采集模式
+	uint32_t frmidx_;		/// 连续采集模式: 上一帧序号
+	ptime tmfrm_;			/// 连续采集模式: 收到上一帧的时间
 	threadptr thrd_waitfrm_;/// 线程: 等待读出图像
+	boost::mutex mtx_waitfrm_;	/// 互斥锁: 曝光开始
 	boost::condition_variable cv_waitfrm_;	/// 条件: 曝光开始, 等待可以读出图像数据
 
 protected:
@@ -36,6 +57,10 @@ protected:
 	 * @brief 继承类实现真正与相机断开连接
 	 */
 	void CloseCamera();
+	/*!
+	 * @brief 释放对SDK的引用, 并在无引用时释放SDK
+	 */
+	void ReleaseApi();
 	/*!
 	 * @brief 设置制冷器工作模式及制冷温度
 	 * @param coolerset  期望温度, 量纲: 摄氏度
@@ -104,6 +129,13 @@ protected:
 	CAMERA_STATUS DownloadImage();
 
 protected:
+	/*!
+	 * @brief 连续采集模式: 以新的曝光时间重启采集, 并丢弃缓冲环中的旧帧
+	 * @param duration 曝光时间, 量纲: 秒
+	 * @return
+	 * 重启结果
+	 */
+	bool restart_sequence(double duration);
 	/*!
 	 * @brief 线程: 等待曝光结束读出图像数据
 	 */
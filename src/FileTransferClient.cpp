@@ -20,6 +20,9 @@ FileTransferClient::FileTransferClient() {
 	nffile_ = boost::make_shared<file_info>();
 	fdfile_ = boost::make_shared<file_data>();
 	flagfile_ = boost::make_shared<file_flag>();
+	bytesSent_   = 0;
+	filesSent_   = 0;
+	filesFailed_ = 0;
 }
 
 FileTransferClient::~FileTransferClient() {
@@ -71,6 +74,23 @@ void FileTransferClient::NewFile(upload_file* newfile) {
 	TriggerUpload();
 }
 
+int FileTransferClient::QueueDepth() {
+	mtxlck lock(mtxlist_);
+	return int(filelist_.size());
+}
+
+uint64_t FileTransferClient::BytesSent() {
+	return bytesSent_;
+}
+
+uint64_t FileTransferClient::FilesSent() {
+	return filesSent_;
+}
+
+uint64_t FileTransferClient::FilesFailed() {
+	return filesFailed_;
+}
+
 bool FileTransferClient::connect_server() {
 	if (!socket_.unique()) {
 		try {
@@ -175,25 +195,27 @@ bool FileTransferClient::UploadFile(upfptr file) {
 		nffile_->set_file(*file);
 		nffile_->filesize = filesize;
 
-		socket_->write_some(boost::asio::buffer(nffile_.get(), sizeof(file_info)));
+		__sync_fetch_and_add(&bytesSent_, socket_->write_some(boost::asio::buffer(nffile_.get(), sizeof(file_info))));
 		socket_->read_some(boost::asio::buffer(flagfile_.get(), sizeof(file_flag)));
 		while (filesize > 0) {
 			if (pack_size > filesize) pack_size = filesize;
 			fdfile_->offset = offset;
 			fdfile_->size   = pack_size;
 			memcpy(fdfile_->data, headptr, pack_size);
-			socket_->write_some(boost::asio::buffer(fdfile_.get(), sizeof(file_data)));
+			__sync_fetch_and_add(&bytesSent_, socket_->write_some(boost::asio::buffer(fdfile_.get(), sizeof(file_data))));
 			headptr += pack_size;
 			offset  += pack_size;
 			filesize-= pack_size;
 		}
 		socket_->read_some(boost::asio::buffer(flagfile_.get(), sizeof(file_flag)));
 		gLog.Write("Upload over");
+		__sync_fetch_and_add(&filesSent_, 1);
 
 		return true;
 	}
 	catch(exception& ex) {
 		gLog.Write(LOG_FAULT, "UploadFile()", ex.what());
+		__sync_fetch_and_add(&filesFailed_, 1);
 		socket_.reset();
 		return false;
 	}
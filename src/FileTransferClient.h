@@ -11,6 +11,7 @@
 #include <list>
 #include <string>
 #include <string.h>
+#include <stdint.h>
 #include <boost/interprocess/ipc/message_queue.hpp>
 #include <boost/smart_ptr.hpp>
 #include <boost/thread.hpp>
@@ -34,6 +35,7 @@ public:
 		string filepath;	//< 文件本地全路径
 		string subpath;		//< 子目录名
 		string filename;	//< 文件名
+		string camera_id;	//< 相机标志. 空: 采用SetDeviceID()设置的相机标志
 
 	public:
 		upload_file& operator=(const upload_file& other) {
@@ -44,6 +46,7 @@ public:
 				filepath		= other.filepath;
 				subpath		= other.subpath;
 				filename		= other.filename;
+				camera_id	= other.camera_id;
 
 				if (grid_id.empty()) grid_id = "undefined";
 				if (field_id.empty()) field_id = "undefined";
@@ -83,6 +86,7 @@ protected:
 			strcpy(timeobs,  upf.timeobs.c_str());
 			strcpy(subpath,  upf.subpath.c_str());
 			strcpy(filename, upf.filename.c_str());
+			if (!upf.camera_id.empty()) strcpy(camera_id, upf.camera_id.c_str());
 		}
 	};
 
@@ -122,6 +126,9 @@ protected:
 	boost::shared_ptr<file_info> nffile_;	//< 待传输文件描述信息
 	boost::shared_ptr<file_data> fdfile_;	//< 待传输文件数据
 	boost::shared_ptr<file_flag> flagfile_;	//< 文件传输标记
+	uint64_t bytesSent_;	//< 已发送字节数
+	uint64_t filesSent_;	//< 已上传文件数
+	uint64_t filesFailed_;	//< 上传失败次数
 
 public:
 	/*!
@@ -150,6 +157,26 @@ public:
 	 * @param newfile  带传输文件描述信息
 	 */
 	void NewFile(upload_file* newfile);
+	/*!
+	 * @brief 查看待上传文件数量
+	 * @return
+	 * 队列深度, 含正在上传的文件
+	 */
+	int QueueDepth();
+	/*!
+	 * @brief 查看已发送字节数
+	 * @return
+	 * 字节数, 含协议头
+	 */
+	uint64_t BytesSent();
+	/*!
+	 * @brief 查看已上传文件数
+	 */
+	uint64_t FilesSent();
+	/*!
+	 * @brief 查看上传失败次数
+	 */
+	uint64_t FilesFailed();
 
 protected:
 	/*!
@@ -0,0 +1,201 @@
+/*
+ * @file FocalPlane.cpp 焦面倾斜与场曲估计定义文件
+ * @date 2026-10-18
+ * @version 0.1
+ */
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include "FocalPlane.h"
+
+bool solve_linear(double *a, double *b, int n) {
+	int i, j, k, piv;
+	double t, amax(0.0);
+
+	for (i = 0; i < n * n; ++i) {
+		if (fabs(a[i]) > amax) amax = fabs(a[i]);
+	}
+	for (k = 0; k < n; ++k) {
+		for (i = k + 1, piv = k; i < n; ++i) {
+			if (fabs(a[i * n + k]) > fabs(a[piv * n + k])) piv = i;
+		}
+		if (fabs(a[piv * n + k]) <= 1E-12 * amax) return false;
+		if (piv != k) {
+			for (j = 0; j < n; ++j) std::swap(a[k * n + j], a[piv * n + j]);
+			std::swap(b[k], b[piv]);
+		}
+		for (i = k + 1; i < n; ++i) {
+			t = a[i * n + k] / a[k * n + k];
+			for (j = k; j < n; ++j) a[i * n + j] -= t * a[k * n + j];
+			b[i] -= t * b[k];
+		}
+	}
+	for (k = n - 1; k >= 0; --k) {
+		for (j = k + 1; j < n; ++j) b[k] -= a[k * n + j] * b[j];
+		b[k] /= a[k * n + k];
+	}
+	return true;
+}
+
+FocalPlane::FocalPlane(int grid, int wsensor, int hsensor, int minstar) {
+	grid_    = grid < 1 ? 1 : grid;
+	wsensor_ = wsensor;
+	hsensor_ = hsensor;
+	minstar_ = minstar < 1 ? 1 : minstar;
+	hasref_  = false;
+	pref_    = 0;
+	regions_.resize(grid_ * grid_);
+	memset(&regions_[0], 0, sizeof(region_stat) * regions_.size());
+}
+
+FocalPlane::~FocalPlane() {
+}
+
+int FocalPlane::AddFrame(int pos, const star_catalog &cat, int xorg, int yorg, int xbin, int ybin) {
+	std::vector<std::vector<float> > fwhm(regions_.size());
+	float scale = sqrtf(float(xbin * ybin)); // 半高全宽换算为传感器像素
+	int i, ix, iy;
+
+	for (i = 0; i < cat.size(); ++i) {
+		if (cat.flags[i]) continue;
+		ix = int((xorg + (cat.x[i] + 0.5f) * xbin) * grid_ / wsensor_);
+		iy = int((yorg + (cat.y[i] + 0.5f) * ybin) * grid_ / hsensor_);
+		if (ix < 0 || ix >= grid_ || iy < 0 || iy >= grid_) continue;
+		fwhm[iy * grid_ + ix].push_back(cat.fwhm(i) * scale);
+	}
+	return add_regions(pos, fwhm);
+}
+
+int FocalPlane::AddFrame(int pos, const psf_catalog &psf, int xorg, int yorg, int xbin, int ybin) {
+	std::vector<std::vector<float> > fwhm(regions_.size());
+	float scale = sqrtf(float(xbin * ybin));
+	int i, ix, iy;
+
+	for (i = 0; i < psf.size(); ++i) {
+		ix = int((xorg + (psf.x[i] + 0.5f) * xbin) * grid_ / wsensor_);
+		iy = int((yorg + (psf.y[i] + 0.5f) * ybin) * grid_ / hsensor_);
+		if (ix < 0 || ix >= grid_ || iy < 0 || iy >= grid_) continue;
+		fwhm[iy * grid_ + ix].push_back(psf.fwhm[i] * scale);
+	}
+	return add_regions(pos, fwhm);
+}
+
+int FocalPlane::add_regions(int pos, std::vector<std::vector<float> > &fwhm) {
+	int i, n(0);
+
+	mutex_lock lck(mtxplane_);
+	if (!hasref_) {
+		hasref_ = true;
+		pref_   = pos;
+	}
+	double t = pos - pref_, f2, w;
+	for (i = 0; i < int(regions_.size()); ++i) {
+		std::vector<float> &v = fwhm[i];
+		if (int(v.size()) < minstar_) continue;
+		std::nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+		f2 = double(v[v.size() / 2]) * v[v.size() / 2];
+		w  = double(v.size()); // 中值误差约与星像数的平方根成反比
+
+		region_stat &rs = regions_[i];
+		if (!rs.nframe || pos < rs.pmin) rs.pmin = pos;
+		if (!rs.nframe || pos > rs.pmax) rs.pmax = pos;
+		rs.st[0] += w;
+		rs.st[1] += w * t;
+		rs.st[2] += w * t * t;
+		rs.st[3] += w * t * t * t;
+		rs.st[4] += w * t * t * t * t;
+		rs.sf[0] += w * f2;
+		rs.sf[1] += w * f2 * t;
+		rs.sf[2] += w * f2 * t * t;
+		++rs.nframe;
+		++n;
+	}
+	return n;
+}
+
+bool FocalPlane::RegionFocus(int ix, int iy, double &pos, double &fwhm) {
+	if (ix < 0 || ix >= grid_ || iy < 0 || iy >= grid_) return false;
+	mutex_lock lck(mtxplane_);
+	return region_focus(regions_[iy * grid_ + ix], pos, fwhm);
+}
+
+bool FocalPlane::region_focus(const region_stat &rs, double &pos, double &fwhm) {
+	if (rs.nframe < 3 || rs.pmax <= rs.pmin) return false;
+
+	// 法方程: [Σt⁴ Σt³ Σt²; Σt³ Σt² Σt; Σt² Σt Σ1]·[A B C]ᵀ = [ΣF²t² ΣF²t ΣF²]ᵀ
+	double a[9] = {
+		rs.st[4], rs.st[3], rs.st[2],
+		rs.st[3], rs.st[2], rs.st[1],
+		rs.st[2], rs.st[1], rs.st[0]
+	};
+	double b[3] = {rs.sf[2], rs.sf[1], rs.sf[0]};
+	if (!solve_linear(a, b, 3) || b[0] <= 0.0) return false;
+
+	double t0 = -b[1] / (2.0 * b[0]), f2 = b[2] - b[1] * b[1] / (4.0 * b[0]);
+	double range = rs.pmax - rs.pmin;
+	pos = t0 + pref_;
+	if (pos < rs.pmin - 0.5 * range || pos > rs.pmax + 0.5 * range) return false;
+	fwhm = f2 > 0.0 ? sqrt(f2) : 0.0;
+	return true;
+}
+
+bool FocalPlane::Solve(tilt_fit &fit) {
+	std::vector<double> u, v, z;
+	double pos, fwhm;
+	int ix, iy, i, j, k, n;
+
+	{
+		mutex_lock lck(mtxplane_);
+		for (iy = 0; iy < grid_; ++iy) {
+			for (ix = 0; ix < grid_; ++ix) {
+				if (!region_focus(regions_[iy * grid_ + ix], pos, fwhm)) continue;
+				u.push_back((2.0 * ix + 1.0) / grid_ - 1.0);
+				v.push_back((2.0 * iy + 1.0) / grid_ - 1.0);
+				z.push_back(pos);
+			}
+		}
+	}
+
+	memset(&fit, 0, sizeof(tilt_fit));
+	fit.nregion = n = int(z.size());
+	if (n < 3) return false;
+
+	// 最小二乘: 基函数1, u, v, u²+v². 含场曲项无解时(如区域共线)退化为平面
+	double a[16], b[4], basis[4], coef[4];
+	int np;
+	for (np = n >= 5 ? 4 : 3; np >= 3; --np) {
+		memset(a, 0, sizeof(a));
+		memset(b, 0, sizeof(b));
+		for (i = 0; i < n; ++i) {
+			basis[0] = 1.0;
+			basis[1] = u[i];
+			basis[2] = v[i];
+			basis[3] = u[i] * u[i] + v[i] * v[i];
+			for (j = 0; j < np; ++j) {
+				for (k = 0; k < np; ++k) a[j * np + k] += basis[j] * basis[k];
+				b[j] += basis[j] * z[i];
+			}
+		}
+		if (solve_linear(a, b, np)) break;
+	}
+	if (np < 3) return false;
+	for (j = 0; j < 4; ++j) coef[j] = j < np ? b[j] : 0.0;
+
+	double res(0.0), d;
+	for (i = 0; i < n; ++i) {
+		d = z[i] - coef[0] - coef[1] * u[i] - coef[2] * v[i] - coef[3] * (u[i] * u[i] + v[i] * v[i]);
+		res += d * d;
+	}
+	fit.curved    = np == 4;
+	fit.focus     = coef[0];
+	fit.tiltx     = coef[1];
+	fit.tilty     = coef[2];
+	fit.curvature = coef[3];
+	fit.corner[0] = -coef[1] - coef[2];
+	fit.corner[1] =  coef[1] - coef[2];
+	fit.corner[2] =  coef[1] + coef[2];
+	fit.corner[3] = -coef[1] + coef[2];
+	fit.rms = sqrt(res / n);
+	return true;
+}
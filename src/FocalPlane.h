@@ -0,0 +1,129 @@
+/*
+ * @file FocalPlane.h 焦面倾斜与场曲估计声明文件
+ * @date 2026-10-18
+ * @version 0.1
+ * @note
+ * - 传感器划分为grid×grid区域. 每帧统计各区域未饱和星像半高全宽的中值, 计入该区域的V曲线
+ * - V曲线以双曲线FWHM²=A·t²+B·t+C描述, t为焦点位置. 该式对t为线性,
+ *   各区域只累加Σt^k(k=0-4)与ΣFWHM²·t^k(k=0-2), 每帧增量更新, 求解3×3方程即得最佳焦点
+ * - 各区域最佳焦点以区域中心的归一化坐标(u, v∈[-1, 1])拟合焦面:
+ *   z = z0 + tx·u + ty·v + c·(u²+v²). 有效区域少于5个时不含场曲项
+ * - 倾斜调整量为仅含倾斜项时四角相对中心的焦点差, 符号以调焦器正方向为准;
+ *   调焦器移动探测器时即为该角沿光轴的调整量(如垫片增量). 场曲无法由调整消除, 单独报告
+ * - 各帧由存储线程并行计入, 累加量与顺序无关
+ */
+
+#ifndef FOCALPLANE_H_
+#define FOCALPLANE_H_
+
+#include <vector>
+#include <boost/thread.hpp>
+#include "StarExtractor.h"
+#include "PsfFitter.h"
+
+struct tilt_fit {// 焦面拟合结果. 量纲: 调焦器单位
+	int nregion;		//< 参与拟合的区域数
+	bool curved;		//< 含场曲项
+	double focus;		//< 视场中心最佳焦点位置
+	double tiltx;		//< 视场中心至右边缘中点的焦点差
+	double tilty;		//< 视场中心至下边缘中点的焦点差
+	double curvature;	//< 视场中心至边缘中点的场曲
+	double corner[4];	//< 四角倾斜调整量: 左上、右上、右下、左下
+	double rms;			//< 各区域最佳焦点的拟合残差
+};
+
+class FocalPlane {
+public:
+	/*!
+	 * @brief 构造函数
+	 * @param grid    区域划分, grid×grid
+	 * @param wsensor 传感器宽度, 量纲: 像素
+	 * @param hsensor 传感器高度, 量纲: 像素
+	 * @param minstar 区域内参与统计的最少星像数
+	 */
+	FocalPlane(int grid, int wsensor, int hsensor, int minstar = 3);
+	virtual ~FocalPlane();
+
+protected:
+	/* 声明数据类型 */
+	typedef boost::unique_lock<boost::mutex> mutex_lock;
+
+	struct region_stat {// 区域V曲线累加量
+		double st[5];	//< Σw·t^k
+		double sf[3];	//< Σw·FWHM²·t^k
+		int nframe;		//< 帧数
+		int pmin, pmax;	//< 焦点位置范围
+	};
+
+	/* 成员变量 */
+	int grid_;			//< 区域划分
+	int wsensor_, hsensor_;	//< 传感器尺寸
+	int minstar_;		//< 最少星像数
+	bool hasref_;		//< 已设置参考位置
+	int pref_;			//< 参考位置: 首帧焦点位置. 改善方程条件数
+	std::vector<region_stat> regions_;	//< 区域累加量
+	boost::mutex mtxplane_;	//< 互斥锁
+
+public:
+	/*!
+	 * @brief 计入一帧星像
+	 * @param pos  焦点位置
+	 * @param cat  星像表
+	 * @param xorg 图像左上角在传感器中的X坐标, 起始为0
+	 * @param yorg 图像左上角在传感器中的Y坐标, 起始为0
+	 * @param xbin X方向合并因子
+	 * @param ybin Y方向合并因子
+	 * @return
+	 * 计入的区域数
+	 */
+	int AddFrame(int pos, const star_catalog &cat, int xorg, int yorg, int xbin, int ybin);
+	/*!
+	 * @brief 计入一帧PSF拟合结果
+	 * @note
+	 * 参数与返回值同前. 欠采样星像的拟合半高全宽噪声较小, 启用PSF拟合时优先使用
+	 */
+	int AddFrame(int pos, const psf_catalog &psf, int xorg, int yorg, int xbin, int ybin);
+	/*!
+	 * @brief 查看区域最佳焦点
+	 * @param ix   区域X序号
+	 * @param iy   区域Y序号
+	 * @param pos  最佳焦点位置
+	 * @param fwhm 最佳焦点处半高全宽, 量纲: 传感器像素
+	 * @return
+	 * 帧数不足3、V曲线开口向下或极小值远离采样范围时返回false
+	 */
+	bool RegionFocus(int ix, int iy, double &pos, double &fwhm);
+	/*!
+	 * @brief 拟合焦面倾斜与场曲
+	 * @param fit 拟合结果
+	 * @return
+	 * 有效区域少于3个时返回false
+	 */
+	bool Solve(tilt_fit &fit);
+
+protected:
+	/*!
+	 * @brief 按区域计入半高全宽中值
+	 * @param pos  焦点位置
+	 * @param fwhm 各区域星像半高全宽, 量纲: 传感器像素. 求中值时重排
+	 * @return
+	 * 计入的区域数
+	 */
+	int add_regions(int pos, std::vector<std::vector<float> > &fwhm);
+	/*!
+	 * @brief 由累加量求解区域最佳焦点. 调用前须加锁
+	 */
+	bool region_focus(const region_stat &rs, double &pos, double &fwhm);
+};
+
+/*!
+ * @brief 以列主元高斯消去法求解n元线性方程组
+ * @param a 系数矩阵, n×n, 按行存储. 求解后被改写
+ * @param b 常数项, 求解后为解
+ * @param n 未知数个数
+ * @return
+ * 矩阵奇异时返回false
+ */
+extern bool solve_linear(double *a, double *b, int n);
+
+#endif /* FOCALPLANE_H_ */
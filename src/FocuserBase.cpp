@@ -0,0 +1,131 @@
+/*
+ * @file FocuserBase.cpp 调焦器基类定义文件
+ * @date 2026-10-18
+ * @version 0.1
+ */
+
+#include <stdlib.h>
+#include "FocuserBase.h"
+#include "pipetrace.h"
+
+FocuserBase::FocuserBase(int tolerance, int repeat) {
+	tolerance_ = tolerance > 0 ? tolerance : 2;
+	repeat_    = repeat > 0 ? repeat : 5;
+	backlash_  = 0;
+	online_    = false;
+}
+
+FocuserBase::~FocuserBase() {
+}
+
+void FocuserBase::register_notify(const FocusNotify::slot_type &slot) {
+	notify_.connect(slot);
+}
+
+void FocuserBase::SetTolerance(int tolerance) {
+	mutex_lock lck(mtxfoc_);
+	if (tolerance > 0) tolerance_ = tolerance;
+}
+
+void FocuserBase::SetBacklash(int backlash) {
+	mutex_lock lck(mtxfoc_);
+	backlash_ = backlash;
+}
+
+bool FocuserBase::IsOnline() {
+	mutex_lock lck(mtxfoc_);
+	return online_;
+}
+
+bool FocuserBase::Move(const std::string &cid, int target) {
+	mutex_lock lck(mtxfoc_);
+	if (!online_) return false;
+
+	channel &ch = channels_[cid];
+	ch.posFinal = target;
+	if (target == ch.posAct && !ch.moving) {// 已在目标位置: 立即产生到位事件, 流程与定位后到位一致
+		push_event(FOCUS_ARRIVE, cid, target);
+		lck.unlock();
+		notify_();
+		return false;
+	}
+	ch.tmmove = trace_now();
+	/* 消隙: 运动方向与逼近方向相反, 或此前方向未知时, 先至目标位置之前一个回差处 */
+	int approach = backlash_ > 0 ? 1 : -1;
+	int dir = ch.posAct == VALID_FOCUS ? 0 : (target > ch.posAct ? 1 : -1);
+	int mid = target - backlash_;
+	if (backlash_ && (dir != approach || ch.lastdir != approach) && mid != ch.posAct)
+		return start_move(cid, ch, mid);
+	return start_move(cid, ch, target);
+}
+
+bool FocuserBase::GetEvent(focus_event &evt) {
+	mutex_lock lck(mtxfoc_);
+	if (events_.empty()) return false;
+	evt = events_.front();
+	events_.pop_front();
+	return true;
+}
+
+bool FocuserBase::start_move(const std::string &cid, channel &ch, int target) {
+	ch.dir    = ch.posAct == VALID_FOCUS ? 0 : (target > ch.posAct ? 1 : -1);
+	ch.posTar = target;
+	ch.repeat = repeat_;
+	ch.moving = true;
+	ch.tmcmd  = trace_now();
+	return send_target(cid, target);
+}
+
+void FocuserBase::update_position(const std::string &cid, int pos) {
+	bool notify(false);
+	{
+		mutex_lock lck(mtxfoc_);
+		channel &ch = channels_[cid];
+		if (ch.tmcmd) {// 发送目标位置后的首个位置反馈
+			trace_record(TS_FOCUS_RTT, trace_now() - ch.tmcmd);
+			ch.tmcmd = 0;
+		}
+		if (pos != ch.posAct) {// 运动中
+			ch.posAct = pos;
+			push_event(FOCUS_POSITION, cid, pos);
+			notify = true;
+		}
+		else if (ch.moving) {// 静止
+			if (abs(pos - ch.posTar) < tolerance_) {
+				if (ch.posTar != ch.posFinal) start_move(cid, ch, ch.posFinal); // 消隙后返回
+				else {
+					ch.moving  = false;
+					ch.lastdir = ch.dir;
+					trace_record(TS_FOCUS_MOVE, trace_now() - ch.tmmove);
+					push_event(FOCUS_ARRIVE, cid, pos);
+					notify = true;
+				}
+			}
+			else if (--ch.repeat < 0) {
+				ch.moving  = false;
+				ch.lastdir = 0;
+				push_event(FOCUS_FAIL, cid, pos);
+				notify = true;
+			}
+		}
+	}
+	if (notify) notify_();
+}
+
+void FocuserBase::set_online(bool online) {
+	{
+		mutex_lock lck(mtxfoc_);
+		online_ = online;
+		if (online) channels_.clear();
+		push_event(online ? FOCUS_ONLINE : FOCUS_OFFLINE, "", VALID_FOCUS);
+	}
+	notify_();
+}
+
+void FocuserBase::push_event(int type, const std::string &cid, int pos) {
+	focus_event evt;
+	evt.type     = type;
+	evt.cid      = cid;
+	evt.position = pos;
+	events_.push_back(evt);
+}
@@ -0,0 +1,174 @@
+/*
+ * @file FocuserBase.h 调焦器基类声明文件, 各类调焦器共同访问控制接口
+ * @date 2026-10-18
+ * @version 0.1
+ * @note
+ * 功能列表:
+ * @li 维护各相机对应调焦通道的实际位置与目标位置
+ * @li 由位置反馈判定到位或定位失败: 位置不变即静止, 静止时偏差小于容差为到位,
+ *     连续多次静止仍未到位为失败
+ * @li 消隙策略: 以固定方向逼近目标. 运动方向相反或此前方向未知时, 先越过目标一个回差再返回
+ * @li 事件(联机、脱机、位置变化、到位、失败)进入队列, 由注册的回调函数通知,
+ *     主线程取出事件后处理, 不在调焦器线程中执行观测流程
+ * @li 声明具体调焦器需实现的纯虚函数: 启动、停止与发送目标位置
+ */
+
+#ifndef FOCUSERBASE_H_
+#define FOCUSERBASE_H_
+
+#include <string>
+#include <map>
+#include <deque>
+#include <stdint.h>
+#include <boost/thread.hpp>
+#include <boost/signals2.hpp>
+
+#define VALID_FOCUS		10000	// 无效焦点位置
+
+enum FOCUS_EVENT {// 调焦器事件
+	FOCUS_ONLINE,	// 联机
+	FOCUS_OFFLINE,	// 脱机
+	FOCUS_POSITION,	// 位置变化
+	FOCUS_ARRIVE,	// 到达目标位置
+	FOCUS_FAIL		// 静止但未到达目标位置
+};
+
+struct focus_event {// 调焦器事件
+	int type;			//< 事件类型, FOCUS_EVENT
+	std::string cid;	//< 相机标志. 联机/脱机事件为空
+	int position;		//< 实际位置
+};
+
+/*!
+ * @brief 声明事件通知回调函数: 事件队列非空
+ */
+typedef boost::signals2::signal<void ()> FocusNotify;
+
+class FocuserBase {
+public:
+	/*!
+	 * @brief 构造函数
+	 * @param tolerance 到位容差, 量纲: 微米
+	 * @param repeat    判定定位失败的连续静止次数
+	 */
+	FocuserBase(int tolerance = 2, int repeat = 5);
+	virtual ~FocuserBase();
+
+protected:
+	/* 声明数据类型 */
+	typedef boost::unique_lock<boost::mutex> mutex_lock;
+
+	struct channel {// 调焦通道: 一台相机对应的调焦器
+		int posAct;		//< 实际位置
+		int posTar;		//< 当前目标位置. 消隙时为中间位置
+		int posFinal;	//< 最终目标位置
+		int repeat;		//< 剩余静止次数
+		int dir;		//< 当前运动方向
+		int lastdir;	//< 最近一次到位时的运动方向. 0: 未知
+		bool moving;	//< 定位中
+		int64_t tmcmd;	//< 发送目标位置的时间, 用于统计调焦指令往返耗时. 0: 无
+		int64_t tmmove;	//< 开始定位的时间
+
+	public:
+		channel() {
+			posAct = posTar = posFinal = VALID_FOCUS;
+			repeat  = dir = lastdir = 0;
+			moving  = false;
+			tmcmd   = tmmove = 0;
+		}
+	};
+	typedef std::map<std::string, channel> chmap;
+
+	/* 成员变量 */
+	int tolerance_;		//< 到位容差
+	int repeat_;		//< 判定失败的连续静止次数
+	int backlash_;		//< 回差. 正负号为最终逼近方向, 0: 不消隙
+	bool online_;		//< 联机标志
+	chmap channels_;	//< 调焦通道
+	std::deque<focus_event> events_;	//< 待处理事件
+	boost::mutex mtxfoc_;	//< 通道与事件互斥锁
+	FocusNotify notify_;	//< 事件通知回调函数
+
+public:
+	/*!
+	 * @brief 注册事件通知回调函数
+	 * @param slot 插槽函数
+	 * @note
+	 * 回调函数在调焦器线程中执行, 应仅投递消息, 由主线程调用GetEvent()
+	 */
+	void register_notify(const FocusNotify::slot_type &slot);
+	/*!
+	 * @brief 设置到位容差
+	 */
+	void SetTolerance(int tolerance);
+	/*!
+	 * @brief 设置消隙回差
+	 * @param backlash 回差, 量纲: 微米. 正负号为最终逼近方向, 0: 不消隙
+	 */
+	void SetBacklash(int backlash);
+	/*!
+	 * @brief 查看联机标志
+	 */
+	bool IsOnline();
+	/*!
+	 * @brief 移动至目标位置
+	 * @param cid    相机标志
+	 * @param target 目标位置
+	 * @return
+	 * true: 需要定位, 到位后产生FOCUS_ARRIVE事件; false: 已在目标位置或脱机
+	 * @note
+	 * 已在目标位置时立即产生FOCUS_ARRIVE事件, 调用者无需区分是否定位
+	 */
+	bool Move(const std::string &cid, int target);
+	/*!
+	 * @brief 取出一个待处理事件
+	 * @param evt 事件
+	 * @return
+	 * 队列为空时返回false
+	 */
+	bool GetEvent(focus_event &evt);
+	/*!
+	 * @brief 启动调焦器
+	 * @return
+	 * 启动结果. 联机后产生FOCUS_ONLINE事件
+	 */
+	virtual bool Start() = 0;
+	/*!
+	 * @brief 停止调焦器
+	 */
+	virtual void Stop() = 0;
+
+protected:
+	/*!
+	 * @brief 向调焦器发送目标位置
+	 * @param cid    相机标志
+	 * @param target 目标位置
+	 * @return
+	 * 发送结果
+	 */
+	virtual bool send_target(const std::string &cid, int target) = 0;
+	/*!
+	 * @brief 由继承类在收到位置反馈时调用, 判定到位与失败
+	 * @param cid 相机标志
+	 * @param pos 实际位置
+	 */
+	void update_position(const std::string &cid, int pos);
+	/*!
+	 * @brief 由继承类在联机状态变化时调用
+	 * @param online 联机标志
+	 * @note
+	 * 联机时清除各通道状态
+	 */
+	void set_online(bool online);
+	/*!
+	 * @brief 事件进入队列. 调用前须加锁
+	 */
+	void push_event(int type, const std::string &cid, int pos);
+	/*!
+	 * @brief 向目标位置发起一段运动. 调用前须加锁
+	 */
+	bool start_move(const std::string &cid, channel &ch, int target);
+};
+typedef boost::shared_ptr<FocuserBase> focptr;
+
+#endif /* FOCUSERBASE_H_ */
@@ -0,0 +1,100 @@
+/*
+ * @file FocuserSim.cpp 模拟调焦器定义文件
+ * @date 2026-10-18
+ * @version 0.1
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include "FocuserSim.h"
+
+FocuserSim::FocuserSim(double speed, double settle, int noise, int period) {
+	speed_  = speed > 0.0 ? speed : 200.0;
+	settle_ = settle > 0.0 ? settle : 0.0;
+	noise_  = noise > 0 ? noise : 0;
+	period_ = period >= 10 ? period : 200;
+	seed_   = (unsigned int) time(NULL);
+}
+
+FocuserSim::~FocuserSim() {
+	Stop();
+}
+
+bool FocuserSim::Start() {
+	if (thrdsim_.use_count()) return true;
+	set_online(true);
+	thrdsim_.reset(new boost::thread(boost::bind(&FocuserSim::thread_sim, this)));
+	return true;
+}
+
+void FocuserSim::Stop() {
+	if (thrdsim_.use_count()) {
+		thrdsim_->interrupt();
+		thrdsim_->join();
+		thrdsim_.reset();
+		set_online(false);
+	}
+}
+
+bool FocuserSim::send_target(const std::string &cid, int target) {
+	mutex_lock lck(mtxsim_);
+	motormap::iterator it = motors_.find(cid);
+	if (it == motors_.end()) {// 首次定位, 初始位置为0
+		motor m;
+		m.pos    = 0.0;
+		m.offset = 0;
+		it = motors_.insert(motormap::value_type(cid, m)).first;
+	}
+	it->second.target = target;
+	it->second.settle = -1.0;
+	return true;
+}
+
+int FocuserSim::random_noise() {
+	return noise_ ? rand_r(&seed_) % (2 * noise_ + 1) - noise_ : 0;
+}
+
+void FocuserSim::thread_sim() {
+	boost::chrono::milliseconds duration(period_);
+	double step = speed_ * period_ * 1E-3;	// 单个周期的运动量
+	std::vector<std::pair<std::string, int> > report;
+	std::vector<std::pair<std::string, int> >::iterator itr;
+	motormap::iterator it;
+	double dx;
+	int pos;
+
+	while (true) {
+		boost::this_thread::sleep_for(duration);
+
+		report.clear();
+		{
+			mutex_lock lck(mtxsim_);
+			for (it = motors_.begin(); it != motors_.end(); ++it) {
+				motor &m = it->second;
+				if ((dx = m.target - m.pos) != 0.0) {// 运动
+					if (fabs(dx) > step) m.pos += dx > 0.0 ? step : -step;
+					else {
+						m.pos    = m.target;
+						m.settle = settle_;
+						if (m.settle <= 0.0) m.offset = random_noise();
+					}
+					pos = int(floor(m.pos + 0.5));
+				}
+				else if (m.settle > 0.0) {// 稳定过程: 随机抖动
+					m.settle -= period_ * 1E-3;
+					if (m.settle <= 0.0) m.offset = random_noise();
+					pos = m.target + (m.settle > 0.0 ? random_noise() : m.offset);
+				}
+				else pos = m.target + m.offset;
+				report.push_back(std::make_pair(it->first, pos));
+			}
+		}
+		/* 在模拟锁之外反馈位置: 判定到位时可能发送下一段目标位置 */
+		for (itr = report.begin(); itr != report.end(); ++itr)
+			update_position(itr->first, itr->second);
+	}
+}
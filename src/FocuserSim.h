@@ -0,0 +1,68 @@
+/*
+ * @file FocuserSim.h 模拟调焦器声明文件
+ * @date 2026-10-18
+ * @version 0.1
+ * @note
+ * - 无硬件条件下端到端执行并计时自动调焦流程
+ * - 各相机通道在首次定位时创建, 初始位置为0
+ * - 以恒定速度运动至目标位置, 到位后在稳定时间内位置随机抖动,
+ *   稳定后静止于目标位置附近, 偏差为噪声范围内的固定随机量
+ * - 按固定周期反馈各通道位置
+ */
+
+#ifndef FOCUSERSIM_H_
+#define FOCUSERSIM_H_
+
+#include "FocuserBase.h"
+
+class FocuserSim : public FocuserBase {
+public:
+	/*!
+	 * @brief 构造函数
+	 * @param speed  运动速度, 量纲: 微米/秒
+	 * @param settle 到位后稳定时间, 量纲: 秒
+	 * @param noise  位置噪声, 量纲: 微米
+	 * @param period 位置反馈周期, 量纲: 毫秒
+	 */
+	FocuserSim(double speed, double settle, int noise, int period);
+	virtual ~FocuserSim();
+
+protected:
+	/* 声明数据类型 */
+	typedef boost::shared_ptr<boost::thread> threadptr;
+
+	struct motor {// 模拟电机
+		double pos;		//< 当前位置
+		int target;		//< 目标位置
+		int offset;		//< 静止时相对目标位置的偏差
+		double settle;	//< 剩余稳定时间, 量纲: 秒
+	};
+	typedef std::map<std::string, motor> motormap;
+
+	/* 成员变量 */
+	double speed_;		//< 运动速度
+	double settle_;		//< 稳定时间
+	int noise_;			//< 位置噪声
+	int period_;		//< 反馈周期
+	unsigned int seed_;	//< 随机数种子
+	motormap motors_;	//< 各通道电机
+	boost::mutex mtxsim_;	//< 电机互斥锁
+	threadptr thrdsim_;		//< 模拟线程
+
+public:
+	bool Start();
+	void Stop();
+
+protected:
+	bool send_target(const std::string &cid, int target);
+	/*!
+	 * @brief 线程: 按周期推进电机并反馈位置
+	 */
+	void thread_sim();
+	/*!
+	 * @brief 生成[-noise_, noise_]范围内的随机整数
+	 */
+	int random_noise();
+};
+
+#endif /* FOCUSERSIM_H_ */
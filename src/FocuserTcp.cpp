@@ -0,0 +1,104 @@
+/*
+ * @file FocuserTcp.cpp 网络调焦器定义文件
+ * @date 2026-10-18
+ * @version 0.1
+ */
+
+#include <string.h>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/algorithm/string.hpp>
+#include "FocuserTcp.h"
+#include "GLog.h"
+
+FocuserTcp::FocuserTcp(int port, const std::string &grpid, const std::string &unitid) {
+	port_   = port;
+	grpid_  = grpid;
+	unitid_ = unitid;
+}
+
+FocuserTcp::~FocuserTcp() {
+	Stop();
+}
+
+bool FocuserTcp::Start() {
+	const tcps_cbtype &slot = boost::bind(&FocuserTcp::handle_accept, this, _1, _2);
+	proto_  = boost::make_shared<mount_proto>();
+	server_ = boost::make_shared<tcp_server>();
+	server_->register_accept(slot);
+	return server_->start(port_);
+}
+
+void FocuserTcp::Stop() {
+	mutex_lock lck(mtxtcp_);
+	if (client_.use_count()) {
+		client_->close();
+		client_.reset();
+	}
+	server_.reset();
+}
+
+bool FocuserTcp::send_target(const std::string &cid, int target) {
+	mutex_lock lck(mtxtcp_);
+	if (!client_.use_count()) return false;
+	int n;
+	const char *to = proto_->compact_focus(grpid_, unitid_, cid, target, n);
+	client_->write(to, n);
+	return true;
+}
+
+void FocuserTcp::handle_accept(const tcpcptr &client, long) {
+	const tcpc_cbtype &slot = boost::bind(&FocuserTcp::handle_receive, this, _1, _2);
+	{
+		mutex_lock lck(mtxtcp_);
+		if (client_.use_count()) client_->close();
+		client_ = client;
+		client->register_receive(slot);
+	}
+	set_online(true);
+}
+
+void FocuserTcp::handle_receive(long client, long ec) {
+	char term[] = "\n";        // 换行符作为信息结束标记
+	int len = strlen(term);// 结束符长度
+	int pos;      // 标志符位置
+	int toread;   // 信息长度
+	mpbase proto_body;
+	std::string proto_type;
+	char buff[TCP_BUFF_SIZE];
+	std::vector<mntproto_focus> rcvd;
+
+	{
+		mutex_lock lck(mtxtcp_);
+		if (!client_.use_count() || client != (long) client_.get()) return; // 已被替代的连接
+		if (ec) {
+			client_.reset();
+			lck.unlock();
+			set_online(false);
+			return;
+		}
+
+		while (client_->is_open() && (pos = client_->lookup(term, len)) >= 0) {
+			/* 有效性判定 */
+			if ((toread = pos + len) > TCP_BUFF_SIZE) {// 原因: 遗漏换行符作为协议结束标记; 高概率性丢包
+				client_->close();
+				gLog.Write(LOG_WARN, "FocuserTcp", "protocol length from focuser is over than threshold");
+				break;
+			}
+			/* 读取协议内容 */
+			client_->read(buff, toread);
+			buff[pos] = 0;
+			/* 解析协议 */
+			proto_type = proto_->resolve(buff, proto_body);
+			if (boost::iequals(proto_type, "focus")) {
+				boost::shared_ptr<mntproto_focus> proto = boost::static_pointer_cast<mntproto_focus>(proto_body);
+				if (boost::iequals(proto->group_id, grpid_) && boost::iequals(proto->unit_id, unitid_))
+					rcvd.push_back(*proto);
+			}
+		}
+	}
+	/* 在网络锁之外处理位置: 判定到位时可能发送下一段目标位置 */
+	for (std::vector<mntproto_focus>::iterator it = rcvd.begin(); it != rcvd.end(); ++it)
+		update_position(it->camera_id, it->position);
+}
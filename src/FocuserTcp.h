@@ -0,0 +1,59 @@
+/*
+ * @file FocuserTcp.h 网络调焦器声明文件
+ * @date 2026-10-18
+ * @version 0.1
+ * @note
+ * - 调焦器作为客户端连接网络服务端口, 各相机共用一条网络连接
+ * - 位置反馈与目标位置均采用focus协议, 以换行符结束, 依据相机标志分发至对应通道
+ * - 新连接替代已有连接; 连接断开时脱机
+ */
+
+#ifndef FOCUSERTCP_H_
+#define FOCUSERTCP_H_
+
+#include "FocuserBase.h"
+#include "tcp_asio.h"
+#include "mountproto.h"
+
+class FocuserTcp : public FocuserBase {
+public:
+	/*!
+	 * @brief 构造函数
+	 * @param port   网络服务端口
+	 * @param grpid  组标志
+	 * @param unitid 单元标志
+	 */
+	FocuserTcp(int port, const std::string &grpid, const std::string &unitid);
+	virtual ~FocuserTcp();
+
+protected:
+	/* 成员变量 */
+	int port_;				//< 网络服务端口
+	std::string grpid_;		//< 组标志
+	std::string unitid_;	//< 单元标志
+	tcpsptr server_;		//< 网络服务
+	tcpcptr client_;		//< 调焦器网络连接
+	mntptr proto_;			//< 通信协议接口
+	boost::mutex mtxtcp_;	//< 网络连接与协议互斥锁
+
+public:
+	bool Start();
+	void Stop();
+
+protected:
+	bool send_target(const std::string &cid, int target);
+	/*!
+	 * @brief 收到调焦器网络连接请求
+	 * @param client 网络连接资源
+	 * @param param  参数
+	 */
+	void handle_accept(const tcpcptr &client, long param);
+	/*!
+	 * @brief 处理收到的调焦信息
+	 * @param client 网络连接资源
+	 * @param ec     错误代码
+	 */
+	void handle_receive(long client, long ec);
+};
+
+#endif /* FOCUSERTCP_H_ */
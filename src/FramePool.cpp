@@ -0,0 +1,73 @@
+/*
+ * @file FramePool.cpp 图像缓冲池
+ * @date 2026-10-18
+ * @version 0.1
+ */
+
+#include "FramePool.h"
+#include "numamem.h"
+
+FramePool::FramePool(size_t bytes, int depth) {
+	bytes_ = (bytes + 15) & ~size_t(15);	// 长度对准16字节
+	depth_ = depth < 2 ? 2 : depth;
+}
+
+FramePool::~FramePool() {
+	bufs_.clear();
+}
+
+size_t FramePool::Bytes() {
+	return bytes_;
+}
+
+FramePool::bufptr FramePool::Get() {
+	mutex_lock lck(mtxbuf_);
+	boost::posix_time::milliseconds period(100);
+
+	while (true) {
+		for (bufvec::iterator it = bufs_.begin(); it != bufs_.end(); ++it) {
+			if (it->use_count() == 1) return *it;
+		}
+		if (int(bufs_.size()) < depth_) {
+			bufs_.push_back(numamem_alloc(bytes_));
+			return bufs_.back();
+		}
+		// 持有者未调用Recycle()时, 依靠超时重新检查
+		cvbuf_.timed_wait(lck, period);
+	}
+}
+
+void FramePool::Recycle(bufptr &buff) {
+	{
+		mutex_lock lck(mtxbuf_);
+		buff.reset();
+	}
+	cvbuf_.notify_all();
+}
+
+VectorFramePool::VectorFramePool(int depth) {
+	free_ = boost::make_shared<freelist>();
+	free_->depth = depth < 1 ? 1 : depth;
+}
+
+VectorFramePool::~VectorFramePool() {
+}
+
+VectorFramePool::vecptr VectorFramePool::Get() {
+	mutex_lock lck(free_->mtx);
+	vecptr vec;
+
+	if (free_->vecs.empty()) vec = boost::make_shared<vector_type>();
+	else {
+		vec = free_->vecs.back();
+		free_->vecs.pop_back();
+	}
+	return vec;
+}
+
+boost::shared_array<uint8_t> VectorFramePool::Adopt(vecptr vec) {
+	recycler del;
+	del.list = free_;
+	del.vec  = vec;
+	return boost::shared_array<uint8_t>((uint8_t*) &(*vec)[0], del);
+}
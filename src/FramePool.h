@@ -0,0 +1,118 @@
+/*
+ * @file FramePool.h 图像缓冲池
+ * @date 2026-10-18
+ * @version 0.1
+ * @note
+ * - 每台相机一个缓冲池. 曝光完成后以空闲缓冲区替换相机内部存储区, 已采集图像
+ *   转交存储线程, 相机可立即开始下一次曝光, 无需复制图像数据
+ * - 缓冲区由numamem_alloc()分配, 可采用大页与NUMA绑定
+ * - 缓冲区仅被缓冲池引用时视为空闲, 缓冲区数量达到上限时Get()等待空闲缓冲区
+ * - VectorFramePool: SDK只能读出至std::vector时, 直接以vector存储区作为图像缓冲区,
+ *   缓冲区释放时回收vector供下次读出, 避免由vector复制至缓冲区
+ */
+
+#ifndef FRAMEPOOL_H_
+#define FRAMEPOOL_H_
+
+#include <vector>
+#include <stdint.h>
+#include <boost/smart_ptr.hpp>
+#include <boost/thread.hpp>
+
+class FramePool {
+public:
+	/*!
+	 * @brief 构造函数
+	 * @param bytes 单个缓冲区容量, 量纲: 字节
+	 * @param depth 缓冲区数量上限
+	 */
+	FramePool(size_t bytes, int depth);
+	virtual ~FramePool();
+
+protected:
+	/* 声明数据类型 */
+	typedef boost::shared_array<uint8_t> bufptr;
+	typedef std::vector<bufptr> bufvec;
+	typedef boost::unique_lock<boost::mutex> mutex_lock;
+
+	/* 成员变量 */
+	size_t bytes_;	//< 单个缓冲区容量, 量纲: 字节
+	int depth_;		//< 缓冲区数量上限
+	bufvec bufs_;	//< 已分配缓冲区
+	boost::mutex mtxbuf_;	//< 缓冲区互斥锁
+	boost::condition_variable cvbuf_;	//< 通知: 缓冲区被释放
+
+public:
+	/*!
+	 * @brief 查看单个缓冲区容量
+	 * @return
+	 * 缓冲区容量, 量纲: 字节
+	 */
+	size_t Bytes();
+	/*!
+	 * @brief 取空闲缓冲区
+	 * @return
+	 * 缓冲区
+	 * @note
+	 * 无空闲缓冲区且数量已达上限时, 阻塞直至有缓冲区被释放
+	 */
+	bufptr Get();
+	/*!
+	 * @brief 释放缓冲区
+	 * @param buff 缓冲区. 函数返回后为空
+	 */
+	void Recycle(bufptr &buff);
+};
+
+class VectorFramePool {
+public:
+	/*!
+	 * @brief 构造函数
+	 * @param depth 回收vector数量上限
+	 */
+	VectorFramePool(int depth = 3);
+	virtual ~VectorFramePool();
+
+public:
+	/* 声明数据类型 */
+	typedef std::vector<uint16_t> vector_type;
+	typedef boost::shared_ptr<vector_type> vecptr;
+
+protected:
+	typedef boost::unique_lock<boost::mutex> mutex_lock;
+	struct freelist {// 已回收vector. 由缓冲区与缓冲池共同持有, 缓冲区可晚于缓冲池释放
+		boost::mutex mtx;	//< 互斥锁
+		int depth;			//< 数量上限
+		std::vector<vecptr> vecs;	//< 已回收vector
+	};
+	struct recycler {// 缓冲区删除器: 回收vector
+		boost::shared_ptr<freelist> list;
+		vecptr vec;
+
+		void operator()(uint8_t *) {
+			mutex_lock lck(list->mtx);
+			if (int(list->vecs.size()) < list->depth) list->vecs.push_back(vec);
+			vec.reset();
+		}
+	};
+
+	/* 成员变量 */
+	boost::shared_ptr<freelist> free_;	//< 已回收vector
+
+public:
+	/*!
+	 * @brief 取vector用于读出. 优先复用已回收vector, 其存储区无需重新分配
+	 * @return
+	 * vector
+	 */
+	vecptr Get();
+	/*!
+	 * @brief 以vector存储区作为图像缓冲区
+	 * @param vec 已读出数据的vector. 函数返回后由缓冲区持有, 调用者不应再修改
+	 * @return
+	 * 图像缓冲区. 缓冲区释放时vector被回收
+	 */
+	boost::shared_array<uint8_t> Adopt(vecptr vec);
+};
+
+#endif /* FRAMEPOOL_H_ */
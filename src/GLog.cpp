@@ -18,6 +18,8 @@ using namespace boost::posix_time;
 GLog::GLog(FILE *out) {
 	m_day = -1;
 	m_fd  = out;
+	m_written = 0;
+	m_dropped = 0;
 }
 
 GLog::~GLog() {
@@ -42,8 +44,8 @@ bool GLog::valid_file(ptime &t) {
 		if (access(gLogDir, F_OK)) mkdir(gLogDir, 0755);	// 创建目录
 		sprintf(pathname, "%s/%s%s.log",
 				gLogDir, gLogPrefix, to_iso_string(date).c_str());
-		m_fd = fopen(pathname, "a+");
-		fprintf(m_fd, "%s\n", string(79, '-').c_str());
+		if ((m_fd = fopen(pathname, "a+")) != NULL)
+			fprintf(m_fd, "%s\n", string(79, '-').c_str());
 	}
 
 	return (m_fd != NULL);
@@ -65,7 +67,9 @@ void GLog::Write(const char* format, ...) {
 		va_end(vl);
 		fprintf(m_fd, "\n");
 		fflush(m_fd);
+		__sync_fetch_and_add(&m_written, 1);
 	}
+	else __sync_fetch_and_add(&m_dropped, 1);
 }
 
 void GLog::Write(const LOG_TYPE type, const char* where, const char* format, ...) {
@@ -89,5 +93,15 @@ void GLog::Write(const LOG_TYPE type, const char* where, const char* format, ...
 		va_end(vl);
 		fprintf(m_fd, "\n");
 		fflush(m_fd);
+		__sync_fetch_and_add(&m_written, 1);
 	}
+	else __sync_fetch_and_add(&m_dropped, 1);
+}
+
+unsigned long GLog::Written() {
+	return __sync_fetch_and_add(&m_written, 0);
+}
+
+unsigned long GLog::Dropped() {
+	return __sync_fetch_and_add(&m_dropped, 0);
 }
@@ -52,6 +52,14 @@ public:
 	 * @param format  日志描述的格式和内容
 	 */
 	void Write(const LOG_TYPE type, const char* where, const char* format, ...);
+	/*!
+	 * @brief 查看已写入日志条数
+	 */
+	unsigned long Written();
+	/*!
+	 * @brief 查看因日志文件无效而丢弃的日志条数
+	 */
+	unsigned long Dropped();
 
 protected:
 	/* 声明数据类型 */
@@ -60,6 +68,8 @@ protected:
 	boost::mutex m_mutex;	//< 互斥区
 	int  m_day;				//< UTC日期
 	FILE *m_fd;				//< 日志文件描述符
+	unsigned long m_written;	//< 已写入日志条数. 原子操作更新与读取
+	unsigned long m_dropped;	//< 已丢弃日志条数. 原子操作更新与读取
 };
 
 extern GLog gLog;
@@ -0,0 +1,103 @@
+/*
+ * @file ImageDisplay.cpp 通过XPA在ds9中实时显示图像
+ * @date 2026-10-18
+ * @version 0.1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <xpa.h>
+#include "ImageDisplay.h"
+#include "pixkernel.h"
+#include "GLog.h"
+
+ImageDisplay::ImageDisplay() {
+	bin_     = 2;
+	first_   = true;
+	pending_ = false;
+	online_  = true;
+	posted_  = 0;
+	dropped_ = 0;
+}
+
+ImageDisplay::~ImageDisplay() {
+	Stop();
+}
+
+void ImageDisplay::SetBinning(int bin) {
+	bin_ = bin < 1 ? 1 : bin;
+}
+
+void ImageDisplay::Start() {
+	if (!thrdDisplay_.unique())
+		thrdDisplay_.reset(new boost::thread(boost::bind(&ImageDisplay::ThreadDisplay, this)));
+}
+
+void ImageDisplay::Stop() {
+	if (thrdDisplay_.unique()) {
+		thrdDisplay_->interrupt();
+		thrdDisplay_->join();
+		thrdDisplay_.reset();
+	}
+	if (posted_) gLog.Write("ImageDisplay: %ld images posted, %ld dropped", posted_, dropped_);
+}
+
+void ImageDisplay::NewImage(const uint16_t *data, int width, int height, const std::string &title) {
+	mutex_lock lck(mtxfrm_);
+	++posted_;
+	if (pending_) ++dropped_; // 上一帧尚未显示即被覆盖
+	frmnew_.resize(width / bin_, height / bin_);
+	frmnew_.title = title;
+	bin_u16(data, width, height, bin_, frmnew_.data.get());
+	pending_ = true;
+	cvfrm_.notify_one();
+}
+
+void ImageDisplay::ThreadDisplay() {
+	while (true) {
+		{// 取最新图像. 交换存储区, 投递者可立即写入下一帧
+			mutex_lock lck(mtxfrm_);
+			while (!pending_) cvfrm_.wait(lck);
+			std::swap(frmnew_, frmshow_);
+			pending_ = false;
+		}
+
+		if (XPASetArray(frmshow_) && first_) {
+			first_ = false;
+			XPASetCommand("scale mode zscale");
+			XPASetCommand("zoom to fit");
+			XPASetCommand("preserve pan yes");
+			XPASetCommand("preserve regions yes");
+		}
+	}
+}
+
+bool ImageDisplay::XPASetArray(const display_frame &frame) {
+	char *names(NULL), *messages(NULL);
+	char params[100];
+	int n;
+
+	sprintf(params, "array [xdim=%d,ydim=%d,bitpix=-16,arch=littleendian]", frame.width, frame.height);
+	n = XPASet(NULL, (char*) "ds9", params, (char*) "ack=true",
+			(char*) frame.data.get(), size_t(frame.width) * frame.height * sizeof(uint16_t),
+			&names, &messages, 1);
+	if (n == 1 && messages && messages[0]) n = 0; // ds9返回错误信息
+	if (n != 1 && online_) {
+		gLog.Write(LOG_WARN, "ImageDisplay", "failed to display <%s>: %s", frame.title.c_str(),
+				messages ? messages : "ds9 not found");
+	}
+	online_ = n == 1;
+	if (names) free(names);
+	if (messages) free(messages);
+
+	return online_;
+}
+
+void ImageDisplay::XPASetCommand(const char *params) {
+	char *names(NULL), *messages(NULL);
+
+	XPASet(NULL, (char*) "ds9", (char*) params, NULL, NULL, 0, &names, &messages, 1);
+	if (names) free(names);
+	if (messages) free(messages);
+}
@@ -0,0 +1,108 @@
+/*
+ * @file ImageDisplay.h 通过XPA在ds9中实时显示图像
+ * @date 2026-10-18
+ * @version 0.1
+ * @note
+ * - 图像合并后以内存数组形式(xpaset ds9 array)发送, 不再重新读取FITS文件
+ * - 显示在独立线程中完成, 不阻塞消息队列与曝光流程
+ * - 当ds9处理速度低于图像产生速度时, 仅显示最新图像, 丢弃中间未显示图像
+ */
+
+#ifndef IMAGEDISPLAY_H_
+#define IMAGEDISPLAY_H_
+
+#include <string>
+#include <stdint.h>
+#include <boost/smart_ptr.hpp>
+#include <boost/thread.hpp>
+
+class ImageDisplay {
+public:
+	ImageDisplay();
+	virtual ~ImageDisplay();
+
+protected:
+	/* 声明数据类型 */
+	struct display_frame {// 待显示图像
+		boost::shared_array<uint16_t> data;	//< 合并后图像数据
+		int capacity;		//< 存储区容量, 量纲: 像素
+		int width;			//< 宽度
+		int height;			//< 高度
+		std::string title;	//< 图像标题, 一般为文件名
+
+	public:
+		display_frame() {
+			capacity = width = height = 0;
+		}
+
+		void resize(int w, int h) {
+			if (w * h > capacity) {
+				capacity = w * h;
+				data.reset(new uint16_t[capacity]);
+			}
+			width  = w;
+			height = h;
+		}
+	};
+
+	typedef boost::shared_ptr<boost::thread> threadptr;
+	typedef boost::unique_lock<boost::mutex> mutex_lock;
+
+	/* 成员变量 */
+	int bin_;				//< 合并因子
+	bool first_;			//< 首帧标志: 设置ds9显示参数
+	bool pending_;			//< 存在未显示图像
+	bool online_;			//< ds9可访问标志
+	display_frame frmnew_;	//< 最新投递图像
+	display_frame frmshow_;	//< 正在显示图像
+	boost::mutex mtxfrm_;	//< 图像互斥锁
+	boost::condition_variable cvfrm_;	//< 通知: 新的图像
+	threadptr thrdDisplay_;	//< 线程: 显示图像
+	long posted_;			//< 投递图像数量
+	long dropped_;			//< 未显示即被覆盖的图像数量
+
+public:
+	/*!
+	 * @brief 设置合并因子
+	 * @param bin 合并因子. 1: 不合并
+	 */
+	void SetBinning(int bin);
+	/*!
+	 * @brief 启动显示线程
+	 */
+	void Start();
+	/*!
+	 * @brief 停止显示线程
+	 */
+	void Stop();
+	/*!
+	 * @brief 投递待显示图像
+	 * @param data   16位图像数据
+	 * @param width  图像宽度
+	 * @param height 图像高度
+	 * @param title  图像标题
+	 * @note
+	 * 函数返回时已完成合并, 调用者可立即复用data存储区
+	 */
+	void NewImage(const uint16_t *data, int width, int height, const std::string &title);
+
+protected:
+	/*!
+	 * @brief 线程: 将最新图像发送给ds9
+	 */
+	void ThreadDisplay();
+	/*!
+	 * @brief 以内存数组形式将图像发送给ds9
+	 * @param frame 图像
+	 * @return
+	 * 发送结果
+	 */
+	bool XPASetArray(const display_frame &frame);
+	/*!
+	 * @brief 向ds9发送一条无数据指令
+	 * @param params 指令
+	 */
+	void XPASetCommand(const char *params);
+};
+
+#endif /* IMAGEDISPLAY_H_ */
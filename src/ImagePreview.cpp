@@ -0,0 +1,238 @@
+/*
+ * @file ImagePreview.cpp 生成图像缩略图
+ * @date 2026-10-18
+ * @version 0.1
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+#include <png.h>
+#include <boost/chrono.hpp>
+#include "ImagePreview.h"
+#include "pixkernel.h"
+#include "GLog.h"
+
+ImagePreview::ImagePreview() {
+	bin_     = 8;
+	data_    = NULL;
+	width_   = height_ = 0;
+	busy_    = false;
+	result_  = false;
+	elapsed_ = 0.0;
+	capacity_= 0;
+}
+
+ImagePreview::~ImagePreview() {
+	Stop();
+}
+
+void ImagePreview::SetBinning(int bin) {
+	bin_ = bin < 1 ? 1 : bin;
+}
+
+void ImagePreview::Start() {
+	if (!thrdPreview_.unique())
+		thrdPreview_.reset(new boost::thread(boost::bind(&ImagePreview::ThreadPreview, this)));
+}
+
+void ImagePreview::Stop() {
+	if (thrdPreview_.unique()) {
+		Wait();
+		thrdPreview_->interrupt();
+		thrdPreview_->join();
+		thrdPreview_.reset();
+	}
+}
+
+void ImagePreview::Generate(const uint16_t *data, int width, int height, const std::string &fitspath) {
+	mutex_lock lck(mtxjob_);
+	while (busy_) cvjob_.wait(lck);
+
+	std::string::size_type pos = fitspath.rfind('.');
+	data_   = data;
+	width_  = width;
+	height_ = height;
+	filepath_ = (pos == std::string::npos ? fitspath : fitspath.substr(0, pos)) + ".png";
+	busy_   = true;
+	cvjob_.notify_all();
+}
+
+bool ImagePreview::Wait() {
+	mutex_lock lck(mtxjob_);
+	while (busy_) cvjob_.wait(lck);
+	return result_ && !access(filepath_.c_str(), F_OK); // 确认缩略图文件已生成
+}
+
+double ImagePreview::Elapsed() {
+	return elapsed_;
+}
+
+void ImagePreview::ThreadPreview() {
+	typedef boost::chrono::steady_clock clock;
+
+	while (true) {
+		{
+			mutex_lock lck(mtxjob_);
+			while (!busy_) cvjob_.wait(lck);
+		}
+
+		clock::time_point t0 = clock::now();
+		bool rslt = CreatePreview();
+		elapsed_ = boost::chrono::duration<double, boost::milli>(clock::now() - t0).count();
+
+		mutex_lock lck(mtxjob_);
+		result_ = rslt;
+		busy_   = false;
+		data_   = NULL;
+		cvjob_.notify_all();
+	}
+}
+
+bool ImagePreview::CreatePreview() {
+	int wbin(width_ / bin_), hbin(height_ / bin_), n(wbin * hbin);
+	float z1, z2;
+
+	if (n <= 0) return false;
+	if (n > capacity_) {
+		capacity_ = n;
+		bufbin_.reset(new uint16_t[n]);
+		bufimg_.reset(new uint8_t[n]);
+	}
+	// 在原始图像上采样计算zscale, 再合并. 合并取平均值, 显示范围不变
+	ZScale(data_, width_, height_, z1, z2);
+	bin_u16(data_, width_, height_, bin_, bufbin_.get());
+
+	const uint16_t *src = bufbin_.get();
+	uint8_t *dst = bufimg_.get();
+	float scale = z2 > z1 ? 255.0f / (z2 - z1) : 1.0f;
+	for (int i = 0; i < n; ++i) {
+		float v = (src[i] - z1) * scale;
+		dst[i] = v <= 0.0f ? 0 : (v >= 255.0f ? 255 : uint8_t(v + 0.5f));
+	}
+
+	return WritePNG(filepath_, wbin, hbin, z1, z2);
+}
+
+void ImagePreview::ZScale(const uint16_t *data, int width, int height, float &z1, float &z2,
+		int nsample, float contrast) {
+	const int maxiter(5);		// 最大拟合次数
+	const float krej(2.5);		// 拒绝阈值, 量纲: 标准差
+	const float maxreject(0.5);	// 最大拒绝比例
+	int stride, npix, minpix, ngrow, ngood, ngoodlast, i, j;
+	std::vector<float> samples;
+	double slope(0.0), intercept(0.0);
+
+	/* 等间隔采样并排序 */
+	stride = int(sqrt(double(width) * height / nsample));
+	if (stride < 1) stride = 1;
+	samples.reserve(nsample + width / stride + 1);
+	for (j = stride / 2; j < height; j += stride) {
+		const uint16_t *row = data + long(j) * width;
+		for (i = stride / 2; i < width; i += stride) samples.push_back(row[i]);
+	}
+	if ((npix = int(samples.size())) == 0) {
+		z1 = z2 = 0.0f;
+		return;
+	}
+	std::sort(samples.begin(), samples.end());
+	z1 = samples[0];
+	z2 = samples[npix - 1];
+
+	/* 迭代拟合直线并拒绝偏离点 */
+	std::vector<char> bad(npix, 0), grow(npix, 0);
+	minpix = std::max(5, int(npix * maxreject));
+	ngrow  = std::max(1, int(npix * 0.01));
+	ngood  = npix;
+	ngoodlast = npix + 1;
+	for (int iter = 0; iter < maxiter && ngood < ngoodlast && ngood >= minpix; ++iter) {
+		double sx(0), sy(0), sxx(0), sxy(0), sum(0), sum2(0), dev, thresh;
+		int cnt(0);
+		for (i = 0; i < npix; ++i) {
+			if (bad[i]) continue;
+			sx  += i;
+			sy  += samples[i];
+			sxx += double(i) * i;
+			sxy += i * double(samples[i]);
+			++cnt;
+		}
+		dev = cnt * sxx - sx * sx;
+		slope = dev > 0.0 ? (cnt * sxy - sx * sy) / dev : 0.0;
+		intercept = (sy - slope * sx) / cnt;
+
+		for (i = 0; i < npix; ++i) {
+			if (bad[i]) continue;
+			dev = samples[i] - (intercept + slope * i);
+			sum += dev;
+			sum2 += dev * dev;
+		}
+		thresh = krej * sqrt(std::max(0.0, sum2 / cnt - (sum / cnt) * (sum / cnt)));
+		for (i = 0; i < npix; ++i) {
+			dev = samples[i] - (intercept + slope * i);
+			if (dev < -thresh || dev > thresh) bad[i] = 1;
+		}
+		// 被拒绝点向两侧扩展
+		std::fill(grow.begin(), grow.end(), 0);
+		for (i = 0; i < npix; ++i) {
+			if (!bad[i]) continue;
+			int k0 = std::max(0, i - (ngrow - 1) / 2), k1 = std::min(npix - 1, i + ngrow / 2);
+			for (int k = k0; k <= k1; ++k) grow[k] = 1;
+		}
+		bad.swap(grow);
+		ngoodlast = ngood;
+		ngood = int(std::count(bad.begin(), bad.end(), 0));
+	}
+
+	if (ngood >= minpix) {
+		int center = (npix - 1) / 2;
+		float median = npix % 2 ? samples[center] : 0.5f * (samples[center] + samples[center + 1]);
+		if (contrast > 0.0f) slope /= contrast;
+		z1 = std::max(z1, float(median - (center - 1) * slope));
+		z2 = std::min(z2, float(median + (npix - center) * slope));
+	}
+}
+
+bool ImagePreview::WritePNG(const std::string &filepath, int width, int height, float z1, float z2) {
+	png_structp png;
+	png_infop info;
+	FILE *fp;
+
+	if ((fp = fopen(filepath.c_str(), "wb")) == NULL) {
+		gLog.Write(LOG_WARN, "ImagePreview", "failed to create <%s>", filepath.c_str());
+		return false;
+	}
+	if ((png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL)) == NULL
+			|| (info = png_create_info_struct(png)) == NULL) {
+		if (png) png_destroy_write_struct(&png, NULL);
+		fclose(fp);
+		return false;
+	}
+	if (setjmp(png_jmpbuf(png))) {
+		png_destroy_write_struct(&png, &info);
+		fclose(fp);
+		gLog.Write(LOG_WARN, "ImagePreview", "failed to write <%s>", filepath.c_str());
+		return false;
+	}
+
+	char zscale[40];
+	png_text text;
+	sprintf(zscale, "%.1f %.1f", z1, z2);
+	text.compression = PNG_TEXT_COMPRESSION_NONE;
+	text.key  = (png_charp) "zscale";
+	text.text = zscale;
+
+	png_init_io(png, fp);
+	png_set_compression_level(png, 1);
+	png_set_IHDR(png, info, width, height, 8, PNG_COLOR_TYPE_GRAY,
+			PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+	png_set_text(png, info, &text, 1);
+	png_write_info(png, info);
+	for (int j = 0; j < height; ++j) png_write_row(png, bufimg_.get() + long(j) * width);
+	png_write_end(png, NULL);
+	png_destroy_write_struct(&png, &info);
+	fclose(fp);
+
+	return true;
+}
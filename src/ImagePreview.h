@@ -0,0 +1,122 @@
+/*
+ * @file ImagePreview.h 生成图像缩略图
+ * @date 2026-10-18
+ * @version 0.1
+ * @note
+ * - 由稀疏采样计算zscale显示范围, 合并(4×4或8×8)后量化为8位灰度PNG, 存储在FITS文件旁
+ * - 在独立线程中与FITS存储并行执行
+ * - 缩略图内嵌zscale范围(PNG文本块), 便于远程查看时复原灰度
+ */
+
+#ifndef IMAGEPREVIEW_H_
+#define IMAGEPREVIEW_H_
+
+#include <string>
+#include <stdint.h>
+#include <boost/smart_ptr.hpp>
+#include <boost/thread.hpp>
+
+class ImagePreview {
+public:
+	ImagePreview();
+	virtual ~ImagePreview();
+
+protected:
+	/* 声明数据类型 */
+	typedef boost::shared_ptr<boost::thread> threadptr;
+	typedef boost::unique_lock<boost::mutex> mutex_lock;
+
+	/* 成员变量 */
+	int bin_;		//< 合并因子
+	/* 待处理图像 */
+	const uint16_t *data_;	//< 图像数据
+	int width_;				//< 图像宽度
+	int height_;			//< 图像高度
+	std::string filepath_;	//< 缩略图文件路径
+	bool busy_;				//< 正在生成缩略图
+	bool result_;			//< 生成结果
+	double elapsed_;		//< 生成耗时, 量纲: 毫秒
+	boost::mutex mtxjob_;	//< 任务互斥锁
+	boost::condition_variable cvjob_;	//< 通知: 新的任务/任务完成
+	threadptr thrdPreview_;	//< 线程: 生成缩略图
+	/* 工作缓冲区 */
+	boost::shared_array<uint16_t> bufbin_;	//< 合并后图像
+	boost::shared_array<uint8_t> bufimg_;	//< 8位缩略图
+	int capacity_;			//< 缓冲区容量, 量纲: 像素
+
+public:
+	/*!
+	 * @brief 设置合并因子
+	 * @param bin 合并因子, 一般为4或8
+	 */
+	void SetBinning(int bin);
+	/*!
+	 * @brief 启动工作线程
+	 */
+	void Start();
+	/*!
+	 * @brief 停止工作线程
+	 */
+	void Stop();
+	/*!
+	 * @brief 启动生成缩略图
+	 * @param data     16位图像数据
+	 * @param width    图像宽度
+	 * @param height   图像高度
+	 * @param fitspath 对应FITS文件路径. 缩略图扩展名为.png
+	 * @note
+	 * 调用Wait()返回前, data须保持有效且不被改写
+	 */
+	void Generate(const uint16_t *data, int width, int height, const std::string &fitspath);
+	/*!
+	 * @brief 等待完成缩略图
+	 * @return
+	 * 缩略图生成结果. 写入成功且文件存在时为true
+	 */
+	bool Wait();
+	/*!
+	 * @brief 查看最近一次生成缩略图的耗时
+	 * @return
+	 * 耗时, 量纲: 毫秒
+	 */
+	double Elapsed();
+	/*!
+	 * @brief 计算zscale显示范围
+	 * @param data     16位图像数据
+	 * @param width    图像宽度
+	 * @param height   图像高度
+	 * @param z1       显示下限
+	 * @param z2       显示上限
+	 * @param nsample  采样像素数
+	 * @param contrast 对比度
+	 * @note
+	 * 算法同IRAF/ds9 zscale, 采样点在全图内等间隔分布
+	 */
+	static void ZScale(const uint16_t *data, int width, int height, float &z1, float &z2,
+			int nsample = 1000, float contrast = 0.25);
+
+protected:
+	/*!
+	 * @brief 线程: 生成缩略图
+	 */
+	void ThreadPreview();
+	/*!
+	 * @brief 生成缩略图
+	 * @return
+	 * 生成结果
+	 */
+	bool CreatePreview();
+	/*!
+	 * @brief 存储8位灰度PNG文件
+	 * @param filepath 文件路径
+	 * @param width    宽度
+	 * @param height   高度
+	 * @param z1       显示下限
+	 * @param z2       显示上限
+	 * @return
+	 * 存储结果
+	 */
+	bool WritePNG(const std::string &filepath, int width, int height, float z1, float z2);
+};
+
+#endif /* IMAGEPREVIEW_H_ */
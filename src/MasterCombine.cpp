@@ -0,0 +1,75 @@
+/*
+ * @file MasterCombine.cpp 本底/暗场合并定义文件
+ * @date 2026-10-18
+ * @version 0.1
+ */
+
+#include <string.h>
+#include "MasterCombine.h"
+#include "pixkernel.h"
+#include "numamem.h"
+
+MasterCombine::MasterCombine(int width, int height, int count) {
+	size_t pixels = size_t(width) * height;
+
+	width_  = width;
+	height_ = height;
+	count_  = count;
+	added_  = skipped_ = 0;
+	bufsum_ = numamem_alloc(pixels * sizeof(uint32_t));
+	buflo_  = numamem_alloc(pixels * sizeof(uint16_t));
+	bufhi_  = numamem_alloc(pixels * sizeof(uint16_t));
+	memset(bufsum_.get(), 0, pixels * sizeof(uint32_t));
+	memset(buflo_.get(), 0xFF, pixels * sizeof(uint16_t));
+	memset(bufhi_.get(), 0, pixels * sizeof(uint16_t));
+}
+
+MasterCombine::~MasterCombine() {
+}
+
+int MasterCombine::Count() {
+	return count_;
+}
+
+int MasterCombine::Added() {
+	mutex_lock lck(mtxadd_);
+	return added_;
+}
+
+int MasterCombine::Add(const uint16_t *data, int width, int height) {
+	if (width != width_ || height != height_) return -1;
+
+	mutex_lock lck(mtxadd_);
+	accum_minmax_u16(data, (uint32_t*) bufsum_.get(), (uint16_t*) buflo_.get(), (uint16_t*) bufhi_.get(),
+			size_t(width_) * height_);
+	return ++added_ + skipped_;
+}
+
+int MasterCombine::Skip() {
+	mutex_lock lck(mtxadd_);
+	return added_ + ++skipped_;
+}
+
+MasterCombine::bufptr MasterCombine::Combine() {
+	mutex_lock lck(mtxadd_);
+	if (!added_) return bufptr();
+
+	size_t pixels = size_t(width_) * height_;
+	bufptr master = numamem_alloc(pixels * sizeof(uint16_t));
+	const uint32_t *sum = (const uint32_t*) bufsum_.get();
+	const uint16_t *lo = (const uint16_t*) buflo_.get();
+	const uint16_t *hi = (const uint16_t*) bufhi_.get();
+	uint16_t *dst = (uint16_t*) master.get();
+
+	if (added_ >= 3) {// 剔除极小与极大值
+		double rcp = 1.0 / (added_ - 2);
+		for (size_t i = 0; i < pixels; ++i)
+			dst[i] = uint16_t((sum[i] - lo[i] - hi[i]) * rcp + 0.5);
+	}
+	else {
+		double rcp = 1.0 / added_;
+		for (size_t i = 0; i < pixels; ++i)
+			dst[i] = uint16_t(sum[i] * rcp + 0.5);
+	}
+	return master;
+}
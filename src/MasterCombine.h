@@ -0,0 +1,86 @@
+/*
+ * @file MasterCombine.h 本底/暗场合并声明文件
+ * @date 2026-10-18
+ * @version 0.1
+ * @note
+ * - 逐帧累加各像素的和、极小值与极大值, 内存占用为每像素8字节, 与帧数无关
+ * - 合并结果为剔除极小与极大值后的平均值(不少于3帧时), 等效于每像素剔除两个离群值.
+ *   此为有意的简化: 逐像素σ裁剪亦可流式实现(另存平方和, 以均值与σ判定极值是否剔除),
+ *   但需增加每像素8字节与累加核函数, 对本底/暗场中稀少的宇宙线收益有限
+ * - 累加由accum_minmax_u16()完成, 按CPU指令集选择SIMD实现
+ * - 可由多个存储线程并发调用Add()
+ * - 丢失或尺寸不一致的帧由Skip()计数, 已处理帧数达到合并帧数时即合并, 不因丢帧而停滞
+ */
+
+#ifndef MASTERCOMBINE_H_
+#define MASTERCOMBINE_H_
+
+#include <stdint.h>
+#include <boost/smart_ptr.hpp>
+#include <boost/thread.hpp>
+
+class MasterCombine {
+public:
+	/*!
+	 * @brief 构造函数
+	 * @param width  图像宽度
+	 * @param height 图像高度
+	 * @param count  合并帧数
+	 */
+	MasterCombine(int width, int height, int count);
+	virtual ~MasterCombine();
+
+protected:
+	/* 声明数据类型 */
+	typedef boost::shared_array<uint8_t> bufptr;
+	typedef boost::unique_lock<boost::mutex> mutex_lock;
+
+	/* 成员变量 */
+	int width_, height_;	//< 图像尺寸
+	int count_;		//< 合并帧数
+	int added_;		//< 已累加帧数
+	int skipped_;	//< 未累加帧数: 丢失或尺寸不一致
+	bufptr bufsum_;	//< 累加和
+	bufptr buflo_;	//< 极小值
+	bufptr bufhi_;	//< 极大值
+	boost::mutex mtxadd_;	//< 累加互斥锁
+
+public:
+	/*!
+	 * @brief 查看合并帧数
+	 * @return
+	 * 合并帧数
+	 */
+	int Count();
+	/*!
+	 * @brief 查看已累加帧数
+	 * @return
+	 * 已累加帧数
+	 */
+	int Added();
+	/*!
+	 * @brief 累加一帧图像
+	 * @param data   图像数据
+	 * @param width  图像宽度
+	 * @param height 图像高度
+	 * @return
+	 * 含本帧在内的已处理帧数(已累加与未累加). -1: 图像尺寸不一致, 调用者应执行Skip()
+	 * @note
+	 * 返回值等于合并帧数时, 调用者应执行Combine()
+	 */
+	int Add(const uint16_t *data, int width, int height);
+	/*!
+	 * @brief 记录一帧未累加的图像
+	 * @return
+	 * 含本帧在内的已处理帧数
+	 */
+	int Skip();
+	/*!
+	 * @brief 生成合并图像
+	 * @return
+	 * 合并图像, 16位无符号数. 未累加图像时为空
+	 */
+	bufptr Combine();
+};
+
+#endif /* MASTERCOMBINE_H_ */
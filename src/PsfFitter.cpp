@@ -0,0 +1,248 @@
+/*
+ * @file PsfFitter.cpp 星像PSF拟合定义文件
+ * @date 2026-10-18
+ * @version 0.1
+ */
+
+#include <math.h>
+#include <string.h>
+#include <strings.h>
+#include <algorithm>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include "PsfFitter.h"
+#include "FocalPlane.h"
+#include "pixkernel.h"
+
+#define PSF_MAXITER	50		// 最大迭代次数
+#define PSF_LAMBDA0	1E-3	// 初始阻尼因子
+#define PSF_LAMBDAX	1E7		// 阻尼因子上限. 超过时视为已达极小值
+#define PSF_RELTOL	1E-5	// χ²相对下降量小于该值时收敛
+
+/*!
+ * @brief 按流量降序比较星像
+ */
+class flux_greater {
+public:
+	flux_greater(const star_catalog &cat) : cat_(cat) {}
+	bool operator()(int a, int b) const {
+		return cat_.flux[a] > cat_.flux[b];
+	}
+
+protected:
+	const star_catalog &cat_;
+};
+
+int psf_model_code(const std::string &name) {
+	if (!strcasecmp(name.c_str(), "gauss")) return PSF_GAUSS;
+	if (!strcasecmp(name.c_str(), "moffat")) return PSF_MOFFAT;
+	return PSF_NONE;
+}
+
+const char *psf_model_name(int model) {
+	return model == PSF_GAUSS ? "gauss" : (model == PSF_MOFFAT ? "moffat" : "none");
+}
+
+PsfFitter::PsfFitter(int model, int stamp, int maxstar, int nthread) {
+	model_   = model == PSF_GAUSS ? PSF_GAUSS : PSF_MOFFAT;
+	stamp_   = stamp < 5 ? 5 : (stamp | 1);
+	maxstar_ = maxstar < 1 ? 1 : maxstar;
+	nthread_ = nthread > 0 ? nthread : int(boost::thread::hardware_concurrency());
+	if (nthread_ <= 0) nthread_ = 1;
+	data_  = NULL;
+	width_ = 0;
+	cat_   = NULL;
+	nextbatch_ = 0;
+}
+
+PsfFitter::~PsfFitter() {
+}
+
+int PsfFitter::Fit(const uint16_t *data, int width, int height, const star_catalog &cat, psf_catalog &psf) {
+	int half = stamp_ / 2, i, ix, iy;
+
+	psf.clear();
+	/* 候选星像: 未饱和、未接触边界、子图位于图像内, 按流量降序取前maxstar_个 */
+	cand_.clear();
+	for (i = 0; i < cat.size(); ++i) {
+		if (cat.flags[i] || cat.peak[i] <= 0.0f) continue;
+		ix = int(cat.x[i] + 0.5f);
+		iy = int(cat.y[i] + 0.5f);
+		if (ix < half || iy < half || ix + half >= width || iy + half >= height) continue;
+		cand_.push_back(i);
+	}
+	if (int(cand_.size()) > maxstar_) {
+		std::partial_sort(cand_.begin(), cand_.begin() + maxstar_, cand_.end(), flux_greater(cat));
+		cand_.resize(maxstar_);
+	}
+	else std::sort(cand_.begin(), cand_.end(), flux_greater(cat));
+	if (cand_.empty()) return 0;
+
+	/* 按批次并行拟合 */
+	int nbatch = (int(cand_.size()) + PSF_LANES - 1) / PSF_LANES;
+	int n = std::min(nthread_, nbatch);
+	result_.resize(cand_.size());
+	data_  = data;
+	width_ = width;
+	cat_   = &cat;
+	nextbatch_ = 0;
+	if (n <= 1) thread_batch();
+	else {
+		boost::thread_group thrds;
+		for (i = 0; i < n; ++i) thrds.create_thread(boost::bind(&PsfFitter::thread_batch, this));
+		thrds.join_all();
+	}
+	data_ = NULL;
+	cat_  = NULL;
+
+	/* 收集收敛结果. 中心换算为图像坐标 */
+	float fwhm, beta;
+	for (i = 0; i < int(cand_.size()); ++i) {
+		const lane_result &res = result_[i];
+		if (!res.ok) continue;
+		if (model_ == PSF_GAUSS) {
+			fwhm = 2.3548f * res.par[4];
+			beta = 0.0f;
+		}
+		else {
+			beta = res.par[5];
+			fwhm = 2.0f * res.par[4] * sqrtf(powf(2.0f, 1.0f / beta) - 1.0f);
+		}
+		if (fwhm < 0.5f || fwhm > stamp_) continue;
+		psf.index.push_back(cand_[i]);
+		psf.x.push_back(int(cat.x[cand_[i]] + 0.5f) - half + res.par[2]);
+		psf.y.push_back(int(cat.y[cand_[i]] + 0.5f) - half + res.par[3]);
+		psf.fwhm.push_back(fwhm);
+		psf.beta.push_back(beta);
+		psf.amp.push_back(res.par[1]);
+		psf.back.push_back(res.par[0]);
+		psf.rms.push_back(res.rms);
+	}
+	return psf.size();
+}
+
+void PsfFitter::thread_batch() {
+	std::vector<float> pix(stamp_ * stamp_ * PSF_LANES);
+	int nbatch = (int(cand_.size()) + PSF_LANES - 1) / PSF_LANES, i;
+
+	while ((i = __sync_fetch_and_add(&nextbatch_, 1)) < nbatch)
+		fit_batch(i * PSF_LANES, pix);
+}
+
+void PsfFitter::fit_batch(int first, std::vector<float> &pixbuf) {
+	const int np = model_ == PSF_GAUSS ? 5 : 6;
+	const int nt = np * (np + 1) / 2;
+	const int half = stamp_ / 2;
+	int nlane = std::min(PSF_LANES, int(cand_.size()) - first);
+	float *pix = &pixbuf[0];
+	float par[6 * PSF_LANES], trial[6 * PSF_LANES];
+	float jtj[21 * PSF_LANES], jtr[6 * PSF_LANES], chi2[PSF_LANES];
+	float tjtj[21 * PSF_LANES], tjtr[6 * PSF_LANES], tchi2[PSF_LANES];
+	const float lo[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.3f, 1.0f };	// 宽度与β的约束范围
+	const float hi[6] = { 0.0f, 0.0f, 0.0f, 0.0f, float(stamp_), 10.0f };
+	double lambda[PSF_LANES], a[36], b[6], fwhm;
+	bool active[PSF_LANES], ok[PSF_LANES];
+	int l, i, j, k, x, y, x0, y0, iter;
+
+	/* 填充子图与初值. 空闲通道置零, 保持参数不变 */
+	for (l = 0; l < PSF_LANES; ++l) {
+		active[l] = l < nlane;
+		ok[l]     = false;
+		lambda[l] = PSF_LAMBDA0;
+		par[l] = par[PSF_LANES + l] = 0.0f;
+		par[2 * PSF_LANES + l] = par[3 * PSF_LANES + l] = float(half);
+		par[4 * PSF_LANES + l] = 2.0f;
+		if (np == 6) par[5 * PSF_LANES + l] = 2.5f;
+		if (!active[l]) {
+			for (i = 0; i < stamp_ * stamp_; ++i) pix[i * PSF_LANES + l] = 0.0f;
+			continue;
+		}
+
+		int idx = cand_[first + l];
+		x0 = int(cat_->x[idx] + 0.5f) - half;
+		y0 = int(cat_->y[idx] + 0.5f) - half;
+		for (y = 0, i = 0; y < stamp_; ++y) {
+			const uint16_t *row = data_ + size_t(y0 + y) * width_ + x0;
+			for (x = 0; x < stamp_; ++x, ++i) pix[i * PSF_LANES + l] = row[x];
+		}
+		fwhm = cat_->fwhm(idx);
+		if (fwhm < 1.2) fwhm = 1.2; // σ≥0.5
+		par[l] = cat_->back[idx];
+		par[PSF_LANES + l] = cat_->peak[idx];
+		par[2 * PSF_LANES + l] = cat_->x[idx] - x0;
+		par[3 * PSF_LANES + l] = cat_->y[idx] - y0;
+		if (np == 5) par[4 * PSF_LANES + l] = float(fwhm / 2.3548);
+		else par[4 * PSF_LANES + l] = float(fwhm / (2.0 * sqrt(pow(2.0, 1.0 / 2.5) - 1.0)));
+	}
+
+	/* 批次共用迭代: 各通道独立判断接受/拒绝与收敛 */
+	if (np == 5) gauss_normal_f32(pix, stamp_, par, jtj, jtr, chi2);
+	else moffat_normal_f32(pix, stamp_, par, jtj, jtr, chi2);
+	for (iter = 0; iter < PSF_MAXITER; ++iter) {
+		memcpy(trial, par, sizeof(float) * np * PSF_LANES);
+		for (l = 0; l < PSF_LANES; ++l) {
+			if (!active[l]) continue;
+			// 阻尼法方程: (JᵀJ + λ·diag(JᵀJ))·δ = Jᵀr
+			for (i = 0, k = 0; i < np; ++i) {
+				for (j = i; j < np; ++j, ++k) a[i * np + j] = a[j * np + i] = jtj[k * PSF_LANES + l];
+				a[i * np + i] *= 1.0 + lambda[l];
+				b[i] = jtr[i * PSF_LANES + l];
+			}
+			// 宽度或β位于边界且梯度指向外侧时固定该参数, 避免逐次截断导致收敛缓慢
+			for (i = 4; i < np; ++i) {
+				float v = par[i * PSF_LANES + l];
+				if (!((v <= lo[i] && b[i] < 0.0) || (v >= hi[i] && b[i] > 0.0))) continue;
+				for (j = 0; j < np; ++j) a[i * np + j] = a[j * np + i] = 0.0;
+				a[i * np + i] = 1.0;
+				b[i] = 0.0;
+			}
+			if (!solve_linear(a, b, np)) {
+				active[l] = false;
+				continue;
+			}
+			for (i = 0; i < np; ++i) trial[i * PSF_LANES + l] += float(b[i]);
+			// 约束: 幅度为正, 中心位于子图内, 宽度与β在合理范围
+			float &amp = trial[PSF_LANES + l], &xc = trial[2 * PSF_LANES + l], &yc = trial[3 * PSF_LANES + l];
+			if (amp < 1E-3f * par[PSF_LANES + l]) amp = 1E-3f * par[PSF_LANES + l];
+			xc = std::max(0.0f, std::min(float(stamp_ - 1), xc));
+			yc = std::max(0.0f, std::min(float(stamp_ - 1), yc));
+			for (i = 4; i < np; ++i) {
+				float &v = trial[i * PSF_LANES + l];
+				v = std::max(lo[i], std::min(hi[i], v));
+			}
+		}
+		if (np == 5) gauss_normal_f32(pix, stamp_, trial, tjtj, tjtr, tchi2);
+		else moffat_normal_f32(pix, stamp_, trial, tjtj, tjtr, tchi2);
+
+		for (l = 0, k = 0; l < PSF_LANES; ++l) {
+			if (!active[l]) continue;
+			if (tchi2[l] < chi2[l]) {// 接受
+				bool done = chi2[l] - tchi2[l] < PSF_RELTOL * chi2[l];
+				for (i = 0; i < np; ++i) {
+					par[i * PSF_LANES + l] = trial[i * PSF_LANES + l];
+					jtr[i * PSF_LANES + l] = tjtr[i * PSF_LANES + l];
+				}
+				for (i = 0; i < nt; ++i) jtj[i * PSF_LANES + l] = tjtj[i * PSF_LANES + l];
+				chi2[l] = tchi2[l];
+				lambda[l] = std::max(lambda[l] * 0.1, 1E-7);
+				if (done) {
+					ok[l] = true;
+					active[l] = false;
+				}
+			}
+			else if ((lambda[l] *= 10.0) > PSF_LAMBDAX) {// 步长趋于零仍无下降: 已达极小值
+				ok[l] = true;
+				active[l] = false;
+			}
+			k += active[l];
+		}
+		if (!k) break;
+	}
+
+	for (l = 0; l < nlane; ++l) {
+		lane_result &res = result_[first + l];
+		res.ok  = ok[l];
+		res.rms = sqrtf(chi2[l] / (stamp_ * stamp_));
+		for (i = 0; i < np; ++i) res.par[i] = par[i * PSF_LANES + l];
+	}
+}
@@ -0,0 +1,123 @@
+/*
+ * @file PsfFitter.h 星像PSF拟合声明文件
+ * @date 2026-10-18
+ * @version 0.1
+ * @note
+ * - 对最亮的若干未饱和星像, 以边长stamp的子图拟合二维圆高斯或Moffat轮廓, 得到亚像素中心与半高全宽.
+ *   欠采样星像的二阶矩仅统计阈值以上像素, 半高全宽偏小且噪声大, 拟合结果更适合V曲线
+ * - 星像按PSF_LANES个一批, 子图交错排列, 每个星像对应SIMD的一个通道.
+ *   法方程(JᵀJ, Jᵀr, χ²)由pixkernel批量计算, 各星像独立执行Levenberg-Marquardt迭代,
+ *   已收敛的星像保持参数不变, 直至整批收敛
+ * - 批次由工作线程并行处理
+ */
+
+#ifndef PSFFITTER_H_
+#define PSFFITTER_H_
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include "StarExtractor.h"
+
+enum PSF_MODEL {// PSF模型
+	PSF_NONE,	// 不拟合
+	PSF_GAUSS,	// 圆高斯
+	PSF_MOFFAT	// 圆Moffat
+};
+
+struct psf_catalog {// PSF拟合结果. 按列存储, 仅包含收敛的星像
+	std::vector<int> index;		//< 在星像表中的序号
+	std::vector<float> x, y;	//< 中心, 起始为0, 量纲: 像素
+	std::vector<float> fwhm;	//< 半高全宽, 量纲: 像素
+	std::vector<float> beta;	//< Moffat β. 高斯模型为0
+	std::vector<float> amp;		//< 幅度
+	std::vector<float> back;	//< 背景
+	std::vector<float> rms;		//< 残差均方根
+
+public:
+	int size() const {
+		return int(x.size());
+	}
+
+	void clear() {
+		index.clear();
+		x.clear(); y.clear();
+		fwhm.clear(); beta.clear();
+		amp.clear(); back.clear(); rms.clear();
+	}
+};
+
+class PsfFitter {
+public:
+	/*!
+	 * @brief 构造函数
+	 * @param model   PSF模型, PSF_GAUSS或PSF_MOFFAT
+	 * @param stamp   子图边长, 量纲: 像素. 偶数时加1
+	 * @param maxstar 参与拟合的最多星像数
+	 * @param nthread 工作线程数. <=0: 按CPU核数
+	 */
+	PsfFitter(int model = PSF_MOFFAT, int stamp = 15, int maxstar = 64, int nthread = 0);
+	virtual ~PsfFitter();
+
+protected:
+	/* 声明数据类型 */
+	struct lane_result {// 单个星像的拟合结果
+		bool ok;		//< 收敛标志
+		float par[6];	//< 参数
+		float rms;		//< 残差均方根
+	};
+
+	/* 成员变量 */
+	int model_;		//< PSF模型
+	int stamp_;		//< 子图边长
+	int maxstar_;	//< 最多星像数
+	int nthread_;	//< 工作线程数
+	/* 多线程拟合 */
+	const uint16_t *data_;		//< 图像数据
+	int width_;					//< 图像宽度
+	const star_catalog *cat_;	//< 星像表
+	std::vector<int> cand_;		//< 候选星像序号, 按流量降序
+	std::vector<lane_result> result_;	//< 各候选星像的拟合结果
+	int nextbatch_;				//< 下一个待处理批次
+
+public:
+	/*!
+	 * @brief 拟合星像PSF
+	 * @param data   图像数据
+	 * @param width  图像宽度
+	 * @param height 图像高度
+	 * @param cat    星像表
+	 * @param psf    拟合结果
+	 * @return
+	 * 收敛的星像数
+	 * @note
+	 * 仅拟合未饱和、未接触边界且子图完全位于图像内的星像
+	 */
+	int Fit(const uint16_t *data, int width, int height, const star_catalog &cat, psf_catalog &psf);
+
+protected:
+	/*!
+	 * @brief 线程: 拟合批次
+	 */
+	void thread_batch();
+	/*!
+	 * @brief 拟合一批星像
+	 * @param first 批次首个候选星像
+	 * @param pix   子图工作区
+	 */
+	void fit_batch(int first, std::vector<float> &pix);
+};
+
+/*!
+ * @brief 解析PSF模型名称
+ * @param name 名称: none, gauss或moffat, 不区分大小写
+ * @return
+ * PSF模型. 无法识别时返回PSF_NONE
+ */
+extern int psf_model_code(const std::string &name);
+/*!
+ * @brief 查看PSF模型名称
+ */
+extern const char *psf_model_name(int model);
+
+#endif /* PSFFITTER_H_ */
@@ -0,0 +1,93 @@
+/*
+ * @file QualityGate.cpp 图像质量检查定义文件
+ * @date 2026-10-18
+ * @version 0.1
+ */
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "QualityGate.h"
+
+#define REF_WEIGHT	0.3	// 参考值滑动平均中当前帧的权重
+
+QualityGate::QualityGate(const quality_limit &limit) {
+	limit_ = limit;
+	Reset();
+}
+
+QualityGate::~QualityGate() {
+}
+
+void QualityGate::Reset() {
+	mutex_lock lck(mtxgate_);
+	nref_  = 0;
+	flux_  = ellip_ = back_ = 0.0;
+}
+
+int QualityGate::Check(const star_catalog &cat, float back, float rms, frame_quality &q) {
+	std::vector<float> flux;
+	double e1(0.0), e2(0.0);
+	int i, nsat(0);
+
+	flux.reserve(cat.size());
+	for (i = 0; i < cat.size(); ++i) {
+		if (cat.flags[i] & STAR_SATURATED) ++nsat;
+		if (cat.flags[i]) continue;
+		flux.push_back(cat.flux[i]);
+		e1 += cat.e1[i];
+		e2 += cat.e2[i];
+	}
+
+	memset(&q, 0, sizeof(frame_quality));
+	q.nstar     = int(flux.size());
+	q.satfrac   = cat.size() ? float(nsat) / cat.size() : 0.0f;
+	q.back      = back;
+	q.fluxratio = 1.0f;
+	if (q.nstar) {
+		std::nth_element(flux.begin(), flux.begin() + q.nstar / 2, flux.end());
+		q.flux = flux[q.nstar / 2];
+		// 由形状分量平均值换算椭率, 同shape_summary()
+		double chi = sqrt(e1 * e1 + e2 * e2) / q.nstar;
+		if (chi > 0.999) chi = 0.999;
+		q.ellip = float(1.0 - sqrt((1.0 - chi) / (1.0 + chi)));
+	}
+	if (q.nstar < limit_.minstar) q.flags |= QUALITY_FEWSTAR;
+	if (q.satfrac > limit_.maxsat) q.flags |= QUALITY_SATURATED;
+
+	mutex_lock lck(mtxgate_);
+	if (nref_) {
+		q.fluxratio = flux_ > 0.0 ? float(q.flux / flux_) : 1.0f;
+		q.dellip    = float(q.ellip - ellip_);
+		q.bkgjump   = rms > 0.0f ? float((back - back_) / rms) : 0.0f;
+		if (q.nstar && q.fluxratio < limit_.minflux) q.flags |= QUALITY_FLUXDROP;
+		if (q.dellip > limit_.maxellip) q.flags |= QUALITY_TRAILED;
+		if (fabs(q.bkgjump) > limit_.maxjump) q.flags |= QUALITY_BKGJUMP;
+	}
+	if (!q.flags) {
+		if (!nref_++) {
+			flux_  = q.flux;
+			ellip_ = q.ellip;
+			back_  = back;
+		}
+		else {
+			flux_  += REF_WEIGHT * (q.flux - flux_);
+			ellip_ += REF_WEIGHT * (q.ellip - ellip_);
+			back_  += REF_WEIGHT * (back - back_);
+		}
+	}
+	return q.flags;
+}
+
+void quality_text(int flags, std::string &text) {
+	const char *names[] = {"fewstar", "fluxdrop", "saturated", "trailed", "bkgjump"};
+	text = "";
+	for (int i = 0; i < 5; ++i) {
+		if (!(flags & (1 << i))) continue;
+		if (!text.empty()) text += ",";
+		text += names[i];
+	}
+	if (text.empty()) text = "ok";
+}
@@ -0,0 +1,94 @@
+/*
+ * @file QualityGate.h 图像质量检查声明文件
+ * @date 2026-10-18
+ * @version 0.1
+ * @note
+ * - 由星像表与背景统计每帧质量指标: 星像数、流量中值、饱和星像比例、平均椭率与全幅背景
+ * - 流量、椭率与背景与运行参考值比较, 参考值为已通过帧的指数滑动平均:
+ *   云导致流量下降与背景跳变, 风振或跟踪异常导致椭率突增.
+ *   离焦改变星像数与椭率, 但在调焦步长内变化平缓, 滑动参考值随之更新
+ * - 首帧仅检查星像数与饱和比例, 并作为参考
+ * - 同一相机的各帧由存储线程并行检查, 参考值更新加锁
+ */
+
+#ifndef QUALITYGATE_H_
+#define QUALITYGATE_H_
+
+#include <string>
+#include <boost/thread.hpp>
+#include "StarExtractor.h"
+
+enum QUALITY_FLAG {// 质量检查未通过原因
+	QUALITY_FEWSTAR   = 0x01,	// 星像数不足
+	QUALITY_FLUXDROP  = 0x02,	// 流量下降: 云或雾
+	QUALITY_SATURATED = 0x04,	// 饱和星像比例过高
+	QUALITY_TRAILED   = 0x08,	// 椭率突增: 拖影或抖动
+	QUALITY_BKGJUMP   = 0x10	// 背景跳变
+};
+
+struct quality_limit {// 质量检查阈值
+	int minstar;		//< 最少未饱和星像数
+	double minflux;		//< 流量中值与参考值之比的下限
+	double maxsat;		//< 饱和星像比例上限
+	double maxellip;	//< 平均椭率相对参考值的增量上限
+	double maxjump;		//< 背景相对参考值的变化上限, 量纲: 背景噪声
+};
+
+struct frame_quality {// 单帧质量指标
+	int flags;			//< QUALITY_FLAG组合. 0: 通过; <0: 未检查
+	int nstar;			//< 未饱和、未接触边界的星像数
+	float flux;			//< 上述星像流量中值
+	float fluxratio;	//< 流量中值与参考值之比
+	float satfrac;		//< 饱和星像比例
+	float ellip;		//< 平均椭率
+	float dellip;		//< 平均椭率相对参考值的增量
+	float back;			//< 全幅背景
+	float bkgjump;		//< 背景相对参考值的变化, 量纲: 背景噪声
+};
+
+class QualityGate {
+public:
+	/*!
+	 * @brief 构造函数
+	 * @param limit 检查阈值
+	 */
+	QualityGate(const quality_limit &limit);
+	virtual ~QualityGate();
+
+protected:
+	/* 声明数据类型 */
+	typedef boost::unique_lock<boost::mutex> mutex_lock;
+
+	/* 成员变量 */
+	quality_limit limit_;	//< 检查阈值
+	int nref_;		//< 计入参考值的帧数
+	double flux_;	//< 流量中值参考值
+	double ellip_;	//< 平均椭率参考值
+	double back_;	//< 背景参考值
+	boost::mutex mtxgate_;	//< 互斥锁
+
+public:
+	/*!
+	 * @brief 检查一帧图像
+	 * @param cat  星像表
+	 * @param back 全幅背景
+	 * @param rms  全幅背景噪声
+	 * @param q    质量指标
+	 * @return
+	 * QUALITY_FLAG组合. 0: 通过, 并更新参考值
+	 */
+	int Check(const star_catalog &cat, float back, float rms, frame_quality &q);
+	/*!
+	 * @brief 清除参考值
+	 */
+	void Reset();
+};
+
+/*!
+ * @brief 查看质量标志的文字说明
+ * @param flags QUALITY_FLAG组合
+ * @param text  文字说明, 以逗号分隔. 通过时为"ok"
+ */
+extern void quality_text(int flags, std::string &text);
+
+#endif /* QUALITYGATE_H_ */
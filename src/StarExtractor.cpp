@@ -0,0 +1,269 @@
+/*
+ * @file StarExtractor.cpp 星像提取定义文件
+ * @date 2026-10-18
+ * @version 0.1
+ */
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include "StarExtractor.h"
+#include "pixkernel.h"
+
+#define MIN_STRIP_ROWS	32	// 行带最少行数
+
+/*!
+ * @brief 查找并查集根节点, 同时压缩路径
+ */
+static int find_root(std::vector<int> &parent, int i) {
+	while (parent[i] != i) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+/*!
+ * @brief 合并两个集合. 以较小序号为根, 根节点即集合中首个游程
+ */
+static void unite(std::vector<int> &parent, int a, int b) {
+	a = find_root(parent, a);
+	b = find_root(parent, b);
+	if (a < b) parent[b] = a;
+	else if (b < a) parent[a] = b;
+}
+
+/*!
+ * @brief 连通相邻两行的游程
+ * @param prev   上一行所在游程数组
+ * @param cur    当前行所在游程数组
+ * @param parent 并查集
+ * @param pb     上一行首个游程
+ * @param pe     上一行末个游程之后
+ * @param cb     当前行首个游程
+ * @param ce     当前行末个游程之后
+ * @param poff   上一行游程在并查集中的偏移
+ * @param coff   当前行游程在并查集中的偏移
+ * @note
+ * 两行游程均按列排序, 8邻域连通条件为列区间相距不超过1
+ */
+template <class RUN>
+static void link_rows(const RUN *prev, const RUN *cur, std::vector<int> &parent,
+		int pb, int pe, int cb, int ce, int poff, int coff) {
+	int p(pb), q, c;
+	for (c = cb; c < ce; ++c) {
+		while (p < pe && prev[p].x1 + 1 < cur[c].x0) ++p;
+		for (q = p; q < pe && prev[q].x0 <= cur[c].x1 + 1; ++q) unite(parent, q + poff, c + coff);
+	}
+}
+
+StarExtractor::StarExtractor(double nsigma, int minarea, int saturate, int nthread) {
+	nsigma_   = nsigma;
+	minarea_  = minarea < 1 ? 1 : minarea;
+	saturate_ = saturate;
+	nthread_  = nthread > 0 ? nthread : int(boost::thread::hardware_concurrency());
+	if (nthread_ <= 0) nthread_ = 1;
+	data_ = NULL;
+	width_ = height_ = 0;
+	bkg_ = NULL;
+	nextstrip_ = 0;
+}
+
+StarExtractor::~StarExtractor() {
+}
+
+bool StarExtractor::Extract(const uint16_t *data, int width, int height, BackgroundMesh &bkg, star_catalog &cat) {
+	int nx, ny;
+	bkg.MeshSize(nx, ny);
+	cat.clear();
+	if (nx <= 0 || ny <= 0 || width <= 0 || height <= 0) return false;
+
+	/* 划分行带. 行带数为线程数的4倍, 平衡星像分布不均 */
+	int nstrip = std::min(nthread_ * 4, (height + MIN_STRIP_ROWS - 1) / MIN_STRIP_ROWS);
+	int rows = (height + nstrip - 1) / nstrip, i;
+	nstrip = (height + rows - 1) / rows;
+	strips_.resize(nstrip);
+	for (i = 0; i < nstrip; ++i) {
+		strips_[i].y0 = i * rows;
+		strips_[i].y1 = std::min(height, (i + 1) * rows);
+	}
+
+	data_   = data;
+	width_  = width;
+	height_ = height;
+	bkg_    = &bkg;
+	nextstrip_ = 0;
+	int n = std::min(nthread_, nstrip);
+	if (n <= 1) thread_strip();
+	else {
+		boost::thread_group thrds;
+		for (i = 0; i < n; ++i) thrds.create_thread(boost::bind(&StarExtractor::thread_strip, this));
+		thrds.join_all();
+	}
+	data_ = NULL;
+	bkg_  = NULL;
+
+	/* 拼接并查集, 连通行带交界 */
+	std::vector<int> offset(nstrip + 1, 0), parent;
+	for (i = 0; i < nstrip; ++i) offset[i + 1] = offset[i] + int(strips_[i].runs.size());
+	parent.resize(offset[nstrip]);
+	for (i = 0; i < nstrip; ++i) {
+		strip &st = strips_[i];
+		for (int k = 0; k < int(st.parent.size()); ++k) parent[offset[i] + k] = st.parent[k] + offset[i];
+	}
+	for (i = 1; i < nstrip; ++i) {
+		strip &up = strips_[i - 1], &st = strips_[i];
+		if (up.lastbeg < int(up.runs.size()) && st.nfirst > 0)
+			link_rows(&up.runs[0], &st.runs[0], parent, up.lastbeg, int(up.runs.size()), 0, st.nfirst,
+					offset[i - 1], offset[i]);
+	}
+
+	/* 按根节点合并累加量. 根节点为集合中首个游程, 星像按首个像素排序 */
+	std::vector<int> objidx(parent.size(), -1);
+	std::vector<moment> objs;
+	int j, k, r;
+	for (i = 0; i < nstrip; ++i) {
+		strip &st = strips_[i];
+		for (k = 0; k < int(st.runs.size()); ++k) {
+			j = offset[i] + k;
+			r = find_root(parent, j);
+			if (objidx[r] < 0) {
+				objidx[r] = int(objs.size());
+				objs.push_back(st.runs[k].m);
+			}
+			else objs[objidx[r]].merge(st.runs[k].m);
+		}
+		std::vector<pixel_run>().swap(st.runs);
+		std::vector<int>().swap(st.parent);
+	}
+
+	/* 生成星像表 */
+	int nobj(0);
+	for (i = 0; i < int(objs.size()); ++i) nobj += objs[i].npix >= minarea_;
+	cat.reserve(nobj);
+	for (i = 0; i < int(objs.size()); ++i) {
+		const moment &m = objs[i];
+		if (m.npix < minarea_) continue;
+		double xc = m.fx / m.f, yc = m.fy / m.f;
+		double x2 = m.fxx / m.f - xc * xc, y2 = m.fyy / m.f - yc * yc;
+		// 单行或单列星像的二阶矩为0, 以像素均匀分布的方差1/12为下限
+		if (x2 < 1.0 / 12) x2 = 1.0 / 12;
+		if (y2 < 1.0 / 12) y2 = 1.0 / 12;
+		cat.x.push_back(float(xc));
+		cat.y.push_back(float(yc));
+		cat.flux.push_back(float(m.f));
+		cat.peak.push_back(m.peak);
+		cat.back.push_back(float(m.bsum / m.npix));
+		cat.x2.push_back(float(x2));
+		cat.y2.push_back(float(y2));
+		cat.xy.push_back(float(m.fxy / m.f - xc * yc));
+		cat.npix.push_back(m.npix);
+		cat.flags.push_back(uint8_t(m.flags));
+	}
+	cat.e1.resize(cat.size());
+	cat.e2.resize(cat.size());
+	if (cat.size()) shape_f32(&cat.x2[0], &cat.y2[0], &cat.xy[0], &cat.e1[0], &cat.e2[0], cat.size());
+	return true;
+}
+
+/*!
+ * @brief 由形状分量平均值换算椭率与位置角
+ */
+static void shape_finish(shape_region &rs) {
+	if (rs.n) {
+		rs.e1 /= rs.n;
+		rs.e2 /= rs.n;
+	}
+	float chi = sqrtf(rs.e1 * rs.e1 + rs.e2 * rs.e2);
+	if (chi > 0.999f) chi = 0.999f;
+	rs.ellip = 1.0f - sqrtf((1.0f - chi) / (1.0f + chi));
+	rs.theta = 0.5f * atan2f(rs.e2, rs.e1) * float(180.0 / M_PI);
+}
+
+void shape_summary(const star_catalog &cat, int grid, int xorg, int yorg, int xbin, int ybin,
+		int wsensor, int hsensor, std::vector<shape_region> &regions, shape_region &total) {
+	shape_region zero;
+	int i, ix, iy;
+
+	memset(&zero, 0, sizeof(shape_region));
+	regions.assign(grid * grid, zero);
+	total = zero;
+	for (i = 0; i < cat.size(); ++i) {
+		if (cat.flags[i]) continue;
+		total.e1 += cat.e1[i];
+		total.e2 += cat.e2[i];
+		++total.n;
+		ix = int((xorg + (cat.x[i] + 0.5f) * xbin) * grid / wsensor);
+		iy = int((yorg + (cat.y[i] + 0.5f) * ybin) * grid / hsensor);
+		if (ix < 0 || ix >= grid || iy < 0 || iy >= grid) continue;
+		shape_region &rs = regions[iy * grid + ix];
+		rs.e1 += cat.e1[i];
+		rs.e2 += cat.e2[i];
+		++rs.n;
+	}
+	for (i = 0; i < int(regions.size()); ++i) shape_finish(regions[i]);
+	shape_finish(total);
+}
+
+void StarExtractor::thread_strip() {
+	std::vector<float> back(width_), rms(width_);
+	int i;
+
+	while ((i = __sync_fetch_and_add(&nextstrip_, 1)) < int(strips_.size()))
+		label_strip(strips_[i], &back[0], &rms[0]);
+}
+
+void StarExtractor::label_strip(strip &st, float *back, float *rms) {
+	std::vector<pixel_run> &runs = st.runs;
+	std::vector<int> &parent = st.parent;
+	int pb(0), pe(0), cb, x, y;
+	float k = float(nsigma_), d;
+	bool edge;
+
+	runs.clear();
+	parent.clear();
+	st.nfirst  = 0;
+	st.lastbeg = 0;
+	for (y = st.y0; y < st.y1; ++y) {
+		const uint16_t *row = data_ + size_t(y) * width_;
+		bkg_->InterpolateRow(y, back, rms);
+		for (x = 0; x < width_; ++x) rms[x] *= k; // 改为阈值
+
+		cb = int(runs.size());
+		edge = y == 0 || y == height_ - 1;
+		for (x = 0; x < width_; ++x) {
+			if ((d = row[x] - back[x]) <= rms[x]) continue;
+
+			pixel_run run;
+			moment &m = run.m;
+			run.y  = y;
+			run.x0 = x;
+			m.reset();
+			do {// 累加游程内像素
+				m.f   += d;
+				m.fx  += double(d) * x;
+				m.fy  += double(d) * y;
+				m.fxx += double(d) * x * x;
+				m.fyy += double(d) * y * y;
+				m.fxy += double(d) * x * y;
+				m.bsum += back[x];
+				if (d > m.peak) m.peak = d;
+				if (row[x] >= saturate_) m.flags |= STAR_SATURATED;
+				++m.npix;
+			} while (++x < width_ && (d = row[x] - back[x]) > rms[x]);
+			run.x1 = x - 1;
+			if (edge || run.x0 == 0 || x == width_) m.flags |= STAR_EDGE;
+			parent.push_back(int(runs.size()));
+			runs.push_back(run);
+		}
+
+		if (y == st.y0) st.nfirst = int(runs.size());
+		else if (pe > pb && int(runs.size()) > cb)
+			link_rows(&runs[0], &runs[0], parent, pb, pe, cb, int(runs.size()), 0, 0);
+		pb = cb;
+		pe = int(runs.size());
+	}
+	st.lastbeg = pb;
+}
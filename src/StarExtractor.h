@@ -0,0 +1,191 @@
+/*
+ * @file StarExtractor.h 星像提取声明文件
+ * @date 2026-10-18
+ * @version 0.1
+ * @note
+ * - 逐行插值背景与噪声, 扣除背景后高于nsigma×噪声的像素为目标像素
+ * - 目标像素按行合并为游程, 相邻行游程按8邻域以并查集(union-find)连通
+ * - 图像划分为行带, 由工作线程并行标记. 各行带独立维护游程与并查集,
+ *   完成后拼接并查集, 仅需连通相邻行带交界两行的游程
+ * - 各游程在扫描时累加流量、一阶与二阶矩、峰值与标志, 连通后按根节点合并,
+ *   每个像素只读取一次
+ * - 星像表按列存储(SoA), 供FWHM、V曲线与倾斜分析逐列访问
+ * - 形状分量e1/e2由二阶矩按列批量计算(pixkernel), 分区平均后换算椭率与位置角,
+ *   用于诊断准直与倾斜引起的像散、彗差
+ */
+
+#ifndef STAREXTRACTOR_H_
+#define STAREXTRACTOR_H_
+
+#include <vector>
+#include <stdint.h>
+#include <math.h>
+#include "BackgroundMesh.h"
+
+enum STAR_FLAG {// 星像标志
+	STAR_SATURATED = 0x01,	// 含饱和像素
+	STAR_EDGE      = 0x02	// 接触图像边界
+};
+
+struct star_catalog {// 星像表. 按列存储, 同一序号对应同一星像
+	std::vector<float> x, y;		//< 质心, 起始为0, 量纲: 像素
+	std::vector<float> flux;		//< 扣除背景后目标像素流量之和
+	std::vector<float> peak;		//< 扣除背景后的峰值
+	std::vector<float> back;		//< 目标像素平均背景
+	std::vector<float> x2, y2, xy;	//< 流量加权二阶中心矩, 量纲: 像素^2
+	std::vector<float> e1, e2;		//< 形状分量: (x2-y2)/(x2+y2), 2xy/(x2+y2)
+	std::vector<int> npix;			//< 目标像素数
+	std::vector<uint8_t> flags;		//< 星像标志, STAR_FLAG组合
+
+public:
+	int size() const {
+		return int(x.size());
+	}
+
+	void clear() {
+		x.clear(); y.clear();
+		flux.clear(); peak.clear(); back.clear();
+		x2.clear(); y2.clear(); xy.clear();
+		e1.clear(); e2.clear();
+		npix.clear(); flags.clear();
+	}
+
+	void reserve(int n) {
+		x.reserve(n); y.reserve(n);
+		flux.reserve(n); peak.reserve(n); back.reserve(n);
+		x2.reserve(n); y2.reserve(n); xy.reserve(n);
+		e1.reserve(n); e2.reserve(n);
+		npix.reserve(n); flags.reserve(n);
+	}
+
+	/*!
+	 * @brief 由二阶矩估计半高全宽
+	 * @param i 星像序号
+	 * @return
+	 * 半高全宽, 量纲: 像素
+	 * @note
+	 * 按圆对称高斯轮廓换算. 仅统计阈值以上像素, 暗星偏小
+	 */
+	float fwhm(int i) const {
+		return 2.3548f * sqrtf(0.5f * (x2[i] + y2[i]));
+	}
+};
+
+struct shape_region {// 区域星像形状
+	int n;			//< 星像数
+	float e1, e2;	//< 形状分量平均值
+	float ellip;	//< 椭率: 1 - b/a
+	float theta;	//< 长轴位置角, 自+X轴转向+Y轴, 量纲: 角度, [-90, 90]
+};
+
+class StarExtractor {
+public:
+	/*!
+	 * @brief 构造函数
+	 * @param nsigma   检测阈值, 量纲: 背景噪声
+	 * @param minarea  星像最少像素数
+	 * @param saturate 饱和阈值, 量纲: ADU
+	 * @param nthread  工作线程数. <=0: 按CPU核数
+	 */
+	StarExtractor(double nsigma = 3.0, int minarea = 5, int saturate = 60000, int nthread = 0);
+	virtual ~StarExtractor();
+
+protected:
+	/* 声明数据类型 */
+	struct moment {// 游程或星像的累加量
+		double f, fx, fy;		//< 流量及其一阶矩
+		double fxx, fyy, fxy;	//< 二阶矩
+		double bsum;			//< 背景之和
+		float peak;				//< 峰值
+		int npix;				//< 像素数
+		int flags;				//< 标志
+
+	public:
+		void reset() {
+			f = fx = fy = fxx = fyy = fxy = bsum = 0.0;
+			peak  = 0.0f;
+			npix  = 0;
+			flags = 0;
+		}
+
+		void merge(const moment &m) {
+			f += m.f; fx += m.fx; fy += m.fy;
+			fxx += m.fxx; fyy += m.fyy; fxy += m.fxy;
+			bsum += m.bsum;
+			if (m.peak > peak) peak = m.peak;
+			npix  += m.npix;
+			flags |= m.flags;
+		}
+	};
+
+	struct pixel_run {// 游程: 同一行内连续的目标像素
+		int y, x0, x1;	//< 行与首尾列
+		moment m;		//< 累加量
+	};
+
+	struct strip {// 行带
+		int y0, y1;		//< 首行与末行之后一行
+		std::vector<pixel_run> runs;	//< 游程, 按行与列排序
+		std::vector<int> parent;		//< 并查集, 行带内序号
+		int nfirst;		//< 首行游程数
+		int lastbeg;	//< 末行首个游程的序号
+	};
+
+	/* 成员变量 */
+	double nsigma_;	//< 检测阈值
+	int minarea_;	//< 最少像素数
+	int saturate_;	//< 饱和阈值
+	int nthread_;	//< 工作线程数
+	/* 多线程标记 */
+	const uint16_t *data_;		//< 图像数据
+	int width_, height_;		//< 图像尺寸
+	BackgroundMesh *bkg_;		//< 背景与噪声
+	std::vector<strip> strips_;	//< 行带
+	int nextstrip_;				//< 下一个待处理行带
+
+public:
+	/*!
+	 * @brief 提取星像
+	 * @param data   图像数据
+	 * @param width  图像宽度
+	 * @param height 图像高度
+	 * @param bkg    已完成估计的背景与噪声
+	 * @param cat    星像表. 按首个像素的行列排序
+	 * @return
+	 * 提取结果. 背景未完成估计时返回false
+	 */
+	bool Extract(const uint16_t *data, int width, int height, BackgroundMesh &bkg, star_catalog &cat);
+
+protected:
+	/*!
+	 * @brief 线程: 标记行带
+	 */
+	void thread_strip();
+	/*!
+	 * @brief 标记一个行带内的游程并连通
+	 * @param st   行带
+	 * @param back 背景行工作区
+	 * @param rms  噪声行工作区
+	 */
+	void label_strip(strip &st, float *back, float *rms);
+};
+
+/*!
+ * @brief 按传感器区域统计星像形状
+ * @param cat     星像表
+ * @param grid    区域划分, grid×grid
+ * @param xorg    图像左上角在传感器中的X坐标, 起始为0
+ * @param yorg    图像左上角在传感器中的Y坐标, 起始为0
+ * @param xbin    X方向合并因子
+ * @param ybin    Y方向合并因子
+ * @param wsensor 传感器宽度
+ * @param hsensor 传感器高度
+ * @param regions 各区域形状, 按行存储. 无星像区域的n为0
+ * @param total   全部星像的形状
+ * @note
+ * 仅统计未饱和、未接触边界的星像
+ */
+extern void shape_summary(const star_catalog &cat, int grid, int xorg, int yorg, int xbin, int ybin,
+		int wsensor, int hsensor, std::vector<shape_region> &regions, shape_region &total);
+
+#endif /* STAREXTRACTOR_H_ */
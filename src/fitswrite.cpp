@@ -0,0 +1,48 @@
+/*
+ * @file fitswrite.cpp 16位图像FITS文件写入接口定义文件
+ * @date 2026-10-18
+ * @version 0.1
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pixkernel.h"
+#include "pipetrace.h"
+#include "fitswrite.h"
+
+bool WriteFITSFile(const char *filepath, const char *header, int nkeys, const uint16_t *data, long pixels,
+		uint16_t *bufsave, int savecard, int64_t t0) {
+	const int block = 2880;	// FITS记录长度
+	char record[block];
+	long n, bytes;
+	bool rslt;
+	FILE *fp;
+
+	if ((fp = fopen(filepath, "wb")) == NULL) return false;
+	// 头信息: 已以END结束, 空格填充至2880字节整数倍
+	bytes = nkeys * 80;
+	rslt = fwrite(header, 1, bytes, fp) == (size_t) bytes;
+	if (rslt && (n = bytes % block) > 0) {
+		memset(record, ' ', block);
+		rslt = fwrite(record, 1, block - n, fp) == (size_t) (block - n);
+	}
+	// 图像数据: 大端字节序, 0填充至2880字节整数倍
+	for (long i = 0; rslt && i < pixels; i += fits_chunk) {
+		n = pixels - i > fits_chunk ? fits_chunk : pixels - i;
+		swap_offset_u16(data + i, bufsave, n);
+		rslt = fwrite(bufsave, sizeof(uint16_t), n, fp) == (size_t) n;
+	}
+	if (rslt && (n = (pixels * 2) % block) > 0) {
+		memset(record, 0, block);
+		rslt = fwrite(record, 1, block - n, fp) == (size_t) (block - n);
+	}
+	if (rslt && savecard >= 0) {// 回填存储耗时
+		char card[81];
+		sprintf(card, "%-8s= %20ld / %-47s", trace_stage_key(TS_SAVE), long(trace_now() - t0),
+				"FITS save latency in us");
+		rslt = fseek(fp, savecard * 80L, SEEK_SET) == 0 && fwrite(card, 1, 80, fp) == 80;
+	}
+	if (fclose(fp)) rslt = false;
+
+	return rslt;
+}
@@ -0,0 +1,35 @@
+/*
+ * @file fitswrite.h 16位图像FITS文件写入接口声明文件
+ * @date 2026-10-18
+ * @version 0.1
+ * @note
+ * 头信息由cfitsio在内存中生成, 图像数据由本接口分块转换后直接写入文件, 避免cfitsio逐像素转换
+ */
+
+#ifndef FITSWRITE_H_
+#define FITSWRITE_H_
+
+#include <stdint.h>
+
+const long fits_chunk = 1 << 18;	//< FITS数据转换分块长度, 量纲: 像素
+
+/*!
+ * @brief 将FITS头信息和16位图像数据写入文件
+ * @param filepath 文件路径
+ * @param header   由fits_hdr2str()生成的头信息, 以END结束
+ * @param nkeys    头信息关键字数量, 含END
+ * @param data     主机字节序图像数据
+ * @param pixels   像素数
+ * @param bufsave  转换缓冲区, 容量不小于fits_chunk像素
+ * @param savecard 存储耗时关键字在头信息中的序号. <0: 无
+ * @param t0       存储起始时间, 量纲: 微秒
+ * @return
+ * 写入结果
+ * @note
+ * - 数据分块经swap_offset_u16()转换为FITS存储格式后写入, 分块大小保证转换结果驻留在缓存中
+ * - 写完数据后回填存储耗时关键字, 耗时不含关闭文件
+ */
+extern bool WriteFITSFile(const char *filepath, const char *header, int nkeys, const uint16_t *data, long pixels,
+		uint16_t *bufsave, int savecard = -1, int64_t t0 = 0);
+
+#endif /* FITSWRITE_H_ */
@@ -4,30 +4,63 @@
  Copyright   : NAOC
  Description : 焦平面调节辅助工具
  设计说明:
+ - 后台服务模式(focaes -D): 不使用控制台, 通过TCP端口<PortControl>接收指令
+   指令与控制台相同, 每行一条. 执行完毕回复"ok <指令>"或"fail <指令>"
+   异步事件每行一条, 首个单词为事件类型:
+   status <信息>, error <信息>, focuser <on-line|off-line>,
+   focus <相机> <位置> <目标>, progress <相机> <百分比>,
+   file <相机> <帧序号> <帧数> <文件路径>, idle <相机>, trace <统计行>
+ - 指令trace: 将曝光流程各阶段耗时统计(数量/均值/分位数)写入日志; trace reset: 清除统计
+ - 运行指标: HTTP端口<PortMetrics>以Prometheus文本格式输出相机/网络/上传/日志计数与各阶段耗时
+ - 指令roi <bin x y w h>: 设置硬件ROI区与合并因子, 无参数时恢复全幅
+ - 自动调焦子窗口(stroke.window): 流程首帧为全幅, 由其选择亮星子窗口, 后续帧仅读出子窗口
+ - 鑫图相机连续采集模式(Tucam.stream): 相机自由运行, 每次曝光取SDK缓冲环中的下一帧
+ - 指令master bias <count>/master dark <duration> <count>: 存储各帧的同时逐帧累加, 最后一帧存储后
+   写入合并图像G<相机>_mbias/mdark_<时间>.fit, 并广播事件master <相机> <文件路径>
+ - 实时定标(Calibration.path): 连接相机时由该目录加载合并本底/暗场/平场, 分析前定标, 存储原始图像
+ - 指令master badpix <duration> <count>: 合并暗场后生成坏像素表, 存储为<Calibration.path>/G<相机>_badpix.msk
+   并立即用于定标, 广播事件badpix <相机> <文件路径> <坏像素数>. 此后连接相机时自动加载
  Date:         2017-09-21
  Version     : 0.1
  */
 
+#include <signal.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <deque>
+#include <vector>
+#include <algorithm>
 #include <boost/interprocess/ipc/message_queue.hpp>
 #include <cfitsio/longnam.h>
 #include <cfitsio/fitsio.h>
-#include <xpa.h>
 #include "globaldef.h"
 #include "GLog.h"
 #include "gui.h"
 #include "termscreen.h"
 #include "parameter.h"
 #include "tcp_asio.h"
-#include "mountproto.h"
 #include "CameraBase.h"
 #include "CameraApogee.h"
 #include "CameraGY.h"
 #include "CameraTucam.h"
 #include "FileTransferClient.h"
+#include "ImageDisplay.h"
+#include "ImagePreview.h"
+#include "FramePool.h"
+#include "fitswrite.h"
+#include "pipetrace.h"
+#include "numamem.h"
+#include "MasterCombine.h"
+#include "Calibrator.h"
+#include "BackgroundMesh.h"
+#include "StarExtractor.h"
+#include "FocalPlane.h"
+#include "PsfFitter.h"
+#include "QualityGate.h"
+#include "FocuserTcp.h"
+#include "FocuserSim.h"
 
 //////////////////////////////////////////////////////////////////////////////
-#define VALID_FOCUS 10000
-
 /// 数据结构定义
 enum IMAGE_TYPE {// 曝光类型
 	IMGTYPE_BIAS = 1,	// 本底
@@ -106,21 +139,90 @@ public:
 };
 
 struct focuser {// 调焦器
-	tcpcptr tcp;	//< 网络连接
 	int posAct;	//< 实际位置
 	int posTar;	//< 目标位置
-	int repeat;	//< 由静至动再至静的重复次数
+	bool early;		//< 自动调焦: 本位置末帧读出期间已移至下一位置
+	bool arrived;	//< 提前移动已到位, 读出结束后开始曝光
+	int posExp;		//< 提前移动前, 末帧曝光时的位置
 
 public:
 	void reset() {
 		posAct = posTar = VALID_FOCUS;
-		repeat = 0;
+		early  = arrived = false;
+		posExp = VALID_FOCUS;
+	}
+};
+
+struct retake_count {// 自动调焦: 当前焦点位置的质量检查计数
+	int checked;	//< 已检查帧数
+	int rejected;	//< 未通过帧数
+	int retake;		//< 已重拍帧数
+	bool waiting;	//< 已完成曝光, 等待检查结果以决定重拍或移至下一位置
+
+public:
+	void reset() {
+		checked = rejected = retake = 0;
+		waiting = false;
+	}
+};
+
+struct camunit {// 相机工作单元: 相机及其观测序列
+	int index;		//< 相机在单元内的索引, 1-5
+	boost::shared_ptr<CameraBase> camera;	//< 相机控制接口
+	boost::shared_ptr<FramePool> pool;		//< 图像缓冲池
+	systate state;	//< 观测序列状态
+	focuser focus;	//< 对应调焦器位置
+	boost::shared_ptr<MasterCombine> master;	//< 本底/暗场合并. 空指针: 不合并
+	boost::shared_ptr<Calibrator> calib;	//< 实时定标. 空指针: 不定标
+	bool badpix;	//< 合并暗场后生成坏像素表
+	boost::shared_ptr<FocalPlane> plane;	//< 自动调焦时统计焦面倾斜与场曲. 空指针: 不统计
+	boost::shared_ptr<QualityGate> gate;	//< 自动调焦时检查图像质量. 空指针: 不检查
+	retake_count retake;	//< 当前焦点位置的质量检查计数
+
+public:
+	camunit(int idx) {
+		index = idx;
+		badpix = false;
+		focus.reset();
+		retake.reset();
 	}
 };
+typedef boost::shared_ptr<camunit> unitptr;
+
+struct frame_job {// 待存储图像
+	unitptr unit;		//< 相机工作单元
+	systate state;		//< 曝光完成时的序列状态
+	devcam_info nfcam;	//< 曝光完成时的相机信息. nfcam.data指向图像数据
+	int posAct;			//< 焦点位置
+	bool upload;		//< 是否上传文件
+	boost::shared_ptr<MasterCombine> master;	//< 本底/暗场合并. 空指针: 不合并
+	int ncombine;		//< 合并帧数. 0: 单帧图像
+	bool badpix;		//< 合并暗场后生成坏像素表
+	boost::shared_ptr<star_catalog> stars;	//< 星像表. 空指针: 未提取
+	float fwhm;			//< 未饱和星像半高全宽的中值, 量纲: 像素. <0: 无效
+	std::vector<shape_region> shape;	//< 各区域星像形状, 按行存储. 空: 未统计
+	shape_region shapeall;	//< 全部星像的形状
+	boost::shared_ptr<psf_catalog> psf;	//< PSF拟合结果. 空指针: 未拟合
+	float psffwhm;		//< 拟合半高全宽的中值, 量纲: 像素. <0: 无效
+	float psfbeta;		//< 拟合Moffat β的中值
+	boost::shared_ptr<FocalPlane> plane;	//< 焦面倾斜与场曲. 空指针: 不统计
+	boost::shared_ptr<QualityGate> gate;	//< 质量检查. 空指针: 不检查
+	frame_quality quality;	//< 质量指标. quality.flags<0: 未检查
+};
+typedef boost::shared_ptr<frame_job> jobptr;
+typedef std::deque<jobptr> jobque;
 
 typedef boost::interprocess::message_queue msgque;
 typedef boost::unique_lock<boost::mutex> mutex_lock;
 
+/*
+ * 消息编码: 低8位为消息类型, 其余位为相机索引. 相机索引为0时对应非相机消息
+ */
+#define MSG_ENCODE(id, index)	((long(index) << 8) | (id))
+#define MSG_ID(msg)				((msg) & 0xFF)
+#define MSG_INDEX(msg)			(int((msg) >> 8))
+#define MAX_CAMERA	5	// 单元内相机数量上限
+
 //////////////////////////////////////////////////////////////////////////////
 /// 全局变量
 GLog gLog;
@@ -128,22 +230,48 @@ GLog gLog1(stdout);
 param_config param;						//< 配置参数
 boost::shared_ptr<msgque> queue;			//< 消息队列
 boost::shared_ptr<boost::thread> thrdmsg;	//< 消息队列线程句柄
-systate state;							//< 系统状态
-boost::shared_ptr<tcp_server> tcpsfoc;	//< 调焦服务器
-focuser focus;							//< 调焦器
-boost::shared_ptr<CameraBase> camera;	//< 相机控制接口
-mntptr mntproto;	//< 通信协议接口
+focptr focdev;							//< 调焦器, 各相机共用
+unitptr units[MAX_CAMERA + 1];			//< 相机工作单元, 按索引1-5存储. 由get_unit()/set_unit()访问
+boost::mutex mtxunit;					//< 相机工作单元互斥锁
+int unitsel(0);							//< 终端指令对应的当前相机索引
 int curpos;		//< 光标位置
 boost::mutex mtxcur;	//< 光标互斥区
 static char flags[] = "|/-\\";
 static int iflag(-1);
-bool firstimg(true);
 boost::shared_ptr<FileTransferClient> ftcli;	// 文件上传接口
+boost::shared_ptr<ImageDisplay> display;	// 图像显示接口
+/* 图像存储线程池, 各相机共用 */
+jobque jobs;				//< 待存储图像
+int nwriting(0);			//< 正在存储的图像数量
+boost::mutex mtxjob;		//< 存储队列互斥锁
+boost::condition_variable cvjob;	//< 通知: 新的图像/完成存储
+boost::thread_group thrdwriter;		//< 存储线程
+/* 后台服务模式 */
+struct ctl_command {// 控制网络连接投递的指令
+	tcpcptr client;		//< 网络连接
+	std::string line;	//< 指令
+};
+typedef std::deque<ctl_command> ctlque;
+
+bool daemon_mode(false);				//< 后台服务模式
+boost::shared_ptr<tcp_server> tcpsctl;	//< 控制服务器
+std::vector<tcpcptr> ctlclients;		//< 控制网络连接
+ctlque ctlcmds;							//< 待执行指令
+boost::mutex mtxctl;					//< 控制网络连接与指令互斥锁
+boost::condition_variable cvctl;		//< 通知: 新的指令
+volatile sig_atomic_t ctlquit(0);		//< 退出标志, 由SIGTERM/SIGINT设置
+boost::thread::id thrdmain;				//< 主线程标志. 主线程执行指令
+int cmderror(0);						//< 主线程执行指令时的错误计数
+/* 运行指标 */
+boost::shared_ptr<tcp_server> tcpsmet;	//< 运行指标HTTP服务器
+std::vector<tcpcptr> metclients;		//< 运行指标网络连接
+boost::mutex mtxmet;					//< 运行指标网络连接互斥锁
 
 //////////////////////////////////////////////////////////////////////////////
 /// 全局函数
 void SendMessage(const long msg); // 投递高优先级消息
 void PostMessage(const long msg); // 投递低优先级消息
+void NotifyEvent(const char *format, ...); // 广播异步事件
 /*==========================================================================*/
 /// 界面交互
 /*!
@@ -156,23 +284,34 @@ void PrintHelp() {
 	ShowCursor(false);
 	PrintXY(x, ++y, "\033[92;49m%s\033[0m", seps.c_str());
 	PrintXY(x, ++y, "* On <Camera IP/ID>         # connect camera. empty for U9000.       keyword: \033[93;49m\033[1mon\033[0m     *");
+	PrintXY(x, ++y, "* Cam <index>               # select camera for following commands.  keyword: \033[93;49m\033[1mcam\033[0m    *");
 	PrintXY(x, ++y, "* Off                       # disconnect camera.                     keyword: \033[93;49m\033[1moff\033[0m    *");
 	PrintXY(x, ++y, "* Reboot                    # reboot camera.                         keyword: \033[93;49m\033[1mreboot\033[0m *");
 	PrintXY(x, ++y, "* Gain <index>              # change gain                            keyword: \033[93;49m\033[1mG\033[0main   *");
+	PrintXY(x, ++y, "* ROI <bin x y w h>         # set sub-frame. empty for full frame.   keyword: \033[93;49m\033[1mroi\033[0m    *");
 	PrintXY(x, ++y, "* Bias <count>              # take sequential BIAS image.            keyword: \033[93;49m\033[1mB\033[0mias   *");
 	PrintXY(x, ++y, "* Dark <duration> <count>   # take sequential DARK image.            keyword: \033[93;49m\033[1mD\033[0mark   *");
+	PrintXY(x, ++y, "* Master bias <count>       # combine BIAS into master.              keyword: \033[93;49m\033[1mmaster\033[0m *");
+	PrintXY(x, ++y, "* Master dark <dur> <count> # combine DARK into master.              keyword: \033[93;49m\033[1mmaster\033[0m *");
+	PrintXY(x, ++y, "* Master badpix <dur> <cnt> # build bad pixel mask from DARK.        keyword: \033[93;49m\033[1mmaster\033[0m *");
 	PrintXY(x, ++y, "* name <duration> <count>   # take sequential LIGHT image                            *");
 	PrintXY(x, ++y, "* Focus <position>          # change focuser position.               keyword: \033[93;49m\033[1mF\033[0mocus  *");
 	PrintXY(x, ++y, "* Reload                    # reload configuration file.             keyword: \033[93;49m\033[1mR\033[0meload *");
-	PrintXY(x, ++y, "* Start                     # start sequence based on configuration. keyword: \033[93;49m\033[1mstart\033[0m  *");
-	PrintXY(x, ++y, "* Stop                      # stop running sequence.                 keyword: \033[93;49m\033[1mstop\033[0m   *");
+	PrintXY(x, ++y, "* Start                     # start sequence on all cameras.         keyword: \033[93;49m\033[1mstart\033[0m  *");
+	PrintXY(x, ++y, "* Stop                      # stop running sequence on all cameras.  keyword: \033[93;49m\033[1mstop\033[0m   *");
 	PrintXY(x, ++y, "* Quit                      # quit program.                          keyword: \033[93;49m\033[1mQ\033[0muit   *");
 	PrintXY(x, ++y, "\033[92;49m%s\033[0m", seps.c_str());
 }
 
 void PrintServer() {// 显示调焦器网络服务端口
 	ShowCursor(false);
-	PrintXY(1, LINE_PORT, "Focus Daemon Port: %d", param.portFocus);
+	char buff[40];
+	if (boost::iequals(param.focuser_driver, "sim")) strcpy(buff, "Focuser: simulated");
+	else sprintf(buff, "Focus Daemon Port: %d", param.portFocus);
+	if (param.portMetrics > 0)
+		PrintXY(1, LINE_PORT, "%s, Metrics Port: %d", buff, param.portMetrics);
+	else
+		PrintXY(1, LINE_PORT, "%s", buff);
 }
 
 void PrintInput() {// 显示用户输入提示符
@@ -191,22 +330,25 @@ void PrintAutoParameter() {// 显示自动控制参数
 			param.stroke_start, param.stroke_stop, param.stroke_step, param.focuser_error);
 }
 
-void PrintManualParameter() {// 显示手动控制参数
+void PrintManualParameter(unitptr unit) {// 显示手动控制参数
+	systate &state = unit->state;
 	ShowCursor(false);
-	PrintXY(1, LINE_PARAM, "ImageType=%s, name=%s, expdur=%.3f, frmcnt=%d",
+	PrintXY(1, LINE_PARAM, "camera<%s>: ImageType=%s, name=%s, expdur=%.3f, frmcnt=%d",
+			state.cid.c_str(),
 			state.imgtype == IMGTYPE_BIAS ? "BIAS" : (state.imgtype == IMGTYPE_DARK ? "DARK" : "OBJECT"),
 					state.objname.c_str(), state.expdur, state.frmcnt);
 }
 
-void PrintFocus() {// 显示焦点位置
-	int act(focus.posAct), tar(focus.posTar);
+void PrintFocus(unitptr unit) {// 显示焦点位置
+	int act(unit->focus.posAct), tar(unit->focus.posTar);
 	if ((act != VALID_FOCUS) || (tar != VALID_FOCUS)) {
 		char buff[100];
 		int n;
-		n = sprintf(buff, "focuser:");
+		n = sprintf(buff, "focuser<%s>:", unit->state.cid.c_str());
 		if (act != VALID_FOCUS) n += sprintf(buff + n, "  position=%d", act);
 		if (tar != VALID_FOCUS) sprintf(buff + n, "  target=%d", tar);
 
+		NotifyEvent("focus %s %d %d", unit->state.cid.c_str(), act, tar);
 		ShowCursor(false);
 		PrintXY(1, LINE_FOCUS, "%s", buff);
 		mutex_lock lck(mtxcur);
@@ -220,6 +362,67 @@ void ClearError() {// 清除错误信息
 	PrintXY(1, LINE_ERROR, "");
 }
 
+/*!
+ * @brief 向所有控制网络连接广播异步事件
+ * @param format 事件格式. 事件以换行符结束, 首个单词为事件类型
+ */
+void NotifyEvent(const char *format, ...) {
+	if (!daemon_mode) return;
+
+	char buff[TCP_BUFF_SIZE];
+	va_list vl;
+	int n;
+
+	va_start(vl, format);
+	n = vsnprintf(buff, TCP_BUFF_SIZE - 1, format, vl);
+	va_end(vl);
+	if (n < 0) return;
+	if (n > TCP_BUFF_SIZE - 2) n = TCP_BUFF_SIZE - 2;
+	buff[n++] = '\n';
+
+	mutex_lock lck(mtxctl);
+	for (std::vector<tcpcptr>::iterator it = ctlclients.begin(); it != ctlclients.end(); ) {
+		if (!(*it)->is_open()) it = ctlclients.erase(it);
+		else {
+			(*it)->write(buff, n);
+			++it;
+		}
+	}
+}
+
+/*!
+ * @brief 显示状态信息. 后台服务模式下广播status事件
+ * @param format 信息格式
+ */
+void PrintStatus(const char *format, ...) {
+	char buff[TCP_BUFF_SIZE];
+	va_list vl;
+
+	va_start(vl, format);
+	vsnprintf(buff, TCP_BUFF_SIZE - 1, format, vl);
+	va_end(vl);
+	PrintXY(1, LINE_STATUS, "%s", buff);
+	NotifyEvent("status %s", buff);
+}
+
+/*!
+ * @brief 显示错误信息. 后台服务模式下广播error事件
+ * @param format 信息格式
+ * @note
+ * 主线程中的错误计入cmderror, 用于判定指令执行结果
+ */
+void PrintError(const char *format, ...) {
+	char buff[TCP_BUFF_SIZE];
+	va_list vl;
+
+	va_start(vl, format);
+	vsnprintf(buff, TCP_BUFF_SIZE - 1, format, vl);
+	va_end(vl);
+	if (boost::this_thread::get_id() == thrdmain) ++cmderror;
+	PrintXY(1, LINE_ERROR, "%s", buff);
+	NotifyEvent("error %s", buff);
+}
+
 /*!
  * @brief 显示曝光进度
  * @param process 曝光进度, 量纲: 百分比
@@ -249,129 +452,135 @@ void PrintExprocess(double process) {
 	ShowCursor(true);
 	UpdateScreen();
 }
-/*==========================================================================*/
-/* 显示FITS图像 */
-bool XPASetFile(const char *filepath, const char *filename, bool back) {
-	char *names, *messages;
-	char params[100];
-	char mode[50];
 
-	strcpy(mode, back ? "ack=true" : "ack=false");
-	sprintf(params, "fits %s", filename);
-	int fd = open(filepath, O_RDONLY);
-	if (fd >= 0) {
-		XPASetFd(NULL, (char*) "ds9", params, mode, fd, &names, &messages, 1);
-		if (names) free(names);
-		if (messages) free(messages);
-		close(fd);
-		return true;
-	}
-	return false;
+/*!
+ * @brief 查看相机工作单元
+ * @param index 相机索引
+ * @return
+ * 相机工作单元副本. 未连接时为空指针
+ * @note
+ * units[]在终端线程中改变, 在消息、曝光与指标线程中访问, 须在互斥区内复制
+ */
+unitptr get_unit(int index) {
+	mutex_lock lck(mtxunit);
+	return units[index];
 }
 
-void XPASetScaleMode(const char *mode) {
-	char *names, *messages;
-	char params[40];
-
-	sprintf(params, "scale mode %s", mode);
-	XPASet(NULL, (char*) "ds9", params, NULL, NULL, 0, &names, &messages, 1);
-	if (names) free(names);
-	if (messages) free(messages);
+/*!
+ * @brief 设置相机工作单元
+ * @param index 相机索引
+ * @param unit  相机工作单元. 空指针表示移除
+ * @note
+ * 原工作单元在互斥区外释放
+ */
+void set_unit(int index, unitptr unit) {
+	mutex_lock lck(mtxunit);
+	units[index].swap(unit);
 }
 
-void XPASetZoom(const char *zoom) {
-	char *names, *messages;
-	char params[40];
-
-	sprintf(params, "zoom %s", zoom);
-	XPASet(NULL, (char*) "ds9", params, NULL, NULL, 0, &names, &messages, 1);
-	if (names) free(names);
-	if (messages) free(messages);
+/*!
+ * @brief 广播曝光进度
+ * @param index   相机索引
+ * @param percent 曝光进度, 量纲: 百分比
+ * @note
+ * 进度整数部分变化时广播progress事件
+ */
+void NotifyProgress(int index, double percent) {
+	static int last[MAX_CAMERA + 1] = {-1, -1, -1, -1, -1, -1};
+	unitptr unit = get_unit(index);
+	int pct = percent >= 100.0 ? 100 : int(percent);
+
+	if (unit.use_count() && pct != last[index]) {
+		last[index] = pct;
+		NotifyEvent("progress %s %d", unit->state.cid.c_str(), pct);
+	}
 }
+/*==========================================================================*/
+/*!
+ * @brief 查找相机工作单元
+ * @param cid 相机标志
+ * @return
+ * 相机工作单元. 未找到时为空指针
+ */
+unitptr find_unit(const std::string &cid) {
+	unitptr unit;
 
-void XPAPreservePan(bool yes) {
-	char *names, *messages;
-	char params[40];
-
-	sprintf(params, "preserve pan %s", yes ? "yes" : "no");
-	XPASet(NULL, (char*) "ds9", params, NULL, NULL, 0, &names, &messages, 1);
-	if (names) free(names);
-	if (messages) free(messages);
+	for (int i = 1; i <= MAX_CAMERA; ++i) {
+		if ((unit = get_unit(i)).use_count() && boost::iequals(unit->state.cid, cid)) return unit;
+	}
+	return unitptr();
 }
 
-void XPAPreserveRegion(bool yes) {
-	char *names, *messages;
-	char params[40];
-
-	sprintf(params, "preserve regions %s", yes ? "yes" : "no");
-	XPASet(NULL, (char*) "ds9", params, NULL, NULL, 0, &names, &messages, 1);
-	if (names) free(names);
-	if (messages) free(messages);
+/*!
+ * @brief 检查相机是否在线
+ * @param unit 相机工作单元
+ * @return
+ * 在线标志
+ */
+bool unit_online(const unitptr &unit) {
+	return unit.use_count() && unit->camera->IsConnected();
 }
 
-void DisplayImage() {// display fits image
-	if (XPASetFile(state.filepath.c_str(), state.filename.c_str(), firstimg) && firstimg) {
-		firstimg = false;
-		XPASetScaleMode("zscale");
-		XPASetZoom("to fit");
-		XPAPreservePan(true);
-		XPAPreserveRegion(true);
+/*!
+ * @brief 检查是否所有相机空闲
+ * @return
+ * 空闲标志
+ */
+bool units_idle() {
+	unitptr unit;
+
+	for (int i = 1; i <= MAX_CAMERA; ++i) {
+		if ((unit = get_unit(i)).use_count() && unit->state.mode != MODE_INIT) return false;
 	}
+	return true;
+}
+/*==========================================================================*/
+/* 显示FITS图像 */
+void DisplayImage(jobptr job) {// display image in ds9
+	display->NewImage((const uint16_t*) job->nfcam.data.get(),
+			job->nfcam.roi.get_width(), job->nfcam.roi.get_height(), job->state.filename);
 }
 /*==========================================================================*/
-void UploadFile() {// 上传文件
+void UploadFile(jobptr job) {// 上传文件
 	FileTransferClient::upload_file file;
 	file.grid_id = param.grpid;
-	file.filename = state.filename;
-	file.filepath = state.filepath;
+	file.filename = job->state.filename;
+	file.filepath = job->state.filepath;
+	file.camera_id = job->state.cid;
 	ftcli->NewFile(&file);
 }
 /*==========================================================================*/
 /*!
- * @brief 设置焦点目标位置
- * @param target 目标位置
- * @return
- * 处理结果. true: 需要重新定位; false: 不需要定位
+ * @brief 检查调焦器是否联机
  */
-bool set_focus_target(int tar) {
-	bool moving(false);
-	focus.posTar = tar;
-	if (tar != focus.posAct) {
-		moving = true;
-		focus.repeat = 5;
-
-		int n;
-		const char *to = mntproto->compact_focus(param.grpid, param.unitid, state.cid, tar, n);
-		focus.tcp->write(to, n);
-	}
-
-	return moving;
+bool focuser_online() {
+	return focdev.use_count() && focdev->IsOnline();
 }
 
 /*!
- * @brief 设置焦点实际位置
- * @param act 实际位置
+ * @brief 设置焦点目标位置
+ * @param unit   相机工作单元
+ * @param target 目标位置
  * @return
- * 处理结果
- * true: 静止
- * false: 运动
+ * 处理结果. true: 需要重新定位; false: 不需要定位
+ * @note
+ * 消隙与到位判定由调焦器完成. 到位或已在目标位置时产生FOCUS_ARRIVE事件,
+ * 由ResolveFocus()开始曝光, 调用者无需区分返回值
  */
-bool set_focus_real(int act) {
-	bool rslt = act == focus.posAct;
-	if (!rslt) {
-		focus.posAct = act;
-		PrintFocus();
-	}
-	return rslt;
+bool set_focus_target(unitptr unit, int tar) {
+	unit->focus.posTar = tar;
+	return focdev->Move(unit->state.cid, tar);
 }
 
 /*!
  * @brief 检查是否存在下一个焦点位置执行观测序列
+ * @param unit 相机工作单元
  * @return
  * 下一个焦点位置. 若已结束或不可调节, 则返回VALID_FOCUS
  */
-int focuser_next() {
-	if (!focus.tcp.use_count() || state.mode != MODE_AUTO
+int focuser_next(unitptr unit) {
+	focuser &focus = unit->focus;
+	if (!focuser_online() || unit->state.mode != MODE_AUTO
 			|| focus.posTar == param.stroke_stop)
 		return VALID_FOCUS;
 	int op = focus.posTar, np;
@@ -381,132 +590,126 @@ int focuser_next() {
 	return np;
 }
 
-/*!
- * @brief 调焦器到达设定位置
- * @return
- * 0 -- 到达设定位置
- * 1 -- 未到达设定位置, 且不确定是否仍在定位
- * 2 -- 未到达设定位置, 并确定已停止定位
- * @note
- * 检测前置条件: set_focus_real()返回true
- */
-int focuser_arrive() {
-	if (abs(focus.posAct - focus.posTar) < param.focuser_error) return 0;
-	return (--focus.repeat >= 0 ? 1 : 2);
-}
 /*==========================================================================*/
 /*==========================================================================*/
-/// 网络: 调焦器
-/*!
- * @brief 处理收到的调焦信息
- * @param client 网络连接资源
- * @param ec 错误代码
- */
-void ReceiveFocus(const long client, const long ec) {
-	PostMessage(!ec ? 1 : 2);
-}
-
+/// 调焦器
 /*!
- * @brief 收到调焦器网络连接请求
- * @param client 网络连接资源
- * @param param 参数
+ * @brief 调焦器事件通知. 在调焦器线程中执行, 仅投递消息
  */
-void AcceptFocus(const tcpcptr& client, const long param) {
-	focus.tcp = client;
-	focus.reset();
-	const tcpc_cbtype& slot = boost::bind(&ReceiveFocus, _1, _2);
-	client->register_receive(slot);
-	PrintXY(1, LINE_FOCUS, "focuser is on-line");
-
-	mutex_lock lck(mtxcur);
-	MovetoXY(curpos, LINE_INPUT);
-	UpdateScreen();
+void FocuserNotify() {
+	PostMessage(1);
 }
 
 /*!
- * @brief 启动调焦器网络服务
+ * @brief 创建并启动调焦器
  * @return
- * 服务启动结果
+ * 启动结果
+ * @note
+ * param.focuser_driver选择调焦器: tcp, 在param.portFocus端口等待网络调焦器; sim, 模拟调焦器
  */
-bool StartServerFocus() {
-	const tcps_cbtype& slot = boost::bind(&AcceptFocus, _1, _2);
-	tcpsfoc = boost::make_shared<tcp_server>();
-	tcpsfoc->register_accept(slot);
-	return tcpsfoc->start(param.portFocus);
+bool StartFocuser() {
+	if (boost::iequals(param.focuser_driver, "sim"))
+		focdev = boost::make_shared<FocuserSim>(param.focuser_speed, param.focuser_settle,
+				param.focuser_noise, param.focuser_period);
+	else
+		focdev = boost::make_shared<FocuserTcp>(param.portFocus, param.grpid, param.unitid);
+	focdev->SetTolerance(param.focuser_error);
+	focdev->SetBacklash(param.stroke_back);
+	focdev->register_notify(boost::bind(&FocuserNotify));
+	return focdev->Start();
 }
 
 /*!
- * @brief 解析更新焦点位置
+ * @brief 处理调焦器事件
+ * @note
+ * 调焦器由各相机共用, 依据事件中的相机标志分发至对应相机
  */
 void ResolveFocus() {
-	char term[] = "\n";        // 换行符作为信息结束标记
-	int len = strlen(term);// 结束符长度
-	int pos;      // 标志符位置
-	int toread;   // 信息长度
-	mpbase proto_body;
-	std::string proto_type;
-	tcpcptr client = focus.tcp;
-	static char buff[TCP_BUFF_SIZE];
-
-	while (client->is_open() && (pos = client->lookup(term, len)) >= 0) {
-		/* 有效性判定 */
-		if ((toread = pos + len) > TCP_BUFF_SIZE) {// 原因: 遗漏换行符作为协议结束标记; 高>概率性丢包
-			client->close();
-			PrintXY(1, LINE_ERROR, "protocol length from focuser is over than threshold");
+	focus_event evt;
+	unitptr unit;
+
+	while (focdev.use_count() && focdev->GetEvent(evt)) {
+		if (evt.type == FOCUS_ONLINE) {
+			for (int i = 1; i <= MAX_CAMERA; ++i) {
+				if ((unit = get_unit(i)).use_count()) unit->focus.reset();
+			}
+			NotifyEvent("focuser on-line");
+			PrintXY(1, LINE_FOCUS, "focuser is on-line");
 
 			mutex_lock lck(mtxcur);
 			MovetoXY(curpos, LINE_INPUT);
 			UpdateScreen();
 		}
-		else {
-			/* 读取协议内容 */
-			client->read(buff, toread);
-			buff[pos] = 0;
-			/* 解析协议 */
-			proto_type = mntproto->resolve(buff, proto_body);
-			if (boost::iequals(proto_type, "focus")) {
-				boost::shared_ptr<mntproto_focus> proto = boost::static_pointer_cast<mntproto_focus>(proto_body);
-
-				if (boost::iequals(proto->group_id, param.grpid)
-					&& boost::iequals(proto->unit_id, param.unitid)
-					&& boost::iequals(proto->camera_id, state.cid)
-					&& set_focus_real(proto->position)
-					&& state.mode == MODE_AUTO) {// 处理焦点位置
-					int code = focuser_arrive();
-					if (!code) {
-						if (abs(param.stroke_start - param.stroke_back - focus.posAct) < param.focuser_error)// 空回, 消隙
-							set_focus_target(param.stroke_start);
-						else {// 开始曝光
-							camera->Expose(state.expdur, state.imgtype == IMGTYPE_OBJECT);
-						}
-					}
-					else if (code == 2) {
-						state.mode = MODE_INIT;
-						PrintXY(1, LINE_ERROR, "focuser could not arrive target position");
-						mutex_lock lck(mtxcur);
-						MovetoXY(curpos, LINE_INPUT);
-						UpdateScreen();
-					}
+		else if (evt.type == FOCUS_OFFLINE) {
+			ShowCursor(false);
+			for (int i = 1; i <= MAX_CAMERA; ++i) {
+				if ((unit = get_unit(i)).use_count() && unit->state.mode == MODE_AUTO) {
+					PrintError("stroke sequence will be interrupted after this position over");
+					unit->state.mode = MODE_MANUAL;
+				}
+			}
+			NotifyEvent("focuser off-line");
+			PrintXY(1, LINE_FOCUS, "focuser is off-line due to remote broken");
+
+			mutex_lock lck(mtxcur);
+			MovetoXY(curpos, LINE_INPUT);
+			ShowCursor(true);
+			UpdateScreen();
+		}
+		else if ((unit = find_unit(evt.cid)).use_count()) {
+			if (evt.type == FOCUS_POSITION) {
+				unit->focus.posAct = evt.position;
+				PrintFocus(unit);
+			}
+			else if (unit->state.mode != MODE_AUTO) continue;
+			else if (evt.type == FOCUS_ARRIVE) {
+				unit->focus.posAct = evt.position;
+				if (unit->focus.early) {// 末帧仍在读出, 由ExposeComplete()开始曝光
+					unit->focus.arrived = true;
+				}
+				else {// 开始曝光
+					unit->camera->Expose(unit->state.expdur, unit->state.imgtype == IMGTYPE_OBJECT);
 				}
 			}
+			else if (evt.type == FOCUS_FAIL) {
+				unit->state.mode = MODE_INIT;
+				NotifyEvent("idle %s", unit->state.cid.c_str());
+				PrintError("focuser<%s> could not arrive target position", unit->state.cid.c_str());
+				mutex_lock lck(mtxcur);
+				MovetoXY(curpos, LINE_INPUT);
+				UpdateScreen();
+			}
 		}
 	}
 }
 
 /*==========================================================================*/
-void ExposeProcessCB(const double left, const double percent, const int status) {
+/*!
+ * @brief 曝光进度回调函数
+ * @param index   相机索引
+ * @param left    曝光剩余时间, 量纲: 秒
+ * @param percent 曝光进度, 量纲: 百分比
+ * @param status  相机工作状态
+ */
+void ExposeProcessCB(const int index, const double, const double percent, const int status) {
 	switch((CAMERA_STATUS) status) {
 	case CAMERA_ERROR:  // 错误, 需要重启相机等操作
-		PostMessage(5);
+		PostMessage(MSG_ENCODE(5, index));
 		break;
 	case CAMERA_IDLE:   // 中止曝光
-		PostMessage(6);
+		PostMessage(MSG_ENCODE(6, index));
 		break;
-	case CAMERA_EXPOSE: // 曝光过程中
-		PrintExprocess(percent);
+	case CAMERA_EXPOSE: // 曝光过程中. 控制台仅显示当前相机曝光进度
+		if (daemon_mode) NotifyProgress(index, percent);
+		else if (index == unitsel) PrintExprocess(percent);
 		break;
 	case CAMERA_IMGRDY: // 图像准备完成, 可以存储等操作
-		PostMessage(4);
+		PostMessage(MSG_ENCODE(4, index));
+		break;
+	case CAMERA_READOUT: // 积分结束, 开始读出
+		if (daemon_mode) NotifyProgress(index, percent);
+		else if (index == unitsel) PrintExprocess(percent);
+		PostMessage(MSG_ENCODE(9, index));
 		break;
 	default:
 		break;
@@ -514,19 +717,16 @@ void ExposeProcessCB(const double left, const double percent, const int status)
 }
 
 /*!
- * @brief 将相机采集数据存储为FITS文件
- * @return
+ * @brief 生成本帧图像的目录结构与文件名
+ * @param unit 相机工作单元
+ * @note
+ * 在投递存储之前调用
  */
-bool SaveFITSFile() {
-	fitsfile *fitsptr;
-	int status(0);
-	int naxis(2);
-	boost::shared_ptr<devcam_info> nfcam = camera->GetCameraInfo();
-	long naxes[] = {nfcam->roi.get_width(), nfcam->roi.get_height()};
-	long pixels = nfcam->roi.get_width() * nfcam->roi.get_height();
+void CreateFilePath(unitptr unit) {
+	systate &state = unit->state;
+	boost::shared_ptr<devcam_info> nfcam = unit->camera->GetCameraInfo();
 	char buff[300];
 	int n;
-	std::string tmstr;
 
 	// 创建目录结构
 	if (state.frmno == 1) {
@@ -544,172 +744,861 @@ bool SaveFITSFile() {
 	state.filename = buff;
 	sprintf(buff, "%s/%s", state.pathname.c_str(), state.filename.c_str());
 	state.filepath = buff;
-	// 存储FITS文件并写入完整头信息
-	fits_create_file(&fitsptr, state.filepath.c_str(), &status);
+}
+
+/*!
+ * @brief 将相机采集数据存储为FITS文件
+ * @param job     待存储图像
+ * @param bufsave 转换缓冲区
+ * @return
+ * 存储结果
+ * @note
+ * - cfitsio仅用于在内存中生成头信息, 图像数据由WriteFITSFile()转换并写入
+ * - 头信息记录本帧此前各阶段耗时, 存储耗时由WriteFITSFile()回填
+ */
+bool SaveFITSFile(jobptr job, uint16_t *bufsave) {
+	int64_t t0 = trace_now();
+	fitsfile *fitsptr;
+	int status(0);
+	int naxis(2);
+	systate &state = job->state;
+	devcam_info &nfcam = job->nfcam;
+	long naxes[] = {nfcam.roi.get_width(), nfcam.roi.get_height()};
+	long pixels = nfcam.roi.get_width() * nfcam.roi.get_height();
+	frame_trace &trace = nfcam.trace;
+	char *header(NULL);
+	char comment[80];
+	int nkeys(0), savecard(-1);
+	long us;
+
+	// 在内存中生成FITS头
+	fits_create_file(&fitsptr, "mem://", &status);
 	fits_create_img(fitsptr, USHORT_IMG, naxis, naxes, &status);
-	fits_write_img(fitsptr, TUSHORT, 1, pixels, nfcam->data.get(), &status);
 	/* FITS头 */
 	fits_write_key(fitsptr, TSTRING, "GROUP_ID", (void*)param.grpid.c_str(), "group id", &status);
 	fits_write_key(fitsptr, TSTRING, "UNIT_ID", (void*)param.unitid.c_str(), "unit id", &status);
 	fits_write_key(fitsptr, TSTRING, "CAM_ID", (void*)state.cid.c_str(), "camera id", &status);
 	fits_write_key(fitsptr, TSTRING, "MOUNT_ID", (void*)param.unitid.c_str(), "mount id", &status);
 	fits_write_key(fitsptr, TSTRING, "CCDTYPE", (void*)state.imgtypestr.c_str(), "type of image", &status);
-	fits_write_key(fitsptr, TSTRING, "DATE-OBS", (void*)nfcam->dateobs.c_str(), "UTC date of begin observation", &status);
-	fits_write_key(fitsptr, TSTRING, "TIME-OBS", (void*)nfcam->timeobs.c_str(), "UTC time of begin observation", &status);
-	fits_write_key(fitsptr, TSTRING, "TIME-END", (void*)nfcam->timeend.c_str(), "UTC time of end observation", &status);
-	fits_write_key(fitsptr, TDOUBLE, "JD", &nfcam->jd, "Julian day of begin observation", &status);
-	fits_write_key(fitsptr, TDOUBLE, "EXPTIME", &nfcam->eduration, "exposure duration", &status);
-	fits_write_key(fitsptr, TUINT,   "GAIN", &nfcam->gain, "", &status);
-	fits_write_key(fitsptr, TDOUBLE, "TEMPSET", &nfcam->coolerset, "cooler set point", &status);
-	fits_write_key(fitsptr, TDOUBLE, "TEMPACT", &nfcam->coolerget, "cooler actual point", &status);
+	fits_write_key(fitsptr, TSTRING, "DATE-OBS", (void*)nfcam.dateobs.c_str(), "UTC date of begin observation", &status);
+	fits_write_key(fitsptr, TSTRING, "TIME-OBS", (void*)nfcam.timeobs.c_str(), "UTC time of begin observation", &status);
+	fits_write_key(fitsptr, TSTRING, "TIME-END", (void*)nfcam.timeend.c_str(), "UTC time of end observation", &status);
+	fits_write_key(fitsptr, TDOUBLE, "JD", &nfcam.jd, "Julian day of begin observation", &status);
+	fits_write_key(fitsptr, TDOUBLE, "EXPTIME", &nfcam.eduration, "exposure duration", &status);
+	fits_write_key(fitsptr, TUINT,   "GAIN", &nfcam.gain, "", &status);
+	fits_write_key(fitsptr, TDOUBLE, "TEMPSET", &nfcam.coolerset, "cooler set point", &status);
+	fits_write_key(fitsptr, TDOUBLE, "TEMPACT", &nfcam.coolerget, "cooler actual point", &status);
 	fits_write_key(fitsptr, TSTRING, "TERMTYPE", (void*)state.termtype.c_str(), "terminal type", &status);
+	fits_write_key(fitsptr, TINT,    "XBINNING", &nfcam.roi.xbin, "binning factor in X", &status);
+	fits_write_key(fitsptr, TINT,    "YBINNING", &nfcam.roi.ybin, "binning factor in Y", &status);
+	fits_write_key(fitsptr, TINT,    "XORGSUBF", &nfcam.roi.xstart, "sub-frame origin X in sensor pixels", &status);
+	fits_write_key(fitsptr, TINT,    "YORGSUBF", &nfcam.roi.ystart, "sub-frame origin Y in sensor pixels", &status);
 
 	if (state.objname.empty())     fits_write_key(fitsptr, TSTRING, "OBJECT",   (void*)state.objname.c_str(), "name of object", &status);
-	if (focus.posAct != VALID_FOCUS) fits_write_key(fitsptr, TINT,    "TELFOCUS", &focus.posAct,    "telescope focus value in micron", &status);
+	if (job->posAct != VALID_FOCUS) fits_write_key(fitsptr, TINT,    "TELFOCUS", &job->posAct,    "telescope focus value in micron", &status);
+	if (job->ncombine > 0) fits_write_key(fitsptr, TINT, "NCOMBINE", &job->ncombine, "number of frames combined", &status);
+	if (job->stars.use_count()) {
+		int nstars = job->stars->size();
+		fits_write_key(fitsptr, TINT, "NSTARS", &nstars, "number of stars extracted", &status);
+		if (job->fwhm > 0.0f) fits_write_key(fitsptr, TFLOAT, "FWHM", &job->fwhm, "median FWHM of stars in pixel", &status);
+	}
+	if (job->quality.flags >= 0) {
+		std::string text;
+		quality_text(job->quality.flags, text);
+		fits_write_key(fitsptr, TINT, "QUALITY", &job->quality.flags, "quality flags, 0 for passed", &status);
+		fits_write_key(fitsptr, TSTRING, "QUALTXT", (void*) text.c_str(), "quality check result", &status);
+	}
+	if (job->psf.use_count()) {
+		int nfit = job->psf->size();
+		fits_write_key(fitsptr, TSTRING, "PSFMODEL", (void*) psf_model_name(psf_model_code(param.psf_model)),
+				"PSF model fitted", &status);
+		fits_write_key(fitsptr, TINT, "PSFNFIT", &nfit, "number of stars with converged PSF fit", &status);
+		if (job->psffwhm > 0.0f) fits_write_key(fitsptr, TFLOAT, "PSFFWHM", &job->psffwhm, "median fitted FWHM in pixel", &status);
+		if (job->psfbeta > 0.0f) fits_write_key(fitsptr, TFLOAT, "PSFBETA", &job->psfbeta, "median fitted Moffat beta", &status);
+	}
+	if (job->shape.size()) {// 星像形状: 全幅与各区域(行列序号起始为1)的椭率与位置角
+		char key[FLEN_KEYWORD];
+		int grid = param.shape_grid; // 参数加载时限制grid<=9: 行列序号各1位, 关键字不超过8字符且无歧义
+		fits_write_key(fitsptr, TFLOAT, "ELLIP", &job->shapeall.ellip, "mean ellipticity 1-b/a", &status);
+		fits_write_key(fitsptr, TFLOAT, "ELLPA", &job->shapeall.theta, "mean position angle in deg, +X to +Y", &status);
+		for (int i = 0; i < int(job->shape.size()); ++i) {
+			shape_region &rs = job->shape[i];
+			if (!rs.n) continue;
+			snprintf(key, sizeof(key), "ELL_%d%d", i / grid + 1, i % grid + 1);
+			sprintf(comment, "ellipticity of region row %d col %d", i / grid + 1, i % grid + 1);
+			fits_write_key(fitsptr, TFLOAT, key, &rs.ellip, comment, &status);
+			snprintf(key, sizeof(key), "EPA_%d%d", i / grid + 1, i % grid + 1);
+			sprintf(comment, "position angle of region row %d col %d", i / grid + 1, i % grid + 1);
+			fits_write_key(fitsptr, TFLOAT, key, &rs.theta, comment, &status);
+		}
+	}
 
 	fits_write_key(fitsptr, TINT, "FRAMENO", &state.frmno, "frame no in this run", &status);
+	for (int i = 0; i <= TS_SAVE; ++i) {// 各阶段耗时. 存储耗时占位
+		if (i != TS_SAVE && trace.stage[i] < 0) continue;
+		us = i == TS_SAVE ? 0 : long(trace.stage[i]);
+		sprintf(comment, "%s latency in us", trace_stage_name(i));
+		fits_write_key(fitsptr, TLONG, trace_stage_key(i), &us, comment, &status);
+	}
+	fits_hdr2str(fitsptr, 0, NULL, 0, &header, &nkeys, &status);
 	fits_close_file(fitsptr, &status);
+	for (int i = nkeys - 1; !status && i >= 0 && savecard < 0; --i) {
+		if (!strncmp(header + i * 80, trace_stage_key(TS_SAVE), 8)) savecard = i;
+	}
 
 	if (status) {
 		char txt[200];
 		fits_get_errstatus(status, txt);
-		gLog.Write(NULL, LOG_FAULT, "Fail to save FITS file<%s>: %s", state.filepath.c_str(), txt);
+		gLog.Write(LOG_FAULT, "SaveFITSFile()", "Fail to create FITS header<%s>: %s", state.filepath.c_str(), txt);
 	}
+	else if (!WriteFITSFile(state.filepath.c_str(), header, nkeys, (const uint16_t*) nfcam.data.get(), pixels,
+			bufsave, savecard, t0)) {
+		gLog.Write(LOG_FAULT, "SaveFITSFile()", "Fail to save FITS file<%s>: %s", state.filepath.c_str(), strerror(errno));
+		status = -1;
+	}
+	if (header) {
+		int tmp(0);
+		fits_free_memory(header, &tmp);
+	}
+	if (status == 0) trace.finish(TS_SAVE, t0);
 	return status == 0;
 }
+/*==========================================================================*/
+/// 图像存储线程池
+/*!
+ * @brief 由合并暗场生成坏像素表, 存储后替换相机的坏像素表
+ * @param mjob 合并暗场
+ * @note
+ * 仅全幅、无合并的暗场可生成坏像素表
+ */
+void BuildBadPixel(jobptr mjob) {
+	systate &state = mjob->state;
+	ROI &roi = mjob->nfcam.roi;
+	boost::shared_ptr<Calibrator> calib = mjob->unit->calib;
+	boost::shared_ptr<BadPixelMask> mask = boost::make_shared<BadPixelMask>();
+	std::string filepath = param.calib_path + "/G" + state.cid + "_badpix.msk";
+
+	if (roi.xbin != 1 || roi.ybin != 1 || roi.width != mjob->nfcam.wsensor || roi.height != mjob->nfcam.hsensor)
+		PrintError("camera<%s>: bad pixel mask requires full frame without binning", state.cid.c_str());
+	else if (!mask->Build((const uint16_t*) mjob->nfcam.data.get(), roi.width, roi.height))
+		PrintError("camera<%s>: failed to build bad pixel mask", state.cid.c_str());
+	else if (!mask->Save(filepath))
+		PrintError("camera<%s>: failed to save %s: %s", state.cid.c_str(), filepath.c_str(), strerror(errno));
+	else {
+		if (calib.use_count() && !calib->SetMask(mask))
+			gLog.Write(LOG_WARN, "BuildBadPixel()", "camera<%s>: bad pixel mask does not match master frames",
+					state.cid.c_str());
+		gLog.Write("camera<%s>: %d bad pixels, %d bad columns", state.cid.c_str(), mask->Count(), mask->Columns());
+		PrintStatus("camera<%s>: bad pixel mask<%d pixels>: %s", state.cid.c_str(), mask->Count(), filepath.c_str());
+		NotifyEvent("badpix %s %s %d", state.cid.c_str(), filepath.c_str(), mask->Count());
+	}
+}
 
 /*!
- * @brief 曝光正确结束
+ * @brief 累加本底/暗场, 最后一帧处理后存储合并图像
+ * @param job     已存储图像. 图像数据为空时表示该帧已丢失
+ * @param bufsave 转换缓冲区
+ * @note
+ * - 合并图像与最后一帧位于同一目录, 头信息沿用最后一帧并增加NCOMBINE
+ * - 丢失或尺寸不一致的帧不累加, 但计入已处理帧数. 合并帧数不足时提示并广播
+ *   "combine <相机> <已合并帧数> <合并帧数>"
  */
-void ExposeComplete() {
-	ShowCursor(false);
-	++state.frmno;
-	SaveFITSFile();
-	if (param.bfts && ftcli.unique() && state.mode == MODE_AUTO) UploadFile();
-	if (param.display) DisplayImage();
+void CombineFrame(jobptr job, uint16_t *bufsave) {
+	boost::shared_ptr<MasterCombine> master = job->master;
+	systate &state = job->state;
+	ROI &roi = job->nfcam.roi;
+	const uint16_t *data = (const uint16_t*) job->nfcam.data.get();
+	int n = data ? master->Add(data, roi.get_width(), roi.get_height()) : -1;
+
+	if (n < 0) {
+		if (data)
+			gLog.Write(LOG_WARN, "CombineFrame()", "camera<%s>: image size changed, <%s> is not combined",
+					state.cid.c_str(), state.filename.c_str());
+		n = master->Skip();
+	}
+	if (n < master->Count()) return;
+	if ((n = master->Added()) < master->Count()) {
+		gLog.Write(LOG_WARN, "CombineFrame()", "camera<%s>: only %d of %d frames are combined",
+				state.cid.c_str(), n, master->Count());
+		PrintError("camera<%s>: only %d of %d %s frames are combined", state.cid.c_str(), n, master->Count(),
+				state.imgtypeabbr.c_str());
+		NotifyEvent("combine %s %d %d", state.cid.c_str(), n, master->Count());
+		if (!n) return;
+	}
 
-	PrintXY(1, LINE_STATUS, "file<%d/%d>: \033[93;49m\033[1m%s\033[0m",
-			state.frmno, state.frmcnt,
-			state.filepath.c_str());
-	PrintXY(1, LINE_EXPROCESS, "");
+	jobptr mjob = boost::make_shared<frame_job>(*job);
+	systate &mstate = mjob->state;
+	char buff[200];
+
+	mjob->master.reset();
+	mjob->stars.reset();
+	mjob->psf.reset();
+	mjob->plane.reset();
+	mjob->gate.reset();
+	mjob->quality.flags = -1;
+	mjob->ncombine = n;
+	mjob->upload   = false;
+	mjob->nfcam.data = master->Combine();
+	mjob->nfcam.trace.reset();
+	sprintf(buff, "G%s_m%s_%s.fit", mstate.cid.c_str(), mstate.imgtypeabbr.c_str(), mjob->nfcam.utctime.c_str());
+	mstate.filename = buff;
+	mstate.filepath = mstate.pathname + "/" + mstate.filename;
+	if (!SaveFITSFile(mjob, bufsave))
+		PrintError("camera<%s>: failed to save %s", mstate.cid.c_str(), mstate.filename.c_str());
+	else {
+		PrintStatus("camera<%s>: master %s<%d frames>: %s", mstate.cid.c_str(), mstate.imgtypeabbr.c_str(), n,
+				mstate.filepath.c_str());
+		NotifyEvent("master %s %s", mstate.cid.c_str(), mstate.filepath.c_str());
+	}
+	if (job->badpix) BuildBadPixel(mjob);
+}
 
-	if (state.frmno < state.frmcnt) {// 继续曝光
-		if (state.mode != MODE_INIT)
-			camera->Expose(state.expdur, state.imgtype == IMGTYPE_OBJECT);
-		else {
-			ClearError();
-			PrintXY(1, LINE_STATUS, "exposure is aborted. %s", camera->GetCameraInfo()->errmsg.c_str());
-		}
+/*!
+ * @brief 提取目标与调焦图像中的星像, 统计半高全宽
+ * @param job    待存储图像
+ * @param bufcal 定标缓冲区, 按图像尺寸扩容
+ * @note
+ * - 已加载合并图像或坏像素表时由定标后图像提取
+ * - 星像坐标相对图像左上角, 起始为0. 传感器坐标需加ROI区起点
+ * - 半高全宽取未饱和、未接触边界星像的中值
+ * - 按区域统计星像椭率与位置角, 广播"shape <相机> <帧序号> <区域划分> <椭率> <位置角> <各区域椭率/位置角>",
+ *   区域按行排列, 无星像区域为"-"
+ * - 启用PSF拟合时对最亮的未饱和星像拟合高斯或Moffat轮廓, 广播"psf <相机> <帧序号> <收敛星像数> <半高全宽> <β>"
+ * - 启用质量检查时广播"quality <相机> <帧序号> <标志> <说明> <星像数> <流量比> <饱和比例> <椭率增量> <背景变化>"
+ */
+void AnalyseFrame(jobptr job, std::vector<uint16_t> &bufcal) {
+	systate &state = job->state;
+	devcam_info &nfcam = job->nfcam;
+	int width(nfcam.roi.get_width()), height(nfcam.roi.get_height());
+	const uint16_t *data = (const uint16_t*) nfcam.data.get();
+	boost::shared_ptr<Calibrator> calib = job->unit->calib;
+	int64_t t0 = trace_now();
+
+	if (calib.use_count() && calib->IsValid()) {
+		if (bufcal.size() < size_t(width) * height) bufcal.resize(size_t(width) * height);
+		if (calib->Apply(data, nfcam.roi, nfcam.eduration, &bufcal[0])) data = &bufcal[0];
 	}
-	else if (state.mode != MODE_AUTO) {
-		state.mode = MODE_INIT;
-		PrintXY(1, LINE_ERROR, "exposure is over");
+
+	BackgroundMesh bkg(param.bkg_mesh, param.bkg_filter, param.bkg_thread);
+	StarExtractor extractor(param.detect_sigma, param.detect_minarea, param.saturate, param.bkg_thread);
+	boost::shared_ptr<star_catalog> stars = boost::make_shared<star_catalog>();
+	if (!bkg.Estimate(data, width, height) || !extractor.Extract(data, width, height, bkg, *stars)) {
+		gLog.Write(LOG_WARN, "AnalyseFrame()", "camera<%s>: <%s> is smaller than background mesh",
+				state.cid.c_str(), state.filename.c_str());
+		return;
+	}
+
+	std::vector<float> fwhm;
+	fwhm.reserve(stars->size());
+	for (int i = 0; i < stars->size(); ++i) {
+		if (!stars->flags[i]) fwhm.push_back(stars->fwhm(i));
+	}
+	if (fwhm.size()) {
+		std::nth_element(fwhm.begin(), fwhm.begin() + fwhm.size() / 2, fwhm.end());
+		job->fwhm = fwhm[fwhm.size() / 2];
 	}
-	else {// 检查是否需要继续调焦并继续观测
-		int tar = focuser_next();
-		if (tar == VALID_FOCUS) {
-			state.mode = MODE_INIT;
-			PrintXY(1, LINE_ERROR, "exposure is over");
+	job->stars = stars;
+	if (param.shape_grid > 0) {
+		shape_summary(*stars, param.shape_grid, nfcam.roi.xstart - 1, nfcam.roi.ystart - 1,
+				nfcam.roi.xbin, nfcam.roi.ybin, nfcam.wsensor, nfcam.hsensor, job->shape, job->shapeall);
+	}
+	nfcam.trace.finish(TS_ANALYSE, t0);
+	NotifyEvent("stars %s %d %d %.2f", state.cid.c_str(), state.frmno, stars->size(), job->fwhm);
+
+	if (job->gate.use_count()) {
+		frame_quality &q = job->quality;
+		std::string text;
+		job->gate->Check(*stars, bkg.GlobalBack(), bkg.GlobalRms(), q);
+		quality_text(q.flags, text);
+		if (q.flags) {
+			gLog.Write(LOG_WARN, "AnalyseFrame()", "camera<%s>: <%s> rejected<%s>: stars=%d flux=%.2f saturated=%.2f "
+					"ellipticity=%+.3f background=%+.1f", state.cid.c_str(), state.filename.c_str(), text.c_str(),
+					q.nstar, q.fluxratio, q.satfrac, q.dellip, q.bkgjump);
 		}
-		else {
-			set_focus_target(tar);
-			state.frmno = 0;
+		NotifyEvent("quality %s %d %d %s %d %.2f %.2f %.3f %.1f", state.cid.c_str(), state.frmno, q.flags, text.c_str(),
+				q.nstar, q.fluxratio, q.satfrac, q.dellip, q.bkgjump);
+	}
+
+	if (job->shape.size()) {
+		std::string text;
+		char item[40];
+		for (int i = 0; i < int(job->shape.size()); ++i) {
+			if (!job->shape[i].n) text += " -";
+			else {
+				sprintf(item, " %.3f/%.0f", job->shape[i].ellip, job->shape[i].theta);
+				text += item;
+			}
 		}
+		NotifyEvent("shape %s %d %d %.3f %.0f%s", state.cid.c_str(), state.frmno, param.shape_grid,
+				job->shapeall.ellip, job->shapeall.theta, text.c_str());
 	}
 
-	mutex_lock lck(mtxcur);
-	MovetoXY(curpos, LINE_INPUT);
-	ShowCursor(true);
-	UpdateScreen();
+	int model = psf_model_code(param.psf_model);
+	if (model != PSF_NONE) {
+		PsfFitter fitter(model, param.psf_stamp, param.psf_maxstar, param.bkg_thread);
+		boost::shared_ptr<psf_catalog> psf = boost::make_shared<psf_catalog>();
+		int n = fitter.Fit(data, width, height, *stars, *psf);
+		if (n) {
+			fwhm = psf->fwhm;
+			std::nth_element(fwhm.begin(), fwhm.begin() + n / 2, fwhm.end());
+			job->psffwhm = fwhm[n / 2];
+			if (model == PSF_MOFFAT) {
+				fwhm = psf->beta;
+				std::nth_element(fwhm.begin(), fwhm.begin() + n / 2, fwhm.end());
+				job->psfbeta = fwhm[n / 2];
+			}
+		}
+		job->psf = psf;
+		NotifyEvent("psf %s %d %d %.2f %.2f", state.cid.c_str(), state.frmno, n, job->psffwhm, job->psfbeta);
+	}
 }
 
 /*!
- * @brief 中止曝光
+ * @brief 将一帧星像计入焦面统计, 更新倾斜与场曲估计
+ * @param job 已提取星像的图像
+ * @note
+ * - 每帧更新后广播"tilt <相机> <区域数> <中心焦点> <X倾斜> <Y倾斜> <场曲> <四角调整量>",
+ *   调整量顺序为左上、右上、右下、左下
+ * - 子窗口图像仅计入其覆盖的区域
+ * - 已拟合PSF时采用拟合半高全宽
  */
-void ExposeAbort() {
-	state.mode = MODE_INIT;
-	ShowCursor(false);
-	ClearError();
-	PrintXY(1, LINE_STATUS, "exposure is aborted. %s", camera->GetCameraInfo()->errmsg.c_str());
+void UpdateTilt(jobptr job) {
+	systate &state = job->state;
+	ROI &roi = job->nfcam.roi;
+	tilt_fit fit;
+	int n;
 
-	mutex_lock lck(mtxcur);
-	MovetoXY(curpos, LINE_INPUT);
-	ShowCursor(true);
-	UpdateScreen();
+	if (job->psf.use_count())
+		n = job->plane->AddFrame(job->posAct, *job->psf, roi.xstart - 1, roi.ystart - 1, roi.xbin, roi.ybin);
+	else
+		n = job->plane->AddFrame(job->posAct, *job->stars, roi.xstart - 1, roi.ystart - 1, roi.xbin, roi.ybin);
+	if (!n || !job->plane->Solve(fit)) return;
+	gLog.Write("camera<%s>: focal plane<%d regions> focus=%.1f tilt=[%.1f, %.1f] curvature=%.1f "
+			"corner=[%.1f, %.1f, %.1f, %.1f] rms=%.1f", state.cid.c_str(), fit.nregion,
+			fit.focus, fit.tiltx, fit.tilty, fit.curvature,
+			fit.corner[0], fit.corner[1], fit.corner[2], fit.corner[3], fit.rms);
+	PrintStatus("camera<%s>: tilt [%.1f, %.1f] shim [%.1f, %.1f, %.1f, %.1f] curvature %.1f",
+			state.cid.c_str(), fit.tiltx, fit.tilty,
+			fit.corner[0], fit.corner[1], fit.corner[2], fit.corner[3], fit.curvature);
+	NotifyEvent("tilt %s %d %.1f %.2f %.2f %.2f %.2f %.2f %.2f %.2f", state.cid.c_str(), fit.nregion,
+			fit.focus, fit.tiltx, fit.tilty, fit.curvature,
+			fit.corner[0], fit.corner[1], fit.corner[2], fit.corner[3]);
 }
 
 /*!
- * @brief 曝光失败
+ * @brief 存储一帧图像, 并生成缩略图、上传与显示
+ * @param job     待存储图像
+ * @param bufsave 转换缓冲区
+ * @param bufcal  定标缓冲区
+ * @param preview 缩略图接口. 可为空
  */
-void ExposeFail() {
-	state.mode = MODE_INIT;
-	ShowCursor(false);
-	PrintXY(1, LINE_ERROR, "exposure fail. %s",
-			camera->GetCameraInfo()->errmsg.c_str());
+void WriteFrame(jobptr job, uint16_t *bufsave, std::vector<uint16_t> &bufcal, const boost::shared_ptr<ImagePreview> &preview) {
+	systate &state = job->state;
+	frame_trace &trace = job->nfcam.trace;
+	int64_t t0;
+
+	if (!job->nfcam.data) {// 丢失的图像: 仅计入合并
+		if (job->master.use_count()) CombineFrame(job, bufsave);
+		return;
+	}
+	if (preview.use_count()) {// 缩略图与FITS文件存储并行. 二者只读图像数据
+		preview->Generate((const uint16_t*) job->nfcam.data.get(),
+				job->nfcam.roi.get_width(), job->nfcam.roi.get_height(), state.filepath);
+	}
+	if (display.unique() && job->unit->index == unitsel) {// 先于存储投递显示, 耗时写入FITS头
+		t0 = trace_now();
+		DisplayImage(job);
+		trace.finish(TS_DISPLAY, t0);
+	}
+	if (param.detect && (state.imgtype == IMGTYPE_OBJECT || state.imgtype == IMGTYPE_FOCUS))
+		AnalyseFrame(job, bufcal); // 先于存储, 结果写入FITS头
+	if (job->gate.use_count() && param.quality_retake > 0 && state.mode == MODE_AUTO)
+		PostMessage(MSG_ENCODE(job->quality.flags ? 8 : 7, job->unit->index)); // 未检查视为未通过
+	if (job->plane.use_count() && job->stars.use_count() && job->posAct != VALID_FOCUS
+			&& job->quality.flags <= 0) // 未通过质量检查的图像不计入V曲线
+		UpdateTilt(job);
+	if (!SaveFITSFile(job, bufsave)) {
+		PrintError("camera<%s>: failed to save %s", state.cid.c_str(), state.filename.c_str());
+		mutex_lock lck(mtxcur);
+		MovetoXY(curpos, LINE_INPUT);
+		UpdateScreen();
+	}
+	else if (job->upload && ftcli.unique()) {
+		t0 = trace_now();
+		UploadFile(job);
+		trace.finish(TS_UPLOAD, t0);
+	}
+	if (job->master.use_count()) CombineFrame(job, bufsave);
+	if (preview.use_count() && !preview->Wait())
+		gLog.Write(LOG_WARN, "WriteFrame()", "Fail to create preview for <%s>", state.filename.c_str());
+}
 
-	mutex_lock lck(mtxcur);
-	MovetoXY(curpos, LINE_INPUT);
-	ShowCursor(true);
-	UpdateScreen();
+/*!
+ * @brief 线程: 存储图像
+ * @note
+ * 每个线程独立持有转换缓冲区、定标缓冲区与缩略图接口
+ */
+void ThreadWriter() {
+	boost::shared_array<uint8_t> bufmem;
+	uint16_t *bufsave;
+	std::vector<uint16_t> bufcal;
+	boost::shared_ptr<ImagePreview> preview;
+	jobptr job;
+
+	if (!pin_thread(pthread_self(), param.cpu_writer))
+		gLog.Write(LOG_WARN, "ThreadWriter()", "Fail to pin writer thread to CPU <%s>", param.cpu_writer.c_str());
+	bufmem  = numamem_alloc(fits_chunk * sizeof(uint16_t)); // 绑定CPU后分配, 位于本地节点
+	bufsave = (uint16_t*) bufmem.get();
+
+	if (param.preview) {
+		preview = boost::make_shared<ImagePreview>();
+		preview->SetBinning(param.preview_bin);
+		preview->Start();
+	}
+
+	while (true) {
+		{
+			mutex_lock lck(mtxjob);
+			while (jobs.empty()) cvjob.wait(lck);
+			job = jobs.front();
+			jobs.pop_front();
+			++nwriting;
+		}
+
+		WriteFrame(job, bufsave, bufcal, preview);
+		job->unit->pool->Recycle(job->nfcam.data);
+		job.reset();
+
+		{
+			mutex_lock lck(mtxjob);
+			--nwriting;
+		}
+		cvjob.notify_all();
+	}
 }
 
-/*==========================================================================*/
-/// 消息队列
 /*!
- * @消息类型:
- * 0 - 结束消息队列相关线程
- * 1 - 收到调焦信息
- * 2 - 调焦网络远程主机断开连接
- * 3 - 焦点到位
- * 4 - 焦点长时间不能到达位置
- *
+ * @brief 投递待存储图像
+ * @param job 待存储图像
  */
+void PostFrame(jobptr job) {
+	{
+		mutex_lock lck(mtxjob);
+		jobs.push_back(job);
+	}
+	cvjob.notify_all();
+}
+
 /*!
- * @brief 线程, 消息机制工作逻辑
+ * @brief 启动存储线程池
  */
-void ThreadMessageQueue() {
-	long msg;
-	msgque::size_type recvd_size;
-	msgque::size_type msg_size = sizeof(long);
-	unsigned int priority;
-	long pos;
+void StartWriter() {
+	for (int i = 0; i < param.writer_thread; ++i)
+		thrdwriter.create_thread(&ThreadWriter);
+}
 
-	do {
-		queue->receive((void*) &msg, msg_size, recvd_size, priority);
-		switch(msg) {
-		case 1:// 收到调焦信息
-			ResolveFocus();
-			break;
-		case 2:// 调焦远程主机断开网络连接
-			focus.tcp.reset();
-			ShowCursor(false);
-			if (state.mode == MODE_AUTO) {
-				PrintXY(1, LINE_ERROR, "stroke sequence will be interrupted after this position over");
-				state.mode = MODE_MANUAL;
-			}
-			PrintXY(1, LINE_FOCUS, "focuser is off-line due to remote broken");
-			{
-				mutex_lock lck(mtxcur);
-				MovetoXY(curpos, LINE_INPUT);
-				ShowCursor(true);
-				UpdateScreen();
-			}
-			break;
-		case 3:// 焦点到位
+/*!
+ * @brief 完成已投递图像的存储后, 停止存储线程池
+ */
+void StopWriter() {
+	{
+		mutex_lock lck(mtxjob);
+		while (!jobs.empty() || nwriting) cvjob.wait(lck);
+	}
+	thrdwriter.interrupt_all();
+	thrdwriter.join_all();
+}
+/*==========================================================================*/
+/*!
+ * @brief 在全幅图像中选择包含亮星最多的子窗口
+ * @param data   图像数据
+ * @param width  图像宽度
+ * @param height 图像高度
+ * @param size   子窗口边长, 量纲: 像素
+ * @param x0     子窗口左上角X坐标, 起始为1
+ * @param y0     子窗口左上角Y坐标, 起始为1
+ * @return
+ * 找到亮星时返回true
+ * @note
+ * - 图像划分为32×32像素单元, 取各单元极大值. 极大值高于所在网格背景+5σ且未饱和的单元视为含亮星.
+ *   网格背景与噪声由BackgroundMesh估计, 不受渐晕影响
+ * - 以积分图统计各候选窗口内的亮星单元数, 数量相同时取最靠近图像中心者
+ */
+bool SelectSubWindow(const uint16_t *data, int width, int height, int size, int &x0, int &y0) {
+	const int cell(32);
+	int gw(width / cell), gh(height / cell), nw(size / cell);
+	if (nw < 1) nw = 1;
+	if (gw < nw || gh < nw) return false;
+
+	std::vector<uint16_t> peak(gw * gh, 0);
+	std::vector<int> sum((gw + 1) * (gh + 1), 0);
+	BackgroundMesh bkg(param.bkg_mesh, param.bkg_filter, param.bkg_thread);
+	int x, y, i, j, mx, my, nx, ny;
+
+	if (!bkg.Estimate(data, width, height)) return false;
+	bkg.MeshSize(nx, ny);
+
+	for (y = 0; y < gh * cell; ++y) {// 单元极大值
+		const uint16_t *row = data + size_t(y) * width;
+		uint16_t *pk = &peak[(y / cell) * gw];
+		for (x = 0; x < gw * cell; ++x) {
+			if (row[x] > pk[x / cell]) pk[x / cell] = row[x];
+		}
+	}
+	for (j = 0; j < gh; ++j) {// 亮星单元积分图
+		my = std::min((j * cell + cell / 2) / param.bkg_mesh, ny - 1);
+		for (i = 0; i < gw; ++i) {
+			mx = std::min((i * cell + cell / 2) / param.bkg_mesh, nx - 1);
+			float rms = std::max(bkg.MeshRms(mx, my), 1.0f);
+			int star = peak[j * gw + i] > bkg.MeshBack(mx, my) + 5.0f * rms && peak[j * gw + i] < param.saturate;
+			sum[(j + 1) * (gw + 1) + i + 1] = star + sum[j * (gw + 1) + i + 1]
+					+ sum[(j + 1) * (gw + 1) + i] - sum[j * (gw + 1) + i];
+		}
+	}
+
+	int best(0), bestd(INT_MAX), d, cnt;
+	for (j = 0; j + nw <= gh; ++j) {
+		for (i = 0; i + nw <= gw; ++i) {
+			cnt = sum[(j + nw) * (gw + 1) + i + nw] - sum[j * (gw + 1) + i + nw]
+				- sum[(j + nw) * (gw + 1) + i] + sum[j * (gw + 1) + i];
+			d = abs(2 * i + nw - gw) + abs(2 * j + nw - gh);
+			if (cnt > best || (cnt == best && cnt && d < bestd)) {
+				best  = cnt;
+				bestd = d;
+				x0 = i * cell + 1;
+				y0 = j * cell + 1;
+			}
+		}
+	}
+	return best > 0;
+}
+
+/*!
+ * @brief 自动调焦: 由首帧全幅图像选择亮星子窗口, 后续帧仅读出子窗口
+ * @param unit 相机工作单元
+ * @param job  首帧全幅图像
+ * @note
+ * 已加载合并图像时由定标后图像选择, 避免热像素被视为亮星
+ */
+void AutoSubWindow(unitptr unit, jobptr job) {
+	devcam_info &nfcam = job->nfcam;
+	ROI &roi = nfcam.roi;
+	int x0, y0, size(param.focus_window);
+	const uint16_t *data = (const uint16_t*) nfcam.data.get();
+	boost::shared_array<uint8_t> bufcal;
+
+	if (roi.xbin != 1 || roi.ybin != 1 || roi.width != nfcam.wsensor || roi.height != nfcam.hsensor)
+		return;
+	if (unit->calib.use_count() && unit->calib->IsValid()) {
+		bufcal = numamem_alloc(size_t(roi.width) * roi.height * sizeof(uint16_t));
+		if (unit->calib->Apply(data, roi, nfcam.eduration, (uint16_t*) bufcal.get()))
+			data = (const uint16_t*) bufcal.get();
+	}
+	if (!SelectSubWindow(data, roi.width, roi.height, size, x0, y0)) {
+		gLog.Write(LOG_WARN, "AutoSubWindow()", "camera<%s>: no bright star found, keep full frame",
+				unit->state.cid.c_str());
+	}
+	else {
+		unit->camera->SetROI(1, 1, x0, y0, size, size);
+		ROI &sub = unit->camera->GetCameraInfo()->roi;
+		gLog.Write("camera<%s>: sub-window [%d, %d] %d×%d", unit->state.cid.c_str(),
+				sub.xstart, sub.ystart, sub.width, sub.height);
+	}
+}
+
+/*!
+ * @brief 开始目标图像序列时创建质量检查. 各序列独立统计参考值
+ * @param unit 相机工作单元
+ */
+void CreateQualityGate(unitptr unit) {
+	if (param.detect && param.quality) {
+		quality_limit limit = { param.quality_minstar, param.quality_flux, param.quality_satfrac,
+				param.quality_ellip, param.quality_bkgjump };
+		unit->gate = boost::make_shared<QualityGate>(limit);
+	}
+	else unit->gate.reset();
+	unit->retake.reset();
+}
+
+/*!
+ * @brief 自动调焦: 移至下一焦点位置继续观测, 或结束流程
+ * @param unit 相机工作单元
+ */
+void NextPosition(unitptr unit) {
+	systate &state = unit->state;
+	int tar = focuser_next(unit);
+	if (tar == VALID_FOCUS) {
+		state.mode = MODE_INIT;
+		unit->plane.reset();
+		unit->gate.reset();
+		if (param.focus_window > 0) unit->camera->SetROI(); // 恢复全幅
+		PrintError("camera<%s>: exposure is over", state.cid.c_str());
+		NotifyEvent("idle %s", state.cid.c_str());
+	}
+	else {
+		set_focus_target(unit, tar);
+		state.frmno  = 0;
+		state.frmcnt = param.frmcnt; // 恢复重拍前的帧数
+		unit->retake.reset();
+	}
+}
+
+/*!
+ * @brief 自动调焦: 本位置各帧均已检查时, 在原位置重拍未通过的帧, 或移至下一焦点位置
+ * @param unit 相机工作单元
+ * @note
+ * 每个位置最多重拍param.quality_retake帧. 重拍帧同样参与检查
+ */
+void CheckRetake(unitptr unit) {
+	retake_count &rc = unit->retake;
+	systate &state = unit->state;
+	if (!rc.waiting || rc.checked < state.frmcnt) return;
+
+	int n = std::min(rc.rejected, param.quality_retake) - rc.retake;
+	rc.waiting = false;
+	if (n <= 0 || state.mode != MODE_AUTO) NextPosition(unit);
+	else {
+		rc.retake    += n;
+		state.frmcnt += n;
+		PrintStatus("camera<%s>: %d frame(s) rejected at focus %d, retake %d", state.cid.c_str(),
+				rc.rejected, unit->focus.posAct, n);
+		NotifyEvent("retake %s %d %d", state.cid.c_str(), unit->focus.posAct, n);
+		unit->camera->Expose(state.expdur, state.imgtype == IMGTYPE_OBJECT);
+	}
+}
+
+/*!
+ * @brief 积分结束, 开始读出
+ * @param unit 相机工作单元
+ * @note
+ * - 自动调焦时, 本位置末帧积分结束即移至下一位置, 调焦与读出、存储及分析并行
+ * - 到位时若末帧仍在读出, 则由ExposeComplete()开始曝光; 反之到位后由ResolveFocus()开始曝光
+ * - 启用重拍时须等待质量检查结果, 不提前移动
+ */
+void ReadoutBegin(unitptr unit) {
+	systate &state = unit->state;
+	focuser &focus = unit->focus;
+	if (state.mode != MODE_AUTO || state.frmno + 1 < state.frmcnt || focus.early
+			|| (unit->gate.use_count() && param.quality_retake > 0))
+		return;
+	int tar = focuser_next(unit);
+	if (tar == VALID_FOCUS) return;
+	focus.early   = true;
+	focus.arrived = false;
+	focus.posExp  = focus.posAct;
+	set_focus_target(unit, tar); // 已在目标位置时同样经由到位事件置位arrived
+}
+
+/*!
+ * @brief 曝光正确结束
+ * @param unit 相机工作单元
+ * @note
+ * 图像以缓冲池中的空闲缓冲区交换取出, 由存储线程池存储. 相机随即开始下一次曝光或调焦
+ * 读出期间已提前调焦时, 焦点位置取末帧曝光时的位置; 调焦器已到位则随即开始曝光
+ */
+void ExposeComplete(unitptr unit) {
+	systate &state = unit->state;
+	boost::shared_ptr<CameraBase> camera = unit->camera;
+	jobptr job = boost::make_shared<frame_job>();
+
+	ShowCursor(false);
+	++state.frmno;
+	CreateFilePath(unit);
+	job->unit   = unit;
+	job->state  = state;
+	job->nfcam  = *camera->GetCameraInfo();
+	job->nfcam.data = camera->SwapImage(unit->pool->Get());
+	job->posAct = unit->focus.early ? unit->focus.posExp : unit->focus.posAct;
+	job->upload = param.bfts && ftcli.unique() && state.mode == MODE_AUTO;
+	job->master = unit->master;
+	job->ncombine = 0;
+	job->badpix = unit->badpix;
+	job->fwhm   = -1.0f;
+	job->psffwhm = -1.0f;
+	job->psfbeta = -1.0f;
+	job->plane  = unit->plane;
+	job->gate   = unit->gate;
+	job->quality.flags = -1;
+	if (job->nfcam.data) {
+		PostFrame(job);
+		if (state.mode == MODE_AUTO && state.frmno == 1 && param.focus_window > 0) AutoSubWindow(unit, job);
+	}
+	else {
+		gLog.Write(LOG_FAULT, "ExposeComplete()", "camera<%s> is exposing, lost <%s>", state.cid.c_str(), state.filename.c_str());
+		if (job->master.use_count()) PostFrame(job); // 由存储线程计入合并, 避免末帧丢失时不生成合并图像
+		if (unit->gate.use_count() && param.quality_retake > 0) {// 丢失的图像视为未通过
+			++unit->retake.checked;
+			++unit->retake.rejected;
+		}
+	}
+
+	NotifyEvent("file %s %d %d %s", state.cid.c_str(), state.frmno, state.frmcnt, state.filepath.c_str());
+	PrintXY(1, LINE_STATUS, "camera<%s> file<%d/%d>: \033[93;49m\033[1m%s\033[0m",
+			state.cid.c_str(), state.frmno, state.frmcnt,
+			state.filepath.c_str());
+	if (unit->index == unitsel) PrintXY(1, LINE_EXPROCESS, "");
+
+	if (state.frmno < state.frmcnt) {// 继续曝光
+		if (state.mode != MODE_INIT)
+			camera->Expose(state.expdur, state.imgtype == IMGTYPE_OBJECT);
+		else {
+			ClearError();
+			PrintStatus("camera<%s>: exposure is aborted. %s", state.cid.c_str(),
+					camera->GetCameraInfo()->errmsg.c_str());
+			NotifyEvent("idle %s", state.cid.c_str());
+		}
+	}
+	else if (state.mode != MODE_AUTO) {
+		state.mode = MODE_INIT;
+		unit->master.reset();
+		unit->gate.reset();
+		unit->focus.early = unit->focus.arrived = false;
+		PrintError("camera<%s>: exposure is over", state.cid.c_str());
+		NotifyEvent("idle %s", state.cid.c_str());
+	}
+	else if (unit->focus.early) {// 读出期间已移至下一位置
+		bool arrived = unit->focus.arrived;
+		unit->focus.early = unit->focus.arrived = false;
+		state.frmno  = 0;
+		state.frmcnt = param.frmcnt;
+		unit->retake.reset();
+		if (arrived) camera->Expose(state.expdur, state.imgtype == IMGTYPE_OBJECT);
+	}
+	else if (unit->gate.use_count() && param.quality_retake > 0) {// 等待本位置各帧的质量检查结果
+		unit->retake.waiting = true;
+		CheckRetake(unit);
+	}
+	else NextPosition(unit);
+
+	mutex_lock lck(mtxcur);
+	MovetoXY(curpos, LINE_INPUT);
+	ShowCursor(true);
+	UpdateScreen();
+}
+
+/*!
+ * @brief 自动调焦: 收到一帧质量检查结果
+ * @param unit     相机工作单元
+ * @param rejected 未通过检查
+ */
+void QualityChecked(unitptr unit, bool rejected) {
+	if (unit->state.mode == MODE_INIT || !unit->gate.use_count()) return;
+	++unit->retake.checked;
+	if (rejected) ++unit->retake.rejected;
+	if (!unit->retake.waiting) return;
+
+	ShowCursor(false);
+	CheckRetake(unit);
+	mutex_lock lck(mtxcur);
+	MovetoXY(curpos, LINE_INPUT);
+	ShowCursor(true);
+	UpdateScreen();
+}
+
+/*!
+ * @brief 中止曝光
+ * @param unit 相机工作单元
+ */
+void ExposeAbort(unitptr unit) {
+	unit->state.mode = MODE_INIT;
+	unit->focus.early = unit->focus.arrived = false;
+	unit->master.reset();
+	unit->plane.reset();
+	unit->gate.reset();
+	unit->retake.reset();
+	ShowCursor(false);
+	ClearError();
+	PrintStatus("camera<%s>: exposure is aborted. %s", unit->state.cid.c_str(),
+			unit->camera->GetCameraInfo()->errmsg.c_str());
+	NotifyEvent("idle %s", unit->state.cid.c_str());
+
+	mutex_lock lck(mtxcur);
+	MovetoXY(curpos, LINE_INPUT);
+	ShowCursor(true);
+	UpdateScreen();
+}
+
+/*!
+ * @brief 曝光失败
+ * @param unit 相机工作单元
+ */
+void ExposeFail(unitptr unit) {
+	unit->state.mode = MODE_INIT;
+	unit->focus.early = unit->focus.arrived = false;
+	unit->master.reset();
+	unit->plane.reset();
+	unit->gate.reset();
+	unit->retake.reset();
+	ShowCursor(false);
+	PrintError("camera<%s>: exposure fail. %s", unit->state.cid.c_str(),
+			unit->camera->GetCameraInfo()->errmsg.c_str());
+	NotifyEvent("idle %s", unit->state.cid.c_str());
+
+	mutex_lock lck(mtxcur);
+	MovetoXY(curpos, LINE_INPUT);
+	ShowCursor(true);
+	UpdateScreen();
+}
+
+/*==========================================================================*/
+/// 消息队列
+/*!
+ * @消息类型:
+ * 0 - 结束消息队列相关线程
+ * 1 - 收到调焦信息
+ * 2 - 调焦网络远程主机断开连接
+ * 3 - 焦点到位
+ * 4 - 曝光正确结束
+ * 5 - 曝光失败
+ * 6 - 中止曝光
+ * 7 - 图像质量检查通过
+ * 8 - 图像质量检查未通过
+ * 9 - 积分结束, 开始读出
+ * 消息4-9由MSG_ENCODE()编码相机索引
+ */
+/*!
+ * @brief 线程, 消息机制工作逻辑
+ */
+void ThreadMessageQueue() {
+	long msg;
+	msgque::size_type recvd_size;
+	msgque::size_type msg_size = sizeof(long);
+	unsigned int priority;
+	unitptr unit;
+	int index;
+
+	do {
+		queue->receive((void*) &msg, msg_size, recvd_size, priority);
+		if ((index = MSG_INDEX(msg)) > 0 && index <= MAX_CAMERA) unit = get_unit(index);
+		else unit.reset();
+
+		switch(MSG_ID(msg)) {
+		case 1:// 调焦器事件
+			ResolveFocus();
+			break;
+		case 3:// 焦点到位
 			break;
 		case 4:// 曝光正确结束
-			ExposeComplete();
+			if (unit.use_count()) ExposeComplete(unit);
 			break;
 		case 5:// 曝光失败
-			ExposeFail();
+			if (unit.use_count()) ExposeFail(unit);
 			break;
 		case 6:// 中止曝光
-			ExposeAbort();
+			if (unit.use_count()) ExposeAbort(unit);
+			break;
+		case 7:// 图像质量检查通过
+		case 8:// 图像质量检查未通过
+			if (unit.use_count()) QualityChecked(unit, MSG_ID(msg) == 8);
+			break;
+		case 9:// 积分结束, 开始读出
+			if (unit.use_count()) ReadoutBegin(unit);
 			break;
 		default:
 			break;
 		}
 	}while(msg != 0);
+	unit.reset();
 }
 
 void SendMessage(const long msg) {// 投递高优先级消息
@@ -745,261 +1634,770 @@ void StopMessageQueue() {
 	if (queue.unique()) msgque::remove("msg_focaes");
 }
 /*==========================================================================*/
-//////////////////////////////////////////////////////////////////////////////
-int MainBody() {// 主工作流程
-	char input[100], command[100], ch;
+/// 用户指令
+/*!
+ * @brief 执行一条用户指令
+ * @param input 指令
+ * @return
+ * false: 退出程序; true: 继续
+ * @note
+ * 控制台与控制网络连接共用该指令集
+ */
+bool ProcessCommand(const char *input) {
+	char command[100];
 	char *token;
 	char seps[] = " ,;\t";
-	int pos(0), n;
+	unitptr unit = get_unit(unitsel);	// 当前相机
+
+	strncpy(command, input, sizeof(command) - 1);
+	command[sizeof(command) - 1] = 0;
+	if ((token = strtok(command, seps)) == NULL) return true; // 第一个token为关键字或者其它...
+	if (!(strcmp(input, "Q") && strcasecmp(input, "quit"))) return false;
+
+	if (!strcasecmp(token, "on")) {// 尝试连接相机
+		// 依据参数选择待连接相机
+		boost::shared_ptr<CameraBase> camera;
+		std::string termtype;
+		boost::format fmt("%03d");
+		int cid, index(0);
+
+		if ((token = strtok(NULL, seps)) != NULL && strstr(token, ".") != NULL) {// GWAC/ GY CCD
+			using boost::asio::ip::address_v4;
+			std::string camip = token;
+			address_v4 addr = address_v4::from_string(camip.c_str());
+			fmt % (addr.to_ulong() % 256);
+			index = int(addr.to_ulong() % 10);
+			termtype = "JFoV";
+			if (index >= 1 && index <= MAX_CAMERA && !get_unit(index).use_count()) {// 各相机采用不同本地数据端口
+				boost::shared_ptr<CameraGY> ccd = boost::make_shared<CameraGY>(camip, PORT_LOCAL + index - 1);
+				camera = boost::static_pointer_cast<CameraBase>(ccd);
+				ccd->EnableHardwareROI(param.gy_roi);
+				if (!ccd->PinReceiveThread(param.cpu_receive))
+					gLog.Write(LOG_WARN, "", "Fail to pin receive thread of camera<%s> to CPU <%s>",
+							camip.c_str(), param.cpu_receive.c_str());
+			}
+		}
+		else if (token == NULL || (cid = atoi(token)) == 5) {// U9000
+			fmt % (atoi(param.unitid.c_str()) * 10 + 5); // 相机编号编码格式1
+			index = 5;
+			termtype = "FFoV";
+			if (!get_unit(index).use_count()) {
+				boost::shared_ptr<CameraApogee> ccd = boost::make_shared<CameraApogee>();
+				camera = boost::static_pointer_cast<CameraBase>(ccd);
+			}
+		}
+		else if (cid >= 1 && cid <= 4){// CMOS: Dhyana 4040
+			fmt % (atoi(param.unitid.c_str()) * 10 + cid); // 相机编号编码格式1
+			index = cid;
+			termtype = "JFoV";
+			if (!get_unit(index).use_count()) {
+				boost::shared_ptr<CameraTucam> ccd = boost::make_shared<CameraTucam>(-1, param.tucam_stream ? param.tucam_ring : 0);
+				camera = boost::static_pointer_cast<CameraBase>(ccd);
+			}
+		}
 
-//////////////////////////////////////////////////////////////////////////////
-// 准备工作环境
-	param.LoadFile(gConfigPath);
-	if (!StartServerFocus()) {
-		gLog1.Write(LOG_FAULT, "", "Failed to create TCP server for focuser");
-		return -1;
-	}
+		if (index < 1 || index > MAX_CAMERA)
+			PrintError("camera index should be in [1, %d]", MAX_CAMERA);
+		else if (get_unit(index).use_count())
+			PrintError("camera<%d> had connected", index);
+		else if (camera->Connect()) {
+			boost::shared_ptr<devcam_info> nfcam = camera->GetCameraInfo();
+			unit = boost::make_shared<camunit>(index);
+			unit->camera = camera;
+			unit->pool   = boost::make_shared<FramePool>(size_t(nfcam->wsensor) * nfcam->hsensor * sizeof(uint16_t),
+					param.frame_depth);
+			unit->state.cid = fmt.str();
+			unit->state.termtype = termtype;
+			if (!param.calib_path.empty()) {
+				unit->calib = boost::make_shared<Calibrator>();
+				if (!unit->calib->Load(param.calib_path, unit->state.cid)) {// 保留接口, 供生成坏像素表后使用
+					gLog.Write(LOG_WARN, "", "no master frame or bad pixel mask for camera<%s> in <%s>",
+							unit->state.cid.c_str(), param.calib_path.c_str());
+				}
+			}
+			const ExposeProcess::slot_type& slot = boost::bind(&ExposeProcessCB, index, _1, _2, _3);
+			camera->register_expose(slot);
+			set_unit(index, unit);
+			unitsel = index;
 
-	if (!StartMessageQueue()) {
-		gLog1.Write(LOG_FAULT, "", "Failed to create message queue");
-		return -2;
+			PrintStatus("camera<%s> connected", unit->state.cid.c_str());
+			ClearError();
+			if (param.bfts && ftcli.unique()) {
+				ftcli->SetDeviceID(param.grpid, param.unitid, unit->state.cid);
+			}
+		}
+		else {
+			PrintError("failed to connect camera: %s", camera->GetCameraInfo()->errmsg.c_str());
+		}
 	}
-	mntproto = boost::make_shared<mount_proto>();
-	if (param.display) system("ds9&");
-	if (param.bfts) {
-		ftcli = boost::make_shared<FileTransferClient>();
-		ftcli->SetHost(param.ipfts, param.portfts);
-		ftcli->Start();
+	else if (!strcasecmp(token, "cam")) {// 选择当前相机
+		int index;
+		if ((token = strtok(NULL, seps)) == NULL)
+			PrintError("camera index is required");
+		else if ((index = atoi(token)) < 1 || index > MAX_CAMERA || !(unit = get_unit(index)).use_count())
+			PrintError("camera<%d> is off-line", index);
+		else {
+			unitsel = index;
+			PrintStatus("camera<%s> selected", unit->state.cid.c_str());
+			ClearError();
+		}
 	}
-
-	ClearScreen();
-	PrintHelp();
-	PrintServer();
-	PrintAutoParameter();
-	PrintInput();
-
-//////////////////////////////////////////////////////////////////////////////
-	while (1) {
-		if ((ch = getchar()) != '\r' && ch !='\n') {
-			input[pos++] = (char) ch;
-			mutex_lock lck(mtxcur);
-			++curpos;
-		}
-		else if (pos) {
-			input[pos] = 0;
-			pos = 0;
-			strcpy(command, input);
-			token = strtok(command, seps); // 第一个token为关键字或者其它...
-
-			if (!(strcmp(input, "Q") && strcasecmp(input, "quit"))) break;
-
-			if (!strcasecmp(token, "on")) {// 尝试连接相机
-				if (camera.unique() && camera->IsConnected())
-					PrintXY(1, LINE_ERROR, "camera had connected");
-				else {// 依据参数选择待连接相机
-					std::string camid; // 相机标志
-					boost::format fmt("%03d");
-					int cid;
-
-					if ((token = strtok(NULL, seps)) != NULL && strstr(token, ".") != NULL) {// GWAC/ GY CCD
-						using boost::asio::ip::address_v4;
-						std::string camip = token;
-						address_v4 addr = address_v4::from_string(camip.c_str());
-						fmt % (addr.to_ulong() % 256);
-						state.cid = fmt.str();
-						state.termtype = "JFoV";
-						boost::shared_ptr<CameraGY> ccd = boost::make_shared<CameraGY>(camip);
-						camera = boost::static_pointer_cast<CameraGY>(ccd);
-					}
-					else if (token == NULL || (cid = atoi(token)) == 5) {// U9000
-						fmt % (atoi(param.unitid.c_str()) * 10 + 5); // 相机编号编码格式1
-						state.cid = fmt.str();
-						state.termtype = "FFoV";
-						boost::shared_ptr<CameraApogee> ccd = boost::make_shared<CameraApogee>();
-						camera = boost::static_pointer_cast<CameraBase>(ccd);
-					}
-					else if (cid >= 1 && cid <= 4){// CMOS: Dhyana 4040
-						fmt % (atoi(param.unitid.c_str()) * 10 + cid); // 相机编号编码格式1
-						state.cid = fmt.str();
-						state.termtype = "JFoV";
-						boost::shared_ptr<CameraTucam> ccd = boost::make_shared<CameraTucam>();
-						camera = boost::static_pointer_cast<CameraBase>(ccd);
-					}
-					if (camera.unique() && camera->Connect()) {
-						PrintXY(1, LINE_STATUS, "camera<%s> connected", state.cid.c_str());
-						ClearError();
-						const ExposeProcess::slot_type& slot = boost::bind(&ExposeProcessCB, _1, _2, _3);
-						camera->register_expose(slot);
-
-						if (param.bfts && ftcli.unique()) {
-							ftcli->SetDeviceID(param.grpid, param.unitid, state.cid);
-						}
-					}
-					else {
-						PrintXY(1, LINE_ERROR, "failed to connect camera: %s", camera->GetCameraInfo()->errmsg.c_str());
-						camera.reset();
-						state.reset();
-					}
-				}
+	else if (!strcasecmp(token, "off")) {// 尝试断开相机
+		if (!unit_online(unit))
+			PrintError("camera is off-line");
+		else if (unit->state.mode != MODE_INIT)
+			PrintError("camera being in exposure");
+		else {
+			unit->camera->Disconnect();
+			if (unit->camera->IsConnected())
+				PrintError("failed to disconnect camera");
+			else {
+				PrintStatus("camera<%s> disconnected", unit->state.cid.c_str());
+				ClearError();
+				set_unit(unitsel, unitptr());
+				unitsel = 0;
 			}
-			else if (!strcasecmp(token, "off")) {// 尝试断开相机
-				if (!camera.unique() || !camera->IsConnected())
-					PrintXY(1, LINE_ERROR, "camera is off-line");
-				else if (state.mode != MODE_INIT)
-					PrintXY(1, LINE_ERROR, "camera being in exposure");
-				else {
-					camera->Disconnect();
-					if (camera->IsConnected())
-						PrintXY(1, LINE_ERROR, "failed to disconnect camera");
-					else {
-						PrintXY(1, LINE_STATUS, "camera disconnected");
-						ClearError();
-						camera.reset();
-						state.reset();
-					}
-				}
+		}
+	}
+	else if (!strcasecmp(token, "reboot")) {// 重启相机
+		if (!unit_online(unit))
+			PrintError("camera is off-line");
+		else if (unit->camera->Reboot()) {
+			unit->camera->Disconnect();
+			if (unit->camera->IsConnected())
+				PrintError("failed to disconnect camera");
+			else {
+				PrintStatus("camera<%s> disconnected", unit->state.cid.c_str());
+				ClearError();
+				set_unit(unitsel, unitptr());
+				unitsel = 0;
 			}
-			else if (!strcasecmp(token, "reboot")) {// 重启相机
-				if (!camera.unique() || !camera->IsConnected())
-					PrintXY(1, LINE_ERROR, "camera is off-line");
-				else if (camera->Reboot()) {
-					camera->Disconnect();
-					if (camera->IsConnected())
-						PrintXY(1, LINE_ERROR, "failed to disconnect camera");
-					else {
-						PrintXY(1, LINE_STATUS, "camera disconnected");
-						ClearError();
-						camera.reset();
-						state.reset();
-					}
-				}
+		}
+	}
+	else if (!(strcasecmp(token, "G") && strcasecmp(token, "gain"))) {// 查看或改变增益
+		if (!unit_online(unit))
+			PrintError("camera is off-line");
+		else if (unit->state.mode != MODE_INIT)
+			PrintError("camera being in exposure");
+		else {
+			if ((token = strtok(NULL, seps)) != NULL) unit->camera->SetGain(uint32_t(atoi(token)));
+			PrintStatus("camera<%s>: gain = %d", unit->state.cid.c_str(),
+					unit->camera->GetCameraInfo()->gain);
+		}
+	}
+	else if (!strcasecmp(token, "roi")) {// 设置ROI区与合并因子. 无参数时恢复全幅
+		if (!unit_online(unit))
+			PrintError("camera is off-line");
+		else if (unit->state.mode != MODE_INIT)
+			PrintError("camera being in exposure");
+		else {
+			int val[] = {1, 1, 1, -1, -1}; // bin, xstart, ystart, width, height
+			for (int i = 0; i < 5 && (token = strtok(NULL, seps)) != NULL; ++i) val[i] = atoi(token);
+			unit->camera->SetROI(val[0], val[0], val[1], val[2], val[3], val[4]);
+			ROI &roi = unit->camera->GetCameraInfo()->roi;
+			PrintStatus("camera<%s>: bin = %d×%d, ROI = [%d, %d] %d×%d", unit->state.cid.c_str(),
+					roi.xbin, roi.ybin, roi.xstart, roi.ystart, roi.width, roi.height);
+		}
+	}
+	else if (!(strcasecmp(token, "b") && strcasecmp(token, "bias"))) {// 尝试拍摄本底
+		if (!unit_online(unit))
+			PrintError("camera is off-line");
+		else if (unit->state.mode != MODE_INIT)
+			PrintError("camera being in exposure");
+		else {
+			systate &state = unit->state;
+			int count = -1;
+			if ((token = strtok(NULL, seps)) != NULL) count = atoi(token);
+			state.mode = MODE_MANUAL;
+			state.set_exposure(IMGTYPE_BIAS, count);
+			PrintManualParameter(unit);
+			ClearError();
+			if (!unit->camera->Expose(state.expdur, false)) {
+				PrintError("%s", unit->camera->GetCameraInfo()->errmsg.c_str());
+				state.mode = MODE_INIT;
 			}
-			else if (!(strcasecmp(token, "G") && strcasecmp(token, "gain"))) {// 查看或改变增益
-				if (!camera.unique() || !camera->IsConnected())
-					PrintXY(1, LINE_ERROR, "camera is off-line");
-				else if (state.mode != MODE_INIT)
-					PrintXY(1, LINE_ERROR, "camera being in exposure");
-				else {
-					if ((token = strtok(NULL, seps)) != NULL) camera->SetGain(uint32_t(atoi(token)));
-					PrintXY(1, LINE_STATUS, "gain = %d", camera->GetCameraInfo()->gain);
-				}
+		}
+	}
+	else if (!(strcasecmp(token, "d") && strcasecmp(token, "dark"))) {// 尝试拍摄暗场
+		if (!unit_online(unit))
+			PrintError("camera is off-line");
+		else if (unit->state.mode != MODE_INIT)
+			PrintError("camera being in exposure");
+		else {
+			systate &state = unit->state;
+			int count = -1;
+			double expdur = -1.0;
+			if ((token = strtok(NULL, seps)) != NULL) expdur = atof(token);
+			if ((token = strtok(NULL, seps)) != NULL) count = atoi(token);
+			state.mode = MODE_MANUAL;
+			state.set_exposure(IMGTYPE_DARK, count, expdur);
+			PrintManualParameter(unit);
+			ClearError();
+			if (!unit->camera->Expose(state.expdur, false)) {
+				PrintError("%s", unit->camera->GetCameraInfo()->errmsg.c_str());
+				state.mode = MODE_INIT;
 			}
-			else if (!(strcasecmp(token, "b") && strcasecmp(token, "bias"))) {// 尝试拍摄本底
-				if (!camera.unique() || !camera->IsConnected())
-					PrintXY(1, LINE_ERROR, "camera is off-line");
-				else if (state.mode != MODE_INIT)
-					PrintXY(1, LINE_ERROR, "camera being in exposure");
-				else {
-					int count = -1;
-					if ((token = strtok(NULL, seps)) != NULL) count = atoi(token);
-					state.mode = MODE_MANUAL;
-					state.set_exposure(IMGTYPE_BIAS, count);
-					PrintManualParameter();
-					ClearError();
-					if (!camera->Expose(state.expdur, false)) {
-						PrintXY(1, LINE_ERROR, "%s", camera->GetCameraInfo()->errmsg.c_str());
-						state.mode = MODE_INIT;
-					}
-				}
+		}
+	}
+	else if (!strcasecmp(token, "master")) {// 拍摄本底/暗场并合并
+		char *type = strtok(NULL, seps);
+		bool bias = type != NULL && !strcasecmp(type, "bias");
+		bool badpix = type != NULL && !strcasecmp(type, "badpix");
+
+		if (!unit_online(unit))
+			PrintError("camera is off-line");
+		else if (unit->state.mode != MODE_INIT)
+			PrintError("camera being in exposure");
+		else if (!(bias || badpix) && (type == NULL || strcasecmp(type, "dark")))
+			PrintError("usage: master bias <count> | master dark|badpix <duration> <count>");
+		else if (badpix && param.calib_path.empty())
+			PrintError("Calibration.path is required for bad pixel mask");
+		else {
+			systate &state = unit->state;
+			ROI &roi = unit->camera->GetCameraInfo()->roi;
+			int count = -1;
+			double expdur = -1.0;
+			if (!bias && (token = strtok(NULL, seps)) != NULL) expdur = atof(token);
+			if ((token = strtok(NULL, seps)) != NULL) count = atoi(token);
+			state.mode = MODE_MANUAL;
+			state.set_exposure(bias ? IMGTYPE_BIAS : IMGTYPE_DARK, count, expdur);
+			unit->master = boost::make_shared<MasterCombine>(roi.get_width(), roi.get_height(), state.frmcnt);
+			unit->badpix = badpix;
+			PrintManualParameter(unit);
+			ClearError();
+			if (!unit->camera->Expose(state.expdur, false)) {
+				PrintError("%s", unit->camera->GetCameraInfo()->errmsg.c_str());
+				state.mode = MODE_INIT;
+				unit->master.reset();
 			}
-			else if (!(strcasecmp(token, "d") && strcasecmp(token, "dark"))) {// 尝试拍摄暗场
-				if (!camera.unique() || !camera->IsConnected())
-					PrintXY(1, LINE_ERROR, "camera is off-line");
-				else if (state.mode != MODE_INIT)
-					PrintXY(1, LINE_ERROR, "camera being in exposure");
-				else {
-					int count = -1;
-					double expdur = -1.0;
-					if ((token = strtok(NULL, seps)) != NULL) expdur = atof(token);
-					if ((token = strtok(NULL, seps)) != NULL) count = atoi(token);
-					state.mode = MODE_MANUAL;
-					state.set_exposure(IMGTYPE_DARK, count, expdur);
-					PrintManualParameter();
-					ClearError();
-					if (!camera->Expose(state.expdur, false)) {
-						PrintXY(1, LINE_ERROR, "%s", camera->GetCameraInfo()->errmsg.c_str());
-						state.mode = MODE_INIT;
-					}
+		}
+	}
+	else if (!strcasecmp(token, "f") || !strcasecmp(token, "focus")) {// 检查或改变调焦器位置
+		if (!focuser_online())
+			PrintError("focuser is off-line");
+		else if (!unit.use_count())
+			PrintError("camera_id is empty, camera is required to be on-line");
+		else if (unit->state.mode != MODE_INIT)
+			PrintError("camera being in exposure");
+		else if ((token = strtok(NULL, seps)) != NULL) {
+			if (unit->focus.posTar == VALID_FOCUS)
+				set_focus_target(unit, atoi(token));
+			else
+				set_focus_target(unit, atoi(token) + unit->focus.posTar);
+			ClearError();
+		}
+	}
+	else if (!strcasecmp(token, "r") || !strcasecmp(token, "reload")) {// 尝试重新加载配置参数
+		if (!units_idle()) PrintError("camera being in AUTO mode");
+		else {
+			param.LoadFile(gConfigPath);
+			focdev->SetTolerance(param.focuser_error);
+			focdev->SetBacklash(param.stroke_back);
+			PrintAutoParameter();
+			ClearError();
+		}
+	}
+	else if (!strcasecmp(token, "start")) {// 尝试启动观测流程: 所有在线且空闲的相机并行调焦
+		if (!focuser_online())
+			PrintError("focuser is off-line");
+		else {
+			int count(0);
+			PrintAutoParameter();
+			ClearError();
+			for (int i = 1; i <= MAX_CAMERA; ++i) {
+				if (!unit_online(unit = get_unit(i)) || unit->state.mode != MODE_INIT) continue;
+				systate &state = unit->state;
+				state.mode = MODE_AUTO;
+				state.set_exposure(IMGTYPE_OBJECT, param.frmcnt, param.expdur, "auto");
+				if (param.focus_window > 0) unit->camera->SetROI(); // 首帧全幅, 用于选择子窗口
+				if (param.detect && param.tilt_grid > 0) {// 每次流程重新统计焦面
+					devcam_info *nfcam = unit->camera->GetCameraInfo().get();
+					unit->plane = boost::make_shared<FocalPlane>(param.tilt_grid, nfcam->wsensor, nfcam->hsensor,
+							param.tilt_minstar);
 				}
+				else unit->plane.reset();
+				CreateQualityGate(unit);
+				set_focus_target(unit, param.stroke_start); // 顺序执行流程. 调焦器以行程方向逼近起点消齿隙
+				++count;
 			}
-			else if (!strcasecmp(token, "f") || !strcasecmp(token, "focus")) {// 检查或改变调焦器位置
-				if (!focus.tcp.use_count())
-					PrintXY(1, LINE_ERROR, "focuser is off-line");
-				else if (state.mode != MODE_INIT)
-					PrintXY(1, LINE_ERROR, "camera being in exposure");
-				else if (state.cid.empty())
-					PrintXY(1, LINE_ERROR, "camera_id is empty, camera is required to be on-line");
-				else if ((token = strtok(NULL, seps)) != NULL) {
-					if (focus.posTar == VALID_FOCUS)
-						set_focus_target(atoi(token));
-					else
-						set_focus_target(atoi(token) + focus.posTar);
-					ClearError();
-				}
+			if (!count) PrintError("no camera is on-line and idle");
+		}
+	}
+	else if (!strcasecmp(token, "stop")) {// 尝试中止观测流程
+		if (units_idle()) PrintError("system is idle");
+		else {// 中止观测流程
+			for (int i = 1; i <= MAX_CAMERA; ++i) {
+				if ((unit = get_unit(i)).use_count() && unit->state.mode != MODE_INIT
+						&& unit->camera->GetCameraInfo()->state >= CAMERA_EXPOSE)
+					unit->camera->AbortExpose();
 			}
-			else if (!strcasecmp(token, "r") || !strcasecmp(token, "reload")) {// 尝试重新加载配置参数
-				if (state.mode != MODE_INIT) PrintXY(1, LINE_ERROR, "camera being in AUTO mode");
-				else {
-					param.LoadFile(gConfigPath);
-					PrintAutoParameter();
-					ClearError();
-				}
+		}
+	}
+	else if (!strcasecmp(token, "info")) {// 查看调焦器与各相机工作状态
+		const char *modes[] = {"", "idle", "manual", "auto", "cal"};
+		char buff[TCP_BUFF_SIZE];
+		int n;
+
+		n = sprintf(buff, "focuser %s;", focuser_online() ? "on-line" : "off-line");
+		for (int i = 1; i <= MAX_CAMERA; ++i) {
+			if (!(unit = get_unit(i)).use_count()) continue;
+			systate &state = unit->state;
+			n += sprintf(buff + n, " camera<%s>%s %s %d/%d focus=%d;", state.cid.c_str(),
+					i == unitsel ? "*" : "", modes[state.mode], state.frmno < 0 ? 0 : state.frmno,
+					state.frmcnt < 0 ? 0 : state.frmcnt, unit->focus.posAct);
+		}
+		PrintStatus("%s", buff);
+	}
+	else if (!strcasecmp(token, "trace")) {// 各阶段耗时统计: 写入日志; reset: 清除
+		if ((token = strtok(NULL, seps)) != NULL && !strcasecmp(token, "reset")) {
+			trace_reset();
+			PrintStatus("latency statistics reset");
+		}
+		else {
+			std::vector<std::string> lines;
+			trace_dump(lines);
+			for (std::vector<std::string>::iterator it = lines.begin(); it != lines.end(); ++it) {
+				gLog.Write("%s", it->c_str());
+				NotifyEvent("trace %s", it->c_str());
 			}
-			else if (!strcasecmp(token, "start")) {// 尝试启动观测流程
-				if (!focus.tcp.use_count())
-					PrintXY(1, LINE_ERROR, "focuser is off-line");
-				else if (!camera.unique() || !camera->IsConnected())
-					PrintXY(1, LINE_ERROR, "camera is off-line");
-				else if (state.mode != MODE_INIT)
-					PrintXY(1, LINE_ERROR, "camera being in exposure");
-				else {
-					PrintAutoParameter();
-					ClearError();
-					state.mode = MODE_AUTO;
-					state.set_exposure(IMGTYPE_OBJECT, param.frmcnt, param.expdur, "auto");
-					if (!set_focus_target(param.stroke_start - param.stroke_back)) // 顺序执行流程. 多走一个间隔用于消齿隙
-						set_focus_target(param.stroke_start);
-				}
+			PrintStatus("latency statistics of %d stages written into log", int(lines.size()) - 1);
+		}
+	}
+	else {// 尝试拍摄目标图像
+		if (!unit_online(unit))
+			PrintError("camera is off-line");
+		else if (unit->state.mode != MODE_INIT)
+			PrintError("camera being in exposure");
+		else {
+			systate &state = unit->state;
+			std::string name = token;
+			int count(-1);
+			double expdur(-1.0);
+			if ((token = strtok(NULL, seps)) != NULL)
+				expdur = atof(token);
+			if ((token = strtok(NULL, seps)) != NULL)
+				count = atoi(token);
+			state.mode = MODE_MANUAL;
+			state.set_exposure(IMGTYPE_OBJECT, count, expdur, name);
+			CreateQualityGate(unit);
+			PrintManualParameter(unit);
+			ClearError();
+			if (!unit->camera->Expose(state.expdur, true)) {
+				PrintError("%s", unit->camera->GetCameraInfo()->errmsg.c_str());
+				state.mode = MODE_INIT;
 			}
-			else if (!strcasecmp(token, "stop")) {// 尝试中止观测流程
-				if (state.mode != MODE_INIT) {// 中止观测流程
-					if (camera->GetCameraInfo()->state >= CAMERA_EXPOSE)
-						camera->AbortExpose();
-				}
-				else PrintXY(1, LINE_ERROR, "system is idle");
+		}
+	}
+
+	return true;
+}
+
+/*==========================================================================*/
+/// 后台服务: 控制网络连接
+/*!
+ * @brief 处理控制网络连接收到的信息
+ * @param client 网络连接资源
+ * @param ec     错误代码
+ * @note
+ * 以换行符分割指令, 投递给主线程顺序执行
+ */
+void ReceiveControl(long client, long ec) {
+	char term[] = "\n";
+	int len = strlen(term);
+	int pos, toread;
+	char buff[TCP_BUFF_SIZE];
+	ctl_command cmd;
+
+	{
+		mutex_lock lck(mtxctl);
+		for (std::vector<tcpcptr>::iterator it = ctlclients.begin(); it != ctlclients.end(); ++it) {
+			if ((long) it->get() == client) {
+				cmd.client = *it;
+				break;
 			}
-			else {// 尝试拍摄目标图像
-				if (!camera.unique() || !camera->IsConnected())
-					PrintXY(1, LINE_ERROR, "camera is off-line");
-				else if (state.mode != MODE_INIT)
-					PrintXY(1, LINE_ERROR, "camera being in exposure");
-				else {
-					std::string name = token;
-					int count(-1);
-					double expdur(-1.0);
-					if ((token = strtok(NULL, seps)) != NULL)
-						expdur = atof(token);
-					if ((token = strtok(NULL, seps)) != NULL)
-						count = atoi(token);
-					state.mode = MODE_MANUAL;
-					state.set_exposure(IMGTYPE_OBJECT, count, expdur, name);
-					PrintManualParameter();
-					ClearError();
-					if (!camera->Expose(state.expdur, true)) {
-						PrintXY(1, LINE_ERROR, "%s", camera->GetCameraInfo()->errmsg.c_str());
-						state.mode = MODE_INIT;
-					}
-				}
+		}
+	}
+	if (!cmd.client.use_count()) return;
+	if (ec) {// 远程主机断开连接. 由NotifyEvent()或AcceptControl()移除
+		cmd.client->close();
+		return;
+	}
+
+	while (cmd.client->is_open() && (pos = cmd.client->lookup(term, len)) >= 0) {
+		if ((toread = pos + len) > TCP_BUFF_SIZE) {
+			cmd.client->close();
+			gLog.Write(LOG_WARN, "ReceiveControl()", "command length is over than threshold");
+		}
+		else {
+			cmd.client->read(buff, toread);
+			buff[pos] = 0;
+			if (pos > 0 && buff[pos - 1] == '\r') buff[pos - 1] = 0;
+			cmd.line = buff;
+			if (cmd.line.empty()) continue;
+			mutex_lock lck(mtxctl);
+			ctlcmds.push_back(cmd);
+			cvctl.notify_one();
+		}
+	}
+}
+
+/*!
+ * @brief 收到控制网络连接请求
+ * @param client 网络连接资源
+ * @param param  参数
+ */
+void AcceptControl(const tcpcptr& client, long) {
+	mutex_lock lck(mtxctl);
+	for (std::vector<tcpcptr>::iterator it = ctlclients.begin(); it != ctlclients.end(); ) {
+		if (!(*it)->is_open()) it = ctlclients.erase(it);
+		else ++it;
+	}
+	ctlclients.push_back(client);
+	const tcpc_cbtype& slot = boost::bind(&ReceiveControl, _1, _2);
+	client->register_receive(slot);
+	gLog.Write("control client connected. %d clients on-line", int(ctlclients.size()));
+}
+
+/*!
+ * @brief 启动控制网络服务
+ * @return
+ * 服务启动结果
+ */
+bool StartServerControl() {
+	const tcps_cbtype& slot = boost::bind(&AcceptControl, _1, _2);
+	tcpsctl = boost::make_shared<tcp_server>();
+	tcpsctl->register_accept(slot);
+	return tcpsctl->start(param.portCtl);
+}
+
+/*!
+ * @brief 响应SIGTERM/SIGINT, 退出后台服务
+ * @param signum 信号
+ */
+void QuitDaemon(int) {
+	ctlquit = 1;
+}
+
+/*!
+ * @brief 后台服务主循环: 顺序执行控制网络连接投递的指令
+ * @note
+ * 每条指令执行完毕后, 向投递指令的网络连接回复"ok <指令>"或"fail <指令>"
+ */
+void DaemonLoop() {
+	boost::posix_time::seconds period(1);
+	ctl_command cmd;
+	bool running(true);
+	int nerror;
+	char buff[TCP_BUFF_SIZE];
+
+	signal(SIGTERM, QuitDaemon);
+	signal(SIGINT,  QuitDaemon);
+	while (running && !ctlquit) {
+		{
+			mutex_lock lck(mtxctl);
+			if (ctlcmds.empty()) {
+				cvctl.timed_wait(lck, period);
+				continue;
+			}
+			cmd = ctlcmds.front();
+			ctlcmds.pop_front();
+		}
+
+		nerror  = cmderror;
+		running = ProcessCommand(cmd.line.c_str());
+		int n = snprintf(buff, TCP_BUFF_SIZE, "%s %s\n", cmderror == nerror ? "ok" : "fail", cmd.line.c_str());
+		if (n > TCP_BUFF_SIZE) n = TCP_BUFF_SIZE;
+		cmd.client->write(buff, n);
+		cmd.client.reset();
+	}
+	tcpsctl.reset();
+	mutex_lock lck(mtxctl);
+	ctlclients.clear();
+	ctlcmds.clear();
+}
+
+/*==========================================================================*/
+/// 网络: 运行指标
+/*!
+ * @brief 以Prometheus文本格式追加一项指标
+ * @param text   指标文本
+ * @param name   指标名称
+ * @param type   指标类型: counter或gauge
+ * @param help   说明
+ * @note
+ * 仅追加HELP与TYPE行, 样本行由AppendSample()追加
+ */
+void AppendMetric(std::string &text, const char *name, const char *type, const char *help) {
+	char buff[200];
+	sprintf(buff, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+	text += buff;
+}
+
+/*!
+ * @brief 追加一个样本
+ * @param text   指标文本
+ * @param name   指标名称, 可含后缀
+ * @param labels 标签, 格式: key="value"[,...]. 可为空
+ * @param value  样本值
+ */
+void AppendSample(std::string &text, const char *name, const char *labels, double value) {
+	char buff[200];
+	if (labels && labels[0]) sprintf(buff, "%s{%s} %.15g\n", name, labels, value);
+	else sprintf(buff, "%s %.15g\n", name, value);
+	text += buff;
+}
+
+/*!
+ * @brief 生成运行指标
+ * @param text 指标文本
+ * @note
+ * - 仅读取各模块原子计数, 不阻塞数据通路
+ * - 帧率等速率由采集端对计数器求导, 如rate(focaes_frames_total[1m])
+ */
+void FormatMetrics(std::string &text) {
+	struct cam_counter {
+		const char *name, *help;
+		uint64_t camera_stat::*field;
+	} cams[] = {
+		{"focaes_frames_total", "Frames read out from camera", &camera_stat::frames},
+		{"focaes_expose_failed_total", "Exposures ended without image", &camera_stat::failed},
+		{"focaes_packets_received_total", "Image packets received from network camera", &camera_stat::packrcv},
+		{"focaes_packets_retransmit_total", "Image packets requested for retransmission", &camera_stat::packreq},
+		{"focaes_packets_lost_total", "Image packets missing when readout ended", &camera_stat::packlost},
+		{"focaes_frames_skipped_total", "Frames overwritten in SDK ring before readout", &camera_stat::skipped}
+	};
+	unitptr unit;
+	boost::shared_ptr<FileTransferClient> ftc = ftcli;
+	trace_stat stat;
+	char labels[100], name[100];
+	int njob;
+
+	text.clear();
+	for (int j = 0; j < int(sizeof(cams) / sizeof(cam_counter)); ++j) {
+		AppendMetric(text, cams[j].name, "counter", cams[j].help);
+		for (int i = 1; i <= MAX_CAMERA; ++i) {
+			if (!(unit = get_unit(i)).use_count()) continue;
+			sprintf(labels, "camera=\"%s\"", unit->state.cid.c_str());
+			AppendSample(text, cams[j].name, labels, double(unit->camera->GetStatistics().*cams[j].field));
+		}
+	}
+
+	AppendMetric(text, "focaes_stage_latency_seconds", "summary", "Latency of exposure pipeline stages");
+	for (int i = 0; i < TS_LAST; ++i) {
+		trace_summary(i, stat);
+		sprintf(labels, "stage=\"%s\",quantile=\"0.5\"", trace_stage_name(i));
+		AppendSample(text, "focaes_stage_latency_seconds", labels, stat.p50 * 1E-6);
+		sprintf(labels, "stage=\"%s\",quantile=\"0.9\"", trace_stage_name(i));
+		AppendSample(text, "focaes_stage_latency_seconds", labels, stat.p90 * 1E-6);
+		sprintf(labels, "stage=\"%s\",quantile=\"0.99\"", trace_stage_name(i));
+		AppendSample(text, "focaes_stage_latency_seconds", labels, stat.p99 * 1E-6);
+		sprintf(labels, "stage=\"%s\"", trace_stage_name(i));
+		sprintf(name, "%s_sum", "focaes_stage_latency_seconds");
+		AppendSample(text, name, labels, stat.sum * 1E-6);
+		sprintf(name, "%s_count", "focaes_stage_latency_seconds");
+		AppendSample(text, name, labels, double(stat.count));
+	}
+
+	if (ftc.use_count()) {
+		AppendMetric(text, "focaes_upload_bytes_total", "counter", "Bytes sent to file server");
+		AppendSample(text, "focaes_upload_bytes_total", NULL, double(ftc->BytesSent()));
+		AppendMetric(text, "focaes_upload_files_total", "counter", "Files uploaded to file server");
+		AppendSample(text, "focaes_upload_files_total", NULL, double(ftc->FilesSent()));
+		AppendMetric(text, "focaes_upload_failed_total", "counter", "Failed file uploads");
+		AppendSample(text, "focaes_upload_failed_total", NULL, double(ftc->FilesFailed()));
+		AppendMetric(text, "focaes_upload_queue_depth", "gauge", "Files waiting for upload");
+		AppendSample(text, "focaes_upload_queue_depth", NULL, double(ftc->QueueDepth()));
+	}
+	{
+		mutex_lock lck(mtxjob);
+		njob = int(jobs.size()) + nwriting;
+	}
+	AppendMetric(text, "focaes_writer_queue_depth", "gauge", "Frames waiting for or being saved");
+	AppendSample(text, "focaes_writer_queue_depth", NULL, double(njob));
+	AppendMetric(text, "focaes_message_queue_depth", "gauge", "Messages pending in main message queue");
+	AppendSample(text, "focaes_message_queue_depth", NULL, queue.use_count() ? double(queue->get_num_msg()) : 0.0);
+	AppendMetric(text, "focaes_focuser_online", "gauge", "Focuser connection state");
+	AppendSample(text, "focaes_focuser_online", NULL, focuser_online() ? 1.0 : 0.0);
+	AppendMetric(text, "focaes_log_written_total", "counter", "Log entries written");
+	AppendSample(text, "focaes_log_written_total", NULL, double(gLog.Written()));
+	AppendMetric(text, "focaes_log_dropped_total", "counter", "Log entries dropped for invalid log file");
+	AppendSample(text, "focaes_log_dropped_total", NULL, double(gLog.Dropped()));
+}
+
+/*!
+ * @brief 处理运行指标网络连接收到的HTTP请求
+ * @param client 网络连接资源
+ * @param ec     错误代码
+ * @note
+ * 任意路径的GET请求均回复全部指标. 回复后由客户端关闭连接
+ */
+void ReceiveMetrics(long client, long ec) {
+	char term[] = "\r\n\r\n";	// 请求头结束标记
+	int len = strlen(term);
+	int pos, toread, n;
+	char buff[TCP_BUFF_SIZE];
+	std::string text;
+	tcpcptr cli;
+
+	{
+		mutex_lock lck(mtxmet);
+		for (std::vector<tcpcptr>::iterator it = metclients.begin(); it != metclients.end(); ++it) {
+			if ((long) it->get() == client) {
+				cli = *it;
+				break;
 			}
+		}
+	}
+	if (!cli.use_count()) return;
+	if (ec) {// 远程主机断开连接. 由AcceptMetrics()移除
+		cli->close();
+		return;
+	}
 
-			PrintInput();
+	while (cli->is_open() && (pos = cli->lookup(term, len)) >= 0) {
+		if ((toread = pos + len) > TCP_BUFF_SIZE) {
+			cli->close();
+			gLog.Write(LOG_WARN, "ReceiveMetrics()", "request length is over than threshold");
+			break;
+		}
+		cli->read(buff, toread);
+		if (strncmp(buff, "GET ", 4)) {
+			text = "bad request\n";
+			n = sprintf(buff, "HTTP/1.0 400 Bad Request\r\n");
+		}
+		else {
+			FormatMetrics(text);
+			n = sprintf(buff, "HTTP/1.0 200 OK\r\n");
 		}
+		n += sprintf(buff + n, "Content-Type: text/plain; version=0.0.4\r\nContent-Length: %d\r\nConnection: close\r\n\r\n",
+				int(text.size()));
+		if (cli->write(buff, n) != n || cli->write(text.c_str(), int(text.size())) != int(text.size()))
+			gLog.Write(LOG_WARN, "ReceiveMetrics()", "response is truncated by send buffer");
 	}
+}
 
+/*!
+ * @brief 收到运行指标网络连接请求
+ * @param client 网络连接资源
+ * @param param  参数
+ */
+void AcceptMetrics(const tcpcptr& client, long) {
+	mutex_lock lck(mtxmet);
+	for (std::vector<tcpcptr>::iterator it = metclients.begin(); it != metclients.end(); ) {
+		if (!(*it)->is_open()) it = metclients.erase(it);
+		else ++it;
+	}
+	metclients.push_back(client);
+	const tcpc_cbtype& slot = boost::bind(&ReceiveMetrics, _1, _2);
+	client->register_receive(slot);
+}
+
+/*!
+ * @brief 启动运行指标HTTP服务
+ * @return
+ * 服务启动结果
+ */
+bool StartServerMetrics() {
+	const tcps_cbtype& slot = boost::bind(&AcceptMetrics, _1, _2);
+	tcpsmet = boost::make_shared<tcp_server>();
+	tcpsmet->register_accept(slot);
+	return tcpsmet->start(param.portMetrics);
+}
+/*==========================================================================*/
+//////////////////////////////////////////////////////////////////////////////
+/*!
+ * @brief 主工作流程
+ * @param daemon 后台服务模式. 不使用控制台, 通过控制网络连接接收指令
+ * @return
+ * 退出代码
+ */
+int MainBody(bool daemon) {
+	char input[100], ch;
+	int pos(0);
+
+//////////////////////////////////////////////////////////////////////////////
+// 准备工作环境
+	daemon_mode = daemon;
+	thrdmain = boost::this_thread::get_id();
+	if (daemon_mode) EnableScreen(false);
+	param.LoadFile(gConfigPath);
+	numamem_setup(param.hugepage, param.numa_node, param.mem_lock);
+	if (!StartMessageQueue()) {
+		gLog1.Write(LOG_FAULT, "", "Failed to create message queue");
+		return -2;
+	}
+	if (!StartFocuser()) {
+		gLog1.Write(LOG_FAULT, "", "Failed to start focuser <%s>", param.focuser_driver.c_str());
+		StopMessageQueue();
+		return -1;
+	}
+	if (daemon_mode && !StartServerControl()) {
+		gLog1.Write(LOG_FAULT, "", "Failed to create TCP server for control");
+		StopMessageQueue();
+		return -3;
+	}
+	if (param.portMetrics > 0 && !StartServerMetrics()) {// 运行指标服务非必需
+		gLog.Write(LOG_WARN, "", "Failed to create HTTP server for metrics on port %d", param.portMetrics);
+		param.portMetrics = 0;
+	}
+	if (param.display) {
+		system("ds9&");
+		display = boost::make_shared<ImageDisplay>();
+		display->SetBinning(param.display_bin);
+		display->Start();
+	}
+	if (param.bfts) {
+		ftcli = boost::make_shared<FileTransferClient>();
+		ftcli->SetHost(param.ipfts, param.portfts);
+		ftcli->Start();
+	}
+	StartWriter();
+
+//////////////////////////////////////////////////////////////////////////////
+	if (daemon_mode) {
+		gLog.Write("focaes runs as daemon. control port = %d", param.portCtl);
+		DaemonLoop();
+	}
+	else {
+		ClearScreen();
+		PrintHelp();
+		PrintServer();
+		PrintAutoParameter();
+		PrintInput();
+
+		while (1) {
+			if ((ch = getchar()) != '\r' && ch !='\n') {
+				input[pos++] = (char) ch;
+				mutex_lock lck(mtxcur);
+				++curpos;
+			}
+			else if (pos) {
+				input[pos] = 0;
+				pos = 0;
+				if (!ProcessCommand(input)) break;
+
+				PrintInput();
+			}
+		}
+	}
+
+
+	focdev->Stop();
 	StopMessageQueue();
-	tcpsfoc.reset();
-	if (camera.unique() && camera->IsConnected()) camera->Disconnect();
+	StopWriter();
+	focdev.reset();
+	tcpsmet.reset();
+	{
+		mutex_lock lck(mtxmet);
+		metclients.clear();
+	}
+	for (int i = 1; i <= MAX_CAMERA; ++i) {
+		unitptr unit = get_unit(i);
+		if (unit_online(unit)) unit->camera->Disconnect();
+		set_unit(i, unitptr());
+	}
 	if (ftcli.unique()) ftcli->Stop();
+	if (display.unique()) display->Stop();
 
 	return 0;
 }
@@ -1011,12 +2409,17 @@ int main(int argc, char** argv) {
 		if (strcmp(argv[1], "-d") == 0) {
 			param.InitFile(gConfigPath);
 		}
+		else if (strcmp(argv[1], "-D") == 0) {// 后台服务模式
+			rslt = MainBody(true);
+		}
 		else {
-			printf("Usage: focaes <-d>\n");
+			printf("Usage: focaes <-d | -D>\n");
+			printf("  -d: create default configuration file\n");
+			printf("  -D: run as daemon, controlled through TCP port <PortControl>\n");
 		}
 	}
 	else {// 常规工作模式
-		rslt = MainBody();
+		rslt = MainBody(false);
 	}
 
 	return rslt;
@@ -0,0 +1,1242 @@
+/*
+ Name        : focaes_bench.cpp
+ Description : focaes热点路径性能测试
+ Date:         2026-10-18
+ Version     : 0.2
+ @note
+ - 不依赖相机等硬件, 采用合成数据与本机回环网络
+ - 用法: focaes_bench [-j] [-H] [-r 重复次数] [-d 临时目录] [测试项 ...]
+ @li -j: 每项结果输出为一行JSON, 便于跨版本比较
+ @li -H: 图像与包缓冲区采用2MB大页(numamem_alloc), 用于对比TLB开销
+ @li 未指定测试项时执行全部测试项
+ - 测试项:
+ @li swap      : 16位图像减BZERO与字节交换: 4k×4k, 标量/SSE2/AVX2, 原位与非原位
+ @li fits      : 存储4k×4k FITS文件: cfitsio逐像素写入与WriteFITSFile()
+ @li mountproto: mount_proto组装与解析focus协议
+ @li tcp       : tcp_client经本机回环接收并按换行符拆分协议
+ @li gy        : 模拟GY相机经本机回环UDP传输4k×4k图像, 含合成丢包与重传
+ @li glog      : GLog::Write()吞吐量, 单线程与多线程
+ @li zscale    : 缩略图统计与合并: ZScale()与bin_u16()
+ @li vecframe  : SDK读出至vector后转交图像缓冲区(U9000, 3056×3056): 复制与VectorFramePool直接转交
+ @li master    : 本底合并: 4k×4k逐帧累加(标量/SSE2/AVX2)与剔除极值求平均
+ @li calib     : 实时定标: 4k×4k扣除偏置暗流并除以平场, 替换坏像素(标量/SSE2/AVX2)
+ @li background: 4k×4k背景估计: 全幅中值与网格背景(单线程/多线程), 逐行插值
+ @li extract   : 4k×4k星像提取: 行带并行标记与连通(单线程/多线程), 不含背景估计;
+                 星像形状分量(标量/SSE2/AVX2)与3×3分区统计
+ @li psf       : 最亮64颗星像15×15子图的高斯与Moffat PSF拟合(标量/SSE2/AVX2, 单线程/多线程)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <algorithm>
+#include <boost/chrono.hpp>
+#include <boost/smart_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread.hpp>
+#include <cfitsio/fitsio.h>
+#include "GLog.h"
+#include "pixkernel.h"
+#include "fitswrite.h"
+#include "mountproto.h"
+#include "tcp_asio.h"
+#include "CameraGY.h"
+#include "ImagePreview.h"
+#include "FramePool.h"
+#include "numamem.h"
+#include "MasterCombine.h"
+#include "BackgroundMesh.h"
+#include "StarExtractor.h"
+#include "PsfFitter.h"
+
+typedef boost::chrono::steady_clock bench_clock;
+typedef boost::unique_lock<boost::mutex> mutex_lock;
+
+GLog gLog;
+GLog gLog1(stdout);
+
+bool json_output(false);	//< 输出JSON格式结果
+std::string tmpdir("/tmp");	//< 临时文件目录
+
+/*!
+ * @brief 输出一项耗时测试结果
+ * @param name    测试项
+ * @param variant 变体, 如指令集或线程数
+ * @param ms      耗时中值, 量纲: 毫秒
+ * @param rate    吞吐量
+ * @param unit    吞吐量单位
+ */
+void print_result(const char *name, const char *variant, double ms, double rate, const char *unit) {
+	if (json_output)
+		printf("{\"case\":\"%s\",\"variant\":\"%s\",\"median_ms\":%.4f,\"rate\":%.3f,\"unit\":\"%s\"}\n",
+				name, variant, ms, rate, unit);
+	else
+		printf("%-24s %-12s %10.3f ms %12.1f %s\n", name, variant, ms, rate, unit);
+}
+
+/*!
+ * @brief 输出一项计数测试结果
+ * @param name    测试项
+ * @param variant 变体
+ * @param value   计数
+ * @param unit    单位
+ */
+void print_value(const char *name, const char *variant, double value, const char *unit) {
+	if (json_output)
+		printf("{\"case\":\"%s\",\"variant\":\"%s\",\"value\":%.3f,\"unit\":\"%s\"}\n", name, variant, value, unit);
+	else
+		printf("%-24s %-12s %28.3f %s\n", name, variant, value, unit);
+}
+
+/*!
+ * @brief 执行一次测试项并记录耗时
+ * @return
+ * 耗时中值, 量纲: 毫秒
+ */
+template<class Func>
+double run_case(Func &func, int repeat) {
+	std::vector<double> dt;
+	for (int i = 0; i < repeat; ++i) {
+		bench_clock::time_point t0 = bench_clock::now();
+		func();
+		bench_clock::time_point t1 = bench_clock::now();
+		dt.push_back(boost::chrono::duration<double, boost::milli>(t1 - t0).count());
+	}
+	std::sort(dt.begin(), dt.end());
+	return dt[dt.size() / 2];
+}
+
+/*!
+ * @brief 生成合成图像: 本底+噪声+若干星像
+ */
+void synth_image(uint16_t *data, int width, int height) {
+	srand(1);
+	for (int i = 0, n = width * height; i < n; ++i) data[i] = uint16_t(1000 + rand() % 64);
+	for (int k = 0; k < 2000; ++k) {
+		int xc = 8 + rand() % (width - 16), yc = 8 + rand() % (height - 16);
+		double amp = 500 + rand() % 30000;
+		for (int y = -5; y <= 5; ++y) {
+			for (int x = -5; x <= 5; ++x) {
+				uint16_t &v = data[(yc + y) * width + xc + x];
+				double s = v + amp * exp(-(x * x + y * y) / 4.5);
+				v = s > 65535 ? 65535 : uint16_t(s);
+			}
+		}
+	}
+}
+/*==========================================================================*/
+/// 测试项: 字节交换
+/*!
+ * @brief cfitsio写入TUSHORT数据时的处理流程: 先减BZERO, 再逐像素交换字节
+ */
+void cfitsio_like(const uint16_t *src, uint16_t *dst, size_t n) {
+	short *sdst = (short*) dst;
+	for (size_t i = 0; i < n; ++i) sdst[i] = short(int(src[i]) - 32768);
+	for (size_t i = 0; i < n; ++i) {
+		uint16_t v = dst[i];
+		dst[i] = uint16_t((v << 8) | (v >> 8));
+	}
+}
+
+struct swap_case {// 非原位转换
+	const uint16_t *src;
+	uint16_t *dst;
+	size_t n;
+	bool reference;
+
+	void operator()() {
+		if (reference) cfitsio_like(src, dst, n);
+		else swap_offset_u16(src, dst, n);
+	}
+};
+
+struct swap_inplace_case {// 原位转换
+	uint16_t *data;
+	size_t n;
+
+	void operator()() {
+		swap_offset_u16(data, n);
+	}
+};
+
+void bench_swap(int repeat) {
+	const size_t w(4096), h(4096), n(w * h);
+	boost::shared_array<uint16_t> src(new uint16_t[n]);
+	boost::shared_array<uint16_t> dst(new uint16_t[n]);
+	boost::shared_array<uint16_t> ref(new uint16_t[n]);
+	int best = pixkernel_select(PIXISA_LAST);
+	double ms;
+
+	srand(1);
+	for (size_t i = 0; i < n; ++i) src[i] = uint16_t(rand() & 0xFFFF);
+
+	swap_case ref_case = { src.get(), ref.get(), n, true };
+	ms = run_case(ref_case, repeat);
+	print_result("swap_offset(cfitsio)", "scalar", ms, n * 2 / ms * 1E-3, "MB/s");
+
+	for (int isa = PIXISA_SCALAR; isa <= best; ++isa) {
+		pixkernel_select(isa);
+		swap_case one = { src.get(), dst.get(), n, false };
+		ms = run_case(one, repeat);
+		print_result("swap_offset", pixkernel_isa_name(isa), ms, n * 2 / ms * 1E-3, "MB/s");
+		if (memcmp(dst.get(), ref.get(), n * 2))
+			fprintf(stderr, "!! %s result differs from reference\n", pixkernel_isa_name(isa));
+
+		swap_inplace_case two = { dst.get(), n };
+		ms = run_case(two, repeat);
+		print_result("swap_offset(in-place)", pixkernel_isa_name(isa), ms, n * 2 / ms * 1E-3, "MB/s");
+	}
+	pixkernel_select(best);
+}
+/*==========================================================================*/
+/// 测试项: FITS文件存储
+/*!
+ * @brief 写入与SaveFITSFile()相同的头信息关键字
+ */
+void write_keys(fitsfile *fitsptr, int *status) {
+	double jd(2460000.5), expdur(10.0), temp(-40.0);
+	unsigned int gain(1);
+	int frmno(1);
+
+	fits_write_key(fitsptr, TSTRING, "GROUP_ID", (void*) "001", "group id", status);
+	fits_write_key(fitsptr, TSTRING, "UNIT_ID", (void*) "001", "unit id", status);
+	fits_write_key(fitsptr, TSTRING, "CAM_ID", (void*) "011", "camera id", status);
+	fits_write_key(fitsptr, TSTRING, "MOUNT_ID", (void*) "001", "mount id", status);
+	fits_write_key(fitsptr, TSTRING, "CCDTYPE", (void*) "OBJECT", "type of image", status);
+	fits_write_key(fitsptr, TSTRING, "DATE-OBS", (void*) "2026-10-18", "UTC date of begin observation", status);
+	fits_write_key(fitsptr, TSTRING, "TIME-OBS", (void*) "12:00:00.000000", "UTC time of begin observation", status);
+	fits_write_key(fitsptr, TSTRING, "TIME-END", (void*) "12:00:10.000000", "UTC time of end observation", status);
+	fits_write_key(fitsptr, TDOUBLE, "JD", &jd, "Julian day of begin observation", status);
+	fits_write_key(fitsptr, TDOUBLE, "EXPTIME", &expdur, "exposure duration", status);
+	fits_write_key(fitsptr, TUINT,   "GAIN", &gain, "", status);
+	fits_write_key(fitsptr, TDOUBLE, "TEMPSET", &temp, "cooler set point", status);
+	fits_write_key(fitsptr, TDOUBLE, "TEMPACT", &temp, "cooler actual point", status);
+	fits_write_key(fitsptr, TINT,    "FRAMENO", &frmno, "frame no in this run", status);
+}
+
+struct fits_case {
+	const uint16_t *data;
+	long width, height;
+	uint16_t *bufsave;
+	std::string filepath;
+	bool reference;
+	bool failed;
+
+	void operator()() {
+		long naxes[] = {width, height};
+		fitsfile *fitsptr;
+		int status(0);
+
+		if (reference) {// cfitsio: 逐像素减BZERO并交换字节
+			fits_create_file(&fitsptr, ("!" + filepath).c_str(), &status);
+			fits_create_img(fitsptr, USHORT_IMG, 2, naxes, &status);
+			write_keys(fitsptr, &status);
+			fits_write_img(fitsptr, TUSHORT, 1, width * height, (void*) data, &status);
+			fits_close_file(fitsptr, &status);
+		}
+		else {// 与SaveFITSFile()相同: 内存中生成头信息, WriteFITSFile()写入
+			char *header(NULL);
+			int nkeys(0);
+
+			fits_create_file(&fitsptr, "mem://", &status);
+			fits_create_img(fitsptr, USHORT_IMG, 2, naxes, &status);
+			write_keys(fitsptr, &status);
+			fits_hdr2str(fitsptr, 0, NULL, 0, &header, &nkeys, &status);
+			fits_close_file(fitsptr, &status);
+			if (!status && !WriteFITSFile(filepath.c_str(), header, nkeys, data, width * height, bufsave))
+				status = -1;
+			if (header) {
+				int tmp(0);
+				fits_free_memory(header, &tmp);
+			}
+		}
+		if (status) failed = true;
+	}
+};
+
+/*!
+ * @brief 由cfitsio读回FITS文件并逐像素比较
+ * @return
+ * 尺寸与像素均一致时返回true
+ */
+bool verify_fits(const std::string &filepath, const uint16_t *data, long width, long height) {
+	std::vector<uint16_t> pix(width * height);
+	long naxes[2] = {0, 0};
+	fitsfile *fitsptr;
+	int status(0), naxis(0), anynul(0);
+
+	fits_open_file(&fitsptr, filepath.c_str(), READONLY, &status);
+	fits_get_img_dim(fitsptr, &naxis, &status);
+	fits_get_img_size(fitsptr, 2, naxes, &status);
+	fits_read_img(fitsptr, TUSHORT, 1, width * height, NULL, &pix[0], &anynul, &status);
+	fits_close_file(fitsptr, &status);
+	return !status && naxis == 2 && naxes[0] == width && naxes[1] == height
+			&& !memcmp(&pix[0], data, width * height * sizeof(uint16_t));
+}
+
+/*!
+ * @brief WriteFITSFile()写入后读回校验. 分别采用普通头信息与含END恰为2880字节整数倍的头信息
+ */
+void check_fits(const std::string &filepath, const uint16_t *data, long width, long height, uint16_t *bufsave) {
+	long naxes[] = {width, height};
+	char key[FLEN_KEYWORD];
+
+	for (int full = 0; full < 2; ++full) {
+		fitsfile *fitsptr;
+		char *header(NULL);
+		int status(0), nkeys(0), more(0), i(0);
+
+		fits_create_file(&fitsptr, "mem://", &status);
+		fits_create_img(fitsptr, USHORT_IMG, 2, naxes, &status);
+		write_keys(fitsptr, &status);
+		fits_get_hdrspace(fitsptr, &nkeys, &more, &status);
+		// 含END的关键字数量补齐至36的整数倍
+		while (full && !status && (nkeys + 1) % 36) {
+			snprintf(key, sizeof(key), "PAD%d", ++i);
+			fits_write_key(fitsptr, TINT, key, &i, "", &status);
+			++nkeys;
+		}
+		fits_hdr2str(fitsptr, 0, NULL, 0, &header, &nkeys, &status);
+		fits_close_file(fitsptr, &status);
+		if (status || !WriteFITSFile(filepath.c_str(), header, nkeys, data, width * height, bufsave)
+				|| !verify_fits(filepath, data, width, height))
+			fprintf(stderr, "!! fits: read back mismatch, %d header cards\n", nkeys);
+		if (header) {
+			int tmp(0);
+			fits_free_memory(header, &tmp);
+		}
+	}
+}
+
+void bench_fits(int repeat) {
+	const long w(4096), h(4096), n(w * h);
+	boost::shared_array<uint16_t> data(new uint16_t[n]);
+	boost::shared_array<uint16_t> bufsave(new uint16_t[fits_chunk]);
+	std::string filepath = tmpdir + "/focaes_bench.fit";
+	double ms;
+
+	synth_image(data.get(), w, h);
+	for (int i = 0; i < 2; ++i) {
+		fits_case one = { data.get(), w, h, bufsave.get(), filepath, i == 0, false };
+		ms = run_case(one, repeat);
+		if (one.failed) fprintf(stderr, "!! failed to write %s\n", filepath.c_str());
+		print_result("fits_save", i == 0 ? "cfitsio" : "fitswrite", ms, n * 2 / ms * 1E-3, "MB/s");
+	}
+	check_fits(filepath, data.get(), w, h, bufsave.get());
+	unlink(filepath.c_str());
+}
+/*==========================================================================*/
+/// 测试项: 通信协议组装与解析
+struct compact_case {
+	mntptr proto;
+	int count;
+
+	void operator()() {
+		std::string gid("001"), uid("001"), cid("011");
+		int n;
+		for (int i = 0; i < count; ++i) proto->compact_focus(gid, uid, cid, i % 10000, n);
+	}
+};
+
+struct resolve_case {
+	mntptr proto;
+	std::vector<std::string> lines;
+	bool failed;
+
+	void operator()() {
+		mpbase body;
+		for (std::vector<std::string>::iterator it = lines.begin(); it != lines.end(); ++it) {
+			if (strcmp(proto->resolve(it->c_str(), body), "focus")) failed = true;
+		}
+	}
+};
+
+void bench_mountproto(int repeat) {
+	const int count(100000);
+	mntptr proto = boost::make_shared<mount_proto>();
+	double ms;
+	int n;
+
+	compact_case one = { proto, count };
+	ms = run_case(one, repeat);
+	print_result("mountproto", "compact", ms, count / ms * 1E-3, "Mop/s");
+
+	resolve_case two;
+	two.proto  = proto;
+	two.failed = false;
+	for (int i = 0; i < count; ++i) {
+		std::string line = proto->compact_focus("001", "001", "011", i % 10000, n);
+		line.resize(line.size() - 1);	// 同ResolveFocus(): 去除换行符
+		two.lines.push_back(line);
+	}
+	ms = run_case(two, repeat);
+	if (two.failed) fprintf(stderr, "!! mount_proto::resolve() failed\n");
+	print_result("mountproto", "resolve", ms, count / ms * 1E-3, "Mop/s");
+}
+/*==========================================================================*/
+/// 测试项: TCP接收与协议拆分
+struct tcp_case {
+	const int port;
+	std::string stream;	//< 待发送数据
+	int count;			//< 协议条数
+	int received;		//< 已拆分协议条数
+	tcpcptr client;		//< 服务器端网络连接
+	boost::mutex mtx;
+	boost::condition_variable cv;
+
+	tcp_case(int p) : port(p), count(0), received(0) {
+	}
+
+	void on_receive(long, long ec) {// 同ResolveFocus(): 按换行符拆分
+		char term[] = "\n", buff[TCP_BUFF_SIZE];
+		int pos, n(0);
+
+		if (ec) return;
+		while ((pos = client->lookup(term, 1)) >= 0) {
+			client->read(buff, pos + 1);
+			buff[pos] = 0;
+			++n;
+		}
+		mutex_lock lck(mtx);
+		received += n;
+		if (received >= count) cv.notify_one();
+	}
+
+	void on_accept(const tcpcptr& cli, long) {
+		mutex_lock lck(mtx);
+		client = cli;
+		const tcpc_cbtype& slot = boost::bind(&tcp_case::on_receive, this, _1, _2);
+		cli->register_receive(slot);
+		cv.notify_one();
+	}
+
+	bool run(int sock) {
+		boost::posix_time::seconds period(5);
+		size_t sent(0);
+		ssize_t n;
+
+		{
+			mutex_lock lck(mtx);
+			received = 0;
+		}
+		while (sent < stream.size()) {
+			if ((n = send(sock, stream.data() + sent, stream.size() - sent, 0)) <= 0) return false;
+			sent += n;
+		}
+		mutex_lock lck(mtx);
+		while (received < count) {
+			if (!cv.timed_wait(lck, period)) return false;
+		}
+		return true;
+	}
+};
+
+struct tcp_run {
+	tcp_case *tc;
+	int sock;
+	bool failed;
+
+	void operator()() {
+		if (!tc->run(sock)) failed = true;
+	}
+};
+
+void bench_tcp(int repeat) {
+	const int port(14012), count(20000);
+	tcp_case tc(port);
+	tcp_server server;
+	mount_proto proto;
+	sockaddr_in addr;
+	int sock, n;
+	double ms;
+
+	for (int i = 0; i < count; ++i) tc.stream += proto.compact_focus("001", "001", "011", i % 10000, n);
+	tc.count = count;
+	try {
+		const tcps_cbtype& slot = boost::bind(&tcp_case::on_accept, &tc, _1, _2);
+		server.register_accept(slot);
+		if (!server.start(port)) throw std::runtime_error("failed to listen");
+	}
+	catch(std::exception &ex) {
+		fprintf(stderr, "!! tcp: %s\n", ex.what());
+		return;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port   = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0 || connect(sock, (sockaddr*) &addr, sizeof(addr))) {
+		fprintf(stderr, "!! tcp: failed to connect loopback port %d\n", port);
+		if (sock >= 0) close(sock);
+		return;
+	}
+	{
+		mutex_lock lck(tc.mtx);
+		while (!tc.client.use_count()) tc.cv.wait(lck);
+	}
+
+	tcp_run one = { &tc, sock, false };
+	ms = run_case(one, repeat);
+	if (one.failed) fprintf(stderr, "!! tcp: protocol lost\n");
+	print_result("tcp_framing", "loopback", ms, count / ms * 1E-3, "Mmsg/s");
+	print_result("tcp_framing", "loopback", ms, tc.stream.size() / ms * 1E-3, "MB/s");
+	close(sock);
+	tc.client->close();
+}
+/*==========================================================================*/
+/// 测试项: GY相机图像传输
+/*!
+ * @brief 模拟GY相机: 响应寄存器读写, 曝光后经UDP发送图像数据, 响应重传请求
+ * @note
+ * 仅首次发送时按丢包率丢弃数据包, 重传数据包不丢弃
+ */
+class gy_simulator {
+public:
+	gy_simulator(int width, int height)
+		: width_(width), height_(height), loss_(0.0), sockcmd_(-1), sockdata_(-1),
+		  running_(false), expose_(false), dropped_(0), resent_(0) {
+		memset(regs_, 0, sizeof(regs_));
+		packlen_ = 1500 - 20 - 8 - 8;
+		bytes_   = width * height * 2 + 64;
+		packtot_ = (bytes_ + packlen_ - 1) / packlen_;
+		image_.resize(bytes_);
+		synth_image((uint16_t*) &image_[0], width, height);
+	}
+
+	virtual ~gy_simulator() {
+		Stop();
+	}
+
+protected:
+	typedef std::pair<uint32_t, uint32_t> pack_range;
+
+	int width_, height_;	//< 图像尺寸
+	double loss_;			//< 丢包率
+	int sockcmd_;			//< 指令套接口
+	int sockdata_;			//< 数据套接口
+	sockaddr_in peercmd_;	//< 指令对端
+	uint32_t regs_[8];		//< 寄存器: 数据端口, 包长, 曝光时间
+	int packlen_;			//< 单包图像数据长度
+	int bytes_;				//< 图像数据总长度, 含尾部64字节
+	int packtot_;			//< 图像数据包数量
+	std::vector<uint8_t> image_;	//< 图像数据
+	volatile bool running_;	//< 运行标志
+	bool expose_;			//< 曝光请求
+	uint16_t idFrame_;		//< 帧编号
+	std::deque<pack_range> resend_;	//< 重传请求
+	boost::mutex mtx_;
+	boost::condition_variable cv_;
+	boost::thread_group thrds_;
+
+public:
+	uint64_t dropped_;	//< 合成丢弃数据包
+	uint64_t resent_;	//< 重传数据包
+
+public:
+	bool Start() {
+		sockaddr_in addr;
+		timeval tv = {0, 100000};
+
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port   = htons(PORT_CAMERA);
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if ((sockcmd_ = socket(AF_INET, SOCK_DGRAM, 0)) < 0
+				|| bind(sockcmd_, (sockaddr*) &addr, sizeof(addr))
+				|| (sockdata_ = socket(AF_INET, SOCK_DGRAM, 0)) < 0)
+			return false;
+		setsockopt(sockcmd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+		running_ = true;
+		idFrame_ = 0;
+		thrds_.create_thread(boost::bind(&gy_simulator::ThreadCommand, this));
+		thrds_.create_thread(boost::bind(&gy_simulator::ThreadStream, this));
+		return true;
+	}
+
+	void Stop() {
+		if (running_) {
+			running_ = false;
+			cv_.notify_all();
+			thrds_.join_all();
+		}
+		if (sockcmd_ >= 0) close(sockcmd_);
+		if (sockdata_ >= 0) close(sockdata_);
+		sockcmd_ = sockdata_ = -1;
+	}
+
+	void SetLoss(double loss) {
+		loss_ = loss;
+	}
+
+protected:
+	uint32_t &reg(uint32_t addr) {
+		static uint32_t dummy;
+		switch (addr) {
+		case 0x0D00:     return regs_[0];	// 主机数据端口
+		case 0x0D04:     return regs_[1];	// 包长
+		case 0x00020010: return regs_[2];	// 曝光时间
+		case 0x00020008: return regs_[3];	// 增益
+		case 0x0002000C: return regs_[4];	// 快门模式
+		case 0xA004:     return regs_[5];	// 宽度
+		case 0xA008:     return regs_[6];	// 高度
+		default:         return dummy = 0;
+		}
+	}
+
+	void ThreadCommand() {
+		uint8_t buff[64], ack[48];
+		sockaddr_in peer;
+		socklen_t len;
+		ssize_t n;
+		uint32_t addr, val;
+
+		reg(0x0D04) = 1500;
+		reg(0xA004) = width_;
+		reg(0xA008) = height_;
+		while (running_) {
+			len = sizeof(peer);
+			if ((n = recvfrom(sockcmd_, buff, sizeof(buff), 0, (sockaddr*) &peer, &len)) < 8 || buff[0] != 0x42)
+				continue;
+			memset(ack, 0, sizeof(ack));
+			ack[6] = buff[6];
+			ack[7] = buff[7];
+			addr = n >= 12 ? ntohl(((uint32_t*) buff)[2]) : 0;
+			if (buff[3] == 0x02) {// 发现设备: 偏移44处为相机IP
+				ack[3]  = 0x03;
+				ack[44] = 127;
+				ack[47] = 1;
+				sendto(sockcmd_, ack, 48, 0, (sockaddr*) &peer, len);
+			}
+			else if (buff[3] == 0x80) {// 读寄存器
+				ack[3] = 0x81;
+				((uint32_t*) ack)[2] = htonl(reg(addr));
+				sendto(sockcmd_, ack, 12, 0, (sockaddr*) &peer, len);
+			}
+			else if (buff[3] == 0x82 && n >= 16) {// 写寄存器
+				val = ntohl(((uint32_t*) buff)[3]);
+				ack[3]  = 0x83;
+				ack[11] = 0x01;
+				reg(addr) = val;
+				sendto(sockcmd_, ack, 12, 0, (sockaddr*) &peer, len);
+				if (addr == 0x00020000 && val == 1) {// 开始曝光
+					mutex_lock lck(mtx_);
+					expose_ = true;
+					resend_.clear();
+					cv_.notify_one();
+				}
+			}
+			else if (buff[3] == 0x40 && n >= 20) {// 重传请求: 无应答
+				uint32_t p0 = ntohl(((uint32_t*) buff)[3]), p1 = ntohl(((uint32_t*) buff)[4]);
+				if (p0 >= 1 && p0 <= p1 && int(p1) <= packtot_) {
+					mutex_lock lck(mtx_);
+					resend_.push_back(pack_range(p0, p1));
+					cv_.notify_one();
+				}
+			}
+		}
+	}
+
+	void send_packet(const sockaddr_in &peer, uint8_t type, uint32_t id) {
+		uint8_t buff[1500];
+		int n(8);
+
+		buff[0] = buff[1] = 0;
+		buff[2] = uint8_t(idFrame_ >> 8);
+		buff[3] = uint8_t(idFrame_);
+		buff[4] = type;
+		buff[5] = uint8_t(id >> 16);
+		buff[6] = uint8_t(id >> 8);
+		buff[7] = uint8_t(id);
+		if (type == ID_PAYLOAD) {
+			int offset = (id - 1) * packlen_, len = bytes_ - offset;
+			if (len > packlen_) len = packlen_;
+			memcpy(buff + 8, &image_[offset], len);
+			n += len;
+		}
+		sendto(sockdata_, buff, n, 0, (const sockaddr*) &peer, sizeof(peer));
+	}
+
+	void ThreadStream() {
+		boost::posix_time::milliseconds period(10);
+		sockaddr_in peer;
+		pack_range range;
+		bool frame;
+
+		memset(&peer, 0, sizeof(peer));
+		peer.sin_family = AF_INET;
+		peer.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		while (running_) {
+			{
+				mutex_lock lck(mtx_);
+				while (running_ && !expose_ && resend_.empty()) cv_.timed_wait(lck, period);
+				if (!running_) break;
+				if (!(frame = expose_)) {
+					range = resend_.front();
+					resend_.pop_front();
+				}
+				expose_ = false;
+			}
+			peer.sin_port = htons(uint16_t(reg(0x0D00)));
+			if (frame) {// 积分后发送整帧
+				++idFrame_;
+				if (reg(0x00020010)) boost::this_thread::sleep_for(boost::chrono::microseconds(reg(0x00020010)));
+				send_packet(peer, ID_LEADER, 0);
+				for (int i = 1; i <= packtot_; ++i) {
+					if (loss_ > 0.0 && rand() < loss_ * RAND_MAX) ++dropped_;
+					else send_packet(peer, ID_PAYLOAD, i);
+					if (!(i & 63)) boost::this_thread::yield();	// 避免接收缓冲区溢出
+				}
+				send_packet(peer, ID_TRAILER, packtot_ + 1);
+			}
+			else {
+				for (uint32_t i = range.first; i <= range.second; ++i, ++resent_) send_packet(peer, ID_PAYLOAD, i);
+			}
+		}
+	}
+};
+
+struct gy_case {
+	boost::shared_ptr<CameraGY> camera;
+	boost::mutex mtx;
+	boost::condition_variable cv;
+	bool done;
+	int status;
+	int failed;
+
+	gy_case() : done(false), status(0), failed(0) {
+	}
+
+	void on_expose(double, double percent, int state) {
+		if (percent > 100.0 && state != CAMERA_EXPOSE) {// 读出结束
+			mutex_lock lck(mtx);
+			done   = true;
+			status = state;
+			cv.notify_one();
+		}
+	}
+
+	void operator()() {
+		boost::posix_time::seconds period(15);
+		int i;
+
+		done = false;
+		// 上一帧结束回调后相机状态才复位为空闲
+		for (i = 0; i < 1000 && !camera->Expose(0.0, true); ++i) boost::this_thread::sleep_for(boost::chrono::milliseconds(1));
+		mutex_lock lck(mtx);
+		bool timeout(i == 1000);
+		while (!done && !timeout) timeout = !cv.timed_wait(lck, period);
+		if (timeout || status != CAMERA_IMGRDY) ++failed;
+	}
+};
+
+void bench_gy(int repeat) {
+	const int w(4096), h(4096);
+	const double losses[] = {0.0, 0.001, 0.01};
+	gy_simulator sim(w, h);
+	gy_case gc;
+	char variant[40];
+	double ms;
+
+	if (!sim.Start()) {
+		fprintf(stderr, "!! gy: failed to bind loopback UDP port %d\n", PORT_CAMERA);
+		return;
+	}
+	gc.camera = boost::make_shared<CameraGY>("127.0.0.1");
+	const ExposeProcess::slot_type &slot = boost::bind(&gy_case::on_expose, &gc, _1, _2, _3);
+	gc.camera->register_expose(slot);
+	if (!gc.camera->Connect()) {
+		fprintf(stderr, "!! gy: %s\n", gc.camera->GetCameraInfo()->errmsg.c_str());
+		return;
+	}
+
+	for (int i = 0; i < int(sizeof(losses) / sizeof(double)); ++i) {
+		camera_stat st0 = gc.camera->GetStatistics();
+		uint64_t dropped = sim.dropped_, resent = sim.resent_;
+		sim.SetLoss(losses[i]);
+		gc.failed = 0;
+		sprintf(variant, "loss=%g", losses[i]);
+		ms = run_case(gc, repeat);
+		const camera_stat &st1 = gc.camera->GetStatistics();
+		print_result("gy_readout", variant, ms, w * h * 2 / ms * 1E-3, "MB/s");
+		print_value("gy_dropped", variant, double(sim.dropped_ - dropped) / repeat, "packets/frame");
+		print_value("gy_resent", variant, double(sim.resent_ - resent) / repeat, "packets/frame");
+		print_value("gy_requested", variant, double(st1.packreq - st0.packreq) / repeat, "packets/frame");
+		print_value("gy_failed", variant, gc.failed, "frames");
+	}
+	gc.camera->Disconnect();
+	sim.Stop();
+}
+/*==========================================================================*/
+/// 测试项: 日志
+struct glog_case {
+	GLog *log;
+	int threads;
+	int count;
+
+	void write(int id) {
+		for (int i = 0; i < count; ++i)
+			log->Write(LOG_WARN, "glog_case", "thread<%d> frame<%d> focus<%d> elapsed<%.3f>", id, i, i % 10000, i * 0.001);
+	}
+
+	void operator()() {
+		boost::thread_group thrds;
+		for (int i = 0; i < threads; ++i) thrds.create_thread(boost::bind(&glog_case::write, this, i));
+		thrds.join_all();
+	}
+};
+
+void bench_glog(int repeat) {
+	const int count(20000);
+	const int nthread[] = {1, 4};
+	char cwd[300], variant[40];
+	double ms;
+
+	// 日志文件位于当前目录下的log子目录
+	if (!getcwd(cwd, sizeof(cwd)) || chdir(tmpdir.c_str())) {
+		fprintf(stderr, "!! glog: failed to enter %s\n", tmpdir.c_str());
+		return;
+	}
+	{
+		GLog log;
+		for (int i = 0; i < int(sizeof(nthread) / sizeof(int)); ++i) {
+			glog_case one = { &log, nthread[i], count };
+			sprintf(variant, "threads=%d", nthread[i]);
+			ms = run_case(one, repeat);
+			print_result("glog_write", variant, ms, count * nthread[i] / ms, "kline/s");
+		}
+		if (log.Dropped()) fprintf(stderr, "!! glog: %lu lines dropped\n", log.Dropped());
+	}
+	if (chdir(cwd)) fprintf(stderr, "!! glog: failed to return %s\n", cwd);
+}
+/*==========================================================================*/
+/// 测试项: 缩略图统计与合并
+struct zscale_case {
+	const uint16_t *data;
+	int width, height;
+	float z1, z2;
+
+	void operator()() {
+		ImagePreview::ZScale(data, width, height, z1, z2);
+	}
+};
+
+struct bin_case {
+	const uint16_t *data;
+	int width, height, bin;
+	uint16_t *dst;
+
+	void operator()() {
+		bin_u16(data, width, height, bin, dst);
+	}
+};
+
+void bench_zscale(int repeat) {
+	const int w(4096), h(4096), bin(4);
+	boost::shared_array<uint16_t> data(new uint16_t[w * h]);
+	boost::shared_array<uint16_t> dst(new uint16_t[(w / bin) * (h / bin)]);
+	int best = pixkernel_select(PIXISA_LAST);
+	double ms;
+
+	synth_image(data.get(), w, h);
+	zscale_case one = { data.get(), w, h, 0, 0 };
+	ms = run_case(one, repeat);
+	print_result("zscale", "nsample=1000", ms, 1000.0 / ms, "frame/s");
+
+	for (int isa = PIXISA_SCALAR; isa <= best; ++isa) {
+		pixkernel_select(isa);
+		bin_case two = { data.get(), w, h, bin, dst.get() };
+		ms = run_case(two, repeat);
+		print_result("bin4", pixkernel_isa_name(isa), ms, w * h * 2 / ms * 1E-3, "MB/s");
+	}
+	pixkernel_select(best);
+
+	/* 端到端: 生成缩略图并确认PNG文件存在 */
+	std::string fitspath = tmpdir + "/focaes_preview.fit", pngpath = tmpdir + "/focaes_preview.png";
+	ImagePreview preview;
+	unlink(pngpath.c_str());
+	preview.SetBinning(bin);
+	preview.Start();
+	preview.Generate(data.get(), w, h, fitspath);
+	if (!preview.Wait() || access(pngpath.c_str(), F_OK))
+		fprintf(stderr, "!! preview: %s was not created\n", pngpath.c_str());
+	else print_result("preview", "bin=4", preview.Elapsed(), 1000.0 / preview.Elapsed(), "frame/s");
+	preview.Stop();
+	unlink(pngpath.c_str());
+}
+/*==========================================================================*/
+/// 测试项: SDK读出至vector后转交图像缓冲区
+/*!
+ * @brief 模拟SDK读出: 逐像素写入vector
+ */
+void sdk_get_image(std::vector<uint16_t> &vec, size_t n) {
+	if (vec.size() < n) vec.resize(n);
+	uint16_t *p = &vec[0];
+	for (size_t i = 0; i < n; ++i) p[i] = uint16_t(1000 + (i & 63));
+}
+
+struct vec_copy_case {// 读出后复制至缓冲区
+	std::vector<uint16_t> *vec;
+	uint8_t *dst;
+	size_t n;
+
+	void operator()() {
+		sdk_get_image(*vec, n);
+		memcpy(dst, &(*vec)[0], n * sizeof(uint16_t));
+	}
+};
+
+struct vec_adopt_case {// 以vector存储区作为缓冲区, 上一帧缓冲区释放时回收
+	VectorFramePool *pool;
+	boost::shared_array<uint8_t> *held;
+	size_t n;
+
+	void operator()() {
+		VectorFramePool::vecptr vec = pool->Get();
+		sdk_get_image(*vec, n);
+		*held = pool->Adopt(vec);
+	}
+};
+
+void bench_vecframe(int repeat) {
+	const size_t n = size_t(3056) * 3056;
+	std::vector<uint16_t> vec(n);
+	boost::shared_array<uint8_t> dst(new uint8_t[n * sizeof(uint16_t)]), held;
+	VectorFramePool pool;
+	double ms;
+
+	memset(dst.get(), 0, n * sizeof(uint16_t));
+	vec_copy_case one = { &vec, dst.get(), n };
+	ms = run_case(one, repeat);
+	print_result("vecframe", "copy", ms, 1000.0 / ms, "frame/s");
+
+	vec_adopt_case two = { &pool, &held, n };
+	ms = run_case(two, repeat);
+	print_result("vecframe", "adopt", ms, 1000.0 / ms, "frame/s");
+}
+/*==========================================================================*/
+/// 测试项: 本底合并
+struct accum_case {
+	const uint16_t *data;
+	uint32_t *sum;
+	uint16_t *lo, *hi;
+	size_t n;
+
+	void operator()() {
+		accum_minmax_u16(data, sum, lo, hi, n);
+	}
+};
+
+struct combine_case {
+	MasterCombine *master;
+
+	void operator()() {
+		master->Combine();
+	}
+};
+
+void bench_master(int repeat) {
+	const int w(4096), h(4096);
+	const size_t n = size_t(w) * h;
+	boost::shared_array<uint16_t> data(new uint16_t[n]), lo(new uint16_t[n]), hi(new uint16_t[n]);
+	boost::shared_array<uint32_t> sum(new uint32_t[n]);
+	int best = pixkernel_select(PIXISA_LAST);
+	double ms;
+
+	synth_image(data.get(), w, h);
+	memset(sum.get(), 0, n * sizeof(uint32_t));
+	memset(lo.get(), 0xFF, n * sizeof(uint16_t));
+	memset(hi.get(), 0, n * sizeof(uint16_t));
+	for (int isa = PIXISA_SCALAR; isa <= best; ++isa) {
+		pixkernel_select(isa);
+		accum_case one = { data.get(), sum.get(), lo.get(), hi.get(), n };
+		ms = run_case(one, repeat);
+		print_result("master_add", pixkernel_isa_name(isa), ms, 1000.0 / ms, "frame/s");
+	}
+	pixkernel_select(best);
+
+	MasterCombine master(w, h, 5);
+	for (int i = 0; i < 5; ++i) master.Add(data.get(), w, h);
+	combine_case two = { &master };
+	ms = run_case(two, repeat);
+	print_result("master_combine", "minmax", ms, 1000.0 / ms, "frame/s");
+}
+/*==========================================================================*/
+/// 测试项: 实时定标
+struct calib_case {
+	const uint16_t *raw, *offset;
+	const float *gain;
+	uint16_t *dst;
+	size_t n;
+
+	void operator()() {
+		calib_u16(raw, offset, gain, 1000.0f, dst, n);
+	}
+};
+
+struct mask_case {// 逐行替换坏像素
+	const uint16_t *src;
+	const uint8_t *bits;
+	uint16_t *dst;
+	int width, height;
+
+	void operator()() {
+		for (int y = 0; y < height; ++y)
+			mask_fill_u16(src + size_t(y) * width, bits, size_t(y) * width, dst + size_t(y) * width, width);
+	}
+};
+
+void bench_calib(int repeat) {
+	const int w(4096), h(4096);
+	const size_t n = size_t(w) * h;
+	boost::shared_array<uint16_t> raw(new uint16_t[n]), offset(new uint16_t[n]), dst(new uint16_t[n]);
+	boost::shared_array<float> gain(new float[n]);
+	int best = pixkernel_select(PIXISA_LAST);
+	double ms;
+
+	synth_image(raw.get(), w, h);
+	for (size_t i = 0; i < n; ++i) {
+		offset[i] = uint16_t(900 + (i & 31));
+		gain[i]   = 0.95f + (i & 63) * 0.001f;
+	}
+	for (int isa = PIXISA_SCALAR; isa <= best; ++isa) {
+		pixkernel_select(isa);
+		calib_case one = { raw.get(), offset.get(), gain.get(), dst.get(), n };
+		ms = run_case(one, repeat);
+		print_result("calib", pixkernel_isa_name(isa), ms, 1000.0 / ms, "frame/s");
+	}
+
+	boost::shared_array<uint8_t> bits(new uint8_t[n / 8 + 8]);
+	for (size_t i = 0; i < n / 8 + 8; ++i) bits[i] = (i % 97) ? 0 : uint8_t(1 << (i & 7));
+	for (int isa = PIXISA_SCALAR; isa <= best; ++isa) {
+		pixkernel_select(isa);
+		mask_case two = { raw.get(), bits.get(), dst.get(), w, h };
+		ms = run_case(two, repeat);
+		print_result("mask_fill", pixkernel_isa_name(isa), ms, 1000.0 / ms, "frame/s");
+	}
+	pixkernel_select(best);
+}
+/*==========================================================================*/
+/// 测试项: 背景估计
+struct median_case {// 全幅中值
+	const uint16_t *data;
+	std::vector<uint16_t> *tmp;
+
+	void operator()() {
+		tmp->assign(data, data + tmp->size());
+		std::nth_element(tmp->begin(), tmp->begin() + tmp->size() / 2, tmp->end());
+	}
+};
+
+struct mesh_case {
+	BackgroundMesh *bkg;
+	const uint16_t *data;
+	int width, height;
+
+	void operator()() {
+		bkg->Estimate(data, width, height);
+	}
+};
+
+struct interp_case {// 逐行插值全幅背景与噪声
+	BackgroundMesh *bkg;
+	float *back, *rms;
+	int height;
+
+	void operator()() {
+		for (int y = 0; y < height; ++y) bkg->InterpolateRow(y, back, rms);
+	}
+};
+
+void bench_background(int repeat) {
+	const int w(4096), h(4096);
+	boost::shared_array<uint16_t> data(new uint16_t[w * h]);
+	std::vector<uint16_t> tmp(w * h);
+	std::vector<float> back(w), rms(w);
+	int nthread = boost::thread::hardware_concurrency();
+	char variant[40];
+	double ms;
+
+	synth_image(data.get(), w, h);
+	median_case one = { data.get(), &tmp };
+	ms = run_case(one, repeat);
+	print_result("background", "global median", ms, 1000.0 / ms, "frame/s");
+
+	for (int n = 1; n <= nthread; n = n < nthread && n * 2 > nthread ? nthread : n * 2) {
+		BackgroundMesh bkg(64, 3, n);
+		mesh_case two = { &bkg, data.get(), w, h };
+		ms = run_case(two, repeat);
+		sprintf(variant, "mesh64 thread=%d", n);
+		print_result("background", variant, ms, 1000.0 / ms, "frame/s");
+		if (n == nthread) {
+			interp_case three = { &bkg, &back[0], &rms[0], h };
+			ms = run_case(three, repeat);
+			print_result("background", "interpolate", ms, 1000.0 / ms, "frame/s");
+		}
+	}
+}
+/*==========================================================================*/
+/// 测试项: 星像提取
+struct extract_case {
+	StarExtractor *extractor;
+	BackgroundMesh *bkg;
+	const uint16_t *data;
+	int width, height;
+	star_catalog *cat;
+
+	void operator()() {
+		extractor->Extract(data, width, height, *bkg, *cat);
+	}
+};
+
+struct shape_case {// 星像形状分量与分区统计
+	star_catalog *cat;
+	std::vector<shape_region> *regions;
+	shape_region *total;
+	int width, height;
+
+	void operator()() {
+		shape_f32(&cat->x2[0], &cat->y2[0], &cat->xy[0], &cat->e1[0], &cat->e2[0], cat->size());
+		shape_summary(*cat, 3, 0, 0, 1, 1, width, height, *regions, *total);
+	}
+};
+
+void bench_extract(int repeat) {
+	const int w(4096), h(4096);
+	boost::shared_array<uint16_t> data(new uint16_t[w * h]);
+	BackgroundMesh bkg(64, 3, 0);
+	star_catalog cat;
+	int nthread = boost::thread::hardware_concurrency();
+	char variant[40];
+	double ms;
+
+	synth_image(data.get(), w, h);
+	bkg.Estimate(data.get(), w, h);
+	for (int n = 1; n <= nthread; n = n < nthread && n * 2 > nthread ? nthread : n * 2) {
+		StarExtractor extractor(3.0, 5, 60000, n);
+		extract_case one = { &extractor, &bkg, data.get(), w, h, &cat };
+		ms = run_case(one, repeat);
+		sprintf(variant, "thread=%d stars=%d", n, cat.size());
+		print_result("extract", variant, ms, 1000.0 / ms, "frame/s");
+	}
+
+	std::vector<shape_region> regions;
+	shape_region total;
+	int best = pixkernel_select(PIXISA_LAST);
+	for (int isa = PIXISA_SCALAR; isa <= best; ++isa) {
+		pixkernel_select(isa);
+		shape_case two = { &cat, &regions, &total, w, h };
+		ms = run_case(two, repeat * 100);
+		print_result("shape", pixkernel_isa_name(isa), ms, cat.size() / ms * 1E-3, "Mstar/s");
+	}
+	pixkernel_select(best);
+}
+/*==========================================================================*/
+/// 测试项: PSF拟合
+struct psf_case {
+	PsfFitter *fitter;
+	const uint16_t *data;
+	int width, height;
+	star_catalog *cat;
+	psf_catalog *psf;
+
+	void operator()() {
+		fitter->Fit(data, width, height, *cat, *psf);
+	}
+};
+
+void bench_psf(int repeat) {
+	const int w(4096), h(4096);
+	boost::shared_array<uint16_t> data(new uint16_t[w * h]);
+	BackgroundMesh bkg(64, 3, 0);
+	StarExtractor extractor(3.0, 5, 60000, 0);
+	star_catalog cat;
+	psf_catalog psf;
+	int nthread = boost::thread::hardware_concurrency();
+	char variant[60];
+	double ms;
+
+	synth_image(data.get(), w, h);
+	bkg.Estimate(data.get(), w, h);
+	extractor.Extract(data.get(), w, h, bkg, cat);
+
+	int best = pixkernel_select(PIXISA_LAST);
+	for (int model = PSF_GAUSS; model <= PSF_MOFFAT; ++model) {
+		for (int isa = PIXISA_SCALAR; isa <= best; ++isa) {
+			pixkernel_select(isa);
+			for (int n = 1; n <= nthread; n = n < nthread && n * 2 > nthread ? nthread : n * 2) {
+				if (n > 1 && isa != best) break;
+				PsfFitter fitter(model, 15, 64, n);
+				psf_case one = { &fitter, data.get(), w, h, &cat, &psf };
+				ms = run_case(one, repeat);
+				sprintf(variant, "%s %s thread=%d fit=%d", psf_model_name(model), pixkernel_isa_name(isa), n, psf.size());
+				print_result("psf", variant, ms, 64 / ms, "kstar/s");
+			}
+		}
+	}
+	pixkernel_select(best);
+}
+/*==========================================================================*/
+struct bench_item {
+	const char *name;
+	void (*func)(int);
+	int divisor;	//< 宏测试项的重复次数为repeat/divisor
+};
+
+int main(int argc, char** argv) {
+	const bench_item items[] = {
+		{"swap",       bench_swap,       1},
+		{"fits",       bench_fits,       4},
+		{"mountproto", bench_mountproto, 1},
+		{"tcp",        bench_tcp,        1},
+		{"gy",         bench_gy,         4},
+		{"glog",       bench_glog,       4},
+		{"zscale",     bench_zscale,     1},
+		{"vecframe",   bench_vecframe,   1},
+		{"master",     bench_master,     1},
+		{"calib",      bench_calib,      1},
+		{"background", bench_background, 1},
+		{"extract",    bench_extract,    1},
+		{"psf",        bench_psf,        1}
+	};
+	const int nitem = int(sizeof(items) / sizeof(bench_item));
+	std::vector<std::string> cases;
+	int repeat(21), ch, n;
+
+	while ((ch = getopt(argc, argv, "jHr:d:h")) != -1) {
+		if (ch == 'j') json_output = true;
+		else if (ch == 'H') numamem_setup(true, -1, false);
+		else if (ch == 'r') repeat = atoi(optarg);
+		else if (ch == 'd') tmpdir = optarg;
+		else {
+			printf("Usage: focaes_bench [-j] [-H] [-r repeat] [-d tmpdir] [case ...]\n");
+			printf("cases:");
+			for (int i = 0; i < nitem; ++i) printf(" %s", items[i].name);
+			printf("\n");
+			return ch == 'h' ? 0 : 1;
+		}
+	}
+	for (int i = optind; i < argc; ++i) {
+		if (strspn(argv[i], "0123456789") == strlen(argv[i])) repeat = atoi(argv[i]); // 兼容: 首个参数为重复次数
+		else cases.push_back(argv[i]);
+	}
+	if (repeat <= 0) repeat = 21;
+
+	for (int i = 0; i < nitem; ++i) {
+		if (!cases.empty() && std::find(cases.begin(), cases.end(), items[i].name) == cases.end()) continue;
+		if ((n = repeat / items[i].divisor) < 3) n = 3;
+		items[i].func(n);
+		fflush(stdout);
+	}
+
+	return 0;
+}
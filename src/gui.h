@@ -9,29 +9,31 @@
   定义用户交互区
 ******************************************************************* <分割提示符>        1
 On <camera ip/id>         # connect camera. empty for U9000                            2
-Off                       # disconnect camera                                          3
-Reboot                    # reboot camera                                              4
-gain <index>              # change gain                                                5
-Bias <count>              # take sequential BIAS images                                6
-Dark <duration> <count>   # take sequential DARK images                                7
-<name> <duration> <count> # take sequential LIGHT images                               8
-Focus <position>          # change focuser position                                    9
-Reload                    # Reload configuration parameters                           10
-Start                     # start sequence using configuration parameters             11
-Stop                      # stop running sequence                                     12
-Quit                      # quit program                                              13
-******************************************************************* <分割提示符>        14
-Focus Daemon Port: %d                                                                 15
-<duration=%.3f>, <count=%d>, <focuser from %d to %d, step=%d, error=%d>               16 控制参数
-<focus=%d> <target=%d>                                                                17 焦点位置
-<status>                                                                              18 状态
-<error or warn prompts>                                                               19 错误提示
-<exposure process>                                                                    20 曝光进度
-<space line>                                                                          21
-<User Input>                                                                          22
+Cam <index>               # select camera for following commands                       3
+Off                       # disconnect camera                                          4
+Reboot                    # reboot camera                                              5
+gain <index>              # change gain                                                6
+Bias <count>              # take sequential BIAS images                                7
+Dark <duration> <count>   # take sequential DARK images                                8
+<name> <duration> <count> # take sequential LIGHT images                               9
+Focus <position>          # change focuser position                                   10
+Reload                    # Reload configuration parameters                           11
+Start                     # start sequence on all cameras                             12
+Stop                      # stop running sequence on all cameras                      13
+Quit                      # quit program                                              14
+******************************************************************* <分割提示符>        15
+Focus Daemon Port: %d                                                                 16
+<duration=%.3f>, <count=%d>, <focuser from %d to %d, step=%d, error=%d>               17 控制参数
+<focus=%d> <target=%d>                                                                18 焦点位置
+<status>                                                                              19 状态
+<error or warn prompts>                                                               20 错误提示
+<exposure process>                                                                    21 曝光进度
+<space line>                                                                          22
+<User Input>                                                                          23
 
   定义用户指令
-  On  <camera ip/index>     # 连接相机
+  On  <camera ip/index>     # 连接相机, 并选择为当前相机
+  Cam <index>               # 选择当前相机. 单元内相机索引为1-5
   Off                       # 断开相机
   Bias <count>              # 采集本底
   Dark <duration> <count>   # 采集暗场
@@ -41,13 +43,13 @@ Focus Daemon Port: %d
 
 enum {// 各行对应信息
 	LINE_SEPARATOR = 1,
-	LINE_PORT = 15,
+	LINE_PORT = 16,
 	LINE_PARAM,
 	LINE_FOCUS,
 	LINE_STATUS,
 	LINE_ERROR,
 	LINE_EXPROCESS,
-	LINE_INPUT  = 22
+	LINE_INPUT  = 23
 };
 
 #endif /* GUI_H_ */
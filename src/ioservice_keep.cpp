@@ -23,3 +23,7 @@ ioservice_keep::~ioservice_keep() {
 io_service& ioservice_keep::get_service() {
 	return ios_;
 }
+
+ioservice_keep::thread::native_handle_type ioservice_keep::native_handle() {
+	return thread_->native_handle();
+}
@@ -32,6 +32,10 @@ public:
 public:
 	// 属性函数
 	io_service& get_service();
+	/*!
+	 * @brief 查看run()所在线程的句柄, 用于设置CPU绑定等
+	 */
+	thread::native_handle_type native_handle();
 
 private:
 	// 成员变量
@@ -0,0 +1,112 @@
+/*
+ * @file numamem.cpp 大页/NUMA内存分配与线程CPU绑定定义文件
+ * @date 2026-10-18
+ * @version 0.1
+ */
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "GLog.h"
+#include "numamem.h"
+
+#define HUGE_PAGE_SIZE	(size_t(2) << 20)	// 大页容量
+#ifndef MPOL_BIND
+#define MPOL_BIND		2	// 内存仅分配于指定节点
+#endif
+
+struct numamem_config {// 内存分配选项
+	bool hugepage;	//< 启用大页
+	int node;		//< NUMA节点. -1: 不绑定
+	bool lock;		//< 锁定内存
+};
+
+static numamem_config config = {false, -1, false};
+static int warned(0);	//< 已记录的警告类型, 每类仅记录一次
+
+struct munmap_deleter {// 释放映射内存
+	size_t bytes;	//< 映射容量
+
+	void operator()(uint8_t *ptr) {
+		munmap(ptr, bytes);
+	}
+};
+
+/*!
+ * @brief 每类警告仅记录一次
+ * @param flag 警告类型
+ * @param what 警告内容
+ */
+static void warn_once(int flag, const char *what) {
+	if (!(__sync_fetch_and_or(&warned, flag) & flag))
+		gLog.Write(LOG_WARN, "numamem_alloc()", "%s: %s", what, strerror(errno));
+}
+
+void numamem_setup(bool hugepage, int node, bool lock) {
+	config.hugepage = hugepage;
+	config.node     = node;
+	config.lock     = lock;
+}
+
+boost::shared_array<uint8_t> numamem_alloc(size_t bytes) {
+	if (!config.hugepage && config.node < 0 && !config.lock)
+		return boost::shared_array<uint8_t>(new uint8_t[bytes]);
+
+	size_t align = config.hugepage ? HUGE_PAGE_SIZE : size_t(sysconf(_SC_PAGESIZE));
+	size_t mapped = (bytes + align - 1) & ~(align - 1);
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	void *ptr = MAP_FAILED;
+
+	if (config.hugepage) {
+		ptr = mmap(NULL, mapped, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+		if (ptr == MAP_FAILED) warn_once(1, "no reserved hugepage, fall back to transparent hugepage");
+	}
+	if (ptr == MAP_FAILED) {
+		if ((ptr = mmap(NULL, mapped, PROT_READ | PROT_WRITE, flags, -1, 0)) == MAP_FAILED) {
+			warn_once(2, "mmap failed, fall back to heap");
+			return boost::shared_array<uint8_t>(new uint8_t[bytes]);
+		}
+		if (config.hugepage) madvise(ptr, mapped, MADV_HUGEPAGE);
+	}
+	if (config.node >= 0) {// 须在首次写入之前绑定
+		unsigned long mask[4] = {0};
+		if (config.node < int(sizeof(mask) * 8)) {
+			mask[config.node / (sizeof(unsigned long) * 8)] = 1UL << (config.node % (sizeof(unsigned long) * 8));
+			if (syscall(SYS_mbind, ptr, mapped, MPOL_BIND, mask, sizeof(mask) * 8, 0))
+				warn_once(4, "mbind failed");
+		}
+	}
+	if (config.lock && mlock(ptr, mapped)) warn_once(8, "mlock failed, check RLIMIT_MEMLOCK");
+
+	munmap_deleter del;
+	del.bytes = mapped;
+	return boost::shared_array<uint8_t>((uint8_t*) ptr, del);
+}
+
+bool pin_thread(pthread_t thrd, const std::string &cpus) {
+	if (cpus.empty()) return true;
+
+	cpu_set_t set;
+	const char *ptr = cpus.c_str();
+	char *end;
+	long first, last;
+
+	CPU_ZERO(&set);
+	while (*ptr) {// 解析"0-3,8"
+		first = last = strtol(ptr, &end, 10);
+		if (end == ptr) return false;
+		if (*end == '-') {
+			ptr = end + 1;
+			last = strtol(ptr, &end, 10);
+			if (end == ptr) return false;
+		}
+		for (; first <= last && first < CPU_SETSIZE; ++first) CPU_SET(int(first), &set);
+		ptr = *end == ',' ? end + 1 : end;
+		if (*end && *end != ',') return false;
+	}
+	return !pthread_setaffinity_np(thrd, sizeof(cpu_set_t), &set);
+}
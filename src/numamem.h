@@ -0,0 +1,46 @@
+/*
+ * @file numamem.h 大页/NUMA内存分配与线程CPU绑定声明文件
+ * @date 2026-10-18
+ * @version 0.1
+ * @note
+ * - 用于图像缓冲区、GY相机包缓存区与FITS转换缓冲区等大块内存
+ * - 大页: 优先MAP_HUGETLB(2MB, 需预留vm.nr_hugepages), 失败时采用透明大页(MADV_HUGEPAGE)
+ * - NUMA: 以mbind将内存绑定至指定节点. 未指定节点时由首次写入的线程决定(内核默认策略)
+ * - 锁定: mlock避免缓冲区被换出
+ * - 未启用任何选项时等同new[]
+ * - CPU列表格式与taskset相同, 如"0-3,8"
+ */
+
+#ifndef NUMAMEM_H_
+#define NUMAMEM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <string>
+#include <boost/smart_ptr/shared_array.hpp>
+
+/*!
+ * @brief 设置内存分配选项. 此后分配的缓冲区生效
+ * @param hugepage 启用2MB大页
+ * @param node     NUMA节点. -1: 不绑定
+ * @param lock     锁定内存
+ */
+extern void numamem_setup(bool hugepage, int node, bool lock);
+/*!
+ * @brief 按分配选项申请缓冲区
+ * @param bytes 容量, 量纲: 字节
+ * @return
+ * 缓冲区. 引用计数归零时释放
+ */
+extern boost::shared_array<uint8_t> numamem_alloc(size_t bytes);
+/*!
+ * @brief 将线程绑定至CPU列表
+ * @param thrd 线程
+ * @param cpus CPU列表. 空字符串时不绑定
+ * @return
+ * 绑定结果. CPU列表为空时返回true
+ */
+extern bool pin_thread(pthread_t thrd, const std::string &cpus);
+
+#endif /* NUMAMEM_H_ */
@@ -19,6 +19,8 @@
 
 struct param_config {// 软件配置参数
 	int portFocus;		//< 面向调焦器网络服务端口
+	int portCtl;		//< 后台服务模式下的控制网络服务端口
+	int portMetrics;	//< 运行指标HTTP服务端口. 0: 禁用
 	std::string grpid;	//< 组标志
 	std::string unitid;	//< 单元标志
 	int stroke_start;	//< 行程起点, 量纲: 微米
@@ -26,12 +28,52 @@ struct param_config {// 软件配置参数
 	int stroke_step;	//< 行程步长, 量纲: 微米
 	int stroke_back;//< 行程回差, 量纲: 微米
 	int focuser_error;	//< 调焦器定位误差, 量纲: 微米
+	std::string focuser_driver;	//< 调焦器驱动: tcp, 网络调焦器; sim, 模拟调焦器
+	double focuser_speed;	//< 模拟调焦器运动速度, 量纲: 微米/秒
+	double focuser_settle;	//< 模拟调焦器到位后稳定时间, 量纲: 秒
+	int focuser_noise;		//< 模拟调焦器位置噪声, 量纲: 微米
+	int focuser_period;		//< 模拟调焦器位置反馈周期, 量纲: 毫秒
+	int focus_window;	//< 自动调焦亮星子窗口边长, 量纲: 像素. 0: 全幅
 	double expdur;		//< 曝光时间, 量纲: 秒
 	int frmcnt;			//< 曝光帧数
 	bool bfts;			//< 启用文件服务器
 	std::string ipfts;	//< 文件服务器IP地址
 	int portfts;			//< 文件服务器端口
 	bool display;		//< 是否实时显示图像
+	int display_bin;	//< 实时显示图像时的合并因子
+	bool preview;		//< 是否生成PNG缩略图
+	int preview_bin;	//< 缩略图合并因子
+	int writer_thread;	//< 图像存储线程数量, 各相机共用
+	int frame_depth;	//< 每台相机的图像缓冲区数量
+	bool hugepage;		//< 图像与包缓冲区采用2MB大页
+	int numa_node;		//< 图像与包缓冲区绑定的NUMA节点. -1: 不绑定
+	bool mem_lock;		//< 锁定图像与包缓冲区
+	std::string cpu_receive;	//< GY相机数据接收线程绑定的CPU列表. 空: 不绑定
+	bool gy_roi;		//< GY相机启用硬件ROI与合并. 偏移与合并寄存器地址未经确认, 默认禁用
+	std::string cpu_writer;		//< 图像存储线程绑定的CPU列表. 空: 不绑定
+	bool tucam_stream;	//< 鑫图相机启用连续采集模式
+	int tucam_ring;		//< 鑫图相机连续采集模式的SDK缓冲环帧数
+	int bkg_mesh;		//< 背景估计网格边长, 量纲: 像素
+	int bkg_filter;		//< 背景网格中值滤波窗口, 量纲: 网格
+	int bkg_thread;		//< 背景估计线程数. 0: 按CPU核数
+	bool detect;		//< 提取目标与调焦图像中的星像
+	double detect_sigma;//< 星像检测阈值, 量纲: 背景噪声
+	int detect_minarea;	//< 星像最少像素数
+	int saturate;		//< 饱和阈值, 量纲: ADU
+	int tilt_grid;		//< 焦面倾斜统计区域划分, grid×grid. 0: 不统计
+	int tilt_minstar;	//< 区域内参与统计的最少星像数
+	int shape_grid;		//< 星像形状统计区域划分, grid×grid. 0: 不统计
+	std::string psf_model;	//< PSF拟合模型: none, gauss或moffat
+	int psf_stamp;		//< PSF拟合子图边长, 量纲: 像素
+	int psf_maxstar;	//< 参与PSF拟合的最亮星像数
+	bool quality;		//< 检查目标与调焦图像质量, 未通过的图像不计入焦面统计
+	int quality_minstar;	//< 最少未饱和星像数
+	double quality_flux;	//< 星像流量中值与参考值之比的下限
+	double quality_satfrac;	//< 饱和星像比例上限
+	double quality_ellip;	//< 平均椭率相对参考值的增量上限
+	double quality_bkgjump;	//< 背景相对参考值的变化上限, 量纲: 背景噪声
+	int quality_retake;		//< 自动调焦时每个焦点位置最多重拍帧数. 0: 不重拍
+	std::string calib_path;	//< 合并本底/暗场/平场与坏像素表所在目录. 空: 不定标
 	std::string pathroot;//< 文件存储根路径
 
 public:
@@ -41,6 +83,8 @@ public:
 		ptree pt;
 		pt.add("version", "0.1");
 		pt.add("PortFocus", portFocus  = 4012);
+		pt.add("PortControl", portCtl  = 4013);
+		pt.add("PortMetrics", portMetrics = 4014);
 		pt.add("Device.<xmlattr>.group", grpid  = "001");
 		pt.add("Device.<xmlattr>.unit",  unitid = "001");
 		pt.add("stroke.<xmlattr>.start", stroke_start = -100);
@@ -48,12 +92,52 @@ public:
 		pt.add("stroke.<xmlattr>.step",  stroke_step = 10);
 		pt.add("stroke.<xmlattr>.backlash",  stroke_back = 50);
 		pt.add("stroke.<xmlattr>.error", focuser_error = 2);
+		pt.add("Focuser.<xmlattr>.driver", focuser_driver = "tcp");
+		pt.add("Focuser.<xmlattr>.speed",  focuser_speed  = 200.0);
+		pt.add("Focuser.<xmlattr>.settle", focuser_settle = 0.5);
+		pt.add("Focuser.<xmlattr>.noise",  focuser_noise  = 1);
+		pt.add("Focuser.<xmlattr>.period", focuser_period = 200);
+		pt.add("stroke.<xmlattr>.window", focus_window = 0);
 		pt.add("exposure.<xmlattr>.duration", expdur = 5);
 		pt.add("exposure.<xmlattr>.count", frmcnt = 1);
 		pt.add("FileServer.<xmlattr>.Enable", bfts = false);
 		pt.add("FileServer.<xmlattr>.IP", ipfts = "127.0.0.1");
 		pt.add("FileServer.<xmlattr>.Port", portfts = 4020);
 		pt.add("display", display = false);
+		pt.add("display.<xmlattr>.bin", display_bin = 2);
+		pt.add("preview", preview = false);
+		pt.add("preview.<xmlattr>.bin", preview_bin = 4);
+		pt.add("writer.<xmlattr>.thread", writer_thread = 2);
+		pt.add("writer.<xmlattr>.depth", frame_depth = 3);
+		pt.add("Memory.<xmlattr>.hugepage", hugepage = false);
+		pt.add("Memory.<xmlattr>.node", numa_node = -1);
+		pt.add("Memory.<xmlattr>.lock", mem_lock = false);
+		pt.add("Affinity.<xmlattr>.receive", cpu_receive = "");
+		pt.add("Affinity.<xmlattr>.writer", cpu_writer = "");
+		pt.add("GY.<xmlattr>.roi", gy_roi = false);
+		pt.add("Tucam.<xmlattr>.stream", tucam_stream = false);
+		pt.add("Tucam.<xmlattr>.ring", tucam_ring = 8);
+		pt.add("Calibration.<xmlattr>.path", calib_path = "");
+		pt.add("Background.<xmlattr>.mesh", bkg_mesh = 64);
+		pt.add("Background.<xmlattr>.filter", bkg_filter = 3);
+		pt.add("Background.<xmlattr>.thread", bkg_thread = 0);
+		pt.add("Detection.<xmlattr>.enable", detect = true);
+		pt.add("Detection.<xmlattr>.sigma", detect_sigma = 3.0);
+		pt.add("Detection.<xmlattr>.minarea", detect_minarea = 5);
+		pt.add("Detection.<xmlattr>.saturate", saturate = 60000);
+		pt.add("Tilt.<xmlattr>.grid", tilt_grid = 3);
+		pt.add("Tilt.<xmlattr>.minstar", tilt_minstar = 3);
+		pt.add("Shape.<xmlattr>.grid", shape_grid = 3);
+		pt.add("PSF.<xmlattr>.model", psf_model = "none");
+		pt.add("PSF.<xmlattr>.stamp", psf_stamp = 15);
+		pt.add("PSF.<xmlattr>.maxstar", psf_maxstar = 64);
+		pt.add("Quality.<xmlattr>.enable", quality = true);
+		pt.add("Quality.<xmlattr>.minstar", quality_minstar = 10);
+		pt.add("Quality.<xmlattr>.flux", quality_flux = 0.5);
+		pt.add("Quality.<xmlattr>.satfrac", quality_satfrac = 0.3);
+		pt.add("Quality.<xmlattr>.ellip", quality_ellip = 0.15);
+		pt.add("Quality.<xmlattr>.background", quality_bkgjump = 10.0);
+		pt.add("Quality.<xmlattr>.retake", quality_retake = 0);
 		pt.add("PathRoot", pathroot = "/data");
 
 		boost::property_tree::xml_writer_settings<std::string> settings(' ', 4);
@@ -68,6 +152,8 @@ public:
 		read_xml(filepath, pt, boost::property_tree::xml_parser::trim_whitespace);
 
 		portFocus  = pt.get("PortFocus", 4012);
+		portCtl    = pt.get("PortControl", 4013);
+		portMetrics = pt.get("PortMetrics", 4014);
 		grpid  = pt.get("Device.<xmlattr>.group", "001");
 		unitid = pt.get("Device.<xmlattr>.unit",  "001");
 		stroke_start = pt.get("stroke.<xmlattr>.start", -100);;
@@ -75,17 +161,62 @@ public:
 		stroke_step = pt.get("stroke.<xmlattr>.step",  10);
 		stroke_back = pt.get("stroke.<xmlattr>.backlash", 50);
 		focuser_error = pt.get("stroke.<xmlattr>.error", 2);
+		focuser_driver = pt.get("Focuser.<xmlattr>.driver", "tcp");
+		focuser_speed  = pt.get("Focuser.<xmlattr>.speed",  200.0);
+		focuser_settle = pt.get("Focuser.<xmlattr>.settle", 0.5);
+		focuser_noise  = pt.get("Focuser.<xmlattr>.noise",  1);
+		focuser_period = pt.get("Focuser.<xmlattr>.period", 200);
+		focus_window = pt.get("stroke.<xmlattr>.window", 0);
 		expdur = pt.get("exposure.<xmlattr>.duration", 2);
 		frmcnt = pt.get("exposure.<xmlattr>.count", 3);
 		bfts   = pt.get("FileServer.<xmlattr>.Enable", false);
 		ipfts  = pt.get("FileServer.<xmlattr>.IP", "127.0.0.1");
 		portfts  = pt.get("FileServer.<xmlattr>.Port", 4020);
 		display = pt.get("display", false);
+		display_bin = pt.get("display.<xmlattr>.bin", 2);
+		preview = pt.get("preview", false);
+		preview_bin = pt.get("preview.<xmlattr>.bin", 4);
+		writer_thread = pt.get("writer.<xmlattr>.thread", 2);
+		frame_depth = pt.get("writer.<xmlattr>.depth", 3);
+		hugepage  = pt.get("Memory.<xmlattr>.hugepage", false);
+		numa_node = pt.get("Memory.<xmlattr>.node", -1);
+		mem_lock  = pt.get("Memory.<xmlattr>.lock", false);
+		cpu_receive = pt.get("Affinity.<xmlattr>.receive", "");
+		cpu_writer  = pt.get("Affinity.<xmlattr>.writer", "");
+		gy_roi      = pt.get("GY.<xmlattr>.roi", false);
+		tucam_stream = pt.get("Tucam.<xmlattr>.stream", false);
+		tucam_ring = pt.get("Tucam.<xmlattr>.ring", 8);
+		calib_path = pt.get("Calibration.<xmlattr>.path", "");
+		bkg_mesh   = pt.get("Background.<xmlattr>.mesh", 64);
+		bkg_filter = pt.get("Background.<xmlattr>.filter", 3);
+		bkg_thread = pt.get("Background.<xmlattr>.thread", 0);
+		detect       = pt.get("Detection.<xmlattr>.enable", true);
+		detect_sigma = pt.get("Detection.<xmlattr>.sigma", 3.0);
+		detect_minarea = pt.get("Detection.<xmlattr>.minarea", 5);
+		saturate     = pt.get("Detection.<xmlattr>.saturate", 60000);
+		tilt_grid    = pt.get("Tilt.<xmlattr>.grid", 3);
+		tilt_minstar = pt.get("Tilt.<xmlattr>.minstar", 3);
+		shape_grid   = pt.get("Shape.<xmlattr>.grid", 3);
+		psf_model    = pt.get("PSF.<xmlattr>.model", "none");
+		psf_stamp    = pt.get("PSF.<xmlattr>.stamp", 15);
+		psf_maxstar  = pt.get("PSF.<xmlattr>.maxstar", 64);
+		quality         = pt.get("Quality.<xmlattr>.enable", true);
+		quality_minstar = pt.get("Quality.<xmlattr>.minstar", 10);
+		quality_flux    = pt.get("Quality.<xmlattr>.flux", 0.5);
+		quality_satfrac = pt.get("Quality.<xmlattr>.satfrac", 0.3);
+		quality_ellip   = pt.get("Quality.<xmlattr>.ellip", 0.15);
+		quality_bkgjump = pt.get("Quality.<xmlattr>.background", 10.0);
+		quality_retake  = pt.get("Quality.<xmlattr>.retake", 0);
 		pathroot= pt.get("PathRoot", "/data");
 		boost::trim_right_if(pathroot, boost::is_punct() || boost::is_space());
 
 		if (stroke_step == 0) stroke_step = 10;
 		if (focuser_error <= 0) focuser_error = 2;
+		if (focuser_speed <= 0.0) focuser_speed = 200.0;
+		if (focuser_settle < 0.0) focuser_settle = 0.0;
+		if (focuser_noise < 0) focuser_noise = 0;
+		if (focuser_period < 10) focuser_period = 200;
+		if (focus_window < 0) focus_window = 0;
 		if ((stroke_start > stroke_stop && stroke_step > 0)
 				|| (stroke_start < stroke_stop && stroke_step < 0))
 			stroke_step *= -1;
@@ -94,6 +225,28 @@ public:
 			stroke_back *= -1;
 		if (expdur <= 1E-6) expdur = 2.0;
 		if (frmcnt <= 0) frmcnt = 1;
+		if (display_bin <= 0) display_bin = 1;
+		if (preview_bin <= 0) preview_bin = 1;
+		if (writer_thread <= 0) writer_thread = 1;
+		if (frame_depth < 2) frame_depth = 2;
+		if (tucam_ring < 2) tucam_ring = 2;
+		if (bkg_mesh < 16) bkg_mesh = 16;
+		if (bkg_thread < 0) bkg_thread = 0;
+		if (detect_sigma <= 0.0) detect_sigma = 3.0;
+		if (detect_minarea < 1) detect_minarea = 1;
+		if (saturate <= 0 || saturate > 65535) saturate = 60000;
+		if (tilt_grid < 0) tilt_grid = 0;
+		else if (tilt_grid > 9) tilt_grid = 9;
+		if (tilt_minstar < 1) tilt_minstar = 1;
+		if (shape_grid < 0) shape_grid = 0;
+		else if (shape_grid > 9) shape_grid = 9;
+		if (psf_stamp < 5) psf_stamp = 5;
+		if (psf_maxstar < 1) psf_maxstar = 1;
+		if (quality_minstar < 0) quality_minstar = 0;
+		if (quality_satfrac <= 0.0) quality_satfrac = 0.3;
+		if (quality_ellip <= 0.0) quality_ellip = 0.15;
+		if (quality_bkgjump <= 0.0) quality_bkgjump = 10.0;
+		if (quality_retake < 0) quality_retake = 0;
 	}
 };
 
@@ -0,0 +1,159 @@
+/*
+ * @file pipetrace.cpp 曝光流程各阶段耗时统计定义文件
+ * @date 2026-10-18
+ * @version 0.1
+ */
+
+#include <time.h>
+#include <stdio.h>
+#include <string.h>
+#include "pipetrace.h"
+
+#define SUB_BITS		4						// 每个量级的线性分桶位数
+#define SUB_COUNT		(1 << SUB_BITS)			// 每个量级的线性分桶数
+#define MAX_BITS		40						// 可记录最大耗时: 2^40微秒
+#define BUCKET_COUNT	((MAX_BITS - SUB_BITS + 1) * SUB_COUNT)
+
+struct latency_hist {// 耗时直方图
+	uint64_t count[BUCKET_COUNT];	//< 分桶计数
+	uint64_t total;	//< 总数
+	uint64_t sum;	//< 累计耗时, 量纲: 微秒
+	uint64_t max;	//< 最大耗时, 量纲: 微秒
+};
+
+static latency_hist hists[TS_LAST];
+
+static const char *stage_name[] = {
+	"expose_cmd", "integrate", "first_packet", "last_packet",
+	"download", "display", "analyse", "save", "upload", "focus_rtt", "focus_move"
+};
+
+static const char *stage_key[] = {
+	"LT_EXPCM", "LT_INTEG", "LT_FPACK", "LT_LPACK",
+	"LT_DNLD", "LT_DISP", "LT_ANALY", "LT_SAVE", "LT_UPLD", "LT_FOCRT", "LT_FOCMV"
+};
+
+/*!
+ * @brief 计算耗时对应的分桶
+ * @param v 耗时
+ * @return
+ * 分桶索引
+ */
+static int bucket_index(uint64_t v) {
+	if (v < SUB_COUNT) return int(v);
+	int shift = 63 - __builtin_clzll(v) - SUB_BITS;
+	int idx = (shift + 1) * SUB_COUNT + int((v >> shift) - SUB_COUNT);
+	return idx < BUCKET_COUNT ? idx : BUCKET_COUNT - 1;
+}
+
+/*!
+ * @brief 计算分桶代表值: 分桶中点
+ * @param idx 分桶索引
+ * @return
+ * 耗时
+ */
+static uint64_t bucket_value(int idx) {
+	if (idx < SUB_COUNT) return uint64_t(idx);
+	int shift = idx / SUB_COUNT - 1;
+	uint64_t low = uint64_t(SUB_COUNT + idx % SUB_COUNT) << shift;
+	return low + ((uint64_t(1) << shift) >> 1);
+}
+
+/*!
+ * @brief 由直方图计算分位数
+ * @param hist  直方图
+ * @param total 总数
+ * @param p     分位, 0-1
+ * @return
+ * 耗时
+ */
+static uint64_t percentile(const latency_hist &hist, uint64_t total, double p) {
+	uint64_t target = uint64_t(p * total + 0.5), sum(0);
+	if (target < 1) target = 1;
+	for (int i = 0; i < BUCKET_COUNT; ++i) {
+		if ((sum += hist.count[i]) >= target) return bucket_value(i);
+	}
+	return hist.max;
+}
+
+int64_t trace_now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return int64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+const char *trace_stage_name(int stage) {
+	return stage >= 0 && stage < TS_LAST ? stage_name[stage] : "";
+}
+
+const char *trace_stage_key(int stage) {
+	return stage >= 0 && stage < TS_LAST ? stage_key[stage] : "";
+}
+
+void trace_record(int stage, int64_t us) {
+	if (stage < 0 || stage >= TS_LAST || us < 0) return;
+
+	latency_hist &hist = hists[stage];
+	uint64_t v = uint64_t(us), old;
+	__sync_fetch_and_add(&hist.count[bucket_index(v)], 1);
+	__sync_fetch_and_add(&hist.total, 1);
+	__sync_fetch_and_add(&hist.sum, v);
+	while (v > (old = hist.max) && !__sync_bool_compare_and_swap(&hist.max, old, v));
+}
+
+void trace_summary(int stage, trace_stat &stat) {
+	memset(&stat, 0, sizeof(trace_stat));
+	if (stage < 0 || stage >= TS_LAST) return;
+
+	const latency_hist &hist = hists[stage];
+	if ((stat.count = hist.total) > 0) {
+		stat.sum = hist.sum;
+		stat.p50 = percentile(hist, stat.count, 0.50);
+		stat.p90 = percentile(hist, stat.count, 0.90);
+		stat.p99 = percentile(hist, stat.count, 0.99);
+		stat.max = hist.max;
+	}
+}
+
+void trace_dump(std::vector<std::string> &lines) {
+	char buff[200];
+	trace_stat stat;
+
+	lines.clear();
+	sprintf(buff, "%-12s %8s %10s %10s %10s %10s %10s  (us)", "stage", "count", "mean", "p50", "p90", "p99", "max");
+	lines.push_back(buff);
+	for (int i = 0; i < TS_LAST; ++i) {
+		trace_summary(i, stat);
+		if (!stat.count) continue;
+		sprintf(buff, "%-12s %8lu %10lu %10lu %10lu %10lu %10lu", stage_name[i],
+				(unsigned long) stat.count, (unsigned long) (stat.sum / stat.count),
+				(unsigned long) stat.p50, (unsigned long) stat.p90,
+				(unsigned long) stat.p99, (unsigned long) stat.max);
+		lines.push_back(buff);
+	}
+}
+
+void trace_reset() {
+	memset(hists, 0, sizeof(hists));
+}
+
+void frame_trace::settle(double expdur) {
+	const int ids[] = {TS_EXPOSE_CMD, TS_INTEGRATE, TS_FIRST_PACKET, TS_LAST_PACKET, TS_DOWNLOAD};
+	int64_t *p = point;
+	int end = p[TP_FIRST_PACKET] >= 0 ? TP_FIRST_PACKET : TP_IMGRDY;
+
+	if (p[TP_EXPOSE_BEGIN] >= 0 && p[TP_EXPOSE_START] >= 0)
+		stage[TS_EXPOSE_CMD] = p[TP_EXPOSE_START] - p[TP_EXPOSE_BEGIN];
+	if (p[TP_EXPOSE_START] >= 0 && p[end] >= 0)
+		stage[TS_INTEGRATE] = p[end] - p[TP_EXPOSE_START];
+	if (p[TP_EXPOSE_START] >= 0 && p[TP_FIRST_PACKET] >= 0) {
+		int64_t dt = p[TP_FIRST_PACKET] - p[TP_EXPOSE_START] - int64_t(expdur * 1E6);
+		stage[TS_FIRST_PACKET] = dt < 0 ? 0 : dt;
+	}
+	if (p[TP_FIRST_PACKET] >= 0 && p[TP_LAST_PACKET] >= 0)
+		stage[TS_LAST_PACKET] = p[TP_LAST_PACKET] - p[TP_FIRST_PACKET];
+	if (p[TP_IMGRDY] >= 0 && p[TP_DOWNLOAD] >= 0)
+		stage[TS_DOWNLOAD] = p[TP_DOWNLOAD] - p[TP_IMGRDY];
+
+	for (int i = 0; i < int(sizeof(ids) / sizeof(int)); ++i) trace_record(ids[i], stage[ids[i]]);
+}
@@ -0,0 +1,126 @@
+/*
+ * @file pipetrace.h 曝光流程各阶段耗时统计声明文件
+ * @date 2026-10-18
+ * @version 0.1
+ * @note
+ * - 时间戳采用单调时钟(CLOCK_MONOTONIC), 量纲: 微秒
+ * - 各阶段耗时累计为对数-线性分桶直方图(HDR风格), 相对误差不超过1/16
+ * - 直方图计数采用原子操作, 记录耗时不加锁
+ */
+
+#ifndef PIPETRACE_H_
+#define PIPETRACE_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+enum TRACE_POINT {// 单帧时间点
+	TP_EXPOSE_BEGIN,	// 开始发送曝光指令
+	TP_EXPOSE_START,	// 曝光指令完成, 开始积分
+	TP_IMGRDY,			// 检测到积分结束
+	TP_FIRST_PACKET,	// 收到首个数据包. 仅网络相机
+	TP_LAST_PACKET,		// 收到最后一个数据包. 仅网络相机
+	TP_DOWNLOAD,		// 完成读出
+	TP_LAST				// 占位
+};
+
+enum TRACE_STAGE {// 流程阶段
+	TS_EXPOSE_CMD,		// 曝光指令(寄存器写入)
+	TS_INTEGRATE,		// 积分, 至收到首个数据包或检测到积分结束
+	TS_FIRST_PACKET,	// 名义积分结束至收到首个数据包
+	TS_LAST_PACKET,		// 首个数据包至最后一个数据包
+	TS_DOWNLOAD,		// DownloadImage()
+	TS_DISPLAY,			// 投递显示
+	TS_ANALYSE,			// 定标、背景估计与星像提取
+	TS_SAVE,			// 存储FITS文件
+	TS_UPLOAD,			// 投递上传
+	TS_FOCUS_RTT,		// 调焦指令往返: 发送目标位置至收到位置反馈
+	TS_FOCUS_MOVE,		// 调焦: 发送目标位置至到位, 含消隙
+	TS_LAST				// 占位
+};
+
+struct trace_stat {// 阶段耗时统计, 量纲: 微秒
+	uint64_t count;	//< 数量
+	uint64_t sum;	//< 累计耗时
+	uint64_t p50, p90, p99;	//< 分位数
+	uint64_t max;	//< 最大耗时
+};
+
+/*!
+ * @brief 查看单调时钟时间
+ * @return
+ * 时间, 量纲: 微秒
+ */
+extern int64_t trace_now();
+/*!
+ * @brief 查看阶段名称
+ * @param stage 阶段
+ * @return
+ * 名称
+ */
+extern const char *trace_stage_name(int stage);
+/*!
+ * @brief 查看阶段对应的FITS关键字
+ * @param stage 阶段
+ * @return
+ * 关键字
+ */
+extern const char *trace_stage_key(int stage);
+/*!
+ * @brief 将阶段耗时计入直方图
+ * @param stage 阶段
+ * @param us    耗时, 量纲: 微秒
+ */
+extern void trace_record(int stage, int64_t us);
+/*!
+ * @brief 查看阶段耗时统计
+ * @param stage 阶段
+ * @param stat  统计结果
+ */
+extern void trace_summary(int stage, trace_stat &stat);
+/*!
+ * @brief 输出各阶段耗时统计
+ * @param lines 统计结果, 每阶段一行
+ */
+extern void trace_dump(std::vector<std::string> &lines);
+/*!
+ * @brief 清除各阶段耗时统计
+ */
+extern void trace_reset();
+
+struct frame_trace {// 单帧时间点与阶段耗时. 未记录时为-1
+	int64_t point[TP_LAST];	//< 时间点, 量纲: 微秒
+	int64_t stage[TS_LAST];	//< 阶段耗时, 量纲: 微秒
+
+public:
+	frame_trace() {
+		reset();
+	}
+
+	void reset() {
+		for (int i = 0; i < TP_LAST; ++i) point[i] = -1;
+		for (int i = 0; i < TS_LAST; ++i) stage[i] = -1;
+	}
+
+	void mark(int tp) {
+		point[tp] = trace_now();
+	}
+
+	/*!
+	 * @brief 由时间点计算相机端各阶段耗时, 并计入直方图
+	 * @param expdur 名义曝光时间, 量纲: 秒
+	 */
+	void settle(double expdur);
+
+	/*!
+	 * @brief 记录阶段耗时, 并计入直方图
+	 * @param st 阶段
+	 * @param t0 阶段起始时间, 量纲: 微秒
+	 */
+	void finish(int st, int64_t t0) {
+		trace_record(st, stage[st] = trace_now() - t0);
+	}
+};
+
+#endif /* PIPETRACE_H_ */
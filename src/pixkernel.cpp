@@ -0,0 +1,874 @@
+/*
+ * @file pixkernel.cpp 图像像素级核函数定义文件
+ * @date 2026-10-18
+ * @version 0.1
+ * @note
+ * 16位图像存储为FITS时, v - 32768等价于v ^ 0x8000, 因此减BZERO与字节交换合并为:
+ * dst = bswap16(v) ^ 0x0080
+ */
+
+#include <string.h>
+#include <math.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PIXKERNEL_X86
+#endif
+#include <boost/smart_ptr.hpp>
+#include <boost/thread/once.hpp>
+#include "pixkernel.h"
+
+//////////////////////////////////////////////////////////////////////////////
+/* 标量实现 */
+static void swap_offset_u16_scalar(const uint16_t *src, uint16_t *dst, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		uint16_t v = src[i];
+		dst[i] = uint16_t((v << 8) | (v >> 8)) ^ 0x0080;
+	}
+}
+
+static void bin_u16_scalar(const uint16_t *src, int width, int height, int bin, uint16_t *dst) {
+	int wbin(width / bin), hbin(height / bin), nbin(bin * bin);
+	boost::scoped_array<uint32_t> sum(new uint32_t[wbin]);
+
+	for (int j = 0; j < hbin; ++j, dst += wbin) {
+		memset(sum.get(), 0, wbin * sizeof(uint32_t));
+		for (int k = 0; k < bin; ++k, src += width) {
+			const uint16_t *row = src;
+			for (int i = 0; i < wbin; ++i) {
+				for (int m = 0; m < bin; ++m, ++row) sum[i] += *row;
+			}
+		}
+		for (int i = 0; i < wbin; ++i) dst[i] = uint16_t(sum[i] / nbin);
+	}
+}
+
+static void accum_minmax_u16_scalar(const uint16_t *src, uint32_t *sum, uint16_t *lo, uint16_t *hi, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		uint16_t v = src[i];
+		sum[i] += v;
+		if (v < lo[i]) lo[i] = v;
+		if (v > hi[i]) hi[i] = v;
+	}
+}
+
+static void calib_u16_scalar(const uint16_t *raw, const uint16_t *offset, const float *gain, float pedestal,
+		uint16_t *dst, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		float v = (float(raw[i]) - float(offset[i])) * gain[i] + pedestal;
+		if (v < 0.0f) v = 0.0f;
+		else if (v > 65535.0f) v = 65535.0f;
+		dst[i] = uint16_t(lrintf(v));
+	}
+}
+
+static void mask_fill_u16_scalar(const uint16_t *src, const uint8_t *bits, size_t bit0, uint16_t *dst, size_t n) {
+	for (size_t i = 0, k = bit0; i < n; ++i, ++k) {
+		uint16_t m = uint16_t(-((bits[k >> 3] >> (k & 7)) & 1));
+		uint16_t nb = i ? src[i - 1] : src[n > 1];
+		dst[i] = uint16_t((nb & m) | (src[i] & ~m));
+	}
+}
+
+static void shape_f32_scalar(const float *x2, const float *y2, const float *xy, float *e1, float *e2, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		float r = 1.0f / (x2[i] + y2[i]);
+		e1[i] = (x2[i] - y2[i]) * r;
+		e2[i] = 2.0f * xy[i] * r;
+	}
+}
+
+/*!
+ * @brief 累加一个像素对法方程的贡献
+ * @param j   模型对各参数的偏导数
+ * @param np  参数个数
+ * @param r   残差: 像素值 - 模型值
+ * @param l   批次内序号
+ */
+static inline void psf_accum_scalar(const float *j, int np, float r, float *jtj, float *jtr, float *chi2, int l) {
+	for (int a = 0, k = 0; a < np; ++a) {
+		jtr[a * PSF_LANES + l] += j[a] * r;
+		for (int b = a; b < np; ++b, ++k) jtj[k * PSF_LANES + l] += j[a] * j[b];
+	}
+	chi2[l] += r * r;
+}
+
+static void gauss_normal_f32_scalar(const float *pix, int size, const float *par, float *jtj, float *jtr, float *chi2) {
+	float j[5], dx, dy, r2, s, q, e;
+
+	memset(jtj, 0, 15 * PSF_LANES * sizeof(float));
+	memset(jtr, 0, 5 * PSF_LANES * sizeof(float));
+	memset(chi2, 0, PSF_LANES * sizeof(float));
+	for (int gy = 0; gy < size; ++gy) {
+		for (int gx = 0; gx < size; ++gx, pix += PSF_LANES) {
+			for (int l = 0; l < PSF_LANES; ++l) {
+				dx = gx - par[2 * PSF_LANES + l];
+				dy = gy - par[3 * PSF_LANES + l];
+				s  = par[4 * PSF_LANES + l];
+				r2 = dx * dx + dy * dy;
+				q  = 1.0f / (s * s);
+				e  = expf(-0.5f * r2 * q);
+				j[0] = 1.0f;
+				j[1] = e;
+				j[2] = par[PSF_LANES + l] * e * q * dx;
+				j[3] = par[PSF_LANES + l] * e * q * dy;
+				j[4] = par[PSF_LANES + l] * e * q * r2 / s;
+				psf_accum_scalar(j, 5, pix[l] - par[l] - par[PSF_LANES + l] * e, jtj, jtr, chi2, l);
+			}
+		}
+	}
+}
+
+static void moffat_normal_f32_scalar(const float *pix, int size, const float *par, float *jtj, float *jtr, float *chi2) {
+	float j[6], dx, dy, r2, alpha, beta, ia2, u, lu, g, c;
+
+	memset(jtj, 0, 21 * PSF_LANES * sizeof(float));
+	memset(jtr, 0, 6 * PSF_LANES * sizeof(float));
+	memset(chi2, 0, PSF_LANES * sizeof(float));
+	for (int gy = 0; gy < size; ++gy) {
+		for (int gx = 0; gx < size; ++gx, pix += PSF_LANES) {
+			for (int l = 0; l < PSF_LANES; ++l) {
+				dx = gx - par[2 * PSF_LANES + l];
+				dy = gy - par[3 * PSF_LANES + l];
+				alpha = par[4 * PSF_LANES + l];
+				beta  = par[5 * PSF_LANES + l];
+				r2  = dx * dx + dy * dy;
+				ia2 = 1.0f / (alpha * alpha);
+				u   = 1.0f + r2 * ia2;
+				lu  = logf(u);
+				g   = expf(-beta * lu);
+				c   = 2.0f * par[PSF_LANES + l] * beta * g * ia2 / u;
+				j[0] = 1.0f;
+				j[1] = g;
+				j[2] = c * dx;
+				j[3] = c * dy;
+				j[4] = c * r2 / alpha;
+				j[5] = -par[PSF_LANES + l] * g * lu;
+				psf_accum_scalar(j, 6, pix[l] - par[l] - par[PSF_LANES + l] * g, jtj, jtr, chi2, l);
+			}
+		}
+	}
+}
+
+/*!
+ * @brief 合并: 将纵向累加后的像素对之和归并为输出像素
+ * @param acc  像素对之和, 每个像素对已减去2×32768
+ * @param wbin 输出宽度
+ * @param bin  合并因子, 偶数
+ * @param dst  输出
+ */
+static void bin_reduce_pairs(const int32_t *acc, int wbin, int bin, uint16_t *dst) {
+	int half(bin / 2), nbin(bin * bin), bias(32768 * nbin);
+	for (int i = 0; i < wbin; ++i, acc += half) {
+		int32_t sum(bias);
+		for (int m = 0; m < half; ++m) sum += acc[m];
+		dst[i] = uint16_t(sum / nbin);
+	}
+}
+
+#ifdef PIXKERNEL_X86
+/* SSE2实现 */
+__attribute__((target("sse2")))
+static void swap_offset_u16_sse2(const uint16_t *src, uint16_t *dst, size_t n) {
+	const __m128i mask = _mm_set1_epi16(0x0080);
+	size_t i(0);
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i v0 = _mm_loadu_si128((const __m128i*) (src + i));
+		__m128i v1 = _mm_loadu_si128((const __m128i*) (src + i + 8));
+		v0 = _mm_xor_si128(_mm_or_si128(_mm_slli_epi16(v0, 8), _mm_srli_epi16(v0, 8)), mask);
+		v1 = _mm_xor_si128(_mm_or_si128(_mm_slli_epi16(v1, 8), _mm_srli_epi16(v1, 8)), mask);
+		_mm_storeu_si128((__m128i*) (dst + i), v0);
+		_mm_storeu_si128((__m128i*) (dst + i + 8), v1);
+	}
+	swap_offset_u16_scalar(src + i, dst + i, n - i);
+}
+
+/*
+ * 合并因子为偶数时, 像素异或0x8000转换为有符号数后, 由madd一次完成相邻像素对求和,
+ * 再纵向累加bin行, 最后由bin_reduce_pairs()归并
+ */
+__attribute__((target("sse2")))
+static void bin_u16_sse2(const uint16_t *src, int width, int height, int bin, uint16_t *dst) {
+	if (bin & 1) {
+		bin_u16_scalar(src, width, height, bin, dst);
+		return;
+	}
+
+	int wbin(width / bin), hbin(height / bin), npair(wbin * bin / 2), i;
+	boost::scoped_array<int32_t> acc(new int32_t[npair]);
+	const __m128i flip = _mm_set1_epi16(short(0x8000));
+	const __m128i ones = _mm_set1_epi16(1);
+
+	for (int j = 0; j < hbin; ++j, dst += wbin) {
+		memset(acc.get(), 0, npair * sizeof(int32_t));
+		for (int k = 0; k < bin; ++k, src += width) {
+			int32_t *ptr = acc.get();
+			for (i = 0; i + 4 <= npair; i += 4) {
+				__m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*) (src + 2 * i)), flip);
+				__m128i a = _mm_loadu_si128((const __m128i*) (ptr + i));
+				_mm_storeu_si128((__m128i*) (ptr + i), _mm_add_epi32(a, _mm_madd_epi16(v, ones)));
+			}
+			for (; i < npair; ++i) ptr[i] += int32_t(src[2 * i]) + src[2 * i + 1] - 65536;
+		}
+		bin_reduce_pairs(acc.get(), wbin, bin, dst);
+	}
+}
+
+/*
+ * SSE2无无符号16位极值指令, 异或0x8000转换为有符号数比较后再转换回来
+ */
+__attribute__((target("sse2")))
+static void accum_minmax_u16_sse2(const uint16_t *src, uint32_t *sum, uint16_t *lo, uint16_t *hi, size_t n) {
+	const __m128i flip = _mm_set1_epi16(short(0x8000));
+	const __m128i zero = _mm_setzero_si128();
+	size_t i(0);
+
+	for (; i + 8 <= n; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+		__m128i s0 = _mm_loadu_si128((const __m128i*) (sum + i));
+		__m128i s1 = _mm_loadu_si128((const __m128i*) (sum + i + 4));
+		__m128i vs = _mm_xor_si128(v, flip);
+		__m128i l = _mm_xor_si128(_mm_loadu_si128((const __m128i*) (lo + i)), flip);
+		__m128i h = _mm_xor_si128(_mm_loadu_si128((const __m128i*) (hi + i)), flip);
+		_mm_storeu_si128((__m128i*) (sum + i), _mm_add_epi32(s0, _mm_unpacklo_epi16(v, zero)));
+		_mm_storeu_si128((__m128i*) (sum + i + 4), _mm_add_epi32(s1, _mm_unpackhi_epi16(v, zero)));
+		_mm_storeu_si128((__m128i*) (lo + i), _mm_xor_si128(_mm_min_epi16(l, vs), flip));
+		_mm_storeu_si128((__m128i*) (hi + i), _mm_xor_si128(_mm_max_epi16(h, vs), flip));
+	}
+	accum_minmax_u16_scalar(src + i, sum + i, lo + i, hi + i, n - i);
+}
+
+/*
+ * SSE2无32位无符号饱和打包指令, 减32768后以有符号饱和打包, 再加回32768
+ */
+__attribute__((target("sse2")))
+static void calib_u16_sse2(const uint16_t *raw, const uint16_t *offset, const float *gain, float pedestal,
+		uint16_t *dst, size_t n) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i bias = _mm_set1_epi32(32768);
+	const __m128i flip = _mm_set1_epi16(short(0x8000));
+	const __m128 ped = _mm_set1_ps(pedestal);
+	const __m128 fmin = _mm_setzero_ps();
+	const __m128 fmax = _mm_set1_ps(65535.0f);
+	size_t i(0);
+
+	for (; i + 8 <= n; i += 8) {
+		__m128i r = _mm_loadu_si128((const __m128i*) (raw + i));
+		__m128i o = _mm_loadu_si128((const __m128i*) (offset + i));
+		__m128 f0 = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_unpacklo_epi16(r, zero), _mm_unpacklo_epi16(o, zero)));
+		__m128 f1 = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_unpackhi_epi16(r, zero), _mm_unpackhi_epi16(o, zero)));
+		f0 = _mm_add_ps(_mm_mul_ps(f0, _mm_loadu_ps(gain + i)), ped);
+		f1 = _mm_add_ps(_mm_mul_ps(f1, _mm_loadu_ps(gain + i + 4)), ped);
+		f0 = _mm_min_ps(_mm_max_ps(f0, fmin), fmax);
+		f1 = _mm_min_ps(_mm_max_ps(f1, fmin), fmax);
+		__m128i v = _mm_packs_epi32(_mm_sub_epi32(_mm_cvtps_epi32(f0), bias), _mm_sub_epi32(_mm_cvtps_epi32(f1), bias));
+		_mm_storeu_si128((__m128i*) (dst + i), _mm_xor_si128(v, flip));
+	}
+	calib_u16_scalar(raw + i, offset + i, gain + i, pedestal, dst + i, n - i);
+}
+
+/*
+ * 取位图中连续8位, 扩展为8个16位掩码
+ */
+__attribute__((target("sse2")))
+static void mask_fill_u16_sse2(const uint16_t *src, const uint8_t *bits, size_t bit0, uint16_t *dst, size_t n) {
+	const __m128i sel = _mm_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128);
+	size_t i(1), k;
+	uint16_t word;
+
+	if (n < 2) {
+		mask_fill_u16_scalar(src, bits, bit0, dst, n);
+		return;
+	}
+	uint16_t m0 = uint16_t(-((bits[bit0 >> 3] >> (bit0 & 7)) & 1));
+	dst[0] = uint16_t((src[1] & m0) | (src[0] & ~m0));
+	for (; i + 8 <= n; i += 8) {
+		k = bit0 + i;
+		memcpy(&word, bits + (k >> 3), sizeof(word));
+		__m128i m = _mm_and_si128(_mm_set1_epi16(short(word >> (k & 7))), sel);
+		m = _mm_cmpeq_epi16(m, sel);
+		__m128i cur = _mm_loadu_si128((const __m128i*) (src + i));
+		__m128i left = _mm_loadu_si128((const __m128i*) (src + i - 1));
+		_mm_storeu_si128((__m128i*) (dst + i), _mm_or_si128(_mm_and_si128(m, left), _mm_andnot_si128(m, cur)));
+	}
+	for (k = bit0 + i; i < n; ++i, ++k) {
+		uint16_t m = uint16_t(-((bits[k >> 3] >> (k & 7)) & 1));
+		dst[i] = uint16_t((src[i - 1] & m) | (src[i] & ~m));
+	}
+}
+
+__attribute__((target("sse2")))
+static void shape_f32_sse2(const float *x2, const float *y2, const float *xy, float *e1, float *e2, size_t n) {
+	const __m128 two = _mm_set1_ps(2.0f);
+	size_t i(0);
+
+	for (; i + 4 <= n; i += 4) {
+		__m128 a = _mm_loadu_ps(x2 + i);
+		__m128 b = _mm_loadu_ps(y2 + i);
+		__m128 r = _mm_div_ps(_mm_set1_ps(1.0f), _mm_add_ps(a, b));
+		_mm_storeu_ps(e1 + i, _mm_mul_ps(_mm_sub_ps(a, b), r));
+		_mm_storeu_ps(e2 + i, _mm_mul_ps(_mm_mul_ps(two, _mm_loadu_ps(xy + i)), r));
+	}
+	shape_f32_scalar(x2 + i, y2 + i, xy + i, e1 + i, e2 + i, n - i);
+}
+
+/*
+ * exp与log采用Cephes多项式逼近, 相对误差约1E-7
+ */
+__attribute__((target("sse2")))
+static inline __m128 exp_ps_sse2(__m128 x) {
+	const __m128 one = _mm_set1_ps(1.0f);
+	__m128 fx, tmp, y, z;
+	__m128i emm0;
+
+	x  = _mm_max_ps(_mm_min_ps(x, _mm_set1_ps(88.3762626647949f)), _mm_set1_ps(-88.3762626647949f));
+	fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341f)), _mm_set1_ps(0.5f));
+	tmp = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+	fx = _mm_sub_ps(tmp, _mm_and_ps(_mm_cmpgt_ps(tmp, fx), one)); // floor
+	x  = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(0.693359375f)));
+	x  = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(-2.12194440e-4f)));
+	z  = _mm_mul_ps(x, x);
+	y  = _mm_set1_ps(1.9875691500E-4f);
+	y  = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.3981999507E-3f));
+	y  = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(8.3334519073E-3f));
+	y  = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(4.1665795894E-2f));
+	y  = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.6666665459E-1f));
+	y  = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(5.0000001201E-1f));
+	y  = _mm_add_ps(_mm_add_ps(_mm_mul_ps(y, z), x), one);
+	emm0 = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(fx), _mm_set1_epi32(0x7f)), 23);
+	return _mm_mul_ps(y, _mm_castsi128_ps(emm0));
+}
+
+/*
+ * 仅用于x >= 1
+ */
+__attribute__((target("sse2")))
+static inline __m128 log_ps_sse2(__m128 x) {
+	const __m128 one = _mm_set1_ps(1.0f);
+	__m128 e, mask, tmp, y, z;
+	__m128i emm0;
+
+	emm0 = _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(x), 23), _mm_set1_epi32(0x7f));
+	x = _mm_or_ps(_mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(~0x7f800000))), _mm_set1_ps(0.5f));
+	e = _mm_add_ps(_mm_cvtepi32_ps(emm0), one);
+	mask = _mm_cmplt_ps(x, _mm_set1_ps(0.707106781186547524f));
+	tmp = _mm_and_ps(x, mask);
+	x = _mm_add_ps(_mm_sub_ps(x, one), tmp);
+	e = _mm_sub_ps(e, _mm_and_ps(one, mask));
+	z = _mm_mul_ps(x, x);
+	y = _mm_set1_ps(7.0376836292E-2f);
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.1514610310E-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.1676998740E-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.2420140846E-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.4249322787E-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.6668057665E-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(2.0000714765E-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-2.4999993993E-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(3.3333331174E-1f));
+	y = _mm_mul_ps(_mm_mul_ps(y, x), z);
+	y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(-2.12194440e-4f)));
+	y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+	x = _mm_add_ps(x, y);
+	return _mm_add_ps(x, _mm_mul_ps(e, _mm_set1_ps(0.693359375f)));
+}
+
+/*
+ * 每次处理4个星像, 批次内分两半执行. 法方程累加量保存在局部数组中, 最后写回
+ */
+__attribute__((target("sse2")))
+static void gauss_normal_f32_sse2(const float *pix, int size, const float *par, float *jtj, float *jtr, float *chi2) {
+	for (int h = 0; h < PSF_LANES; h += 4) {
+		__m128 aj[15], ar[5], ac = _mm_setzero_ps(), j[5];
+		__m128 x0 = _mm_loadu_ps(par + 2 * PSF_LANES + h), y0 = _mm_loadu_ps(par + 3 * PSF_LANES + h);
+		__m128 b0 = _mm_loadu_ps(par + h), amp = _mm_loadu_ps(par + PSF_LANES + h);
+		__m128 s = _mm_loadu_ps(par + 4 * PSF_LANES + h);
+		__m128 q = _mm_div_ps(_mm_set1_ps(1.0f), _mm_mul_ps(s, s)), is = _mm_div_ps(_mm_set1_ps(1.0f), s);
+		__m128 nhq = _mm_mul_ps(q, _mm_set1_ps(-0.5f));
+		const float *ptr = pix + h;
+		int a, b, k;
+
+		for (k = 0; k < 15; ++k) aj[k] = _mm_setzero_ps();
+		for (k = 0; k < 5; ++k) ar[k] = _mm_setzero_ps();
+		j[0] = _mm_set1_ps(1.0f);
+		for (int gy = 0; gy < size; ++gy) {
+			__m128 dy = _mm_sub_ps(_mm_set1_ps(float(gy)), y0);
+			for (int gx = 0; gx < size; ++gx, ptr += PSF_LANES) {
+				__m128 dx = _mm_sub_ps(_mm_set1_ps(float(gx)), x0);
+				__m128 r2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+				__m128 e = exp_ps_sse2(_mm_mul_ps(r2, nhq));
+				__m128 aeq = _mm_mul_ps(_mm_mul_ps(amp, e), q);
+				__m128 r = _mm_sub_ps(_mm_loadu_ps(ptr), _mm_add_ps(b0, _mm_mul_ps(amp, e)));
+				j[1] = e;
+				j[2] = _mm_mul_ps(aeq, dx);
+				j[3] = _mm_mul_ps(aeq, dy);
+				j[4] = _mm_mul_ps(_mm_mul_ps(aeq, r2), is);
+				for (a = 0, k = 0; a < 5; ++a) {
+					ar[a] = _mm_add_ps(ar[a], _mm_mul_ps(j[a], r));
+					for (b = a; b < 5; ++b, ++k) aj[k] = _mm_add_ps(aj[k], _mm_mul_ps(j[a], j[b]));
+				}
+				ac = _mm_add_ps(ac, _mm_mul_ps(r, r));
+			}
+		}
+		for (k = 0; k < 15; ++k) _mm_storeu_ps(jtj + k * PSF_LANES + h, aj[k]);
+		for (k = 0; k < 5; ++k) _mm_storeu_ps(jtr + k * PSF_LANES + h, ar[k]);
+		_mm_storeu_ps(chi2 + h, ac);
+	}
+}
+
+__attribute__((target("sse2")))
+static void moffat_normal_f32_sse2(const float *pix, int size, const float *par, float *jtj, float *jtr, float *chi2) {
+	for (int h = 0; h < PSF_LANES; h += 4) {
+		__m128 aj[21], ar[6], ac = _mm_setzero_ps(), j[6];
+		__m128 x0 = _mm_loadu_ps(par + 2 * PSF_LANES + h), y0 = _mm_loadu_ps(par + 3 * PSF_LANES + h);
+		__m128 b0 = _mm_loadu_ps(par + h), amp = _mm_loadu_ps(par + PSF_LANES + h);
+		__m128 alpha = _mm_loadu_ps(par + 4 * PSF_LANES + h), beta = _mm_loadu_ps(par + 5 * PSF_LANES + h);
+		__m128 ia2 = _mm_div_ps(_mm_set1_ps(1.0f), _mm_mul_ps(alpha, alpha));
+		__m128 ia = _mm_div_ps(_mm_set1_ps(1.0f), alpha), nbeta = _mm_sub_ps(_mm_setzero_ps(), beta);
+		__m128 c0 = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(2.0f), amp), _mm_mul_ps(beta, ia2));
+		__m128 namp = _mm_sub_ps(_mm_setzero_ps(), amp);
+		const float *ptr = pix + h;
+		int a, b, k;
+
+		for (k = 0; k < 21; ++k) aj[k] = _mm_setzero_ps();
+		for (k = 0; k < 6; ++k) ar[k] = _mm_setzero_ps();
+		j[0] = _mm_set1_ps(1.0f);
+		for (int gy = 0; gy < size; ++gy) {
+			__m128 dy = _mm_sub_ps(_mm_set1_ps(float(gy)), y0);
+			for (int gx = 0; gx < size; ++gx, ptr += PSF_LANES) {
+				__m128 dx = _mm_sub_ps(_mm_set1_ps(float(gx)), x0);
+				__m128 r2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+				__m128 u = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(r2, ia2));
+				__m128 lu = log_ps_sse2(u);
+				__m128 g = exp_ps_sse2(_mm_mul_ps(nbeta, lu));
+				__m128 c = _mm_div_ps(_mm_mul_ps(c0, g), u);
+				__m128 r = _mm_sub_ps(_mm_loadu_ps(ptr), _mm_add_ps(b0, _mm_mul_ps(amp, g)));
+				j[1] = g;
+				j[2] = _mm_mul_ps(c, dx);
+				j[3] = _mm_mul_ps(c, dy);
+				j[4] = _mm_mul_ps(_mm_mul_ps(c, r2), ia);
+				j[5] = _mm_mul_ps(_mm_mul_ps(namp, g), lu);
+				for (a = 0, k = 0; a < 6; ++a) {
+					ar[a] = _mm_add_ps(ar[a], _mm_mul_ps(j[a], r));
+					for (b = a; b < 6; ++b, ++k) aj[k] = _mm_add_ps(aj[k], _mm_mul_ps(j[a], j[b]));
+				}
+				ac = _mm_add_ps(ac, _mm_mul_ps(r, r));
+			}
+		}
+		for (k = 0; k < 21; ++k) _mm_storeu_ps(jtj + k * PSF_LANES + h, aj[k]);
+		for (k = 0; k < 6; ++k) _mm_storeu_ps(jtr + k * PSF_LANES + h, ar[k]);
+		_mm_storeu_ps(chi2 + h, ac);
+	}
+}
+
+/* AVX2实现 */
+__attribute__((target("avx2")))
+static void swap_offset_u16_avx2(const uint16_t *src, uint16_t *dst, size_t n) {
+	const __m256i mask = _mm256_set1_epi16(0x0080);
+	size_t i(0);
+
+	for (; i + 32 <= n; i += 32) {
+		__m256i v0 = _mm256_loadu_si256((const __m256i*) (src + i));
+		__m256i v1 = _mm256_loadu_si256((const __m256i*) (src + i + 16));
+		v0 = _mm256_xor_si256(_mm256_or_si256(_mm256_slli_epi16(v0, 8), _mm256_srli_epi16(v0, 8)), mask);
+		v1 = _mm256_xor_si256(_mm256_or_si256(_mm256_slli_epi16(v1, 8), _mm256_srli_epi16(v1, 8)), mask);
+		_mm256_storeu_si256((__m256i*) (dst + i), v0);
+		_mm256_storeu_si256((__m256i*) (dst + i + 16), v1);
+	}
+	swap_offset_u16_scalar(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void bin_u16_avx2(const uint16_t *src, int width, int height, int bin, uint16_t *dst) {
+	if (bin & 1) {
+		bin_u16_scalar(src, width, height, bin, dst);
+		return;
+	}
+
+	int wbin(width / bin), hbin(height / bin), npair(wbin * bin / 2), i;
+	boost::scoped_array<int32_t> acc(new int32_t[npair]);
+	const __m256i flip = _mm256_set1_epi16(short(0x8000));
+	const __m256i ones = _mm256_set1_epi16(1);
+
+	for (int j = 0; j < hbin; ++j, dst += wbin) {
+		memset(acc.get(), 0, npair * sizeof(int32_t));
+		for (int k = 0; k < bin; ++k, src += width) {
+			int32_t *ptr = acc.get();
+			for (i = 0; i + 8 <= npair; i += 8) {
+				__m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*) (src + 2 * i)), flip);
+				__m256i a = _mm256_loadu_si256((const __m256i*) (ptr + i));
+				_mm256_storeu_si256((__m256i*) (ptr + i), _mm256_add_epi32(a, _mm256_madd_epi16(v, ones)));
+			}
+			for (; i < npair; ++i) ptr[i] += int32_t(src[2 * i]) + src[2 * i + 1] - 65536;
+		}
+		bin_reduce_pairs(acc.get(), wbin, bin, dst);
+	}
+}
+
+__attribute__((target("avx2")))
+static void accum_minmax_u16_avx2(const uint16_t *src, uint32_t *sum, uint16_t *lo, uint16_t *hi, size_t n) {
+	size_t i(0);
+
+	for (; i + 16 <= n; i += 16) {
+		__m256i v = _mm256_loadu_si256((const __m256i*) (src + i));
+		__m256i s0 = _mm256_loadu_si256((const __m256i*) (sum + i));
+		__m256i s1 = _mm256_loadu_si256((const __m256i*) (sum + i + 8));
+		__m256i l = _mm256_loadu_si256((const __m256i*) (lo + i));
+		__m256i h = _mm256_loadu_si256((const __m256i*) (hi + i));
+		s0 = _mm256_add_epi32(s0, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(v)));
+		s1 = _mm256_add_epi32(s1, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(v, 1)));
+		_mm256_storeu_si256((__m256i*) (sum + i), s0);
+		_mm256_storeu_si256((__m256i*) (sum + i + 8), s1);
+		_mm256_storeu_si256((__m256i*) (lo + i), _mm256_min_epu16(l, v));
+		_mm256_storeu_si256((__m256i*) (hi + i), _mm256_max_epu16(h, v));
+	}
+	accum_minmax_u16_scalar(src + i, sum + i, lo + i, hi + i, n - i);
+}
+__attribute__((target("avx2")))
+static void calib_u16_avx2(const uint16_t *raw, const uint16_t *offset, const float *gain, float pedestal,
+		uint16_t *dst, size_t n) {
+	const __m256 ped = _mm256_set1_ps(pedestal);
+	const __m256 fmin = _mm256_setzero_ps();
+	const __m256 fmax = _mm256_set1_ps(65535.0f);
+	size_t i(0);
+
+	for (; i + 16 <= n; i += 16) {
+		__m256i r = _mm256_loadu_si256((const __m256i*) (raw + i));
+		__m256i o = _mm256_loadu_si256((const __m256i*) (offset + i));
+		__m256 f0 = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(r)),
+				_mm256_cvtepu16_epi32(_mm256_castsi256_si128(o))));
+		__m256 f1 = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(r, 1)),
+				_mm256_cvtepu16_epi32(_mm256_extracti128_si256(o, 1))));
+		f0 = _mm256_add_ps(_mm256_mul_ps(f0, _mm256_loadu_ps(gain + i)), ped);
+		f1 = _mm256_add_ps(_mm256_mul_ps(f1, _mm256_loadu_ps(gain + i + 8)), ped);
+		f0 = _mm256_min_ps(_mm256_max_ps(f0, fmin), fmax);
+		f1 = _mm256_min_ps(_mm256_max_ps(f1, fmin), fmax);
+		// packus按128位通道交错, 以permute恢复顺序
+		__m256i v = _mm256_packus_epi32(_mm256_cvtps_epi32(f0), _mm256_cvtps_epi32(f1));
+		_mm256_storeu_si256((__m256i*) (dst + i), _mm256_permute4x64_epi64(v, 0xD8));
+	}
+	calib_u16_scalar(raw + i, offset + i, gain + i, pedestal, dst + i, n - i);
+}
+__attribute__((target("avx2")))
+static void mask_fill_u16_avx2(const uint16_t *src, const uint8_t *bits, size_t bit0, uint16_t *dst, size_t n) {
+	const __m256i sel = _mm256_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128,
+			256, 512, 1024, 2048, 4096, 8192, 16384, short(0x8000));
+	size_t i(1), k;
+	uint32_t word;
+
+	if (n < 2) {
+		mask_fill_u16_scalar(src, bits, bit0, dst, n);
+		return;
+	}
+	uint16_t m0 = uint16_t(-((bits[bit0 >> 3] >> (bit0 & 7)) & 1));
+	dst[0] = uint16_t((src[1] & m0) | (src[0] & ~m0));
+	for (; i + 16 <= n; i += 16) {
+		k = bit0 + i;
+		memcpy(&word, bits + (k >> 3), sizeof(word));
+		__m256i m = _mm256_and_si256(_mm256_set1_epi16(short(word >> (k & 7))), sel);
+		m = _mm256_cmpeq_epi16(m, sel);
+		__m256i cur = _mm256_loadu_si256((const __m256i*) (src + i));
+		__m256i left = _mm256_loadu_si256((const __m256i*) (src + i - 1));
+		_mm256_storeu_si256((__m256i*) (dst + i), _mm256_blendv_epi8(cur, left, m));
+	}
+	for (k = bit0 + i; i < n; ++i, ++k) {
+		uint16_t m = uint16_t(-((bits[k >> 3] >> (k & 7)) & 1));
+		dst[i] = uint16_t((src[i - 1] & m) | (src[i] & ~m));
+	}
+}
+__attribute__((target("avx2")))
+static void shape_f32_avx2(const float *x2, const float *y2, const float *xy, float *e1, float *e2, size_t n) {
+	const __m256 two = _mm256_set1_ps(2.0f);
+	size_t i(0);
+
+	for (; i + 8 <= n; i += 8) {
+		__m256 a = _mm256_loadu_ps(x2 + i);
+		__m256 b = _mm256_loadu_ps(y2 + i);
+		__m256 r = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_add_ps(a, b));
+		_mm256_storeu_ps(e1 + i, _mm256_mul_ps(_mm256_sub_ps(a, b), r));
+		_mm256_storeu_ps(e2 + i, _mm256_mul_ps(_mm256_mul_ps(two, _mm256_loadu_ps(xy + i)), r));
+	}
+	shape_f32_scalar(x2 + i, y2 + i, xy + i, e1 + i, e2 + i, n - i);
+}
+__attribute__((target("avx2")))
+static inline __m256 exp_ps_avx2(__m256 x) {
+	const __m256 one = _mm256_set1_ps(1.0f);
+	__m256 fx, tmp, y, z;
+	__m256i emm0;
+
+	x  = _mm256_max_ps(_mm256_min_ps(x, _mm256_set1_ps(88.3762626647949f)), _mm256_set1_ps(-88.3762626647949f));
+	fx = _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f)), _mm256_set1_ps(0.5f));
+	tmp = _mm256_cvtepi32_ps(_mm256_cvttps_epi32(fx));
+	fx = _mm256_sub_ps(tmp, _mm256_and_ps(_mm256_cmp_ps(tmp, fx, _CMP_GT_OQ), one)); // floor
+	x  = _mm256_sub_ps(x, _mm256_mul_ps(fx, _mm256_set1_ps(0.693359375f)));
+	x  = _mm256_sub_ps(x, _mm256_mul_ps(fx, _mm256_set1_ps(-2.12194440e-4f)));
+	z  = _mm256_mul_ps(x, x);
+	y  = _mm256_set1_ps(1.9875691500E-4f);
+	y  = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(1.3981999507E-3f));
+	y  = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(8.3334519073E-3f));
+	y  = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(4.1665795894E-2f));
+	y  = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(1.6666665459E-1f));
+	y  = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(5.0000001201E-1f));
+	y  = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(y, z), x), one);
+	emm0 = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(fx), _mm256_set1_epi32(0x7f)), 23);
+	return _mm256_mul_ps(y, _mm256_castsi256_ps(emm0));
+}
+__attribute__((target("avx2")))
+static inline __m256 log_ps_avx2(__m256 x) {
+	const __m256 one = _mm256_set1_ps(1.0f);
+	__m256 e, mask, tmp, y, z;
+	__m256i emm0;
+
+	emm0 = _mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(x), 23), _mm256_set1_epi32(0x7f));
+	x = _mm256_or_ps(_mm256_and_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(~0x7f800000))), _mm256_set1_ps(0.5f));
+	e = _mm256_add_ps(_mm256_cvtepi32_ps(emm0), one);
+	mask = _mm256_cmp_ps(x, _mm256_set1_ps(0.707106781186547524f), _CMP_LT_OQ);
+	tmp = _mm256_and_ps(x, mask);
+	x = _mm256_add_ps(_mm256_sub_ps(x, one), tmp);
+	e = _mm256_sub_ps(e, _mm256_and_ps(one, mask));
+	z = _mm256_mul_ps(x, x);
+	y = _mm256_set1_ps(7.0376836292E-2f);
+	y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(-1.1514610310E-1f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(1.1676998740E-1f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(-1.2420140846E-1f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(1.4249322787E-1f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(-1.6668057665E-1f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(2.0000714765E-1f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(-2.4999993993E-1f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(3.3333331174E-1f));
+	y = _mm256_mul_ps(_mm256_mul_ps(y, x), z);
+	y = _mm256_add_ps(y, _mm256_mul_ps(e, _mm256_set1_ps(-2.12194440e-4f)));
+	y = _mm256_sub_ps(y, _mm256_mul_ps(z, _mm256_set1_ps(0.5f)));
+	x = _mm256_add_ps(x, y);
+	return _mm256_add_ps(x, _mm256_mul_ps(e, _mm256_set1_ps(0.693359375f)));
+}
+__attribute__((target("avx2")))
+static void gauss_normal_f32_avx2(const float *pix, int size, const float *par, float *jtj, float *jtr, float *chi2) {
+	for (int h = 0; h < PSF_LANES; h += 8) {
+		__m256 aj[15], ar[5], ac = _mm256_setzero_ps(), j[5];
+		__m256 x0 = _mm256_loadu_ps(par + 2 * PSF_LANES + h), y0 = _mm256_loadu_ps(par + 3 * PSF_LANES + h);
+		__m256 b0 = _mm256_loadu_ps(par + h), amp = _mm256_loadu_ps(par + PSF_LANES + h);
+		__m256 s = _mm256_loadu_ps(par + 4 * PSF_LANES + h);
+		__m256 q = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(s, s)), is = _mm256_div_ps(_mm256_set1_ps(1.0f), s);
+		__m256 nhq = _mm256_mul_ps(q, _mm256_set1_ps(-0.5f));
+		const float *ptr = pix + h;
+		int a, b, k;
+
+		for (k = 0; k < 15; ++k) aj[k] = _mm256_setzero_ps();
+		for (k = 0; k < 5; ++k) ar[k] = _mm256_setzero_ps();
+		j[0] = _mm256_set1_ps(1.0f);
+		for (int gy = 0; gy < size; ++gy) {
+			__m256 dy = _mm256_sub_ps(_mm256_set1_ps(float(gy)), y0);
+			for (int gx = 0; gx < size; ++gx, ptr += PSF_LANES) {
+				__m256 dx = _mm256_sub_ps(_mm256_set1_ps(float(gx)), x0);
+				__m256 r2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+				__m256 e = exp_ps_avx2(_mm256_mul_ps(r2, nhq));
+				__m256 aeq = _mm256_mul_ps(_mm256_mul_ps(amp, e), q);
+				__m256 r = _mm256_sub_ps(_mm256_loadu_ps(ptr), _mm256_add_ps(b0, _mm256_mul_ps(amp, e)));
+				j[1] = e;
+				j[2] = _mm256_mul_ps(aeq, dx);
+				j[3] = _mm256_mul_ps(aeq, dy);
+				j[4] = _mm256_mul_ps(_mm256_mul_ps(aeq, r2), is);
+				for (a = 0, k = 0; a < 5; ++a) {
+					ar[a] = _mm256_add_ps(ar[a], _mm256_mul_ps(j[a], r));
+					for (b = a; b < 5; ++b, ++k) aj[k] = _mm256_add_ps(aj[k], _mm256_mul_ps(j[a], j[b]));
+				}
+				ac = _mm256_add_ps(ac, _mm256_mul_ps(r, r));
+			}
+		}
+		for (k = 0; k < 15; ++k) _mm256_storeu_ps(jtj + k * PSF_LANES + h, aj[k]);
+		for (k = 0; k < 5; ++k) _mm256_storeu_ps(jtr + k * PSF_LANES + h, ar[k]);
+		_mm256_storeu_ps(chi2 + h, ac);
+	}
+}
+__attribute__((target("avx2")))
+static void moffat_normal_f32_avx2(const float *pix, int size, const float *par, float *jtj, float *jtr, float *chi2) {
+	for (int h = 0; h < PSF_LANES; h += 8) {
+		__m256 aj[21], ar[6], ac = _mm256_setzero_ps(), j[6];
+		__m256 x0 = _mm256_loadu_ps(par + 2 * PSF_LANES + h), y0 = _mm256_loadu_ps(par + 3 * PSF_LANES + h);
+		__m256 b0 = _mm256_loadu_ps(par + h), amp = _mm256_loadu_ps(par + PSF_LANES + h);
+		__m256 alpha = _mm256_loadu_ps(par + 4 * PSF_LANES + h), beta = _mm256_loadu_ps(par + 5 * PSF_LANES + h);
+		__m256 ia2 = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(alpha, alpha));
+		__m256 ia = _mm256_div_ps(_mm256_set1_ps(1.0f), alpha), nbeta = _mm256_sub_ps(_mm256_setzero_ps(), beta);
+		__m256 c0 = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(2.0f), amp), _mm256_mul_ps(beta, ia2));
+		__m256 namp = _mm256_sub_ps(_mm256_setzero_ps(), amp);
+		const float *ptr = pix + h;
+		int a, b, k;
+
+		for (k = 0; k < 21; ++k) aj[k] = _mm256_setzero_ps();
+		for (k = 0; k < 6; ++k) ar[k] = _mm256_setzero_ps();
+		j[0] = _mm256_set1_ps(1.0f);
+		for (int gy = 0; gy < size; ++gy) {
+			__m256 dy = _mm256_sub_ps(_mm256_set1_ps(float(gy)), y0);
+			for (int gx = 0; gx < size; ++gx, ptr += PSF_LANES) {
+				__m256 dx = _mm256_sub_ps(_mm256_set1_ps(float(gx)), x0);
+				__m256 r2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+				__m256 u = _mm256_add_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(r2, ia2));
+				__m256 lu = log_ps_avx2(u);
+				__m256 g = exp_ps_avx2(_mm256_mul_ps(nbeta, lu));
+				__m256 c = _mm256_div_ps(_mm256_mul_ps(c0, g), u);
+				__m256 r = _mm256_sub_ps(_mm256_loadu_ps(ptr), _mm256_add_ps(b0, _mm256_mul_ps(amp, g)));
+				j[1] = g;
+				j[2] = _mm256_mul_ps(c, dx);
+				j[3] = _mm256_mul_ps(c, dy);
+				j[4] = _mm256_mul_ps(_mm256_mul_ps(c, r2), ia);
+				j[5] = _mm256_mul_ps(_mm256_mul_ps(namp, g), lu);
+				for (a = 0, k = 0; a < 6; ++a) {
+					ar[a] = _mm256_add_ps(ar[a], _mm256_mul_ps(j[a], r));
+					for (b = a; b < 6; ++b, ++k) aj[k] = _mm256_add_ps(aj[k], _mm256_mul_ps(j[a], j[b]));
+				}
+				ac = _mm256_add_ps(ac, _mm256_mul_ps(r, r));
+			}
+		}
+		for (k = 0; k < 21; ++k) _mm256_storeu_ps(jtj + k * PSF_LANES + h, aj[k]);
+		for (k = 0; k < 6; ++k) _mm256_storeu_ps(jtr + k * PSF_LANES + h, ar[k]);
+		_mm256_storeu_ps(chi2 + h, ac);
+	}
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+/* 运行时选择 */
+struct kernel_table {// 核函数表
+	int isa;	//< 指令集
+	void (*swap_offset_u16)(const uint16_t*, uint16_t*, size_t);
+	void (*bin_u16)(const uint16_t*, int, int, int, uint16_t*);
+	void (*accum_minmax_u16)(const uint16_t*, uint32_t*, uint16_t*, uint16_t*, size_t);
+	void (*calib_u16)(const uint16_t*, const uint16_t*, const float*, float, uint16_t*, size_t);
+	void (*mask_fill_u16)(const uint16_t*, const uint8_t*, size_t, uint16_t*, size_t);
+	void (*shape_f32)(const float*, const float*, const float*, float*, float*, size_t);
+	void (*gauss_normal_f32)(const float*, int, const float*, float*, float*, float*);
+	void (*moffat_normal_f32)(const float*, int, const float*, float*, float*, float*);
+};
+
+static kernel_table kernels = { -1, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+static boost::once_flag kernels_once = BOOST_ONCE_INIT;	//< 核函数表初始化标志
+
+/*!
+ * @brief 检测CPU支持的最高指令集
+ */
+static int detect_isa() {
+#ifdef PIXKERNEL_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return PIXISA_AVX2;
+	if (__builtin_cpu_supports("sse2")) return PIXISA_SSE2;
+#endif
+	return PIXISA_SCALAR;
+}
+
+/*!
+ * @brief 按指令集填充核函数表
+ * @param isa   指令集. 若CPU不支持, 则采用CPU支持的最高指令集
+ * @param table 核函数表
+ */
+static void fill_kernels(int isa, kernel_table &table) {
+	int best = detect_isa();
+	if (isa < 0 || isa > best) isa = best;
+
+	table.isa = PIXISA_SCALAR;
+	table.swap_offset_u16 = swap_offset_u16_scalar;
+	table.bin_u16 = bin_u16_scalar;
+	table.accum_minmax_u16 = accum_minmax_u16_scalar;
+	table.calib_u16 = calib_u16_scalar;
+	table.mask_fill_u16 = mask_fill_u16_scalar;
+	table.shape_f32 = shape_f32_scalar;
+	table.gauss_normal_f32 = gauss_normal_f32_scalar;
+	table.moffat_normal_f32 = moffat_normal_f32_scalar;
+#ifdef PIXKERNEL_X86
+	if (isa == PIXISA_AVX2) {
+		table.isa = PIXISA_AVX2;
+		table.swap_offset_u16 = swap_offset_u16_avx2;
+		table.bin_u16 = bin_u16_avx2;
+		table.accum_minmax_u16 = accum_minmax_u16_avx2;
+		table.calib_u16 = calib_u16_avx2;
+		table.mask_fill_u16 = mask_fill_u16_avx2;
+		table.shape_f32 = shape_f32_avx2;
+		table.gauss_normal_f32 = gauss_normal_f32_avx2;
+		table.moffat_normal_f32 = moffat_normal_f32_avx2;
+	}
+	else if (isa == PIXISA_SSE2) {
+		table.isa = PIXISA_SSE2;
+		table.swap_offset_u16 = swap_offset_u16_sse2;
+		table.bin_u16 = bin_u16_sse2;
+		table.accum_minmax_u16 = accum_minmax_u16_sse2;
+		table.calib_u16 = calib_u16_sse2;
+		table.mask_fill_u16 = mask_fill_u16_sse2;
+		table.shape_f32 = shape_f32_sse2;
+		table.gauss_normal_f32 = gauss_normal_f32_sse2;
+		table.moffat_normal_f32 = moffat_normal_f32_sse2;
+	}
+#endif
+}
+
+/*!
+ * @brief 采用CPU支持的最高指令集初始化核函数表
+ */
+static void init_kernels() {
+	fill_kernels(PIXISA_LAST, kernels);
+}
+
+/*!
+ * @brief 查找核函数表
+ * @note
+ * 多个线程可能同时首次调用核函数, 由call_once保证核函数表只初始化一次
+ */
+static inline const kernel_table& get_kernels() {
+	boost::call_once(init_kernels, kernels_once);
+	return kernels;
+}
+
+int pixkernel_select(int isa) {
+	kernel_table table;
+
+	boost::call_once(init_kernels, kernels_once);
+	fill_kernels(isa, table);
+	kernels = table;
+
+	return kernels.isa;
+}
+
+int pixkernel_isa() {
+	return get_kernels().isa;
+}
+
+const char *pixkernel_isa_name(int isa) {
+	static const char *names[] = {"scalar", "sse2", "avx2"};
+	return (isa >= PIXISA_SCALAR && isa < PIXISA_LAST) ? names[isa] : "unknown";
+}
+
+void swap_offset_u16(const uint16_t *src, uint16_t *dst, size_t n) {
+	get_kernels().swap_offset_u16(src, dst, n);
+}
+
+void swap_offset_u16(uint16_t *data, size_t n) {
+	get_kernels().swap_offset_u16(data, data, n);
+}
+
+void bin_u16(const uint16_t *src, int width, int height, int bin, uint16_t *dst) {
+	if (bin <= 1) memcpy(dst, src, size_t(width) * height * sizeof(uint16_t));
+	else get_kernels().bin_u16(src, width, height, bin, dst);
+}
+
+void accum_minmax_u16(const uint16_t *src, uint32_t *sum, uint16_t *lo, uint16_t *hi, size_t n) {
+	get_kernels().accum_minmax_u16(src, sum, lo, hi, n);
+}
+
+void calib_u16(const uint16_t *raw, const uint16_t *offset, const float *gain, float pedestal,
+		uint16_t *dst, size_t n) {
+	get_kernels().calib_u16(raw, offset, gain, pedestal, dst, n);
+}
+
+void mask_fill_u16(const uint16_t *src, const uint8_t *bits, size_t bit0, uint16_t *dst, size_t n) {
+	get_kernels().mask_fill_u16(src, bits, bit0, dst, n);
+}
+
+void shape_f32(const float *x2, const float *y2, const float *xy, float *e1, float *e2, size_t n) {
+	get_kernels().shape_f32(x2, y2, xy, e1, e2, n);
+}
+
+void gauss_normal_f32(const float *pix, int size, const float *par, float *jtj, float *jtr, float *chi2) {
+	get_kernels().gauss_normal_f32(pix, size, par, jtj, jtr, chi2);
+}
+
+void moffat_normal_f32(const float *pix, int size, const float *par, float *jtj, float *jtr, float *chi2) {
+	get_kernels().moffat_normal_f32(pix, size, par, jtj, jtr, chi2);
+}
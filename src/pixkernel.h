@@ -0,0 +1,141 @@
+/*
+ * @file pixkernel.h 图像像素级核函数声明文件
+ * @date 2026-10-18
+ * @version 0.1
+ * @note
+ * - 核函数按CPU指令集(SSE2/AVX2)在运行时选择实现, 首次调用前自动完成选择
+ * - 16位图像按FITS约定存储: BITPIX=16, BZERO=32768, 大端字节序
+ * - 除图像外, 亦包括按列存储的星像表上的逐星计算
+ */
+
+#ifndef PIXKERNEL_H_
+#define PIXKERNEL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define PSF_LANES	8	// PSF拟合批次的星像数
+
+enum PIXKERNEL_ISA {// 核函数指令集
+	PIXISA_SCALAR,	// 标量
+	PIXISA_SSE2,	// SSE2
+	PIXISA_AVX2,	// AVX2
+	PIXISA_LAST		// 占位
+};
+
+/*!
+ * @brief 查看当前采用的指令集
+ * @return
+ * 指令集
+ */
+extern int pixkernel_isa();
+/*!
+ * @brief 查看指令集名称
+ * @param isa 指令集
+ * @return
+ * 名称
+ */
+extern const char *pixkernel_isa_name(int isa);
+/*!
+ * @brief 强制采用指定指令集
+ * @param isa 指令集
+ * @return
+ * 实际采用的指令集. 若CPU不支持isa, 则采用CPU支持的最高指令集
+ * @note
+ * 用于性能测试与对比, 正常流程不需要调用.
+ * 切换核函数表不加锁, 调用时不可有其它线程正在使用核函数
+ */
+extern int pixkernel_select(int isa);
+/*!
+ * @brief 16位无符号图像转换为FITS存储格式: 减BZERO并转换为大端字节序
+ * @param src 主机字节序数据
+ * @param dst 转换后数据. 可与src相同
+ * @param n   像素数
+ */
+extern void swap_offset_u16(const uint16_t *src, uint16_t *dst, size_t n);
+/*!
+ * @brief 16位无符号图像原位转换为FITS存储格式
+ * @param data 数据
+ * @param n    像素数
+ */
+extern void swap_offset_u16(uint16_t *data, size_t n);
+/*!
+ * @brief 16位图像合并: bin×bin像素取平均值
+ * @param src    原始图像
+ * @param width  原始图像宽度
+ * @param height 原始图像高度
+ * @param bin    合并因子
+ * @param dst    合并后图像, 尺寸为(width / bin)×(height / bin)
+ * @note
+ * 不足bin的右侧列与底部行被舍弃
+ */
+extern void bin_u16(const uint16_t *src, int width, int height, int bin, uint16_t *dst);
+/*!
+ * @brief 逐像素累加16位图像, 并更新极小值与极大值
+ * @param src 图像
+ * @param sum 累加和
+ * @param lo  极小值
+ * @param hi  极大值
+ * @param n   像素数
+ * @note
+ * 用于合并本底/暗场: 剔除极小与极大值后取平均
+ */
+extern void accum_minmax_u16(const uint16_t *src, uint32_t *sum, uint16_t *lo, uint16_t *hi, size_t n);
+/*!
+ * @brief 定标: 扣除偏置与暗流, 除以平场
+ * @param raw      原始图像
+ * @param offset   偏置与暗流之和
+ * @param gain     平场归一化系数的倒数
+ * @param pedestal 输出基底, 避免负值被截断
+ * @param dst      定标后图像: (raw - offset) * gain + pedestal, 四舍五入并限定在[0, 65535]
+ * @param n        像素数
+ */
+extern void calib_u16(const uint16_t *raw, const uint16_t *offset, const float *gain, float pedestal,
+		uint16_t *dst, size_t n);
+/*!
+ * @brief 以左侧相邻像素替换坏像素, 行首像素以右侧相邻像素替换
+ * @param src  图像行
+ * @param bits 坏像素位图, 低位在前. 末尾须至少多分配8字节
+ * @param bit0 src[0]在位图中的序号
+ * @param dst  替换后图像行. 不可与src相同
+ * @param n    像素数
+ */
+extern void mask_fill_u16(const uint16_t *src, const uint8_t *bits, size_t bit0, uint16_t *dst, size_t n);
+/*!
+ * @brief 由二阶矩计算星像形状的两个分量
+ * @param x2 X二阶矩
+ * @param y2 Y二阶矩
+ * @param xy 交叉二阶矩
+ * @param e1 (x2 - y2) / (x2 + y2)
+ * @param e2 2xy / (x2 + y2)
+ * @param n  星像数
+ * @note
+ * x2 + y2须大于0. 分量可直接平均, 由平均值换算椭率与位置角
+ */
+extern void shape_f32(const float *x2, const float *y2, const float *xy, float *e1, float *e2, size_t n);
+/*!
+ * @brief 二维圆高斯PSF: 对一批星像累加Levenberg-Marquardt法方程
+ * @param pix  星像子图, size×size×PSF_LANES. 像素(gx, gy)第l个星像位于((gy * size + gx) * PSF_LANES + l)
+ * @param size 子图边长
+ * @param par  参数, 5×PSF_LANES, 依次为背景B、幅度A、中心x0、y0(子图坐标)与σ.
+ *             模型: B + A·exp(-r²/(2σ²))
+ * @param jtj  JᵀJ上三角(按行), 15×PSF_LANES
+ * @param jtr  Jᵀr, r = 像素值 - 模型值, 5×PSF_LANES
+ * @param chi2 残差平方和, PSF_LANES
+ * @note
+ * 各星像对应SIMD的一个通道, 同一像素位置的PSF_LANES个星像同时计算
+ */
+extern void gauss_normal_f32(const float *pix, int size, const float *par, float *jtj, float *jtr, float *chi2);
+/*!
+ * @brief 二维圆Moffat PSF: 对一批星像累加Levenberg-Marquardt法方程
+ * @param pix  星像子图, 排列同gauss_normal_f32()
+ * @param size 子图边长
+ * @param par  参数, 6×PSF_LANES, 依次为背景B、幅度A、中心x0、y0、α与β.
+ *             模型: B + A·(1 + r²/α²)^(-β)
+ * @param jtj  JᵀJ上三角(按行), 21×PSF_LANES
+ * @param jtr  Jᵀr, 6×PSF_LANES
+ * @param chi2 残差平方和, PSF_LANES
+ */
+extern void moffat_normal_f32(const float *pix, int size, const float *par, float *jtj, float *jtr, float *chi2);
+
+#endif /* PIXKERNEL_H_ */
@@ -3,15 +3,24 @@
 #include <stdio.h>
 #include "termscreen.h"
 
+static bool enabled = true;	// 控制台显示启用标志
+
+void EnableScreen(bool enable) {
+	enabled = enable;
+}
+
 void ClearScreen() {
+	if (!enabled) return;
 	printf("\033[2J\033[1;1H");
 }
 
 void MovetoXY(int x, int y) {
+	if (!enabled) return;
 	printf("\033[%d;%dH", y, x);
 }
 
 void PrintXY(int x, int y, const char *format, ...) {
+	if (!enabled) return;
 	MovetoXY(1, y);
 	printf("\033[0K");	// clear line y
 	MovetoXY(x, y);
@@ -22,10 +31,12 @@ void PrintXY(int x, int y, const char *format, ...) {
 }
 
 void ShowCursor(bool show) {
+	if (!enabled) return;
 	if (show) printf("\033[?25h");
 	else      printf("\033[?25l");
 }
 
 void UpdateScreen() {
+	if (!enabled) return;
 	fflush(stdout);
 }
@@ -5,6 +5,13 @@
 #ifndef _TERM_SCREEN_H_
 #define _TERM_SCREEN_H_
 
+/*!
+ * @brief 启用或禁用控制台显示
+ * @param enable true: 启用; false: 禁用, 后续显示函数不产生输出
+ * @note
+ * 用于后台服务模式, 避免向标准输出写入控制码
+ */
+extern void EnableScreen(bool enable);
 /*!
  * @brief 清除屏幕
  */
@@ -104,3 +104,7 @@ void udp_session::write(const void *data, const int n) {
 			boost::bind(&udp_session::handle_send, this,
 					asio::placeholders::error, asio::placeholders::bytes_transferred));
 }
+
+boost::thread::native_handle_type udp_session::native_handle() {
+	return keep_.native_handle();
+}
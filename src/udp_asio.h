@@ -73,6 +73,12 @@ public:
 	 * 操作结果
 	 */
 	void write(const void *data, const int n);
+	/*!
+	 * @brief 查看接收线程句柄
+	 * @return
+	 * 线程句柄. 接收回调函数在该线程中执行
+	 */
+	boost::thread::native_handle_type native_handle();
 
 public:
 	/*!